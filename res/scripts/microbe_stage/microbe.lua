@@ -18,10 +18,10 @@ end
 
 function MicrobeComponent:load(storage)
     Component.load(self, storage)
-    local organelles = storage:get("organelles", {})
-    for i = 1,organelles:size() do
-        local organelleStorage = organelles:get(i)
-        local organelle = Organelle.loadOrganelle(organelleStorage)
+    -- Converts only what is read, in native code
+    local organelles = storage:view().organelles or {}
+    for i = 1,#organelles do
+        local organelle = Organelle.loadOrganelle(organelles[i])
         local q = organelle.position.q
         local r = organelle.position.r
         local s = encodeAxial(q, r)
@@ -33,12 +33,11 @@ end
 function MicrobeComponent:storage()
     local storage = Component.storage(self)
     -- Organelles
-    local organelles = StorageList()
+    local organelles = {}
     for _, organelle in pairs(self.organelles) do
-        local organelleStorage = organelle:storage()
-        organelles:append(organelleStorage)
+        table.insert(organelles, organelle:storage())
     end
-    storage:set("organelles", organelles)
+    storage:fromTable{ organelles = organelles }
     return storage
 end
 
@@ -68,7 +67,7 @@ function Microbe.createMicrobeEntity(name)
         entity = Entity()
     end
     local rigidBody = RigidBodyComponent()
-    rigidBody.properties.shape = CompoundShape()
+    rigidBody.properties.shape = MultiCircleShape(HEX_SIZE)
     rigidBody.properties.linearDamping = 0.5
     rigidBody.properties.friction = 0.2
     rigidBody.properties.linearFactor = Vector3(1, 1, 0)
@@ -136,12 +135,9 @@ function Microbe:addOrganelle(q, r, organelle)
     organelle.microbe = self
     local x, y = axialToCartesian(q, r)
     local translation = Vector3(x, y, 0)
-    -- Collision shape
-    self.rigidBody.properties.shape:addChildShape(
-        translation,
-        Quaternion(Radian(0), Vector3(1,0,0)),
-        organelle.collisionShape
-    )
+    -- Collision shape, rebuilt once per frame by the physics
+    organelle:addCollisionCircles(self.rigidBody.properties.shape, x, y)
+    self.rigidBody.properties:touch()
     -- Scene node
     organelle.sceneNode.parent = self.entity
     organelle.sceneNode.transform.position = translation
@@ -217,12 +213,15 @@ end
 --  True if an organelle has been removed, false if there was no organelle
 --  at (q,r)
 function Microbe:removeOrganelle(q, r)
-    local index = nil
     local s = encodeAxial(q, r)
-    local organelle = table.remove(self.microbe.organelles, index)
+    local organelle = self.microbe.organelles[s]
     if not organelle then
         return false
     end
+    self.microbe.organelles[s] = nil
+    local x, y = axialToCartesian(q, r)
+    organelle:removeCollisionCircles(self.rigidBody.properties.shape, x, y)
+    self.rigidBody.properties:touch()
     organelle.position.q = 0
     organelle.position.r = 0
     organelle:onRemovedFromMicrobe(self)
@@ -325,6 +324,10 @@ end
 
 -- Private function for initializing a microbe's components
 function Microbe:_initialize()
+    -- Savegames from before MultiCircleShape store a CompoundShape
+    if class_info(self.rigidBody.properties.shape).name ~= "MultiCircleShape" then
+        self.rigidBody.properties.shape = MultiCircleShape(HEX_SIZE)
+    end
     self.rigidBody.properties.shape:clear()
     -- Organelles
     for s, organelle in pairs(self.microbe.organelles) do
@@ -334,17 +337,14 @@ function Microbe:_initialize()
         local x, y = axialToCartesian(q, r)
         local translation = Vector3(x, y, 0)
         -- Collision shape
-        self.rigidBody.properties.shape:addChildShape(
-            translation,
-            Quaternion(Radian(0), Vector3(1,0,0)),
-            organelle.collisionShape
-        )
+        organelle:addCollisionCircles(self.rigidBody.properties.shape, x, y)
         -- Scene node
         organelle.sceneNode.parent = self.entity
         organelle.sceneNode.transform.position = translation
         organelle.sceneNode.transform:touch()
         organelle:onAddedToMicrobe(self, q, r)
     end
+    self.rigidBody.properties:touch()
     self:_updateAllHexColours()
     self.microbe.initialized = true
 end
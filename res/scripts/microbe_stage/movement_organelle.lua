@@ -17,16 +17,18 @@ end
 
 function MovementOrganelle:load(storage)
     Organelle.load(self, storage)
-    self.energyMultiplier = storage:get("energyMultiplier", 0.025)
-    self.force = storage:get("force", Vector3(0,0,0))
-    self.torque = storage:get("torque", Vector3(0,0,0))
+    self.energyMultiplier = storage.energyMultiplier or 0.025
+    self.force = storage.force or Vector3(0,0,0)
+    self.torque = storage.torque or Vector3(0,0,0)
 end
 
 function MovementOrganelle:storage()
     local storage = Organelle.storage(self)
-    storage:set("energyMultiplier", self.energyMultiplier)
-    storage:set("force", self.force)
-    storage:set("torque", self.torque)
+    storage:fromTable{
+        energyMultiplier = self.energyMultiplier,
+        force = self.force,
+        torque = self.torque
+    }
     return storage
 end
 
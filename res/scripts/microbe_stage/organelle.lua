@@ -2,8 +2,11 @@
 class 'Organelle'
 
 -- Factory function for organelles
+--
+-- @param storage
+--  A view of the organelle's storage, see StorageContainer:view()
 function Organelle.loadOrganelle(storage)
-    local className = storage:get("className", "")
+    local className = storage.className or ""
     local cls = _G[className]
     local organelle = cls()
     organelle:load(storage)
@@ -16,7 +19,6 @@ function Organelle:__init()
     self.entity = Entity()
     self.entity:setVolatile(true)
     self.sceneNode = self.entity:getOrCreate(OgreSceneNodeComponent)
-    self.collisionShape = CompoundShape()
     self._hexes = {}
     self.position = {
         q = 0,
@@ -46,7 +48,6 @@ function Organelle:addHex(q, r)
         q = q,
         r = r,
         entity = Entity(),
-        collisionShape = SphereShape(HEX_SIZE),
         sceneNode = OgreSceneNodeComponent()
     }
     local x, y = axialToCartesian(q, r)
@@ -58,17 +59,26 @@ function Organelle:addHex(q, r)
     hex.sceneNode.transform:touch()
     hex.sceneNode.meshName = "hex.mesh"
     hex.entity:addComponent(hex.sceneNode)
-    -- Collision shape
-    self.collisionShape:addChildShape(
-        translation,
-        Quaternion(Radian(0), Vector3(1,0,0)),
-        hex.collisionShape
-    )
     self._hexes[s] = hex
     return true
 end
 
 
+-- Adds a circle per hex to a collision shape
+--
+-- @param shape
+--  The MultiCircleShape of the microbe
+--
+-- @param x, y
+--  The organelle's center in the shape
+function Organelle:addCollisionCircles(shape, x, y)
+    for _, hex in pairs(self._hexes) do
+        local hexX, hexY = axialToCartesian(hex.q, hex.r)
+        shape:addCircle(Vector3(x + hexX, y + hexY, 0))
+    end
+end
+
+
 -- Retrieves a hex
 --
 -- @param q, r
@@ -82,19 +92,21 @@ function Organelle:getHex(q, r)
 end
 
 
+-- Loads the organelle
+--
+-- @param storage
+--  A view of the organelle's storage, see StorageContainer:view()
 function Organelle:load(storage)
-    local hexes = storage:get("hexes", {})
-    for i = 1,hexes:size() do
-        local hexStorage = hexes:get(i)
-        local q = hexStorage:get("q", 0)
-        local r = hexStorage:get("r", 0)
-        self:addHex(q, r)
+    local hexes = storage.hexes or {}
+    for i = 1,#hexes do
+        local hex = hexes[i]
+        self:addHex(hex.q or 0, hex.r or 0)
     end
-    self.position.q = storage:get("q", 0)
-    self.position.r = storage:get("r", 0)
-    self._colour = storage:get("colour", ColourValue.White)
-    self._internalEdgeColour = storage:get("internalEdgeColour", ColourValue.Grey)
-    self._externalEdgeColour = storage:get("externalEdgeColour", ColourValue.Black)
+    self.position.q = storage.q or 0
+    self.position.r = storage.r or 0
+    self._colour = storage.colour or ColourValue.White
+    self._internalEdgeColour = storage.internalEdgeColour or ColourValue.Grey
+    self._externalEdgeColour = storage.externalEdgeColour or ColourValue.Black
 end
 
 
@@ -137,7 +149,6 @@ function Organelle:removeHex(q, r)
     local hex = table.remove(self._hexes, s)
     if hex then
         hex.entity:destroy()
-        self.collisionShape:removeChildShape(hex.collisionShape)
         return true
     else
         return false
@@ -145,6 +156,21 @@ function Organelle:removeHex(q, r)
 end
 
 
+-- Removes the circles added by addCollisionCircles
+--
+-- @param shape
+--  The MultiCircleShape of the microbe
+--
+-- @param x, y
+--  The organelle's center in the shape
+function Organelle:removeCollisionCircles(shape, x, y)
+    for _, hex in pairs(self._hexes) do
+        local hexX, hexY = axialToCartesian(hex.q, hex.r)
+        shape:removeCircleAt(Vector3(x + hexX, y + hexY, 0))
+    end
+end
+
+
 -- Sets the organelle's colour
 --
 -- Temporary until we use proper models for the organelles
@@ -155,21 +181,21 @@ end
 
 
 function Organelle:storage()
-    storage = StorageContainer()
-    storage:set("className", class_info(self).name)
-    hexes = StorageList()
+    local hexes = {}
     for _, hex in pairs(self._hexes) do
-        hexStorage = StorageContainer()
-        hexStorage:set("q", hex.q)
-        hexStorage:set("r", hex.r)
-        hexes:append(hexStorage)
+        table.insert(hexes, { q = hex.q, r = hex.r })
     end
-    storage:set("hexes", hexes)
-    storage:set("q", self.position.q)
-    storage:set("r", self.position.r)
-    storage:set("colour", self._colour)
-    storage:set("internalEdgeColour", self._internalEdgeColour)
-    storage:set("externalEdgeColour", self._externalEdgeColour)
+    -- One native call instead of one per field
+    local storage = StorageContainer()
+    storage:fromTable{
+        className = class_info(self).name,
+        hexes = hexes,
+        q = self.position.q,
+        r = self.position.r,
+        colour = self._colour,
+        internalEdgeColour = self._internalEdgeColour,
+        externalEdgeColour = self._externalEdgeColour
+    }
     return storage
 end
 
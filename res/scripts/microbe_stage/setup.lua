@@ -1,4 +1,5 @@
 Engine:setPhysicsDebugDrawingEnabled(true)
+Engine:setPhysicsPlanar(true)
 
 ADD_SYSTEM(MicrobeSystem)
 ADD_SYSTEM(MicrobeCameraSystem)
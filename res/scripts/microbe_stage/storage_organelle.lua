@@ -10,18 +10,20 @@ function Vacuole:__init(agentId, capacity, amount)
 end
 
 function Vacuole.load(storage)
-    local agentId = storage:get("agentId", 0)
-    local capacity = storage:get("capacity", 0)
-    local amount = storage:get("amount", 0)
+    local agentId = storage.agentId or 0
+    local capacity = storage.capacity or 0
+    local amount = storage.amount or 0
     return Vacuole(agentId, capacity, amount)
 end
 
 
 function Vacuole:storage()
     local storage = StorageContainer()
-    storage:set("agentId", self.agentId)
-    storage:set("capacity", self.capacity)
-    storage:set("amount", self.amount)
+    storage:fromTable{
+        agentId = self.agentId,
+        capacity = self.capacity,
+        amount = self.amount
+    }
     return storage
 end
 
@@ -45,8 +47,7 @@ end
 
 function StorageOrganelle:load(storage)
     Organelle.load(self, storage)
-    local vacuoleStorage = storage:get("vacuole", StorageContainer())
-    self._vacuole = Vacuole.load(vacuoleStorage)
+    self._vacuole = Vacuole.load(storage.vacuole or {})
 end
 
 
@@ -4,6 +4,8 @@ function QuickSaveSystem:__init()
     System.__init(self)
     self.saveDown = false
     self.loadDown = false
+    self.saveStatus = SaveSystem.Idle
+    self.loadStatus = LoadSystem.Idle
 end
 
 
@@ -18,6 +20,24 @@ function QuickSaveSystem:update(milliseconds)
     end
     self.saveDown = saveDown
     self.loadDown = loadDown
+    local saveStatus = Engine.saveSystem.status
+    if saveStatus ~= self.saveStatus then
+        if saveStatus == SaveSystem.Succeeded then
+            print("Game saved")
+        elseif saveStatus == SaveSystem.Failed then
+            print("Saving failed: " .. Engine.saveSystem.errorMessage)
+        end
+        self.saveStatus = saveStatus
+    end
+    local loadStatus = Engine.loadSystem.status
+    if loadStatus ~= self.loadStatus then
+        if loadStatus == LoadSystem.Succeeded then
+            print("Game loaded")
+        elseif loadStatus == LoadSystem.Failed then
+            print("Loading failed: " .. Engine.loadSystem.errorMessage)
+        end
+        self.loadStatus = loadStatus
+    end
 end
 
 ADD_SYSTEM(QuickSaveSystem)
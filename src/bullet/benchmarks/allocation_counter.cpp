@@ -0,0 +1,130 @@
+#include "bullet/benchmarks/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace thrive;
+
+namespace {
+
+// Keeps the alignment malloc guarantees
+const size_t HEADER_SIZE = 16;
+
+std::atomic<size_t> g_liveBytes(0);
+
+}
+
+
+void*
+thrive::countedAllocate(
+    size_t size
+) {
+    auto block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+    if (not block) {
+        return nullptr;
+    }
+    std::memcpy(block, &size, sizeof(size));
+    g_liveBytes += size;
+    return block + HEADER_SIZE;
+}
+
+
+void
+thrive::countedFree(
+    void* pointer
+) {
+    if (not pointer) {
+        return;
+    }
+    auto block = static_cast<char*>(pointer) - HEADER_SIZE;
+    size_t size = 0;
+    std::memcpy(&size, block, sizeof(size));
+    g_liveBytes -= size;
+    std::free(block);
+}
+
+
+size_t
+thrive::liveBytes() {
+    return g_liveBytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Global operator new and delete
+////////////////////////////////////////////////////////////////////////////////
+
+// In a translation unit of their own, so that the compiler can't inline
+// them into code that uses them
+
+void*
+operator new(
+    size_t size
+) {
+    void* pointer = countedAllocate(size == 0 ? 1 : size);
+    if (not pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+
+void*
+operator new(
+    size_t size,
+    const std::nothrow_t&
+) noexcept {
+    return countedAllocate(size == 0 ? 1 : size);
+}
+
+
+void*
+operator new[](
+    size_t size
+) {
+    return operator new(size);
+}
+
+
+void*
+operator new[](
+    size_t size,
+    const std::nothrow_t& tag
+) noexcept {
+    return operator new(size, tag);
+}
+
+
+void
+operator delete(
+    void* pointer
+) noexcept {
+    countedFree(pointer);
+}
+
+
+void
+operator delete(
+    void* pointer,
+    const std::nothrow_t&
+) noexcept {
+    countedFree(pointer);
+}
+
+
+void
+operator delete[](
+    void* pointer
+) noexcept {
+    countedFree(pointer);
+}
+
+
+void
+operator delete[](
+    void* pointer,
+    const std::nothrow_t&
+) noexcept {
+    countedFree(pointer);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+namespace thrive {
+
+/**
+* @brief Allocates memory and counts it in liveBytes()
+*
+* The benchmark executable replaces the global operator new with this.
+* Bullet allocates through its own functions, pass countedAllocate()
+* and countedFree() to btAlignedAllocSetCustom() to count Bullet's
+* objects as well.
+*
+* @param size
+*   The number of bytes
+*
+* @return
+*   The memory or \c nullptr if out of memory
+*/
+void*
+countedAllocate(
+    size_t size
+);
+
+/**
+* @brief Frees memory from countedAllocate()
+*
+* @param pointer
+*   The memory or \c nullptr
+*/
+void
+countedFree(
+    void* pointer
+);
+
+/**
+* @brief The number of bytes allocated and not yet freed
+*/
+size_t
+liveBytes();
+
+}
@@ -0,0 +1,95 @@
+#include "bullet/collision_shape.h"
+
+#include "bullet/benchmarks/allocation_counter.h"
+#include "engine/serialization.h"
+
+#include <boost/chrono.hpp>
+#include <functional>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iostream>
+#include <LinearMath/btAlignedAllocator.h>
+#include <utility>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+/**
+* @brief An emitted agent as it was before agents got sensor objects
+*/
+struct Particle {
+
+    std::unique_ptr<btCollisionObject> object;
+
+    CollisionShape::Ptr shape;
+
+};
+
+using ShapeFactory = std::function<CollisionShape::Ptr()>;
+
+
+/**
+* @brief Spawns particles and prints the time and memory per particle
+*/
+void
+spawnParticles(
+    const char* name,
+    int particleCount,
+    const ShapeFactory& makeShape
+) {
+    using Clock = boost::chrono::steady_clock;
+    std::vector<Particle> particles;
+    particles.reserve(particleCount);
+    size_t bytesBefore = liveBytes();
+    auto start = Clock::now();
+    for (int i = 0; i < particleCount; ++i) {
+        Particle particle;
+        particle.shape = makeShape();
+        particle.object.reset(new btCollisionObject());
+        particle.object->setCollisionShape(particle.shape->bulletShape());
+        particles.push_back(std::move(particle));
+    }
+    boost::chrono::duration<double, boost::micro> duration = Clock::now() - start;
+    size_t bytes = liveBytes() - bytesBefore;
+    EXPECT_GT(bytes, 0u);
+    std::cout << std::setw(14) << name << std::setw(10) << particleCount;
+    std::cout << std::setw(16) << std::fixed << std::setprecision(3) << duration.count() / particleCount;
+    std::cout << std::setw(18) << std::setprecision(1) << double(bytes) / particleCount << std::endl;
+}
+
+}
+
+
+TEST(CollisionShapeBenchmark, ParticleSpawning) {
+    // Bullet allocates its objects itself. Nothing that Bullet allocated
+    // before may be freed until the default allocator is back.
+    btAlignedAllocSetCustom(countedAllocate, countedFree);
+    {
+        const btScalar radius = 0.01f;
+        StorageContainer storage = SphereShape(radius).storage();
+        std::vector<std::pair<const char*, ShapeFactory>> factories = {
+            {"new", [radius]() -> CollisionShape::Ptr {
+                return std::make_shared<SphereShape>(radius);
+            }},
+            {"intern", [radius]() {
+                return CollisionShape::intern(std::make_shared<SphereShape>(radius));
+            }},
+            {"load", [&storage]() {
+                return CollisionShape::Ptr(CollisionShape::load(storage));
+            }},
+            {"loadInterned", [&storage]() {
+                return CollisionShape::loadInterned(storage);
+            }}
+        };
+        std::cout << std::setw(14) << "shape" << std::setw(10) << "particles";
+        std::cout << std::setw(16) << "us/particle" << std::setw(18) << "bytes/particle" << std::endl;
+        for (int particleCount : {10000, 100000}) {
+            for (const auto& factory : factories) {
+                spawnParticles(factory.first, particleCount, factory.second);
+            }
+        }
+    }
+    btAlignedAllocSetCustom(nullptr, nullptr);
+}
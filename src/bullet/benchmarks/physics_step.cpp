@@ -0,0 +1,297 @@
+#include "bullet/collision_shape.h"
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionDispatch/btBox2dBox2dCollisionAlgorithm.h>
+#include <BulletCollision/CollisionDispatch/btConvex2dConvex2dAlgorithm.h>
+#include <BulletCollision/NarrowPhaseCollision/btMinkowskiPenetrationDepthSolver.h>
+#include <BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h>
+
+// Same requirement as Engine::setPhysicsThreadCount()
+#if BT_BULLET_VERSION >= 288
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <LinearMath/btThreads.h>
+#define THRIVE_BULLET_MULTITHREADING
+#endif
+
+#include <boost/chrono.hpp>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+const int STEP_COUNT = 60;
+
+const btScalar TIME_STEP = 1.0f / 60.0f;
+
+const int WARMUP_STEP_COUNT = 10;
+
+/**
+* @brief Bodies moving in the z=0 plane, in a world set up like Engine's
+*/
+class PlanarWorld {
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param bodyCount
+    *   The number of bodies. They start on a grid, close enough to
+    *   collide within the first few steps.
+    *
+    * @param shape
+    *   The shape of all bodies, about one unit wide
+    *
+    * @param multithreaded
+    *   Whether to use the multithreaded world with the current task
+    *   scheduler, as Engine does for more than one physics thread
+    */
+    PlanarWorld(
+        int bodyCount,
+        const CollisionShape& shape,
+        bool multithreaded
+    ) : m_collisionConfiguration(new btDefaultCollisionConfiguration()),
+        m_broadphase(new btDbvtBroadphase())
+    {
+#ifdef THRIVE_BULLET_MULTITHREADING
+        if (multithreaded) {
+            m_dispatcher.reset(new btCollisionDispatcherMt(
+                m_collisionConfiguration.get()
+            ));
+            auto solverPool = new btConstraintSolverPoolMt(
+                btGetTaskScheduler()->getNumThreads()
+            );
+            m_solver.reset(solverPool);
+            m_islandSolver.reset(new btSequentialImpulseConstraintSolverMt());
+            m_world.reset(new btDiscreteDynamicsWorldMt(
+                m_dispatcher.get(),
+                m_broadphase.get(),
+                solverPool,
+                m_islandSolver.get(),
+                m_collisionConfiguration.get()
+            ));
+        }
+#else
+        (void) multithreaded;
+#endif
+        if (not m_world) {
+            m_dispatcher.reset(new btCollisionDispatcher(
+                m_collisionConfiguration.get()
+            ));
+            m_solver.reset(new btSequentialImpulseConstraintSolver());
+            m_world.reset(new btDiscreteDynamicsWorld(
+                m_dispatcher.get(),
+                m_broadphase.get(),
+                m_solver.get(),
+                m_collisionConfiguration.get()
+            ));
+        }
+        this->registerPlanarCollisionAlgorithms();
+        m_world->setGravity(btVector3(0,0,0));
+        btCollisionShape* bulletShape = shape.bulletShape();
+        int side = int(std::ceil(std::sqrt(double(bodyCount))));
+        std::mt19937 random(42);
+        std::uniform_real_distribution<btScalar> velocity(-2.0f, 2.0f);
+        btVector3 inertia(0,0,0);
+        bulletShape->calculateLocalInertia(1.0f, inertia);
+        m_bodies.reserve(bodyCount);
+        for (int i = 0; i < bodyCount; ++i) {
+            btRigidBody::btRigidBodyConstructionInfo info(
+                1.0f,
+                nullptr,
+                bulletShape,
+                inertia
+            );
+            info.m_startWorldTransform.setOrigin(btVector3(
+                (i % side) * 1.2f,
+                (i / side) * 1.2f,
+                0.0f
+            ));
+            std::unique_ptr<btRigidBody> body(new btRigidBody(info));
+            // Like microbes and agents
+            body->setLinearFactor(btVector3(1,1,0));
+            body->setAngularFactor(btVector3(0,0,1));
+            body->setLinearVelocity(btVector3(velocity(random), velocity(random), 0));
+            // Every step should do the same work
+            body->setActivationState(DISABLE_DEACTIVATION);
+            m_world->addRigidBody(body.get());
+            m_bodies.push_back(std::move(body));
+        }
+    }
+
+    ~PlanarWorld() {
+        for (const auto& body : m_bodies) {
+            m_world->removeRigidBody(body.get());
+        }
+    }
+
+    /**
+    * @brief Steps the world and returns the mean time per step
+    */
+    double
+    millisecondsPerStep() {
+        using Clock = boost::chrono::steady_clock;
+        for (int i = 0; i < WARMUP_STEP_COUNT; ++i) {
+            m_world->stepSimulation(TIME_STEP, 0);
+        }
+        auto start = Clock::now();
+        for (int i = 0; i < STEP_COUNT; ++i) {
+            m_world->stepSimulation(TIME_STEP, 0);
+        }
+        boost::chrono::duration<double, boost::milli> duration = Clock::now() - start;
+        return duration.count() / STEP_COUNT;
+    }
+
+private:
+
+    /**
+    * @brief Same as Engine's setupPlanarCollisionAlgorithms()
+    */
+    void
+    registerPlanarCollisionAlgorithms() {
+        auto dispatcher = static_cast<btCollisionDispatcher*>(m_dispatcher.get());
+        m_simplexSolver.reset(new btVoronoiSimplexSolver());
+        m_penetrationDepthSolver.reset(new btMinkowskiPenetrationDepthSolver());
+        m_convex2dAlgorithm.reset(new btConvex2dConvex2dAlgorithm::CreateFunc(
+            m_simplexSolver.get(),
+            m_penetrationDepthSolver.get()
+        ));
+        m_box2dAlgorithm.reset(new btBox2dBox2dCollisionAlgorithm::CreateFunc());
+        dispatcher->registerCollisionCreateFunc(
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            m_convex2dAlgorithm.get()
+        );
+        dispatcher->registerCollisionCreateFunc(
+            BOX_2D_SHAPE_PROXYTYPE,
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            m_convex2dAlgorithm.get()
+        );
+        dispatcher->registerCollisionCreateFunc(
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            BOX_2D_SHAPE_PROXYTYPE,
+            m_convex2dAlgorithm.get()
+        );
+        dispatcher->registerCollisionCreateFunc(
+            BOX_2D_SHAPE_PROXYTYPE,
+            BOX_2D_SHAPE_PROXYTYPE,
+            m_box2dAlgorithm.get()
+        );
+    }
+
+    std::vector<std::unique_ptr<btRigidBody>> m_bodies;
+
+    // Must outlive the dispatcher
+    std::unique_ptr<btCollisionAlgorithmCreateFunc> m_box2dAlgorithm;
+
+    std::unique_ptr<btCollisionAlgorithmCreateFunc> m_convex2dAlgorithm;
+
+    std::unique_ptr<btConvexPenetrationDepthSolver> m_penetrationDepthSolver;
+
+    std::unique_ptr<btVoronoiSimplexSolver> m_simplexSolver;
+
+    std::unique_ptr<btCollisionConfiguration> m_collisionConfiguration;
+
+    std::unique_ptr<btBroadphaseInterface> m_broadphase;
+
+    std::unique_ptr<btDispatcher> m_dispatcher;
+
+    std::unique_ptr<btConstraintSolver> m_islandSolver;
+
+    std::unique_ptr<btConstraintSolver> m_solver;
+
+    std::unique_ptr<btDiscreteDynamicsWorld> m_world;
+
+};
+
+}
+
+
+TEST(PhysicsBenchmark, StepTimeByThreadCount) {
+    // One thread is the single-threaded world, as with
+    // Engine::setPhysicsThreadCount(1)
+    std::vector<int> threadCounts = {1};
+#ifdef THRIVE_BULLET_MULTITHREADING
+    // Null if Bullet was built without BT_THREADSAFE
+    std::unique_ptr<btITaskScheduler> taskScheduler(btCreateDefaultTaskScheduler());
+    if (taskScheduler) {
+        int coreCount = taskScheduler->getNumThreads();
+        for (int threadCount = 2; threadCount < coreCount; threadCount *= 2) {
+            threadCounts.push_back(threadCount);
+        }
+        if (coreCount > 1) {
+            threadCounts.push_back(coreCount);
+        }
+    }
+#endif
+    SphereShape sphere(0.5f);
+    if (threadCounts.size() == 1) {
+        std::cout << "Bullet can't step on several threads here, only one thread is measured" << std::endl;
+    }
+    std::cout << "Milliseconds per step" << std::endl;
+    std::cout << std::setw(8) << "bodies";
+    for (int threadCount : threadCounts) {
+        std::cout << std::setw(8) << threadCount << "T";
+    }
+    std::cout << std::endl;
+    for (int bodyCount : {1000, 10000, 50000}) {
+        std::cout << std::setw(8) << bodyCount;
+        for (int threadCount : threadCounts) {
+#ifdef THRIVE_BULLET_MULTITHREADING
+            if (threadCount > 1) {
+                taskScheduler->setNumThreads(threadCount);
+                btSetTaskScheduler(taskScheduler.get());
+            }
+#endif
+            PlanarWorld world(bodyCount, sphere, threadCount > 1);
+            double milliseconds = world.millisecondsPerStep();
+            EXPECT_GT(milliseconds, 0.0);
+            std::cout << std::setw(9) << std::fixed << std::setprecision(2) << milliseconds << std::flush;
+        }
+        std::cout << std::endl;
+    }
+#ifdef THRIVE_BULLET_MULTITHREADING
+    btSetTaskScheduler(btGetSequentialTaskScheduler());
+#endif
+}
+
+
+TEST(PhysicsBenchmark, PlanarShapes) {
+    // Each 2D shape against the 3D shape it replaces
+    SphereShape sphere(0.5f);
+    CircleShape circle(0.5f);
+    BoxShape box(Ogre::Vector3(0.5f, 0.5f, 0.5f));
+    Box2dShape box2d(0.5f, 0.5f);
+    std::vector<std::pair<const char*, const CollisionShape*>> shapes = {
+        {"sphere", &sphere},
+        {"circle", &circle},
+        {"box", &box},
+        {"box2d", &box2d}
+    };
+    std::cout << "Milliseconds per step on one thread" << std::endl;
+    std::cout << std::setw(8) << "bodies";
+    for (const auto& shape : shapes) {
+        std::cout << std::setw(9) << shape.first;
+    }
+    std::cout << std::endl;
+    for (int bodyCount : {1000, 10000, 50000}) {
+        std::cout << std::setw(8) << bodyCount;
+        for (const auto& shape : shapes) {
+            PlanarWorld world(bodyCount, *shape.second, false);
+            double milliseconds = world.millisecondsPerStep();
+            EXPECT_GT(milliseconds, 0.0);
+            std::cout << std::setw(9) << std::fixed << std::setprecision(2) << milliseconds << std::flush;
+        }
+        std::cout << std::endl;
+    }
+}
@@ -5,14 +5,35 @@
 #include "engine/entity_filter.h"
 #include "ogre/scene_node_system.h"
 
+#include <vector>
+
 using namespace thrive;
 
+namespace {
+
+void
+syncTransform(
+    const RigidBodyComponent* rigidBodyComponent,
+    OgreSceneNodeComponent* sceneNodeComponent
+) {
+    auto& sceneNodeTransform = sceneNodeComponent->m_transform;
+    auto& rigidBodyProperties = rigidBodyComponent->m_dynamicProperties;
+    sceneNodeTransform.orientation = rigidBodyProperties.rotation;
+    sceneNodeTransform.position = rigidBodyProperties.position;
+    sceneNodeTransform.touch();
+}
+
+} // namespace
+
+
 struct BulletToOgreSystem::Implementation {
 
     EntityFilter<
         RigidBodyComponent,
         OgreSceneNodeComponent
-    > m_entities;
+    > m_entities = {true};
+
+    std::vector<EntityId>* m_movedBodies = nullptr;
 };
 
 
@@ -31,27 +52,31 @@ BulletToOgreSystem::init(
 ) {
     System::init(engine);
     m_impl->m_entities.setEntityManager(&engine->entityManager());
+    m_impl->m_movedBodies = &engine->movedRigidBodies();
 }
 
 
 void
 BulletToOgreSystem::shutdown() {
     m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_movedBodies = nullptr;
     System::shutdown();
 }
 
 
 void
 BulletToOgreSystem::update(int) {
-    for (auto& value : m_impl->m_entities) {
-        RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
-        OgreSceneNodeComponent* sceneNodeComponent = std::get<1>(value.second);
-        auto& sceneNodeTransform = sceneNodeComponent->m_transform;
-        auto& rigidBodyProperties = rigidBodyComponent->m_dynamicProperties;
-        sceneNodeTransform.orientation = rigidBodyProperties.rotation;
-        sceneNodeTransform.position = rigidBodyProperties.position;
-        sceneNodeTransform.touch();
+    // Scene nodes may be added to a body that doesn't move
+    for (const auto& added : m_impl->m_entities.addedEntities()) {
+        syncTransform(std::get<0>(added.second), std::get<1>(added.second));
+    }
+    m_impl->m_entities.clearChanges();
+    auto& entities = m_impl->m_entities.entities();
+    // Sleeping and static bodies keep their scene node untouched
+    for (EntityId entityId : *m_impl->m_movedBodies) {
+        auto iter = entities.find(entityId);
+        if (iter != entities.end()) {
+            syncTransform(std::get<0>(iter->second), std::get<1>(iter->second));
+        }
     }
 }
-
-
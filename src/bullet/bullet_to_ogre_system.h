@@ -7,6 +7,8 @@ namespace thrive {
 /**
 * @brief Updates OgreSceneNodeComponents with physics data
 *
+* Only touches the scene nodes of bodies in Engine::movedRigidBodies()
+* and of newly added entities.
 */
 class BulletToOgreSystem : public System {
 
@@ -2,11 +2,189 @@
 
 #include "bullet/bullet_ogre_conversion.h"
 #include "engine/serialization.h"
+#include "engine/shared_storage.h"
 #include "scripting/luabind.h"
 #include "util/make_unique.h"
 
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
 using namespace thrive;
 
+namespace {
+
+/**
+* @brief Weak references to all interned shapes, by fingerprint
+*
+* Each entry keeps the storage it was registered with. Shapes are only
+* shared if their storage is equal, not just its fingerprint, so shapes
+* with colliding fingerprints get entries of their own.
+*/
+struct ShapeRegistry {
+
+    struct Entry {
+
+        StorageContainer storage;
+
+        std::weak_ptr<CollisionShape> shape;
+
+    };
+
+    std::mutex m_mutex;
+
+    // Expired entries are dropped once the registry has doubled in size
+    size_t m_pruneSize = 64;
+
+    std::unordered_multimap<uint64_t, Entry> m_shapes;
+
+    CollisionShape::Ptr
+    find(
+        uint64_t fingerprint,
+        const StorageContainer& storage
+    ) {
+        auto range = m_shapes.equal_range(fingerprint);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            if (iter->second.storage == storage) {
+                return iter->second.shape.lock();
+            }
+        }
+        return nullptr;
+    }
+
+    void
+    insert(
+        uint64_t fingerprint,
+        const StorageContainer& storage,
+        const CollisionShape::Ptr& shape
+    ) {
+        auto range = m_shapes.equal_range(fingerprint);
+        auto iter = std::find_if(range.first, range.second,
+            [&storage] (const std::pair<const uint64_t, Entry>& item) {
+                return item.second.storage == storage;
+            }
+        );
+        if (iter != range.second) {
+            // Replaces an expired entry
+            iter->second.shape = shape;
+            return;
+        }
+        m_shapes.emplace(fingerprint, Entry{storage, shape});
+        if (m_shapes.size() < m_pruneSize) {
+            return;
+        }
+        for (auto iter = m_shapes.begin(); iter != m_shapes.end(); ) {
+            if (iter->second.shape.expired()) {
+                iter = m_shapes.erase(iter);
+            }
+            else {
+                ++iter;
+            }
+        }
+        m_pruneSize = std::max<size_t>(64, 2 * m_shapes.size());
+    }
+
+};
+
+
+ShapeRegistry&
+shapeRegistry() {
+    static ShapeRegistry registry;
+    return registry;
+}
+
+/**
+* @brief Half the thickness of 2D shapes along z
+*
+* Only matters for collisions with 3D shapes.
+*/
+const btScalar PLANAR_HALF_DEPTH = 0.1f;
+
+/**
+* @brief Squared distance below which child translations are equal
+*/
+const Ogre::Real CHILD_TRANSLATION_TOLERANCE = 1e-6f;
+
+
+/**
+* @brief Whether shapes of \a type can change after construction
+*
+* Those are never interned.
+*/
+bool
+isMutable(
+    CollisionShape::ShapeType type
+) {
+    return
+        type == CollisionShape::COMPOUND_SHAPE or
+        type == CollisionShape::MULTI_CIRCLE_SHAPE;
+}
+
+
+Ogre::Real
+cross(
+    const Ogre::Vector3& origin,
+    const Ogre::Vector3& a,
+    const Ogre::Vector3& b
+) {
+    return (a.x - origin.x) * (b.y - origin.y) - (a.y - origin.y) * (b.x - origin.x);
+}
+
+
+/**
+* @brief Cross products below which hull corners count as collinear
+*
+* Hex centers on an edge are off by rounding errors.
+*/
+const Ogre::Real HULL_COLLINEAR_TOLERANCE = 1e-4f;
+
+
+/**
+* @brief The corners of the convex hull of \a points in the xy-plane
+*
+* Andrew's monotone chain. Points on the hull's edges are left out.
+*/
+std::vector<Ogre::Vector3>
+convexHull2d(
+    std::vector<Ogre::Vector3> points
+) {
+    auto lessXY = [] (const Ogre::Vector3& a, const Ogre::Vector3& b) {
+        return a.x < b.x or (a.x == b.x and a.y < b.y);
+    };
+    auto equalXY = [] (const Ogre::Vector3& a, const Ogre::Vector3& b) {
+        return a.x == b.x and a.y == b.y;
+    };
+    std::sort(points.begin(), points.end(), lessXY);
+    points.erase(std::unique(points.begin(), points.end(), equalXY), points.end());
+    if (points.size() < 3) {
+        return points;
+    }
+    std::vector<Ogre::Vector3> hull(2 * points.size());
+    size_t size = 0;
+    // Lower hull
+    for (size_t i = 0; i < points.size(); ++i) {
+        while (size >= 2 and cross(hull[size - 2], hull[size - 1], points[i]) <= HULL_COLLINEAR_TOLERANCE) {
+            --size;
+        }
+        hull[size++] = points[i];
+    }
+    // Upper hull
+    const size_t lowerSize = size + 1;
+    for (size_t i = points.size() - 1; i > 0; --i) {
+        while (size >= lowerSize and cross(hull[size - 2], hull[size - 1], points[i - 1]) <= HULL_COLLINEAR_TOLERANCE) {
+            --size;
+        }
+        hull[size++] = points[i - 1];
+    }
+    // The last point is the first one again
+    hull.resize(size - 1);
+    return hull;
+}
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 // CollisionShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -26,10 +204,13 @@ CollisionShape::load(
     switch (type) {
         SHAPE_TYPE_CASE(EmptyShape)
         SHAPE_TYPE_CASE(BoxShape)
+        SHAPE_TYPE_CASE(Box2dShape)
         SHAPE_TYPE_CASE(CapsuleShape)
+        SHAPE_TYPE_CASE(CircleShape)
         SHAPE_TYPE_CASE(CompoundShape)
         SHAPE_TYPE_CASE(ConeShape)
         SHAPE_TYPE_CASE(CylinderShape)
+        SHAPE_TYPE_CASE(MultiCircleShape)
         SHAPE_TYPE_CASE(SphereShape)
         default:
             return make_unique<EmptyShape>();
@@ -37,6 +218,60 @@ CollisionShape::load(
 }
 
 
+CollisionShape::Ptr
+CollisionShape::intern(
+    const Ptr& shape
+) {
+    if (isMutable(shape->shapeType())) {
+        return shape;
+    }
+    StorageContainer storage = shape->storage();
+    uint64_t fingerprint = storage.fingerprint();
+    ShapeRegistry& registry = shapeRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+    Ptr existing = registry.find(fingerprint, storage);
+    if (existing) {
+        return existing;
+    }
+    registry.insert(fingerprint, storage, shape);
+    return shape;
+}
+
+
+CollisionShape::Ptr
+CollisionShape::loadInterned(
+    const StorageContainer& storage
+) {
+    ShapeType type = static_cast<ShapeType>(
+        storage.get<uint8_t>("shapeType", EMPTY_SHAPE)
+    );
+    if (isMutable(type)) {
+        return Ptr(CollisionShape::load(storage));
+    }
+    uint64_t fingerprint = storage.fingerprint();
+    ShapeRegistry& registry = shapeRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+    Ptr shape = registry.find(fingerprint, storage);
+    if (not shape) {
+        shape = Ptr(CollisionShape::load(storage));
+        // Keyed like intern(), in case the storage has missing or extra keys
+        StorageContainer canonicalStorage = shape->storage();
+        uint64_t canonicalFingerprint = canonicalStorage.fingerprint();
+        Ptr existing = registry.find(canonicalFingerprint, canonicalStorage);
+        if (existing) {
+            shape = existing;
+        }
+        else {
+            registry.insert(canonicalFingerprint, canonicalStorage, shape);
+        }
+        if (canonicalStorage != storage) {
+            registry.insert(fingerprint, storage, shape);
+        }
+    }
+    return shape;
+}
+
+
 luabind::scope
 CollisionShape::luaBindings() {
     using namespace luabind;
@@ -46,13 +281,55 @@ CollisionShape::luaBindings() {
             value("AXIS_Y", CollisionShape::AXIS_Y),
             value("AXIS_Z", CollisionShape::AXIS_Z)
         ]
+        .scope [
+            def("intern", &CollisionShape::intern)
+        ]
     ;
 }
 
 
+CollisionShape::Ptr
+CollisionShape::loadShared(
+    const StorageContainer& storage
+) {
+    SharedStorageTable* table = SharedStorageTable::current();
+    if (not storage.contains<uint64_t>(SharedStorageTable::REFERENCE_KEY)) {
+        return CollisionShape::loadInterned(storage);
+    }
+    if (not table) {
+        std::cerr << "No shared storage table to load collision shape from" << std::endl;
+        return std::make_shared<EmptyShape>();
+    }
+    uint64_t id = storage.get<uint64_t>(SharedStorageTable::REFERENCE_KEY);
+    StorageContainer shapeStorage;
+    try {
+        shapeStorage = table->get(id);
+    }
+    catch (const std::out_of_range& e) {
+        std::cerr << e.what() << std::endl;
+        return std::make_shared<EmptyShape>();
+    }
+    return CollisionShape::loadInterned(shapeStorage);
+}
+
+
+StorageContainer
+CollisionShape::storeShared(
+    const CollisionShape& shape
+) {
+    return SharedStorageTable::share(shape.storage());
+}
+
+
 CollisionShape::~CollisionShape() {}
 
 
+bool
+CollisionShape::rebuild() {
+    return false;
+}
+
+
 StorageContainer
 CollisionShape::storage() const {
     StorageContainer storage;
@@ -123,6 +400,68 @@ BoxShape::storage() const {
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Box2dShape
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+* @brief Loads a 2D box shape
+*
+* @param storage
+*
+* @return 
+*/
+std::unique_ptr<Box2dShape>
+Box2dShape::load(
+    const StorageContainer& storage
+) {
+    btScalar halfWidth = storage.get<btScalar>("halfWidth", 1.0f);
+    btScalar halfHeight = storage.get<btScalar>("halfHeight", 1.0f);
+    return make_unique<Box2dShape>(halfWidth, halfHeight);
+}
+
+
+/**
+* @brief Lua bindings
+*
+* - Box2dShape::Box2dShape()
+*
+* @return 
+*/
+luabind::scope
+Box2dShape::luaBindings() {
+    using namespace luabind;
+    return class_<Box2dShape, CollisionShape, std::shared_ptr<CollisionShape>>("Box2dShape")
+        .def(constructor<btScalar, btScalar>())
+    ;
+}
+
+
+Box2dShape::Box2dShape(
+    btScalar halfWidth,
+    btScalar halfHeight
+) : m_bulletShape(new btBox2dShape(btVector3(halfWidth, halfHeight, PLANAR_HALF_DEPTH))),
+    m_halfHeight(halfHeight),
+    m_halfWidth(halfWidth)
+{
+}
+
+
+/**
+* @brief Serializes this 2D box shape
+*
+* @return 
+*/
+StorageContainer
+Box2dShape::storage() const {
+    StorageContainer storage = CollisionShape::storage();
+    storage.set<btScalar>("halfHeight", m_halfHeight);
+    storage.set<btScalar>("halfWidth", m_halfWidth);
+    return storage;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // CapsuleShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -205,6 +544,66 @@ CapsuleShape::storage() const {
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// CircleShape
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+* @brief Loads a circle shape
+*
+* @param storage
+*
+* @return 
+*/
+std::unique_ptr<CircleShape>
+CircleShape::load(
+    const StorageContainer& storage
+) {
+    btScalar radius = storage.get<btScalar>("radius", 1.0f);
+    return make_unique<CircleShape>(radius);
+}
+
+
+/**
+* @brief Lua bindings
+*
+* - CircleShape::CircleShape()
+*
+* @return 
+*/
+luabind::scope
+CircleShape::luaBindings() {
+    using namespace luabind;
+    return class_<CircleShape, CollisionShape, std::shared_ptr<CollisionShape>>("CircleShape")
+        .def(constructor<btScalar>())
+    ;
+}
+
+
+CircleShape::CircleShape(
+    btScalar radius
+) : m_cylinder(new btCylinderShapeZ(btVector3(radius, radius, PLANAR_HALF_DEPTH))),
+    m_radius(radius)
+{
+    // m_bulletShape is declared before m_cylinder
+    m_bulletShape.reset(new btConvex2dShape(m_cylinder.get()));
+}
+
+
+/**
+* @brief Serializes this circle shape
+*
+* @return 
+*/
+StorageContainer
+CircleShape::storage() const {
+    StorageContainer storage = CollisionShape::storage();
+    storage.set<btScalar>("radius", m_radius);
+    return storage;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // CompoundShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -234,7 +633,7 @@ CompoundShape::load(
         shape->addChildShape(
             translation,
             rotation,
-            CollisionShape::load(childStorage)
+            CollisionShape::loadShared(childStorage)
         );
     }
     return shape;
@@ -248,6 +647,7 @@ CompoundShape::load(
 * - CompoundShape::addChildShape()
 * - CompoundShape::clear()
 * - CompoundShape::removeChildShape()
+* - CompoundShape::removeChildShapeAt()
 *
 * @return 
 */
@@ -259,6 +659,7 @@ CompoundShape::luaBindings() {
         .def("addChildShape", &CompoundShape::addChildShape)
         .def("clear", &CompoundShape::clear)
         .def("removeChildShape", &CompoundShape::removeChildShape)
+        .def("removeChildShapeAt", &CompoundShape::removeChildShapeAt)
     ;
 }
 
@@ -317,6 +718,52 @@ CompoundShape::removeChildShape(
 }
 
 
+void
+CompoundShape::removeChildShapeAt(
+    const Ogre::Vector3& translation
+) {
+    btVector3 origin = ogreToBullet(translation);
+    // Backwards, because removing a child moves the last one into its place
+    for (int i = m_bulletShape->getNumChildShapes() - 1; i >= 0; --i) {
+        const btTransform& transform = m_bulletShape->getChildTransform(i);
+        if (transform.getOrigin().distance2(origin) < CHILD_TRANSLATION_TOLERANCE) {
+            m_bulletShape->removeChildShapeByIndex(i);
+        }
+    }
+    auto iter = m_childShapes.begin();
+    while (iter != m_childShapes.end()) {
+        if (iter->translation.squaredDistance(translation) < CHILD_TRANSLATION_TOLERANCE) {
+            iter = m_childShapes.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+
+bool
+CompoundShape::rebuild() {
+    bool changed = false;
+    for (const auto& childShape : m_childShapes) {
+        // Shapes shared by several children are only rebuilt once anyway
+        changed = childShape.shape->rebuild() or changed;
+    }
+    if (changed) {
+        // Refits the children's bounding boxes and the compound's
+        for (int i = 0; i < m_bulletShape->getNumChildShapes(); ++i) {
+            m_bulletShape->updateChildTransform(
+                i,
+                m_bulletShape->getChildTransform(i),
+                false
+            );
+        }
+        m_bulletShape->recalculateLocalAabb();
+    }
+    return changed;
+}
+
+
 /**
 * @brief Serializes this compound shape
 *
@@ -328,7 +775,7 @@ CompoundShape::storage() const {
     StorageList childShapes;
     childShapes.reserve(m_childShapes.size());
     for (const auto& childShape : m_childShapes) {
-        StorageContainer childStorage = childShape.shape->storage();
+        StorageContainer childStorage = CollisionShape::storeShared(*childShape.shape);
         childStorage.set<Ogre::Vector3>(
             "compoundTranslation", 
             childShape.translation
@@ -566,6 +1013,194 @@ EmptyShape::storage() const {
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// MultiCircleShape
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+* @brief A multi-sphere shape whose spheres can be replaced
+*
+* Keeps the Bullet shape, and with it the rigid bodies' pointers to it,
+* alive across rebuilds.
+*/
+class MultiCircleShape::Spheres : public btMultiSphereShape {
+
+public:
+
+    explicit Spheres(
+        btScalar radius
+    ) : btMultiSphereShape(&ORIGIN, &radius, 1)
+    {
+    }
+
+    void
+    setSpheres(
+        const std::vector<Ogre::Vector3>& centers,
+        btScalar radius
+    ) {
+        if (centers.empty()) {
+            m_localPositionArray.resize(1);
+            m_localPositionArray[0] = ORIGIN;
+            m_radiArray.resize(1);
+            m_radiArray[0] = 0;
+        }
+        else {
+            m_localPositionArray.resize(centers.size());
+            m_radiArray.resize(centers.size());
+            for (size_t i = 0; i < centers.size(); ++i) {
+                m_localPositionArray[i] = ogreToBullet(centers[i]);
+                m_radiArray[i] = radius;
+            }
+        }
+        this->recalcLocalAabb();
+    }
+
+private:
+
+    static const btVector3 ORIGIN;
+
+};
+
+
+const btVector3 MultiCircleShape::Spheres::ORIGIN(0, 0, 0);
+
+
+/**
+* @brief Loads a multi-circle shape
+*
+* @param storage
+*
+* @return 
+*/
+std::unique_ptr<MultiCircleShape>
+MultiCircleShape::load(
+    const StorageContainer& storage
+) {
+    btScalar radius = storage.get<btScalar>("radius", 1.0f);
+    auto shape = make_unique<MultiCircleShape>(radius);
+    StorageList circles = storage.get<StorageList>("circles", StorageList());
+    for (const StorageContainer& circle : circles) {
+        shape->addCircle(
+            circle.get<Ogre::Vector3>("center", Ogre::Vector3::ZERO)
+        );
+    }
+    shape->rebuild();
+    return shape;
+}
+
+
+/**
+* @brief Lua bindings
+*
+* - MultiCircleShape::MultiCircleShape()
+* - MultiCircleShape::addCircle()
+* - MultiCircleShape::circleCount()
+* - MultiCircleShape::clear()
+* - MultiCircleShape::removeCircleAt()
+*
+* @return 
+*/
+luabind::scope
+MultiCircleShape::luaBindings() {
+    using namespace luabind;
+    return class_<MultiCircleShape, CollisionShape, std::shared_ptr<CollisionShape>>("MultiCircleShape")
+        .def(constructor<btScalar>())
+        .def("addCircle", &MultiCircleShape::addCircle)
+        .def("circleCount", &MultiCircleShape::circleCount)
+        .def("clear", &MultiCircleShape::clear)
+        .def("removeCircleAt", &MultiCircleShape::removeCircleAt)
+    ;
+}
+
+
+MultiCircleShape::MultiCircleShape(
+    btScalar radius
+) : m_radius(radius),
+    m_spheres(new Spheres(0))
+{
+    // m_bulletShape is declared before m_spheres
+    m_bulletShape.reset(new btConvex2dShape(m_spheres.get()));
+}
+
+
+MultiCircleShape::~MultiCircleShape() {}
+
+
+void
+MultiCircleShape::addCircle(
+    const Ogre::Vector3& center
+) {
+    m_centers.emplace_back(center.x, center.y, 0);
+    m_needsRebuild = true;
+}
+
+
+size_t
+MultiCircleShape::circleCount() const {
+    return m_centers.size();
+}
+
+
+void
+MultiCircleShape::clear() {
+    m_needsRebuild = m_needsRebuild or not m_centers.empty();
+    m_centers.clear();
+}
+
+
+bool
+MultiCircleShape::rebuild() {
+    if (not m_needsRebuild) {
+        return false;
+    }
+    // The hull of equal circles is spanned by the circles at the corners
+    // of their centers' hull
+    m_spheres->setSpheres(convexHull2d(m_centers), m_radius);
+    m_needsRebuild = false;
+    return true;
+}
+
+
+void
+MultiCircleShape::removeCircleAt(
+    const Ogre::Vector3& center
+) {
+    Ogre::Vector3 planarCenter(center.x, center.y, 0);
+    auto iter = m_centers.begin();
+    while (iter != m_centers.end()) {
+        if (iter->squaredDistance(planarCenter) < CHILD_TRANSLATION_TOLERANCE) {
+            iter = m_centers.erase(iter);
+            m_needsRebuild = true;
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+
+/**
+* @brief Serializes this multi-circle shape
+*
+* @return 
+*/
+StorageContainer
+MultiCircleShape::storage() const {
+    StorageContainer storage = CollisionShape::storage();
+    StorageList circles;
+    circles.reserve(m_centers.size());
+    for (const Ogre::Vector3& center : m_centers) {
+        StorageContainer circle;
+        circle.set<Ogre::Vector3>("center", center);
+        circles.push_back(circle);
+    }
+    storage.set<StorageList>("circles", circles);
+    storage.set<btScalar>("radius", m_radius);
+    return storage;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // SphereShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <btBulletCollisionCommon.h>
+#include <BulletCollision/CollisionShapes/btBox2dShape.h>
+#include <BulletCollision/CollisionShapes/btConvex2dShape.h>
 #include <cstdint>
 #include <memory>
 #include <OgreVector3.h>
@@ -53,9 +55,35 @@ public:
         COMPOUND_SHAPE = 3,
         CONE_SHAPE = 4,
         CYLINDER_SHAPE = 5,
-        SPHERE_SHAPE = 6
+        SPHERE_SHAPE = 6,
+        BOX_2D_SHAPE = 7,
+        CIRCLE_SHAPE = 8,
+        MULTI_CIRCLE_SHAPE = 9
     };
 
+    /**
+    * @brief Returns the one instance of a shape shared by all its users
+    *
+    * Shapes other than compound and multi-circle shapes never change
+    * after construction, so all structurally identical shapes can be
+    * replaced by a single instance, and Bullet only holds it once. The
+    * registry only keeps weak references, a shape is released along with
+    * its last user. Shapes count as equal if their storage is, a matching
+    * fingerprint alone is not enough.
+    *
+    * @param shape
+    *   The shape to intern
+    *
+    * @return
+    *   A live shape equal to \a shape, or \a shape itself, which is
+    *   registered then. Compound and multi-circle shapes are returned as
+    *   they are.
+    */
+    static Ptr
+    intern(
+        const Ptr& shape
+    );
+
     /**
     * @brief Loads a shape from a storage container
     *
@@ -70,16 +98,70 @@ public:
         const StorageContainer& storage
     );
 
+    /**
+    * @brief Loads a shape, reusing an interned one if possible
+    *
+    * Same as intern() on the result of load(), but the shape is only
+    * built if no equal shape is alive.
+    *
+    * @param storage
+    *   The storage of the shape
+    *
+    * @return
+    *   The shape or an EmptyShape if the type is unknown
+    */
+    static Ptr
+    loadInterned(
+        const StorageContainer& storage
+    );
+
+    /**
+    * @brief Loads a shape stored with storeShared()
+    *
+    * Shapes are interned (see loadInterned()), so Bullet holds each
+    * distinct shape only once. Compound and multi-circle shapes are the
+    * exception: they can be modified after loading, so each call returns
+    * a new one. Only the children of compound shapes are shared.
+    *
+    * @param storage
+    *   A reference as returned by storeShared() or a plain shape storage
+    *
+    * @return 
+    *   The shape or an EmptyShape if it can't be loaded
+    */
+    static Ptr
+    loadShared(
+        const StorageContainer& storage
+    );
+
     /**
     * @brief Lua bindings
     *
     * - CollisionShape::Axis
+    * - CollisionShape::intern()
     *
     * @return 
     */
     static luabind::scope
     luaBindings();
 
+    /**
+    * @brief Serializes a shape into the current SharedStorageTable
+    *
+    * Structurally identical shapes are stored only once.
+    *
+    * @param shape
+    *   The shape to store
+    *
+    * @return 
+    *   A reference to the shape's table entry or, if there is no current
+    *   table, the shape's storage
+    */
+    static StorageContainer
+    storeShared(
+        const CollisionShape& shape
+    );
+
     /**
     * @brief Destructor
     */
@@ -93,6 +175,20 @@ public:
     virtual btCollisionShape*
     bulletShape() const = 0;
 
+    /**
+    * @brief Applies pending modifications to the Bullet shape
+    *
+    * Shapes that are expensive to modify collect changes and apply them
+    * here, so a shape that changes several times in a frame is rebuilt
+    * only once. RigidBodyInputSystem calls this when a body's properties
+    * were touched.
+    *
+    * @return
+    *   Whether the Bullet shape changed
+    */
+    virtual bool
+    rebuild();
+
     /**
     * @brief The shape's type
     *
@@ -186,6 +282,44 @@ private:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Box2dShape
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+* @brief A flat rectangle in the xy-plane
+*
+* Meant for planar worlds (see Engine::setPhysicsPlanar()). Collisions with
+* other 2D shapes use Bullet's 2D algorithms.
+*/
+class Box2dShape : public CollisionShape {
+
+    SHAPE_CLASS(Box2dShape, BOX_2D_SHAPE, btBox2dShape)
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param halfWidth
+    *   Half the extent along x
+    * @param halfHeight
+    *   Half the extent along y
+    */
+    Box2dShape(
+        btScalar halfWidth,
+        btScalar halfHeight
+    );
+
+private:
+
+    const btScalar m_halfHeight;
+
+    const btScalar m_halfWidth;
+
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // CapsuleShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -226,6 +360,42 @@ private:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+// CircleShape
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+* @brief A flat disc in the xy-plane
+*
+* Meant for planar worlds (see Engine::setPhysicsPlanar()). Collisions with
+* other 2D shapes use Bullet's 2D algorithms.
+*/
+class CircleShape : public CollisionShape {
+
+    SHAPE_CLASS(CircleShape, CIRCLE_SHAPE, btConvex2dShape)
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param radius
+    *   The circle's radius
+    */
+    CircleShape(
+        btScalar radius
+    );
+
+private:
+
+    // Wrapped by m_bulletShape, which doesn't own it
+    std::unique_ptr<btCylinderShapeZ> m_cylinder;
+
+    const btScalar m_radius;
+
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // CompoundShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -270,6 +440,10 @@ public:
     /**
     * @brief Removes a child shape
     *
+    * Removes all children using \a shape. Interned shapes (see
+    * CollisionShape::intern()) are usually used by several children, use
+    * removeChildShapeAt() for those.
+    *
     * @param shape
     *   The shape to remove
     */
@@ -278,6 +452,26 @@ public:
         const CollisionShape::Ptr& shape
     );
 
+    /**
+    * @brief Removes the child shapes at a translation
+    *
+    * @param translation
+    *   The local translation the children were added with
+    */
+    void
+    removeChildShapeAt(
+        const Ogre::Vector3& translation
+    );
+
+    /**
+    * @brief Rebuilds the children and updates their bounding boxes
+    *
+    * @return
+    *   Whether any child changed
+    */
+    bool
+    rebuild() override;
+
 private:
 
     struct ChildShape {
@@ -395,6 +589,106 @@ public:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+// MultiCircleShape
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+* @brief The convex hull of equally sized circles in the xy-plane
+*
+* Replaces a compound of many CircleShape children with a single convex
+* shape, so the narrowphase runs one test instead of one per child. Only
+* the circles on the hull are handed to Bullet. Concave outlines are
+* filled in.
+*
+* Changes are collected and applied by rebuild(), so touch the
+* properties of the rigid bodies using the shape after changing it.
+* Without circles, the shape is a point at the origin.
+*
+* Meant for planar worlds (see Engine::setPhysicsPlanar()). Collisions with
+* other 2D shapes use Bullet's 2D algorithms.
+*/
+class MultiCircleShape : public CollisionShape {
+
+    SHAPE_CLASS(MultiCircleShape, MULTI_CIRCLE_SHAPE, btConvex2dShape)
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param radius
+    *   The radius of all circles
+    */
+    MultiCircleShape(
+        btScalar radius
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~MultiCircleShape();
+
+    /**
+    * @brief Adds a circle
+    *
+    * @param center
+    *   The circle's center, z is ignored
+    */
+    void
+    addCircle(
+        const Ogre::Vector3& center
+    );
+
+    /**
+    * @brief The number of circles, including those inside the hull
+    */
+    size_t
+    circleCount() const;
+
+    /**
+    * @brief Removes all circles
+    */
+    void
+    clear();
+
+    /**
+    * @brief Replaces the Bullet shape's spheres with the current hull
+    *
+    * @return
+    *   Whether circles were added or removed since the last rebuild
+    */
+    bool
+    rebuild() override;
+
+    /**
+    * @brief Removes the circles at a position
+    *
+    * @param center
+    *   The center the circles were added with, z is ignored
+    */
+    void
+    removeCircleAt(
+        const Ogre::Vector3& center
+    );
+
+private:
+
+    class Spheres;
+
+    // In the xy-plane
+    std::vector<Ogre::Vector3> m_centers;
+
+    bool m_needsRebuild = false;
+
+    const btScalar m_radius;
+
+    // Wrapped by m_bulletShape, which doesn't own it
+    std::unique_ptr<Spheres> m_spheres;
+
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // SphereShape
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,184 @@
+#include "bullet/contact_event_system.h"
+
+#include "engine/engine.h"
+#include "scripting/luabind.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <btBulletDynamicsCommon.h>
+#include <iterator>
+#include <luabind/iterator_policy.hpp>
+
+using namespace thrive;
+
+namespace {
+
+using EntityPair = std::pair<EntityId, EntityId>;
+
+void
+toEvents(
+    const std::vector<EntityPair>& pairs,
+    std::vector<ContactEvent>& events
+) {
+    events.clear();
+    events.reserve(pairs.size());
+    for (const EntityPair& pair : pairs) {
+        ContactEvent event;
+        event.entityA = pair.first;
+        event.entityB = pair.second;
+        events.push_back(event);
+    }
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ContactEvent
+////////////////////////////////////////////////////////////////////////////////
+
+luabind::scope
+ContactEvent::luaBindings() {
+    using namespace luabind;
+    return class_<ContactEvent>("ContactEvent")
+        .def_readonly("entityA", &ContactEvent::entityA)
+        .def_readonly("entityB", &ContactEvent::entityB)
+    ;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ContactEventSystem
+////////////////////////////////////////////////////////////////////////////////
+
+struct ContactEventSystem::Implementation {
+
+    std::vector<ContactEvent> m_begun;
+
+    // Sorted, without duplicates
+    std::vector<EntityPair> m_contacts;
+
+    // Reused between steps to avoid allocations
+    std::vector<EntityPair> m_difference;
+
+    std::vector<ContactEvent> m_ended;
+
+    short m_groupMask = btBroadphaseProxy::AllFilter;
+
+    // Contacts of the step before, swapped with m_contacts
+    std::vector<EntityPair> m_previousContacts;
+
+    btDiscreteDynamicsWorld* m_world = nullptr;
+
+};
+
+
+luabind::scope
+ContactEventSystem::luaBindings() {
+    using namespace luabind;
+    return class_<ContactEventSystem, System>("ContactEventSystem")
+        .def("begun", &ContactEventSystem::begun, return_stl_iterator)
+        .def("ended", &ContactEventSystem::ended, return_stl_iterator)
+        .def("setGroupMask", &ContactEventSystem::setGroupMask)
+    ;
+}
+
+
+ContactEventSystem::ContactEventSystem()
+  : m_impl(new Implementation())
+{
+}
+
+
+ContactEventSystem::~ContactEventSystem() {}
+
+
+const std::vector<ContactEvent>&
+ContactEventSystem::begun() const {
+    return m_impl->m_begun;
+}
+
+
+const std::vector<ContactEvent>&
+ContactEventSystem::ended() const {
+    return m_impl->m_ended;
+}
+
+
+void
+ContactEventSystem::init(
+    Engine* engine
+) {
+    System::init(engine);
+    m_impl->m_world = engine->physicsWorld();
+    assert(m_impl->m_world != nullptr && "World object is null. Initialize the Engine first.");
+}
+
+
+void
+ContactEventSystem::setGroupMask(
+    short mask
+) {
+    m_impl->m_groupMask = mask;
+}
+
+
+void
+ContactEventSystem::shutdown() {
+    m_impl->m_world = nullptr;
+    m_impl->m_begun.clear();
+    m_impl->m_contacts.clear();
+    m_impl->m_ended.clear();
+    System::shutdown();
+}
+
+
+void
+ContactEventSystem::update(int) {
+    assert(m_impl->m_world != nullptr && "ContactEventSystem not initialized");
+    std::swap(m_impl->m_contacts, m_impl->m_previousContacts);
+    std::vector<EntityPair>& contacts = m_impl->m_contacts;
+    contacts.clear();
+    btDispatcher* dispatcher = m_impl->m_world->getDispatcher();
+    int numManifolds = dispatcher->getNumManifolds();
+    for (int i = 0; i < numManifolds; ++i) {
+        btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+        // Manifolds exist as long as the bounding boxes overlap
+        if (manifold->getNumContacts() == 0) {
+            continue;
+        }
+        auto objectA = static_cast<const btCollisionObject*>(manifold->getBody0());
+        auto objectB = static_cast<const btCollisionObject*>(manifold->getBody1());
+        short groups =
+            objectA->getBroadphaseHandle()->m_collisionFilterGroup |
+            objectB->getBroadphaseHandle()->m_collisionFilterGroup;
+        if ((groups & m_impl->m_groupMask) == 0) {
+            continue;
+        }
+        EntityId entityA = reinterpret_cast<size_t>(objectA->getUserPointer());
+        EntityId entityB = reinterpret_cast<size_t>(objectB->getUserPointer());
+        contacts.emplace_back(
+            std::min(entityA, entityB),
+            std::max(entityA, entityB)
+        );
+    }
+    // Compound shapes have one manifold per child pair
+    std::sort(contacts.begin(), contacts.end());
+    contacts.erase(std::unique(contacts.begin(), contacts.end()), contacts.end());
+    const std::vector<EntityPair>& previous = m_impl->m_previousContacts;
+    std::vector<EntityPair>& difference = m_impl->m_difference;
+    difference.clear();
+    std::set_difference(
+        contacts.begin(), contacts.end(),
+        previous.begin(), previous.end(),
+        std::back_inserter(difference)
+    );
+    toEvents(difference, m_impl->m_begun);
+    difference.clear();
+    std::set_difference(
+        previous.begin(), previous.end(),
+        contacts.begin(), contacts.end(),
+        std::back_inserter(difference)
+    );
+    toEvents(difference, m_impl->m_ended);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "engine/system.h"
+#include "engine/typedefs.h"
+
+#include <memory>
+#include <vector>
+
+namespace luabind {
+class scope;
+}
+
+namespace thrive {
+
+/**
+* @brief A pair of entities whose rigid bodies started or stopped touching
+*/
+struct ContactEvent {
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - ContactEvent::entityA (read-only)
+    * - ContactEvent::entityB (read-only)
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief The entity with the lower id
+    */
+    EntityId entityA = NULL_ENTITY;
+
+    /**
+    * @brief The entity with the higher id
+    */
+    EntityId entityB = NULL_ENTITY;
+
+};
+
+
+/**
+* @brief Reports which rigid bodies started or stopped touching
+*
+* After each physics step, the entity pairs that have contact points are
+* compared with those of the previous step. Consumers only see the
+* differences, so they don't need to walk all contact manifolds every
+* frame.
+*
+* The events of one step can be read until the next step. Contacts that
+* end because a rigid body was removed are reported as ended, too.
+*
+* Must run right after UpdatePhysicsSystem.
+*/
+class ContactEventSystem : public System {
+
+public:
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - ContactEventSystem::begun() (as iterator)
+    * - ContactEventSystem::ended() (as iterator)
+    * - ContactEventSystem::setGroupMask()
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    */
+    ContactEventSystem();
+
+    /**
+    * @brief Destructor
+    */
+    ~ContactEventSystem();
+
+    /**
+    * @brief Contacts that began in the last step
+    */
+    const std::vector<ContactEvent>&
+    begun() const;
+
+    /**
+    * @brief Contacts that ended in the last step
+    */
+    const std::vector<ContactEvent>&
+    ended() const;
+
+    /**
+    * @brief Initializes the system
+    *
+    * @param engine
+    */
+    void
+    init(
+        Engine* engine
+    ) override;
+
+    /**
+    * @brief Restricts the tracked contacts to some collision groups
+    *
+    * A contact is tracked if the collision group of at least one of the
+    * bodies is in \a mask. Contacts that are tracked already are
+    * reported as ended once the mask excludes them.
+    *
+    * @param mask
+    *   Bit mask of collision groups. Defaults to all groups.
+    */
+    void
+    setGroupMask(
+        short mask
+    );
+
+    /**
+    * @brief Shuts the system down
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief Updates the system
+    */
+    void
+    update(int) override;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+};
+
+}
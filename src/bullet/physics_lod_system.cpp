@@ -0,0 +1,390 @@
+#include "bullet/physics_lod_system.h"
+
+#include "bullet/bullet_ogre_conversion.h"
+#include "bullet/rigid_body_system.h"
+#include "engine/engine.h"
+#include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
+#include "ogre/scene_node_system.h"
+#include "scripting/luabind.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <btBulletDynamicsCommon.h>
+#include <LinearMath/btTransformUtil.h>
+#include <unordered_map>
+
+using namespace thrive;
+
+namespace {
+
+/**
+* @brief How far beyond a radius bodies have to be to enter the next band
+*
+* As a fraction of the radius
+*/
+const float HYSTERESIS = 0.1f;
+
+/**
+* @brief Squared velocities below which drifting bodies come to rest
+*/
+const btScalar REST_THRESHOLD = 1e-4f;
+
+enum class Level {
+    Full,
+    Drifting,
+    Frozen
+};
+
+
+/**
+* @brief The integral of Bullet's damping factor over \a seconds
+*
+* A body with velocity \c v and damping \a damping travels \c v times
+* this far in \a seconds.
+*/
+btScalar
+dampedTravelTime(
+    btScalar damping,
+    btScalar seconds
+) {
+    if (damping <= 0) {
+        return seconds;
+    }
+    if (damping >= 1) {
+        return 0;
+    }
+    return (btPow(1 - damping, seconds) - 1) / btLog(1 - damping);
+}
+
+
+/**
+* @brief Moves a body outside the world, like the world would
+*
+* Also sets the interpolation state, which the world starts from when
+* the body is added back, and reports the move to the motion state.
+*/
+void
+setState(
+    btRigidBody* body,
+    const btTransform& transform,
+    btVector3 linearVelocity,
+    btVector3 angularVelocity
+) {
+    if (
+        linearVelocity.length2() < REST_THRESHOLD and
+        angularVelocity.length2() < REST_THRESHOLD
+    ) {
+        linearVelocity.setZero();
+        angularVelocity.setZero();
+    }
+    body->setWorldTransform(transform);
+    body->setInterpolationWorldTransform(transform);
+    body->setLinearVelocity(linearVelocity);
+    body->setAngularVelocity(angularVelocity);
+    body->setInterpolationLinearVelocity(linearVelocity);
+    body->setInterpolationAngularVelocity(angularVelocity);
+    body->getMotionState()->setWorldTransform(transform);
+}
+
+
+bool
+isResting(
+    const btRigidBody* body
+) {
+    return
+        body->getLinearVelocity().isZero() and
+        body->getAngularVelocity().isZero();
+}
+
+
+/**
+* @brief Advances a body outside the world by one frame
+*/
+void
+drift(
+    btRigidBody* body,
+    btScalar seconds
+) {
+    if (isResting(body)) {
+        return;
+    }
+    btVector3 linearVelocity = body->getLinearVelocity() *
+        btPow(1 - body->getLinearDamping(), seconds);
+    btVector3 angularVelocity = body->getAngularVelocity() *
+        btPow(1 - body->getAngularDamping(), seconds);
+    btTransform transform;
+    btTransformUtil::integrateTransform(
+        body->getWorldTransform(),
+        linearVelocity,
+        angularVelocity,
+        seconds,
+        transform
+    );
+    setState(body, transform, linearVelocity, angularVelocity);
+}
+
+
+/**
+* @brief Catches up on the time a body was frozen
+*
+* Only the position is extrapolated. The body is far from the focus,
+* nobody sees its orientation.
+*/
+void
+extrapolate(
+    btRigidBody* body,
+    btScalar seconds
+) {
+    if (isResting(body)) {
+        return;
+    }
+    btTransform transform = body->getWorldTransform();
+    transform.getOrigin() += body->getLinearVelocity() *
+        dampedTravelTime(body->getLinearDamping(), seconds);
+    btVector3 linearVelocity = body->getLinearVelocity() *
+        btPow(1 - body->getLinearDamping(), seconds);
+    btVector3 angularVelocity = body->getAngularVelocity() *
+        btPow(1 - body->getAngularDamping(), seconds);
+    setState(body, transform, linearVelocity, angularVelocity);
+}
+
+} // namespace
+
+
+struct PhysicsLodSystem::Implementation {
+
+    /**
+    * @brief A body taken out of the world
+    */
+    struct Detached {
+
+        Level level = Level::Drifting;
+
+        // m_time when the body was frozen
+        double frozenAt = 0.0;
+
+    };
+
+    void
+    attach(
+        RigidBodyComponent* rigidBodyComponent
+    ) {
+        btRigidBody* body = rigidBodyComponent->m_body;
+        body->setInterpolationWorldTransform(body->getWorldTransform());
+        // Torques applied while detached were never cleared by a step
+        body->clearForces();
+        m_world->addRigidBody(
+            body,
+            rigidBodyComponent->m_collisionFilterGroup,
+            rigidBodyComponent->m_collisionFilterMask
+        );
+        body->activate(true);
+    }
+
+    void
+    attachAll() {
+        for (const auto& item : m_detached) {
+            RigidBodyComponent* rigidBodyComponent = this->find(item.first);
+            if (rigidBodyComponent) {
+                if (item.second.level == Level::Frozen) {
+                    extrapolate(rigidBodyComponent->m_body, m_time - item.second.frozenAt);
+                }
+                this->attach(rigidBodyComponent);
+            }
+        }
+        m_detached.clear();
+    }
+
+    RigidBodyComponent*
+    find(
+        EntityId entityId
+    ) {
+        auto& entities = m_entities.entities();
+        auto iter = entities.find(entityId);
+        return iter == entities.end() ? nullptr : std::get<0>(iter->second);
+    }
+
+    Level
+    targetLevel(
+        Level level,
+        float distance
+    ) const {
+        // Leaving a band takes HYSTERESIS more distance than entering it
+        float driftRadius = m_driftRadius;
+        float freezeRadius = m_freezeRadius;
+        if (level == Level::Full) {
+            driftRadius *= 1 + HYSTERESIS;
+            freezeRadius *= 1 + HYSTERESIS;
+        }
+        else if (level == Level::Drifting) {
+            freezeRadius *= 1 + HYSTERESIS;
+        }
+        if (distance > freezeRadius) {
+            return Level::Frozen;
+        }
+        if (distance > driftRadius) {
+            return Level::Drifting;
+        }
+        return Level::Full;
+    }
+
+    std::unordered_map<EntityId, Detached> m_detached;
+
+    float m_driftRadius = 150.0f;
+
+    EntityFilter<
+        RigidBodyComponent
+    > m_entities = {true};
+
+    EntityId m_focusEntity = NULL_ENTITY;
+
+    float m_freezeRadius = 300.0f;
+
+    // Seconds since init, for extrapolating frozen bodies
+    double m_time = 0.0;
+
+    btDiscreteDynamicsWorld* m_world = nullptr;
+
+};
+
+
+luabind::scope
+PhysicsLodSystem::luaBindings() {
+    using namespace luabind;
+    return class_<PhysicsLodSystem, System>("PhysicsLodSystem")
+        .def("setFocusEntity", &PhysicsLodSystem::setFocusEntity)
+        .def("setRadii", &PhysicsLodSystem::setRadii)
+        .property("driftingCount", &PhysicsLodSystem::driftingCount)
+        .property("frozenCount", &PhysicsLodSystem::frozenCount)
+    ;
+}
+
+
+PhysicsLodSystem::PhysicsLodSystem()
+  : m_impl(new Implementation())
+{
+}
+
+
+PhysicsLodSystem::~PhysicsLodSystem() {}
+
+
+size_t
+PhysicsLodSystem::driftingCount() const {
+    return m_impl->m_detached.size() - this->frozenCount();
+}
+
+
+size_t
+PhysicsLodSystem::frozenCount() const {
+    return std::count_if(
+        m_impl->m_detached.begin(),
+        m_impl->m_detached.end(),
+        [] (const std::pair<const EntityId, Implementation::Detached>& item) {
+            return item.second.level == Level::Frozen;
+        }
+    );
+}
+
+
+void
+PhysicsLodSystem::init(
+    Engine* engine
+) {
+    System::init(engine);
+    assert(m_impl->m_world == nullptr && "Double init of system");
+    m_impl->m_world = engine->physicsWorld();
+    m_impl->m_entities.setEntityManager(&engine->entityManager());
+}
+
+
+void
+PhysicsLodSystem::setFocusEntity(
+    EntityId entityId
+) {
+    m_impl->m_focusEntity = entityId;
+}
+
+
+void
+PhysicsLodSystem::setRadii(
+    float driftRadius,
+    float freezeRadius
+) {
+    m_impl->m_driftRadius = driftRadius;
+    m_impl->m_freezeRadius = std::max(driftRadius, freezeRadius);
+}
+
+
+void
+PhysicsLodSystem::shutdown() {
+    m_impl->attachAll();
+    m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_world = nullptr;
+    System::shutdown();
+}
+
+
+void
+PhysicsLodSystem::update(
+    int milliseconds
+) {
+    const btScalar seconds = milliseconds / 1000.0f;
+    m_impl->m_time += seconds;
+    // RigidBodyInputSystem already deleted their bodies
+    for (EntityId entityId : m_impl->m_entities.removedEntities()) {
+        m_impl->m_detached.erase(entityId);
+    }
+    m_impl->m_entities.clearChanges();
+    auto focusNode = this->engine()->entityManager().getComponent<OgreSceneNodeComponent>(
+        m_impl->m_focusEntity
+    );
+    if (not focusNode) {
+        m_impl->attachAll();
+        return;
+    }
+    const btVector3 focus = ogreToBullet(focusNode->m_transform.position);
+    for (const auto& value : m_impl->m_entities) {
+        EntityId entityId = value.first;
+        RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
+        btRigidBody* body = rigidBodyComponent->m_body;
+        auto iter = m_impl->m_detached.find(entityId);
+        Level level = iter == m_impl->m_detached.end() ? Level::Full : iter->second.level;
+        Level target = Level::Full;
+        if (not body->isStaticOrKinematicObject()) {
+            btVector3 origin = body->getWorldTransform().getOrigin();
+            if (level == Level::Frozen) {
+                // Where the body would be by now, like extrapolate()
+                origin += body->getLinearVelocity() * dampedTravelTime(
+                    body->getLinearDamping(),
+                    m_impl->m_time - iter->second.frozenAt
+                );
+            }
+            target = m_impl->targetLevel(level, origin.distance(focus));
+        }
+        if (level == Level::Frozen and target != Level::Frozen) {
+            extrapolate(body, m_impl->m_time - iter->second.frozenAt);
+        }
+        if (target == Level::Full) {
+            if (level != Level::Full) {
+                m_impl->attach(rigidBodyComponent);
+                m_impl->m_detached.erase(iter);
+            }
+            continue;
+        }
+        if (level == Level::Full) {
+            m_impl->m_world->removeRigidBody(body);
+        }
+        Implementation::Detached& detached = m_impl->m_detached[entityId];
+        if (target == Level::Frozen) {
+            if (level != Level::Frozen) {
+                detached.frozenAt = m_impl->m_time;
+            }
+        }
+        else {
+            drift(body, seconds);
+        }
+        detached.level = target;
+    }
+}
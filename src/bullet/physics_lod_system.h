@@ -0,0 +1,146 @@
+#pragma once
+
+#include "engine/system.h"
+#include "engine/typedefs.h"
+
+#include <memory>
+
+namespace luabind {
+class scope;
+}
+
+namespace thrive {
+
+/**
+* @brief Simplifies the physics of rigid bodies far from a focus entity
+*
+* Bodies are sorted into three bands by their distance to the focus,
+* usually the camera:
+* - Within the drift radius, bodies are simulated as usual.
+* - Beyond it, they are taken out of the physics world and drift along
+*   their damped velocity. They don't collide, but moving them costs
+*   next to nothing.
+* - Beyond the freeze radius, they don't move at all. Their distance is
+*   measured from where they would be by now, extrapolated along the
+*   velocity they were frozen with, damped over the time since.
+*   RigidBodyInputSystem doesn't damp bodies out of the world, so
+*   damping is applied once.
+*
+* Bullet steps all bodies of a world at the same rate, so bodies further
+* away are simplified instead of stepped less often.
+*
+* Drifting bodies move continuously. Frozen bodies jump to their
+* extrapolated position once that is back within the freeze radius, so
+* the jump ends there. Bodies rejoin the world with their current
+* position and velocity. Nothing pops as long as the drift radius lies
+* beyond what the camera shows. A band of 10% beyond each radius keeps
+* bodies at the edge from switching every frame.
+*
+* Only dynamic bodies are affected. Static and kinematic bodies cost
+* little and stay in the world. Bodies out of the world don't show up in
+* contact events or PhysicsQuery.
+*
+* Must run after RigidBodyInputSystem and before UpdatePhysicsSystem.
+*/
+class PhysicsLodSystem : public System {
+
+public:
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - PhysicsLodSystem::setFocusEntity()
+    * - PhysicsLodSystem::setRadii()
+    * - PhysicsLodSystem::driftingCount() (as property)
+    * - PhysicsLodSystem::frozenCount() (as property)
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    */
+    PhysicsLodSystem();
+
+    /**
+    * @brief Destructor
+    */
+    ~PhysicsLodSystem();
+
+    /**
+    * @brief The number of bodies drifting outside the world
+    */
+    size_t
+    driftingCount() const;
+
+    /**
+    * @brief The number of frozen bodies
+    */
+    size_t
+    frozenCount() const;
+
+    /**
+    * @brief Initializes the system
+    *
+    * @param engine
+    */
+    void
+    init(
+        Engine* engine
+    ) override;
+
+    /**
+    * @brief Sets the entity distances are measured from
+    *
+    * @param entityId
+    *   The entity to follow, usually the camera. Needs an
+    *   OgreSceneNodeComponent. Without one, all bodies are simulated
+    *   as usual.
+    */
+    void
+    setFocusEntity(
+        EntityId entityId
+    );
+
+    /**
+    * @brief Sets the distances at which bodies are simplified
+    *
+    * @param driftRadius
+    *   Bodies further away than this drift. Defaults to 150.
+    * @param freezeRadius
+    *   Bodies further away than this are frozen. Raised to
+    *   \a driftRadius if smaller. Defaults to 300.
+    */
+    void
+    setRadii(
+        float driftRadius,
+        float freezeRadius
+    );
+
+    /**
+    * @brief Returns all bodies to the world
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief Updates the system
+    *
+    * @param milliseconds
+    */
+    void
+    update(
+        int milliseconds
+    ) override;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
@@ -0,0 +1,391 @@
+#include "bullet/physics_query.h"
+
+#include "bullet/bullet_ogre_conversion.h"
+
+#include <btBulletCollisionCommon.h>
+#include <stdexcept>
+
+// Bullet's parallel for loop is usable since 2.88, like the multithreaded
+// world in engine.cpp
+#if BT_BULLET_VERSION >= 288
+#include <LinearMath/btThreads.h>
+#define THRIVE_BULLET_PARALLEL_QUERIES
+#endif
+
+using namespace thrive;
+
+namespace {
+
+#ifdef THRIVE_BULLET_PARALLEL_QUERIES
+
+// Queries per task, small batches aren't worth splitting up
+const int GRAIN_SIZE = 64;
+
+template<typename Body>
+class ParallelForBody : public btIParallelForBody {
+
+public:
+
+    explicit ParallelForBody(
+        const Body& body
+    ) : m_body(body)
+    {
+    }
+
+    void
+    forLoop(
+        int begin,
+        int end
+    ) const override {
+        for (int i = begin; i < end; ++i) {
+            m_body(i);
+        }
+    }
+
+private:
+
+    const Body& m_body;
+
+};
+
+#endif
+
+/**
+* @brief Calls \a body for every index from 0 to \a count
+*
+* Spread over Bullet's task scheduler if \a parallel is set.
+*/
+template<typename Body>
+void
+forEachIndex(
+    bool parallel,
+    size_t count,
+    const Body& body
+) {
+#ifdef THRIVE_BULLET_PARALLEL_QUERIES
+    if (parallel and count > size_t(GRAIN_SIZE)) {
+        ParallelForBody<Body> loop(body);
+        btParallelFor(0, count, GRAIN_SIZE, loop);
+        return;
+    }
+#else
+    (void)parallel;
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        body(i);
+    }
+}
+
+
+EntityId
+entityOf(
+    const btCollisionObject* object
+) {
+    return reinterpret_cast<size_t>(object->getUserPointer());
+}
+
+
+/**
+* @brief Collects the entities of the broadphase proxies in a box
+*/
+class AabbCallback : public btBroadphaseAabbCallback {
+
+public:
+
+    AabbCallback(
+        std::vector<EntityId>& entities,
+        short group,
+        short mask
+    ) : m_entities(entities),
+        m_group(group),
+        m_mask(mask)
+    {
+    }
+
+    bool
+    process(
+        const btBroadphaseProxy* proxy
+    ) override {
+        // Same test as btOverlapFilterCallback's default
+        bool collides =
+            (proxy->m_collisionFilterGroup & m_mask) and
+            (m_group & proxy->m_collisionFilterMask);
+        if (collides) {
+            EntityId entityId = entityOf(
+                static_cast<const btCollisionObject*>(proxy->m_clientObject)
+            );
+            if (entityId != NULL_ENTITY) {
+                m_entities.push_back(entityId);
+            }
+        }
+        return true;
+    }
+
+private:
+
+    std::vector<EntityId>& m_entities;
+
+    short m_group;
+
+    short m_mask;
+
+};
+
+
+/**
+* @brief Reads two equally long sequences of Vector3
+*/
+std::vector<PhysicsQuery::Segment>
+readSegments(
+    lua_State* L,
+    const luabind::object& from,
+    const luabind::object& to
+) {
+    if (
+        luabind::type(from) != LUA_TTABLE or
+        luabind::type(to) != LUA_TTABLE
+    ) {
+        throw std::invalid_argument("Expected two sequences of Vector3");
+    }
+    from.push(L);
+    size_t count = lua_rawlen(L, -1);
+    to.push(L);
+    size_t toCount = lua_rawlen(L, -1);
+    lua_pop(L, 2);
+    if (count != toCount) {
+        throw std::invalid_argument("Sequences of Vector3 differ in length");
+    }
+    std::vector<PhysicsQuery::Segment> segments(count);
+    for (size_t i = 0; i < count; ++i) {
+        segments[i].from = luabind::object_cast<Ogre::Vector3>(from[i + 1]);
+        segments[i].to = luabind::object_cast<Ogre::Vector3>(to[i + 1]);
+    }
+    return segments;
+}
+
+
+/**
+* @brief Pushes one sequence per field of \a hits
+*/
+luabind::object
+toLuaTable(
+    lua_State* L,
+    const std::vector<PhysicsQuery::Hit>& hits
+) {
+    lua_createtable(L, 0, 4);
+    lua_createtable(L, hits.size(), 0);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        lua_pushnumber(L, static_cast<lua_Number>(hits[i].entityId));
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "entity");
+    lua_createtable(L, hits.size(), 0);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        lua_pushnumber(L, hits[i].fraction);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "fraction");
+    lua_createtable(L, hits.size(), 0);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        luabind::object(L, hits[i].point).push(L);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "point");
+    lua_createtable(L, hits.size(), 0);
+    for (size_t i = 0; i < hits.size(); ++i) {
+        luabind::object(L, hits[i].normal).push(L);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "normal");
+    luabind::object table(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return table;
+}
+
+} // namespace
+
+
+luabind::scope
+PhysicsQuery::luaBindings() {
+    using namespace luabind;
+    return class_<PhysicsQuery>("PhysicsQuery")
+        .def("castRays", &PhysicsQuery::luaCastRays)
+        .def("castSpheres", &PhysicsQuery::luaCastSpheres)
+        .def("overlapBoxes", &PhysicsQuery::luaOverlapBoxes)
+        .def("setParallel", &PhysicsQuery::setParallel)
+    ;
+}
+
+
+PhysicsQuery::PhysicsQuery(
+    btCollisionWorld* world
+) : m_world(world)
+{
+}
+
+
+void
+PhysicsQuery::castRays(
+    const std::vector<Segment>& rays,
+    std::vector<Hit>& hits,
+    short group,
+    short mask
+) const {
+    hits.assign(rays.size(), Hit());
+    const btCollisionWorld* world = m_world;
+    forEachIndex(m_parallel, rays.size(),
+        [&] (size_t i) {
+            btVector3 from = ogreToBullet(rays[i].from);
+            btVector3 to = ogreToBullet(rays[i].to);
+            btCollisionWorld::ClosestRayResultCallback callback(from, to);
+            callback.m_collisionFilterGroup = group;
+            callback.m_collisionFilterMask = mask;
+            world->rayTest(from, to, callback);
+            Hit& hit = hits[i];
+            if (callback.hasHit()) {
+                hit.entityId = entityOf(callback.m_collisionObject);
+                hit.fraction = callback.m_closestHitFraction;
+                hit.normal = bulletToOgre(callback.m_hitNormalWorld);
+                hit.point = bulletToOgre(callback.m_hitPointWorld);
+            }
+            else {
+                hit.point = rays[i].to;
+            }
+        }
+    );
+}
+
+
+void
+PhysicsQuery::castSpheres(
+    const std::vector<Segment>& segments,
+    float radius,
+    std::vector<Hit>& hits,
+    short group,
+    short mask
+) const {
+    hits.assign(segments.size(), Hit());
+    // Shapes are only read during sweeps, so all tasks can share one
+    btSphereShape sphere(radius);
+    const btCollisionWorld* world = m_world;
+    forEachIndex(m_parallel, segments.size(),
+        [&] (size_t i) {
+            btVector3 from = ogreToBullet(segments[i].from);
+            btVector3 to = ogreToBullet(segments[i].to);
+            btCollisionWorld::ClosestConvexResultCallback callback(from, to);
+            callback.m_collisionFilterGroup = group;
+            callback.m_collisionFilterMask = mask;
+            world->convexSweepTest(
+                &sphere,
+                btTransform(btQuaternion::getIdentity(), from),
+                btTransform(btQuaternion::getIdentity(), to),
+                callback
+            );
+            Hit& hit = hits[i];
+            if (callback.hasHit()) {
+                hit.entityId = entityOf(callback.m_hitCollisionObject);
+                hit.fraction = callback.m_closestHitFraction;
+                hit.normal = bulletToOgre(callback.m_hitNormalWorld);
+                hit.point = bulletToOgre(callback.m_hitPointWorld);
+            }
+            else {
+                hit.point = segments[i].to;
+            }
+        }
+    );
+}
+
+
+luabind::object
+PhysicsQuery::luaCastRays(
+    lua_State* L,
+    const luabind::object& from,
+    const luabind::object& to,
+    short group,
+    short mask
+) const {
+    std::vector<Hit> hits;
+    this->castRays(readSegments(L, from, to), hits, group, mask);
+    return toLuaTable(L, hits);
+}
+
+
+luabind::object
+PhysicsQuery::luaCastSpheres(
+    lua_State* L,
+    const luabind::object& from,
+    const luabind::object& to,
+    float radius,
+    short group,
+    short mask
+) const {
+    std::vector<Hit> hits;
+    this->castSpheres(readSegments(L, from, to), radius, hits, group, mask);
+    return toLuaTable(L, hits);
+}
+
+
+luabind::object
+PhysicsQuery::luaOverlapBoxes(
+    lua_State* L,
+    const luabind::object& min,
+    const luabind::object& max,
+    short group,
+    short mask
+) const {
+    std::vector<EntityId> entities;
+    std::vector<size_t> offsets;
+    this->overlapBoxes(readSegments(L, min, max), entities, offsets, group, mask);
+    size_t boxCount = offsets.size() - 1;
+    lua_createtable(L, boxCount, 0);
+    for (size_t box = 0; box < boxCount; ++box) {
+        lua_createtable(L, offsets[box + 1] - offsets[box], 0);
+        for (size_t i = offsets[box]; i < offsets[box + 1]; ++i) {
+            lua_pushnumber(L, static_cast<lua_Number>(entities[i]));
+            lua_rawseti(L, -2, i - offsets[box] + 1);
+        }
+        lua_rawseti(L, -2, box + 1);
+    }
+    luabind::object table(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return table;
+}
+
+
+void
+PhysicsQuery::overlapBoxes(
+    const std::vector<Segment>& boxes,
+    std::vector<EntityId>& entities,
+    std::vector<size_t>& offsets,
+    short group,
+    short mask
+) const {
+    // One list per box so tasks don't share output
+    std::vector<std::vector<EntityId>> perBox(boxes.size());
+    btBroadphaseInterface* broadphase = m_world->getBroadphase();
+    forEachIndex(m_parallel, boxes.size(),
+        [&] (size_t i) {
+            AabbCallback callback(perBox[i], group, mask);
+            broadphase->aabbTest(
+                ogreToBullet(boxes[i].from),
+                ogreToBullet(boxes[i].to),
+                callback
+            );
+        }
+    );
+    entities.clear();
+    offsets.resize(boxes.size() + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        entities.insert(entities.end(), perBox[i].begin(), perBox[i].end());
+        offsets[i + 1] = entities.size();
+    }
+}
+
+
+void
+PhysicsQuery::setParallel(
+    bool parallel
+) {
+    m_parallel = parallel;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "engine/typedefs.h"
+#include "scripting/luabind.h"
+
+#include <btBulletCollisionCommon.h>
+#include <OgreVector3.h>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief Batched ray casts, sphere casts and box overlaps against the
+* physics world
+*
+* Each call runs a whole batch of queries. With setParallel(), the
+* queries of a batch are spread over Bullet's task scheduler. The engine
+* only sets one up when physics runs on several threads (see
+* Engine::setPhysicsThreadCount()), otherwise they run one after another.
+*
+* Collision groups and masks work like those of RigidBodyComponent: a
+* query sees an object if the query's group is in the object's mask and
+* the object's group is in the query's mask.
+*
+* Queries see the world as of the last physics step. Don't run them while
+* the world is being stepped.
+*/
+class PhysicsQuery {
+
+public:
+
+    /**
+    * @brief A line segment to cast along
+    */
+    struct Segment {
+
+        /**
+        * @brief Start point
+        */
+        Ogre::Vector3 from;
+
+        /**
+        * @brief End point
+        */
+        Ogre::Vector3 to;
+
+    };
+
+    /**
+    * @brief The closest hit of a cast
+    */
+    struct Hit {
+
+        /**
+        * @brief The entity hit, NULL_ENTITY if nothing was hit
+        */
+        EntityId entityId = NULL_ENTITY;
+
+        /**
+        * @brief Where along the segment the hit is, from 0 to 1
+        *
+        * 1 if nothing was hit
+        */
+        float fraction = 1.0f;
+
+        /**
+        * @brief The surface normal at the hit point
+        */
+        Ogre::Vector3 normal = Ogre::Vector3::ZERO;
+
+        /**
+        * @brief The hit point
+        */
+        Ogre::Vector3 point = Ogre::Vector3::ZERO;
+
+    };
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - PhysicsQuery::luaCastRays() (as castRays)
+    * - PhysicsQuery::luaCastSpheres() (as castSpheres)
+    * - PhysicsQuery::luaOverlapBoxes() (as overlapBoxes)
+    * - PhysicsQuery::setParallel()
+    *
+    * The cast functions take sequences of start and end points and
+    * return a table of sequences, one element per segment:
+    * \c entity, \c fraction, \c point and \c normal.
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    *
+    * @param world
+    *   The world to query
+    */
+    explicit PhysicsQuery(
+        btCollisionWorld* world
+    );
+
+    /**
+    * @brief Finds the closest hit along each ray
+    *
+    * @param rays
+    *   The rays to cast
+    * @param[out] hits
+    *   Resized to one hit per ray
+    * @param group
+    *   The rays' collision group
+    * @param mask
+    *   The groups the rays can hit
+    */
+    void
+    castRays(
+        const std::vector<Segment>& rays,
+        std::vector<Hit>& hits,
+        short group = btBroadphaseProxy::DefaultFilter,
+        short mask = btBroadphaseProxy::AllFilter
+    ) const;
+
+    /**
+    * @brief Finds the closest hit of a sphere swept along each segment
+    *
+    * @param segments
+    *   The paths of the sphere
+    * @param radius
+    *   The sphere's radius
+    * @param[out] hits
+    *   Resized to one hit per segment
+    * @param group
+    *   The sphere's collision group
+    * @param mask
+    *   The groups the sphere can hit
+    */
+    void
+    castSpheres(
+        const std::vector<Segment>& segments,
+        float radius,
+        std::vector<Hit>& hits,
+        short group = btBroadphaseProxy::DefaultFilter,
+        short mask = btBroadphaseProxy::AllFilter
+    ) const;
+
+    /**
+    * @brief Ray casts for Lua
+    *
+    * @param L
+    * @param from
+    *   Sequence of start points
+    * @param to
+    *   Sequence of end points, as long as \a from
+    * @param group
+    * @param mask
+    *
+    * @return
+    *   Table with the sequences \c entity, \c fraction, \c point and
+    *   \c normal
+    */
+    luabind::object
+    luaCastRays(
+        lua_State* L,
+        const luabind::object& from,
+        const luabind::object& to,
+        short group,
+        short mask
+    ) const;
+
+    /**
+    * @brief Sphere casts for Lua
+    *
+    * @param L
+    * @param from
+    *   Sequence of start points
+    * @param to
+    *   Sequence of end points, as long as \a from
+    * @param radius
+    * @param group
+    * @param mask
+    *
+    * @return
+    *   Same as luaCastRays()
+    */
+    luabind::object
+    luaCastSpheres(
+        lua_State* L,
+        const luabind::object& from,
+        const luabind::object& to,
+        float radius,
+        short group,
+        short mask
+    ) const;
+
+    /**
+    * @brief Box overlaps for Lua
+    *
+    * @param L
+    * @param min
+    *   Sequence of lower box corners
+    * @param max
+    *   Sequence of upper box corners, as long as \a min
+    * @param group
+    * @param mask
+    *
+    * @return
+    *   A sequence with one sequence of entity ids per box
+    */
+    luabind::object
+    luaOverlapBoxes(
+        lua_State* L,
+        const luabind::object& min,
+        const luabind::object& max,
+        short group,
+        short mask
+    ) const;
+
+    /**
+    * @brief Finds the objects whose bounding boxes overlap each box
+    *
+    * Only bounding boxes are compared, so the results can include
+    * objects whose shape doesn't touch the box.
+    *
+    * @param boxes
+    *   The boxes to test, as (min, max) corners
+    * @param[out] entities
+    *   The entities found, box after box
+    * @param[out] offsets
+    *   Resized to one more than the number of boxes. The entities of box
+    *   \c i are those from \c offsets[i] to \c offsets[i+1].
+    * @param group
+    *   The boxes' collision group
+    * @param mask
+    *   The groups the boxes can overlap
+    */
+    void
+    overlapBoxes(
+        const std::vector<Segment>& boxes,
+        std::vector<EntityId>& entities,
+        std::vector<size_t>& offsets,
+        short group = btBroadphaseProxy::DefaultFilter,
+        short mask = btBroadphaseProxy::AllFilter
+    ) const;
+
+    /**
+    * @brief Whether to spread the queries of a batch over several threads
+    *
+    * @param parallel
+    *   Defaults to \c false
+    */
+    void
+    setParallel(
+        bool parallel
+    );
+
+private:
+
+    bool m_parallel = false;
+
+    btCollisionWorld* m_world = nullptr;
+
+};
+
+}
@@ -7,7 +7,9 @@
 #include "scripting/luabind.h"
 #include "engine/serialization.h"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
 using namespace thrive;
 
@@ -107,7 +109,7 @@ RigidBodyComponent::load(
 ) {
     Component::load(storage);
     // Static
-    m_properties.shape = CollisionShape::load(storage.get<StorageContainer>("shape", StorageContainer()));
+    m_properties.shape = CollisionShape::loadShared(storage.get<StorageContainer>("shape", StorageContainer()));
     m_properties.restitution = storage.get<btScalar>("restitution", 0.0f);
     m_properties.linearFactor = storage.get<Ogre::Vector3>("linearFactor", Ogre::Vector3(1,1,1));
     m_properties.angularFactor = storage.get<Ogre::Vector3>("angularFactor", Ogre::Vector3(1,1,1));
@@ -124,6 +126,7 @@ RigidBodyComponent::load(
     m_dynamicProperties.rotation = storage.get<Ogre::Quaternion>("rotation", Ogre::Quaternion::IDENTITY);
     m_dynamicProperties.linearVelocity = storage.get<Ogre::Vector3>("linearVelocity", Ogre::Vector3::ZERO);
     m_dynamicProperties.angularVelocity = storage.get<Ogre::Vector3>("angularVelocity", Ogre::Vector3::ZERO);
+    m_dynamicProperties.touch();
 }
 
 
@@ -133,6 +136,11 @@ RigidBodyComponent::setWorldTransform(
 ) {
     m_dynamicProperties.position = bulletToOgre(transform.getOrigin());
     m_dynamicProperties.rotation = bulletToOgre(transform.getRotation());
+    // Called from the thread stepping the world, even in the
+    // multithreaded world
+    if (m_movedBodies) {
+        m_movedBodies->push_back(this->owner());
+    }
 }
 
 
@@ -140,7 +148,7 @@ StorageContainer
 RigidBodyComponent::storage() const {
     StorageContainer storage = Component::storage();
     // Static
-    storage.set<StorageContainer>("shape", m_properties.shape->storage());
+    storage.set<StorageContainer>("shape", CollisionShape::storeShared(*m_properties.shape));
     storage.set<Ogre::Vector3>("linearFactor", m_properties.linearFactor);
     storage.set<Ogre::Vector3>("angularFactor", m_properties.angularFactor);
     storage.set<btScalar>("mass", m_properties.mass);
@@ -173,6 +181,11 @@ struct RigidBodyInputSystem::Implementation {
 
     std::unordered_map<EntityId, std::unique_ptr<btRigidBody>> m_bodies;
 
+    std::vector<EntityId>* m_movedBodies = nullptr;
+
+    // Whether the constraints of a planar world were applied
+    bool m_planar = false;
+
     btDiscreteDynamicsWorld* m_world = nullptr;
 
 };
@@ -194,6 +207,7 @@ RigidBodyInputSystem::init(
     System::init(engine);
     assert(m_impl->m_world == nullptr && "Double init of system");
     m_impl->m_world = engine->physicsWorld();
+    m_impl->m_movedBodies = &engine->movedRigidBodies();
     m_impl->m_entities.setEntityManager(&engine->entityManager());
 }
 
@@ -201,6 +215,7 @@ RigidBodyInputSystem::init(
 void
 RigidBodyInputSystem::shutdown() {
     m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_movedBodies = nullptr;
     m_impl->m_world = nullptr;
     System::shutdown();
 }
@@ -208,6 +223,8 @@ RigidBodyInputSystem::shutdown() {
 
 void
 RigidBodyInputSystem::update(int milliseconds) {
+    std::vector<EntityId>& movedBodies = *m_impl->m_movedBodies;
+    movedBodies.clear();
     for (EntityId entityId : m_impl->m_entities.removedEntities()) {
         btRigidBody* body = m_impl->m_bodies[entityId].get();
         m_impl->m_world->removeRigidBody(body);
@@ -217,6 +234,7 @@ RigidBodyInputSystem::update(int milliseconds) {
         EntityId entityId = added.first;
         RigidBodyComponent* rigidBodyComponent = std::get<0>(added.second);
         auto& properties = rigidBodyComponent->m_properties;
+        properties.shape->rebuild();
         btVector3 localInertia;
         properties.shape->bulletShape()->calculateLocalInertia(
             properties.mass,
@@ -231,6 +249,7 @@ RigidBodyInputSystem::update(int milliseconds) {
         std::unique_ptr<btRigidBody> rigidBody(new btRigidBody(rigidBodyCI));
         rigidBody->setUserPointer(reinterpret_cast<void*>(entityId));
         rigidBodyComponent->m_body = rigidBody.get();
+        rigidBodyComponent->m_movedBodies = &movedBodies;
         m_impl->m_world->addRigidBody(
             rigidBody.get(),
             rigidBodyComponent->m_collisionFilterGroup,
@@ -239,11 +258,17 @@ RigidBodyInputSystem::update(int milliseconds) {
         m_impl->m_bodies[entityId] = std::move(rigidBody);
     }
     m_impl->m_entities.clearChanges();
+    // Reapply all properties when the world becomes planar or stops being so
+    const bool planar = this->engine()->physicsPlanar();
+    const bool planarChanged = planar != m_impl->m_planar;
+    m_impl->m_planar = planar;
     for (const auto& value : m_impl->m_entities) {
         RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
         btRigidBody* body = rigidBodyComponent->m_body;
         auto& properties = rigidBodyComponent->m_properties;
-        if (properties.hasChanges()) {
+        if (properties.hasChanges() or planarChanged) {
+            // Batches all changes to the shape since the last frame
+            const bool shapeChanged = properties.shape->rebuild();
             btVector3 localInertia;
             properties.shape->bulletShape()->calculateLocalInertia(
                 properties.mass,
@@ -253,8 +278,15 @@ RigidBodyInputSystem::update(int milliseconds) {
                 properties.mass, 
                 localInertia
             );
-            body->setLinearFactor(ogreToBullet(properties.linearFactor));
-            body->setAngularFactor(ogreToBullet(properties.angularFactor));
+            btVector3 linearFactor = ogreToBullet(properties.linearFactor);
+            btVector3 angularFactor = ogreToBullet(properties.angularFactor);
+            if (planar) {
+                linearFactor.setZ(0);
+                angularFactor.setX(0);
+                angularFactor.setY(0);
+            }
+            body->setLinearFactor(linearFactor);
+            body->setAngularFactor(angularFactor);
             body->setDamping(
                 properties.linearDamping, 
                 properties.angularDamping
@@ -283,17 +315,30 @@ RigidBodyInputSystem::update(int milliseconds) {
                     body->getCollisionFlags() & not btCollisionObject::CF_KINEMATIC_OBJECT
                 );
             }
+            if (shapeChanged) {
+                // Sleeping bodies would keep their old contacts
+                body->activate();
+            }
             properties.untouch();
         }
         auto& dynamicProperties = rigidBodyComponent->m_dynamicProperties;
-        if (dynamicProperties.hasChanges()) {
+        if (dynamicProperties.hasChanges() or planarChanged) {
             btTransform transform;
             rigidBodyComponent->getWorldTransform(transform);
+            btVector3 linearVelocity = ogreToBullet(dynamicProperties.linearVelocity);
+            btVector3 angularVelocity = ogreToBullet(dynamicProperties.angularVelocity);
+            if (planar) {
+                transform.getOrigin().setZ(0);
+                linearVelocity.setZ(0);
+                angularVelocity.setX(0);
+                angularVelocity.setY(0);
+            }
             body->setWorldTransform(transform);
-            body->setLinearVelocity(ogreToBullet(dynamicProperties.linearVelocity));
-            body->setAngularVelocity(ogreToBullet(dynamicProperties.angularVelocity));
+            body->setLinearVelocity(linearVelocity);
+            body->setAngularVelocity(angularVelocity);
             dynamicProperties.untouch();
             body->activate();
+            movedBodies.push_back(value.first);
         }
         for (const auto& impulsePair : rigidBodyComponent->m_impulseQueue) {
             body->applyImpulse(
@@ -309,7 +354,11 @@ RigidBodyInputSystem::update(int milliseconds) {
             );
             rigidBodyComponent->m_torque = Ogre::Vector3::ZERO;
         }
-        body->applyDamping(milliseconds / 1000.0f);
+        // Bodies taken out of the world by PhysicsLodSystem are damped
+        // there, over the time they were out
+        if (body->isInWorld()) {
+            body->applyDamping(milliseconds / 1000.0f);
+        }
     }
 }
 
@@ -322,6 +371,26 @@ struct RigidBodyOutputSystem::Implementation {
     EntityFilter<
         RigidBodyComponent
     > m_entities;
+
+    // Sorted, without duplicates
+    std::vector<EntityId> m_moved;
+
+    std::vector<EntityId>* m_movedBodies = nullptr;
+
+    // Moved in the last frame, but not in this one
+    std::vector<EntityId> m_stopped;
+
+    // m_moved of the last frame
+    std::vector<EntityId> m_previouslyMoved;
+
+    RigidBodyComponent*
+    find(
+        EntityId entityId
+    ) {
+        auto& entities = m_entities.entities();
+        auto iter = entities.find(entityId);
+        return iter == entities.end() ? nullptr : std::get<0>(iter->second);
+    }
 };
 
 
@@ -340,20 +409,32 @@ RigidBodyOutputSystem::init(
 ) {
     System::init(engine);
     m_impl->m_entities.setEntityManager(&engine->entityManager());
+    m_impl->m_movedBodies = &engine->movedRigidBodies();
 }
 
 
 void
 RigidBodyOutputSystem::shutdown() {
     m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_movedBodies = nullptr;
+    m_impl->m_moved.clear();
+    m_impl->m_previouslyMoved.clear();
     System::shutdown();
 }
 
 
 void
 RigidBodyOutputSystem::update(int) {
-    for (auto& value : m_impl->m_entities.entities()) {
-        RigidBodyComponent* rigidBodyComponent = std::get<0>(value.second);
+    std::swap(m_impl->m_moved, m_impl->m_previouslyMoved);
+    std::vector<EntityId>& moved = m_impl->m_moved;
+    moved.assign(m_impl->m_movedBodies->begin(), m_impl->m_movedBodies->end());
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+    for (EntityId entityId : moved) {
+        RigidBodyComponent* rigidBodyComponent = m_impl->find(entityId);
+        if (not rigidBodyComponent) {
+            continue;
+        }
         btRigidBody* rigidBody = rigidBodyComponent->m_body;
         auto& dynamicProperties = rigidBodyComponent->m_dynamicProperties;
         // Position and orientation are handled by RigidBodyComponent::setWorldTransform
@@ -361,12 +442,22 @@ RigidBodyOutputSystem::update(int) {
             dynamicProperties.linearVelocity = bulletToOgre(rigidBody->getLinearVelocity());
             dynamicProperties.angularVelocity = bulletToOgre(rigidBody->getAngularVelocity());
         }
-        else if (
-            not dynamicProperties.linearVelocity.isZeroLength()
-            or not dynamicProperties.angularVelocity.isZeroLength()
-        ) {
-            dynamicProperties.linearVelocity = Ogre::Vector3::ZERO;
-            dynamicProperties.angularVelocity = Ogre::Vector3::ZERO;
+    }
+    // Bodies that fell asleep are not reported anymore
+    std::vector<EntityId>& stopped = m_impl->m_stopped;
+    stopped.clear();
+    std::set_difference(
+        m_impl->m_previouslyMoved.begin(), m_impl->m_previouslyMoved.end(),
+        moved.begin(), moved.end(),
+        std::back_inserter(stopped)
+    );
+    for (EntityId entityId : stopped) {
+        RigidBodyComponent* rigidBodyComponent = m_impl->find(entityId);
+        if (not rigidBodyComponent or rigidBodyComponent->m_body->isActive()) {
+            continue;
         }
+        auto& dynamicProperties = rigidBodyComponent->m_dynamicProperties;
+        dynamicProperties.linearVelocity = Ogre::Vector3::ZERO;
+        dynamicProperties.angularVelocity = Ogre::Vector3::ZERO;
     }
 }
@@ -8,6 +8,7 @@
 #include <btBulletCollisionCommon.h>
 #include <btBulletDynamicsCommon.h>
 #include <memory>
+#include <vector>
 #include <OgreQuaternion.h>
 #include <OgreVector3.h>
 
@@ -35,6 +36,9 @@ public:
 
         /**
         * @brief The body's shape .
+        *
+        * Touch the properties after modifying the shape, pending changes
+        * are applied then (see CollisionShape::rebuild()).
         */
         CollisionShape::Ptr shape {new EmptyShape()};
 
@@ -226,6 +230,9 @@ public:
     /**
     * @brief Reimplemented from btMotionState
     *
+    * Bullet calls this for active bodies only. Also reports the body in
+    * Engine::movedRigidBodies().
+    *
     * @param transform
     *   The rigid body's position and orientation
     */
@@ -271,6 +278,13 @@ public:
     */
     btRigidBody* m_body = nullptr;
 
+    /**
+    * @brief Internal list the motion state reports movements to
+    *
+    * See Engine::movedRigidBodies(). Set by RigidBodyInputSystem.
+    */
+    std::vector<EntityId>* m_movedBodies = nullptr;
+
     /**
     * @brief The body's collision group
     */
@@ -309,6 +323,13 @@ public:
 
 /**
 * @brief Creates rigid bodies and updates its properties
+*
+* If the engine's physics world is planar (see Engine::setPhysicsPlanar()),
+* the bodies are kept in the xy-plane regardless of their linear and
+* angular factors.
+*
+* Only bodies in the physics world are damped. PhysicsLodSystem damps
+* those it took out.
 */
 class RigidBodyInputSystem : public System {
 
@@ -359,6 +380,8 @@ private:
 * Copies the data from the simulation into 
 * RigidBodyComponent::m_dynamicOutputProperties.
 *
+* Only visits the bodies in Engine::movedRigidBodies(), and those that
+* fell asleep since the last frame.
 */
 class RigidBodyOutputSystem : public System {
 
@@ -2,6 +2,9 @@
 
 #include "bullet/bullet_ogre_conversion.h"
 #include "bullet/collision_shape.h"
+#include "bullet/contact_event_system.h"
+#include "bullet/physics_lod_system.h"
+#include "bullet/physics_query.h"
 #include "bullet/rigid_body_system.h"
 #include "scripting/luabind.h"
 
@@ -17,13 +20,20 @@ thrive::BulletBindings::luaBindings() {
     return (
         CollisionShape::luaBindings(),
         BoxShape::luaBindings(),
+        Box2dShape::luaBindings(),
         CapsuleShape::luaBindings(),
+        CircleShape::luaBindings(),
         CompoundShape::luaBindings(),
         ConeShape::luaBindings(),
         CylinderShape::luaBindings(),
         EmptyShape::luaBindings(),
+        MultiCircleShape::luaBindings(),
         SphereShape::luaBindings(),
-        RigidBodyComponent::luaBindings()
+        RigidBodyComponent::luaBindings(),
+        ContactEvent::luaBindings(),
+        ContactEventSystem::luaBindings(),
+        PhysicsLodSystem::luaBindings(),
+        PhysicsQuery::luaBindings()
     );
 }
 
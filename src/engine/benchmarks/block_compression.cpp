@@ -0,0 +1,110 @@
+#include "engine/block_compression.h"
+
+#include "engine/serialization.h"
+#include "engine/typedefs.h"
+
+#include <boost/chrono.hpp>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace thrive;
+
+
+/**
+* @brief A serialized world of agents with rigid bodies, like a savegame
+*
+* Positions and velocities are random, everything else repeats the way
+* it does in real savegames.
+*/
+static std::string
+savegameData(
+    unsigned int entityCount
+) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+    StorageList rigidBodies;
+    StorageList agents;
+    for (unsigned int i = 0; i < entityCount; ++i) {
+        StorageContainer rigidBody;
+        rigidBody.set<EntityId>("owner", i + 1);
+        rigidBody.set<Ogre::Vector3>("linearFactor", Ogre::Vector3(1, 1, 0));
+        rigidBody.set<Ogre::Vector3>("angularFactor", Ogre::Vector3(0, 0, 1));
+        rigidBody.set<float>("mass", 1.0f);
+        rigidBody.set<float>("friction", 0.5f);
+        rigidBody.set<float>("linearDamping", 0.0f);
+        rigidBody.set<float>("angularDamping", 0.0f);
+        rigidBody.set<bool>("hasContactResponse", true);
+        rigidBody.set<bool>("kinematic", false);
+        rigidBody.set<Ogre::Vector3>("position", Ogre::Vector3(coordinate(random), coordinate(random), 0));
+        rigidBody.set<Ogre::Quaternion>("rotation", Ogre::Quaternion::IDENTITY);
+        rigidBody.set<Ogre::Vector3>("linearVelocity", Ogre::Vector3(speed(random), speed(random), 0));
+        rigidBody.set<Ogre::Vector3>("angularVelocity", Ogre::Vector3::ZERO);
+        rigidBodies.append(rigidBody);
+        StorageContainer agent;
+        agent.set<EntityId>("owner", i + 1);
+        agent.set<uint16_t>("agentId", 1 + i % 4);
+        agent.set<float>("potency", 0.5f);
+        agent.set<int32_t>("timeToLive", 1000 + int32_t(i % 2000));
+        agent.set<Ogre::Vector3>("velocity", Ogre::Vector3(speed(random), speed(random), 0));
+        agents.append(agent);
+    }
+    // Laid out like EntityManager's savegames
+    StorageContainer collections;
+    collections.set<StorageList>("RigidBodyComponent", rigidBodies);
+    collections.set<StorageList>("AgentComponent", agents);
+    StorageContainer savegame;
+    savegame.set<EntityId>("currentId", entityCount + 1);
+    savegame.set<StorageContainer>("collections", collections);
+    std::ostringstream stream;
+    stream << savegame;
+    return stream.str();
+}
+
+
+/**
+* @brief Megabytes of \a size processed per second
+*/
+template<typename Function>
+static double
+throughput(
+    size_t size,
+    int repetitions,
+    const Function& function
+) {
+    using Clock = boost::chrono::steady_clock;
+    auto start = Clock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        function();
+    }
+    boost::chrono::duration<double> duration = Clock::now() - start;
+    return size * repetitions / duration.count() / 1e6;
+}
+
+
+TEST(BlockCompressionBenchmark, RatioAndThroughput) {
+    const int repetitions = 3;
+    std::string data = savegameData(100000);
+    std::cout << "Savegame of " << data.size() / 1024 << " KiB" << std::endl;
+    std::cout << std::setw(8) << "codec" << std::setw(10) << "ratio";
+    std::cout << std::setw(16) << "compress MB/s" << std::setw(18) << "decompress MB/s" << std::endl;
+    const char* names[] = {"None", "Fast", "Dense"};
+    for (auto codec : {BlockCompression::None, BlockCompression::Fast, BlockCompression::Dense}) {
+        std::string frame;
+        double compressSpeed = throughput(data.size(), repetitions, [&]() {
+            frame = BlockCompression::compress(data.data(), data.size(), codec);
+        });
+        std::string decompressed;
+        double decompressSpeed = throughput(data.size(), repetitions, [&]() {
+            decompressed = BlockCompression::decompress(frame.data(), frame.size());
+        });
+        EXPECT_EQ(data, decompressed);
+        std::cout << std::setw(8) << names[codec];
+        std::cout << std::setw(10) << std::fixed << std::setprecision(2) << double(data.size()) / frame.size();
+        std::cout << std::setw(16) << std::setprecision(1) << compressSpeed;
+        std::cout << std::setw(18) << decompressSpeed << std::endl;
+    }
+}
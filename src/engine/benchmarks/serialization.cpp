@@ -0,0 +1,128 @@
+#include "engine/serialization.h"
+
+#include "scripting/lua_state.h"
+#include "scripting/script_initializer.h"
+
+#include <boost/chrono.hpp>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iostream>
+#include <luabind/luabind.hpp>
+#include <vector>
+
+using namespace thrive;
+
+
+/**
+* @brief A microbe as MicrobeComponent:storage() writes it
+*/
+static StorageContainer
+microbeStorage(
+    int organelleCount,
+    int hexCount
+) {
+    StorageList organelles;
+    for (int i = 0; i < organelleCount; ++i) {
+        StorageList hexes;
+        for (int j = 0; j < hexCount; ++j) {
+            StorageContainer hex;
+            hex.set<double>("q", j % 3 - 1);
+            hex.set<double>("r", j / 3 - 1);
+            hexes.append(hex);
+        }
+        StorageContainer organelle;
+        organelle.set<std::string>("className", "MovementOrganelle");
+        organelle.set<StorageList>("hexes", hexes);
+        organelle.set<double>("q", i % 5);
+        organelle.set<double>("r", i / 5);
+        organelle.set<Ogre::ColourValue>("colour", Ogre::ColourValue(0.8f, 0.4f, 0.5f, 1.0f));
+        organelle.set<Ogre::ColourValue>("internalEdgeColour", Ogre::ColourValue(0.5f, 0.5f, 0.5f, 1.0f));
+        organelle.set<Ogre::ColourValue>("externalEdgeColour", Ogre::ColourValue(0.0f, 0.0f, 0.0f, 1.0f));
+        organelles.append(organelle);
+    }
+    StorageContainer microbe;
+    microbe.set<StorageList>("organelles", organelles);
+    return microbe;
+}
+
+
+// The reads of MicrobeComponent:load and Organelle:load, without the
+// organelles themselves. loadPerKey is how they read before toTable()
+// and view() existed.
+static const char* LOAD_FUNCTIONS =
+    "function loadPerKey(storage)\n"
+    "    local sum = 0\n"
+    "    local organelles = storage:get('organelles', StorageList())\n"
+    "    for i = 1,organelles:size() do\n"
+    "        local organelle = organelles:get(i)\n"
+    "        local className = organelle:get('className', '')\n"
+    "        local hexes = organelle:get('hexes', StorageList())\n"
+    "        for j = 1,hexes:size() do\n"
+    "            local hex = hexes:get(j)\n"
+    "            sum = sum + hex:get('q', 0) + hex:get('r', 0)\n"
+    "        end\n"
+    "        sum = sum + organelle:get('q', 0) + organelle:get('r', 0)\n"
+    "        local colour = organelle:get('colour', ColourValue.White)\n"
+    "        local internalEdgeColour = organelle:get('internalEdgeColour', ColourValue.Grey)\n"
+    "        local externalEdgeColour = organelle:get('externalEdgeColour', ColourValue.Black)\n"
+    "    end\n"
+    "    return sum\n"
+    "end\n"
+    "function loadTable(organelles)\n"
+    "    local sum = 0\n"
+    "    for i = 1,#organelles do\n"
+    "        local organelle = organelles[i]\n"
+    "        local className = organelle.className or ''\n"
+    "        local hexes = organelle.hexes or {}\n"
+    "        for j = 1,#hexes do\n"
+    "            local hex = hexes[j]\n"
+    "            sum = sum + (hex.q or 0) + (hex.r or 0)\n"
+    "        end\n"
+    "        sum = sum + (organelle.q or 0) + (organelle.r or 0)\n"
+    "        local colour = organelle.colour or ColourValue.White\n"
+    "        local internalEdgeColour = organelle.internalEdgeColour or ColourValue.Grey\n"
+    "        local externalEdgeColour = organelle.externalEdgeColour or ColourValue.Black\n"
+    "    end\n"
+    "    return sum\n"
+    "end\n"
+    "function loadEager(storage)\n"
+    "    return loadTable(storage:toTable().organelles or {})\n"
+    "end\n"
+    "function loadLazy(storage)\n"
+    "    return loadTable(storage:view().organelles or {})\n"
+    "end\n"
+    "function loadAll(load)\n"
+    "    result = 0\n"
+    "    for i = 1,#microbes do\n"
+    "        result = result + load(microbes[i])\n"
+    "    end\n"
+    "end\n";
+
+
+TEST(SerializationBenchmark, LuaMicrobeLoading) {
+    using Clock = boost::chrono::steady_clock;
+    const int microbeCount = 1000;
+    LuaState L;
+    initializeLua(L);
+    ASSERT_TRUE(L.doString(LOAD_FUNCTIONS));
+    luabind::object globals = luabind::globals(L);
+    luabind::object microbes = luabind::newtable(L);
+    for (int i = 0; i < microbeCount; ++i) {
+        microbes[i + 1] = microbeStorage(20, 7);
+    }
+    globals["microbes"] = microbes;
+    std::cout << microbeCount << " microbes with 20 organelles of 7 hexes" << std::endl;
+    std::cout << std::setw(12) << "load" << std::setw(20) << "us per microbe" << std::endl;
+    std::vector<double> results;
+    for (const char* function : {"loadPerKey", "loadEager", "loadLazy"}) {
+        std::string call = std::string("loadAll(") + function + ")";
+        auto start = Clock::now();
+        ASSERT_TRUE(L.doString(call));
+        boost::chrono::duration<double, boost::micro> duration = Clock::now() - start;
+        results.push_back(luabind::object_cast<double>(globals["result"]));
+        // All read the same
+        EXPECT_DOUBLE_EQ(results.front(), results.back());
+        std::cout << std::setw(12) << function;
+        std::cout << std::setw(20) << std::fixed << std::setprecision(1) << duration.count() / microbeCount << std::endl;
+    }
+}
@@ -0,0 +1,93 @@
+#include "engine/spatial_grid.h"
+
+#include <boost/chrono.hpp>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace thrive;
+
+using Clock = boost::chrono::steady_clock;
+
+
+static double
+microsecondsSince(
+    Clock::time_point start
+) {
+    boost::chrono::duration<double, boost::micro> duration = Clock::now() - start;
+    return duration.count();
+}
+
+
+TEST(SpatialGridBenchmark, MovingPoints) {
+    const EntityId pointCount = 50000;
+    const int frameCount = 10;
+    const int queryCount = 10000;
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> speed(-1.0f, 1.0f);
+    SpatialGrid grid(20.0f);
+    std::vector<Ogre::Vector3> positions(pointCount);
+    std::vector<Ogre::Vector3> velocities(pointCount);
+    for (EntityId i = 0; i < pointCount; ++i) {
+        positions[i] = Ogre::Vector3(coordinate(random), coordinate(random), 0.0f);
+        velocities[i] = Ogre::Vector3(speed(random), speed(random), 0.0f);
+        grid.setPosition(i + 1, positions[i]);
+    }
+    auto start = Clock::now();
+    for (int frame = 0; frame < frameCount; ++frame) {
+        for (EntityId i = 0; i < pointCount; ++i) {
+            positions[i] += velocities[i];
+            grid.setPosition(i + 1, positions[i]);
+        }
+    }
+    double updateTime = microsecondsSince(start) / frameCount;
+    std::vector<EntityId> result;
+    size_t found = 0;
+    start = Clock::now();
+    for (int i = 0; i < queryCount; ++i) {
+        result.clear();
+        grid.queryRadius(positions[i], 30.0f, result);
+        found += result.size();
+    }
+    double radiusTime = microsecondsSince(start) / queryCount;
+    start = Clock::now();
+    for (int i = 0; i < queryCount; ++i) {
+        result.clear();
+        grid.queryBox(
+            positions[i] - Ogre::Vector3(30.0f, 30.0f, 1.0f),
+            positions[i] + Ogre::Vector3(30.0f, 30.0f, 1.0f),
+            result
+        );
+        found += result.size();
+    }
+    double boxTime = microsecondsSince(start) / queryCount;
+    start = Clock::now();
+    for (int i = 0; i < queryCount; ++i) {
+        result.clear();
+        grid.queryNearest(positions[i], 8, result);
+        found += result.size();
+    }
+    double nearestTime = microsecondsSince(start) / queryCount;
+    // What every system would do without the grid
+    start = Clock::now();
+    for (int i = 0; i < queryCount / 100; ++i) {
+        result.clear();
+        for (EntityId j = 0; j < pointCount; ++j) {
+            if (positions[i].squaredDistance(positions[j]) <= 30.0f * 30.0f) {
+                result.push_back(j + 1);
+            }
+        }
+        found += result.size();
+    }
+    double scanTime = microsecondsSince(start) / (queryCount / 100);
+    EXPECT_GT(found, 0u);
+    std::cout << pointCount << " points, times in microseconds" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(28) << "update all points" << std::setw(12) << updateTime << std::endl;
+    std::cout << std::setw(28) << "radius 30" << std::setw(12) << radiusTime << std::endl;
+    std::cout << std::setw(28) << "box 60x60" << std::setw(12) << boxTime << std::endl;
+    std::cout << std::setw(28) << "8 nearest" << std::setw(12) << nearestTime << std::endl;
+    std::cout << std::setw(28) << "radius 30 by full scan" << std::setw(12) << scanTime << std::endl;
+}
@@ -0,0 +1,204 @@
+#include "engine/block_compression.h"
+
+#include "util/parallel_for.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+using namespace thrive;
+
+namespace {
+
+const char FRAME_MAGIC[4] = {'T', 'H', 'R', 'Z'};
+
+const uint8_t FRAME_VERSION = 1;
+
+/**
+* @brief Magic, version, codec, reserved, block count
+*/
+const size_t FRAME_HEADER_SIZE = 4 + 1 + 1 + 2 + 4;
+
+/**
+* @brief Uncompressed size and stored size
+*/
+const size_t BLOCK_ENTRY_SIZE = 4 + 4;
+
+
+struct Block {
+
+    uint32_t rawSize;
+
+    uint32_t storedSize;
+
+};
+
+
+template<typename T>
+void
+appendRaw(
+    std::string& buffer,
+    T value
+) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+T
+readRaw(
+    const char* data
+) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+
+int
+zlibLevel(
+    BlockCompression::Codec codec
+) {
+    switch(codec) {
+        case BlockCompression::Fast:
+            return Z_BEST_SPEED;
+        case BlockCompression::Dense:
+            return Z_BEST_COMPRESSION;
+        default:
+            return Z_NO_COMPRESSION;
+    }
+}
+
+} // namespace
+
+
+std::string
+BlockCompression::compress(
+    const char* data,
+    size_t size,
+    Codec codec,
+    size_t blockSize
+) {
+    if (blockSize == 0 or blockSize > UINT32_MAX) {
+        throw std::invalid_argument("Invalid block size");
+    }
+    size_t blockCount = (size + blockSize - 1) / blockSize;
+    std::vector<std::string> blocks(blockCount);
+    parallelFor(blockCount, [&] (size_t i) {
+        const char* blockData = data + i * blockSize;
+        size_t rawSize = std::min(blockSize, size - i * blockSize);
+        std::string& block = blocks[i];
+        if (codec != None) {
+            uLongf storedSize = compressBound(rawSize);
+            block.resize(storedSize);
+            int result = compress2(
+                reinterpret_cast<Bytef*>(&block[0]),
+                &storedSize,
+                reinterpret_cast<const Bytef*>(blockData),
+                rawSize,
+                zlibLevel(codec)
+            );
+            if (result == Z_OK and storedSize < rawSize) {
+                block.resize(storedSize);
+                return;
+            }
+        }
+        // Stored blocks are recognized by their unchanged size
+        block.assign(blockData, rawSize);
+    });
+    std::string frame;
+    size_t frameSize = FRAME_HEADER_SIZE + blockCount * BLOCK_ENTRY_SIZE;
+    for (const std::string& block : blocks) {
+        frameSize += block.size();
+    }
+    frame.reserve(frameSize);
+    frame.append(FRAME_MAGIC, sizeof(FRAME_MAGIC));
+    appendRaw<uint8_t>(frame, FRAME_VERSION);
+    appendRaw<uint8_t>(frame, codec);
+    appendRaw<uint16_t>(frame, 0);
+    appendRaw<uint32_t>(frame, blockCount);
+    for (size_t i = 0; i < blockCount; ++i) {
+        appendRaw<uint32_t>(frame, std::min(blockSize, size - i * blockSize));
+        appendRaw<uint32_t>(frame, blocks[i].size());
+    }
+    for (std::string& block : blocks) {
+        frame.append(block);
+        // Release early, frames can be large
+        std::string().swap(block);
+    }
+    return frame;
+}
+
+
+std::string
+BlockCompression::decompress(
+    const char* data,
+    size_t size
+) {
+    if (not isCompressed(data, size)) {
+        throw std::runtime_error("Corrupt savegame: not a compressed frame");
+    }
+    if (readRaw<uint8_t>(data + 4) > FRAME_VERSION) {
+        throw std::runtime_error("Compressed frame was written by a newer version of Thrive");
+    }
+    uint32_t blockCount = readRaw<uint32_t>(data + 8);
+    if (blockCount > (size - FRAME_HEADER_SIZE) / BLOCK_ENTRY_SIZE) {
+        throw std::runtime_error("Corrupt savegame: truncated block table");
+    }
+    // Locate all blocks
+    std::vector<Block> blocks(blockCount);
+    std::vector<size_t> sourceOffsets(blockCount);
+    std::vector<size_t> targetOffsets(blockCount);
+    size_t sourceOffset = FRAME_HEADER_SIZE + blockCount * BLOCK_ENTRY_SIZE;
+    size_t targetOffset = 0;
+    for (size_t i = 0; i < blockCount; ++i) {
+        const char* entry = data + FRAME_HEADER_SIZE + i * BLOCK_ENTRY_SIZE;
+        blocks[i].rawSize = readRaw<uint32_t>(entry);
+        blocks[i].storedSize = readRaw<uint32_t>(entry + 4);
+        sourceOffsets[i] = sourceOffset;
+        targetOffsets[i] = targetOffset;
+        sourceOffset += blocks[i].storedSize;
+        targetOffset += blocks[i].rawSize;
+    }
+    if (sourceOffset > size) {
+        throw std::runtime_error("Corrupt savegame: truncated block data");
+    }
+    std::string result(targetOffset, '\0');
+    std::vector<char> failed(blockCount, false);
+    parallelFor(blockCount, [&] (size_t i) {
+        const Block& block = blocks[i];
+        const char* source = data + sourceOffsets[i];
+        char* target = &result[0] + targetOffsets[i];
+        if (block.storedSize == block.rawSize) {
+            std::memcpy(target, source, block.rawSize);
+            return;
+        }
+        uLongf rawSize = block.rawSize;
+        int status = uncompress(
+            reinterpret_cast<Bytef*>(target),
+            &rawSize,
+            reinterpret_cast<const Bytef*>(source),
+            block.storedSize
+        );
+        failed[i] = (status != Z_OK or rawSize != block.rawSize);
+    });
+    if (std::find(failed.begin(), failed.end(), true) != failed.end()) {
+        throw std::runtime_error("Corrupt savegame: invalid compressed block");
+    }
+    return result;
+}
+
+
+bool
+BlockCompression::isCompressed(
+    const char* data,
+    size_t size
+) {
+    return (
+        size >= FRAME_HEADER_SIZE and
+        std::memcmp(data, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0
+    );
+}
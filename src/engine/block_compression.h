@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace thrive {
+
+/**
+* @brief Compresses data in independent blocks
+*
+* The data is split into blocks of equal size that are compressed 
+* independently, using all available cores. The result is a 
+* self-describing frame:
+*
+* - Header: magic, format version, codec, number of blocks
+* - Block table: uncompressed and stored size of each block
+* - Block data
+*
+* Since the block table precedes the data, decompression can locate all
+* blocks up front and process them in parallel as well.
+*
+* Blocks that do not shrink are stored uncompressed.
+*/
+class BlockCompression {
+
+public:
+
+    /**
+    * @brief Available codecs
+    */
+    enum Codec {
+        /**
+        * @brief Blocks are stored uncompressed
+        */
+        None = 0,
+
+        /**
+        * @brief Fast compression, for autosaves and quicksaves
+        */
+        Fast = 1,
+
+        /**
+        * @brief Slow but dense compression, for archiving
+        */
+        Dense = 2
+    };
+
+    /**
+    * @brief Default block size
+    */
+    static const size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+    /**
+    * @brief Compresses data into a frame
+    *
+    * @param data
+    *   The data to compress
+    * @param size
+    *   Size of \a data in bytes
+    * @param codec
+    *   The codec to use
+    * @param blockSize
+    *   The uncompressed size of each block but the last
+    *
+    * @return 
+    *   The compressed frame
+    */
+    static std::string
+    compress(
+        const char* data,
+        size_t size,
+        Codec codec,
+        size_t blockSize = DEFAULT_BLOCK_SIZE
+    );
+
+    /**
+    * @brief Decompresses a frame
+    *
+    * @param data
+    *   The frame, as returned by compress()
+    * @param size
+    *   Size of the frame in bytes
+    *
+    * @return 
+    *   The uncompressed data
+    *
+    * @throws std::runtime_error if the frame is corrupt
+    */
+    static std::string
+    decompress(
+        const char* data,
+        size_t size
+    );
+
+    /**
+    * @brief Checks whether data starts with a compressed frame
+    *
+    * @param data
+    *   The data to check
+    * @param size
+    *   Size of \a data in bytes
+    */
+    static bool
+    isCompressed(
+        const char* data,
+        size_t size
+    );
+
+};
+
+}
@@ -4,6 +4,7 @@
 
 #include <luabind/class_info.hpp>
 #include <luabind/adopt_policy.hpp>
+#include <unordered_set>
 
 using namespace thrive;
 
@@ -34,6 +35,14 @@ globalRegistry() {
 }
 
 
+// Type ids of globalRegistry(), for a quick isNative()
+static std::unordered_set<ComponentTypeId>&
+nativeTypeIds() {
+    static std::unordered_set<ComponentTypeId> typeIds;
+    return typeIds;
+}
+
+
 static ComponentTypeId
 ComponentFactory_registerComponentType(
     ComponentFactory* self,
@@ -88,6 +97,7 @@ ComponentFactory::registerGlobalComponentType(
     if (not isNew) {
         throw std::runtime_error("Duplicate component name: " + name);
     }
+    nativeTypeIds().insert(typeId);
     return typeId;
 }
 
@@ -134,6 +144,14 @@ ComponentFactory::getTypeName(
 }
 
 
+bool
+ComponentFactory::isNative(
+    ComponentTypeId typeId
+) const {
+    return nativeTypeIds().count(typeId) > 0;
+}
+
+
 std::unique_ptr<Component>
 ComponentFactory::load(
     const std::string& typeName,
@@ -169,6 +187,20 @@ ComponentFactory::registerComponentType(
 }
 
 
+std::vector<std::string>
+ComponentFactory::typeNames() const {
+    std::vector<std::string> names;
+    names.reserve(globalRegistry().size() + m_impl->m_registry.size());
+    for (const auto& item : globalRegistry()) {
+        names.push_back(item.first);
+    }
+    for (const auto& item : m_impl->m_registry) {
+        names.push_back(item.first);
+    }
+    return names;
+}
+
+
 void
 ComponentFactory::unregisterComponentType(
     const std::string& name
@@ -3,6 +3,10 @@
 #include "engine/component.h"
 #include "util/make_unique.h"
 
+#include <functional>
+#include <string>
+#include <vector>
+
 namespace luabind {
     class scope;
 }
@@ -107,6 +111,21 @@ public:
         ComponentTypeId typeId
     ) const;
 
+    /**
+    * @brief Whether a component type is implemented in C++
+    *
+    * Native types are registered globally with REGISTER_COMPONENT. Their
+    * components don't call into Lua, so they can be serialized on worker
+    * threads.
+    *
+    * @param typeId
+    *   The component type id
+    */
+    bool
+    isNative(
+        ComponentTypeId typeId
+    ) const;
+
     /**
     * @brief Loads a component from storage
     *
@@ -142,6 +161,12 @@ public:
         ComponentLoader loader
     );
 
+    /**
+    * @brief The names of all registered component types
+    */
+    std::vector<std::string>
+    typeNames() const;
+
     /**
     * @brief Unregisters a component type
     *
@@ -4,12 +4,18 @@
 #include "engine/component_factory.h"
 #include "engine/entity_manager.h"
 #include "engine/saving.h"
+#include "engine/snapshot_system.h"
+#include "engine/spatial_index_system.h"
+#include "engine/streaming_system.h"
 #include "engine/system.h"
 #include "game.h"
 
 // Bullet
 #include "bullet/bullet_to_ogre_system.h"
+#include "bullet/contact_event_system.h"
 #include "bullet/debug_drawing.h"
+#include "bullet/physics_lod_system.h"
+#include "bullet/physics_query.h"
 #include "bullet/rigid_body_system.h"
 #include "bullet/update_physics_system.h"
 
@@ -41,6 +47,10 @@
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionDispatch/btBox2dBox2dCollisionAlgorithm.h>
+#include <BulletCollision/CollisionDispatch/btConvex2dConvex2dAlgorithm.h>
+#include <BulletCollision/NarrowPhaseCollision/btMinkowskiPenetrationDepthSolver.h>
+#include <BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h>
 #include <chrono>
 #include <ctime>
 #include <forward_list>
@@ -61,6 +71,15 @@
 
 #include <iostream>
 
+// The multithreaded world needs Bullet 2.88 or later
+#if BT_BULLET_VERSION >= 288
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <LinearMath/btThreads.h>
+#define THRIVE_BULLET_MULTITHREADING
+#endif
+
 using namespace thrive;
 
 static const char* RESOURCES_CFG = "resources.cfg";
@@ -78,10 +97,14 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
         m_loadSystem(std::make_shared<LoadSystem>()),
         m_saveSystem(std::make_shared<SaveSystem>()),
         m_scriptSystemUpdater(std::make_shared<ScriptSystemUpdater>()),
+        m_snapshotSystem(std::make_shared<SnapshotSystem>()),
+        m_spatialIndexSystem(std::make_shared<SpatialIndexSystem>()),
+        m_streamingSystem(std::make_shared<StreamingSystem>()),
         m_viewportSystem(std::make_shared<OgreViewportSystem>())
     {
         m_loadSystem->setActive(false);
         m_saveSystem->setActive(false);
+        m_snapshotSystem->setActive(false);
         m_input.keyboardSystem = std::make_shared<KeyboardSystem>();
         m_input.mouseSystem = std::make_shared<MouseSystem>();
     }
@@ -239,21 +262,128 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
         logManager.createLog("default", true, false, false);
     }
 
-    void
-    setupPhysics() {
-        m_physics.collisionConfiguration.reset(new btDefaultCollisionConfiguration());
-        m_physics.dispatcher.reset(new btCollisionDispatcher(
+    /**
+    * @brief Creates a physics world that steps on several threads
+    *
+    * Complains about missing thread support only if a thread count was
+    * set explicitly. The default just takes what is there.
+    *
+    * @return
+    *   \c false if only one thread was requested or the linked Bullet
+    *   can't run on several threads
+    */
+    bool
+    setupMultithreadedPhysics() {
+        if (m_physics.threadCount == 1) {
+            return false;
+        }
+        bool explicitCount = m_physics.threadCount != 0;
+#ifdef THRIVE_BULLET_MULTITHREADING
+        // Null if Bullet was built without BT_THREADSAFE
+        std::unique_ptr<btITaskScheduler> taskScheduler(btCreateDefaultTaskScheduler());
+        if (not taskScheduler) {
+            if (explicitCount) {
+                std::cerr << "Bullet was built without thread support, physics runs on one thread" << std::endl;
+            }
+            m_physics.threadCount = 1;
+            return false;
+        }
+        // A new scheduler runs one thread per core, the maximum is a
+        // compile time limit of Bullet
+        int threadCount = explicitCount ?
+            std::min(int(m_physics.threadCount), taskScheduler->getMaxNumThreads()) :
+            taskScheduler->getNumThreads();
+        if (threadCount <= 1) {
+            m_physics.threadCount = 1;
+            return false;
+        }
+        taskScheduler->setNumThreads(threadCount);
+        btSetTaskScheduler(taskScheduler.get());
+        m_physics.taskScheduler = std::move(taskScheduler);
+        m_physics.threadCount = threadCount;
+        m_physics.dispatcher.reset(new btCollisionDispatcherMt(
             m_physics.collisionConfiguration.get()
         ));
-        m_physics.broadphase.reset(new btDbvtBroadphase());
-        m_physics.solver.reset(new btSequentialImpulseConstraintSolver());
-        m_physics.world.reset(new btDiscreteDynamicsWorld(
+        auto solverPool = new btConstraintSolverPoolMt(threadCount);
+        m_physics.solver.reset(solverPool);
+        m_physics.islandSolver.reset(new btSequentialImpulseConstraintSolverMt());
+        m_physics.world.reset(new btDiscreteDynamicsWorldMt(
             m_physics.dispatcher.get(),
             m_physics.broadphase.get(),
-            m_physics.solver.get(),
+            solverPool,
+            m_physics.islandSolver.get(),
             m_physics.collisionConfiguration.get()
         ));
+        return true;
+#else
+        if (explicitCount) {
+            std::cerr << "Bullet is too old for multithreading, physics runs on one thread" << std::endl;
+        }
+        m_physics.threadCount = 1;
+        return false;
+#endif
+    }
+
+    /**
+    * @brief Registers Bullet's algorithms for pairs of 2D shapes
+    *
+    * See Box2dShape and CircleShape. Other shapes are not affected.
+    */
+    void
+    setupPlanarCollisionAlgorithms() {
+        auto dispatcher = static_cast<btCollisionDispatcher*>(
+            m_physics.dispatcher.get()
+        );
+        m_physics.simplexSolver.reset(new btVoronoiSimplexSolver());
+        m_physics.penetrationDepthSolver.reset(new btMinkowskiPenetrationDepthSolver());
+        m_physics.convex2dAlgorithm.reset(new btConvex2dConvex2dAlgorithm::CreateFunc(
+            m_physics.simplexSolver.get(),
+            m_physics.penetrationDepthSolver.get()
+        ));
+        m_physics.box2dAlgorithm.reset(new btBox2dBox2dCollisionAlgorithm::CreateFunc());
+        dispatcher->registerCollisionCreateFunc(
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            m_physics.convex2dAlgorithm.get()
+        );
+        dispatcher->registerCollisionCreateFunc(
+            BOX_2D_SHAPE_PROXYTYPE,
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            m_physics.convex2dAlgorithm.get()
+        );
+        dispatcher->registerCollisionCreateFunc(
+            CONVEX_2D_SHAPE_PROXYTYPE,
+            BOX_2D_SHAPE_PROXYTYPE,
+            m_physics.convex2dAlgorithm.get()
+        );
+        dispatcher->registerCollisionCreateFunc(
+            BOX_2D_SHAPE_PROXYTYPE,
+            BOX_2D_SHAPE_PROXYTYPE,
+            m_physics.box2dAlgorithm.get()
+        );
+    }
+
+    void
+    setupPhysics() {
+        m_physics.collisionConfiguration.reset(new btDefaultCollisionConfiguration());
+        m_physics.broadphase.reset(new btDbvtBroadphase());
+        if (not this->setupMultithreadedPhysics()) {
+            m_physics.dispatcher.reset(new btCollisionDispatcher(
+                m_physics.collisionConfiguration.get()
+            ));
+            m_physics.solver.reset(new btSequentialImpulseConstraintSolver());
+            m_physics.world.reset(new btDiscreteDynamicsWorld(
+                m_physics.dispatcher.get(),
+                m_physics.broadphase.get(),
+                m_physics.solver.get(),
+                m_physics.collisionConfiguration.get()
+            ));
+        }
+        this->setupPlanarCollisionAlgorithms();
         m_physics.world->setGravity(btVector3(0,0,0));
+        m_physics.query.reset(new PhysicsQuery(m_physics.world.get()));
+        m_physics.contactEventSystem = std::make_shared<ContactEventSystem>();
+        m_physics.lodSystem = std::make_shared<PhysicsLodSystem>();
         // Debug drawing
         m_physics.debugDrawSystem = std::make_shared<BulletDebugDrawSystem>();
         m_physics.debugDrawSystem->setActive(false);
@@ -269,6 +399,8 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
         std::shared_ptr<System> systems[] = {
             // Loading, this should be first
             m_loadSystem,
+            // Streaming, before anything works on the streamed entities
+            m_streamingSystem,
             // Input
             m_input.keyboardSystem,
             m_input.mouseSystem,
@@ -281,10 +413,14 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
             std::make_shared<AgentAbsorberSystem>(),
             // Physics
             std::make_shared<RigidBodyInputSystem>(),
+            m_physics.lodSystem,
             std::make_shared<UpdatePhysicsSystem>(),
+            m_physics.contactEventSystem,
             std::make_shared<RigidBodyOutputSystem>(),
             std::make_shared<BulletToOgreSystem>(),
             m_physics.debugDrawSystem,
+            // Spatial index, after everything that moves scene nodes
+            m_spatialIndexSystem,
             // Graphics
             std::make_shared<OgreAddSceneNodeSystem>(),
             std::make_shared<OgreUpdateSceneNodeSystem>(),
@@ -295,6 +431,8 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
             m_viewportSystem, // Has to come *after* camera system
             std::make_shared<OgreRemoveSceneNodeSystem>(),
             std::make_shared<RenderSystem>(),
+            // Snapshots, after everything that changes components
+            m_snapshotSystem,
             // Saving, this should be last
             m_saveSystem
         };
@@ -373,16 +511,46 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
 
     struct Physics {
 
+        // Must outlive the dispatcher
+        std::unique_ptr<btCollisionAlgorithmCreateFunc> box2dAlgorithm;
+
         std::unique_ptr<btBroadphaseInterface> broadphase;
 
         std::unique_ptr<btCollisionConfiguration> collisionConfiguration;
 
+        std::shared_ptr<ContactEventSystem> contactEventSystem;
+
+        // Must outlive the dispatcher
+        std::unique_ptr<btCollisionAlgorithmCreateFunc> convex2dAlgorithm;
+
         std::shared_ptr<BulletDebugDrawSystem> debugDrawSystem;
 
         std::unique_ptr<btDispatcher> dispatcher;
 
+        // Solves large islands in the multithreaded world
+        std::unique_ptr<btConstraintSolver> islandSolver;
+
+        std::shared_ptr<PhysicsLodSystem> lodSystem;
+
+        std::vector<EntityId> movedBodies;
+
+        std::unique_ptr<btConvexPenetrationDepthSolver> penetrationDepthSolver;
+
+        bool planar = false;
+
+        std::unique_ptr<PhysicsQuery> query;
+
+        std::unique_ptr<btVoronoiSimplexSolver> simplexSolver;
+
         std::unique_ptr<btConstraintSolver> solver;
 
+#ifdef THRIVE_BULLET_MULTITHREADING
+        std::unique_ptr<btITaskScheduler> taskScheduler;
+#endif
+
+        // 0 for one per core
+        unsigned int threadCount = 0;
+
         std::unique_ptr<btDiscreteDynamicsWorld> world;
 
     } m_physics;
@@ -391,6 +559,12 @@ struct Engine::Implementation : public Ogre::WindowEventListener {
 
     std::shared_ptr<ScriptSystemUpdater> m_scriptSystemUpdater;
 
+    std::shared_ptr<SnapshotSystem> m_snapshotSystem;
+
+    std::shared_ptr<SpatialIndexSystem> m_spatialIndexSystem;
+
+    std::shared_ptr<StreamingSystem> m_streamingSystem;
+
     std::list<std::shared_ptr<System>> m_systems;
 
     std::shared_ptr<OgreViewportSystem> m_viewportSystem;
@@ -414,10 +588,21 @@ Engine::luaBindings() {
         .def("load", &Engine::load)
         .def("save", &Engine::save)
         .def("setPhysicsDebugDrawingEnabled", &Engine::setPhysicsDebugDrawingEnabled)
+        .def("setPhysicsPlanar", &Engine::setPhysicsPlanar)
         .property("componentFactory", &Engine::componentFactory)
+        .property("contactEventSystem", &Engine::contactEventSystem)
         .property("keyboard", &Engine::keyboardSystem)
+        .property("loadSystem", &Engine::loadSystem)
         .property("mouse", &Engine::mouseSystem)
+        .property("physicsLodSystem", &Engine::physicsLodSystem)
+        .property("physicsPlanar", &Engine::physicsPlanar)
+        .property("physicsQuery", &Engine::physicsQuery)
+        .property("physicsThreadCount", &Engine::physicsThreadCount)
+        .property("saveSystem", &Engine::saveSystem)
         .property("sceneManager", &Engine::sceneManager)
+        .property("snapshotSystem", &Engine::snapshotSystem)
+        .property("spatialIndexSystem", &Engine::spatialIndexSystem)
+        .property("streamingSystem", &Engine::streamingSystem)
     ;
 }
 
@@ -432,6 +617,12 @@ Engine::Engine()
 
 Engine::~Engine() { 
     m_impl->m_physics.world.reset();
+#ifdef THRIVE_BULLET_MULTITHREADING
+    if (m_impl->m_physics.taskScheduler) {
+        // Bullet keeps using the global scheduler otherwise
+        btSetTaskScheduler(btGetSequentialTaskScheduler());
+    }
+#endif
 }
 
 
@@ -452,6 +643,12 @@ Engine::componentFactory() {
 }
 
 
+ContactEventSystem&
+Engine::contactEventSystem() const {
+    return *m_impl->m_physics.contactEventSystem;
+}
+
+
 EntityManager&
 Engine::entityManager() {
     return m_impl->m_entityManager;
@@ -493,17 +690,53 @@ Engine::load(
 }
 
 
+LoadSystem&
+Engine::loadSystem() const {
+    return *m_impl->m_loadSystem;
+}
+
+
 MouseSystem&
 Engine::mouseSystem() const {
     return *m_impl->m_input.mouseSystem;
 }
 
 
+std::vector<EntityId>&
+Engine::movedRigidBodies() const {
+    return m_impl->m_physics.movedBodies;
+}
+
+
 Ogre::Root*
 Engine::ogreRoot() const {
     return m_impl->m_graphics.root.get();
 }
 
+PhysicsLodSystem&
+Engine::physicsLodSystem() const {
+    return *m_impl->m_physics.lodSystem;
+}
+
+
+bool
+Engine::physicsPlanar() const {
+    return m_impl->m_physics.planar;
+}
+
+
+PhysicsQuery&
+Engine::physicsQuery() const {
+    return *m_impl->m_physics.query;
+}
+
+
+unsigned int
+Engine::physicsThreadCount() const {
+    return m_impl->m_physics.threadCount;
+}
+
+
 btDiscreteDynamicsWorld*
 Engine::physicsWorld() const {
     return m_impl->m_physics.world.get();
@@ -523,6 +756,12 @@ Engine::save(
 }
 
 
+SaveSystem&
+Engine::saveSystem() const {
+    return *m_impl->m_saveSystem;
+}
+
+
 Ogre::SceneManager*
 Engine::sceneManager() const {
     return m_impl->m_graphics.sceneManager;
@@ -537,6 +776,25 @@ Engine::setPhysicsDebugDrawingEnabled(
 }
 
 
+void
+Engine::setPhysicsPlanar(
+    bool planar
+) {
+    m_impl->m_physics.planar = planar;
+}
+
+
+void
+Engine::setPhysicsThreadCount(
+    unsigned int threadCount
+) {
+    if (m_impl->m_physics.world) {
+        throw std::runtime_error("Cannot change physics thread count after engine is initialized");
+    }
+    m_impl->m_physics.threadCount = threadCount;
+}
+
+
 void
 Engine::shutdown() {
     m_impl->m_scriptSystemUpdater->shutdownSystems();
@@ -549,6 +807,24 @@ Engine::shutdown() {
 }
 
 
+SnapshotSystem&
+Engine::snapshotSystem() const {
+    return *m_impl->m_snapshotSystem;
+}
+
+
+SpatialIndexSystem&
+Engine::spatialIndexSystem() const {
+    return *m_impl->m_spatialIndexSystem;
+}
+
+
+StreamingSystem&
+Engine::streamingSystem() const {
+    return *m_impl->m_streamingSystem;
+}
+
+
 void
 Engine::update(
     int milliSeconds
@@ -3,6 +3,7 @@
 #include "engine/typedefs.h"
 
 #include <memory>
+#include <vector>
 
 class btDiscreteDynamicsWorld;
 class lua_State;
@@ -25,10 +26,18 @@ namespace OIS {
 namespace thrive {
 
 class ComponentFactory;
+class ContactEventSystem;
 class EntityManager;
 class KeyboardSystem;
+class LoadSystem;
 class MouseSystem;
 class OgreViewportSystem;
+class PhysicsLodSystem;
+class PhysicsQuery;
+class SaveSystem;
+class SnapshotSystem;
+class SpatialIndexSystem;
+class StreamingSystem;
 class System;
 
 /**
@@ -50,10 +59,21 @@ public:
     * - Engine::load()
     * - Engine::save()
     * - Engine::setPhysicsDebugDrawingEnabled()
+    * - Engine::setPhysicsPlanar()
     * - Engine::componentFactory() (as property)
+    * - Engine::contactEventSystem() (as property)
     * - Engine::keyboard() (as property)
+    * - Engine::loadSystem() (as property)
     * - Engine::mouse() (as property)
+    * - Engine::physicsLodSystem() (as property)
+    * - Engine::physicsPlanar() (as property)
+    * - Engine::physicsQuery() (as property)
+    * - Engine::physicsThreadCount() (as property)
+    * - Engine::saveSystem() (as property)
     * - Engine::sceneManager() (as property)
+    * - Engine::snapshotSystem() (as property)
+    * - Engine::spatialIndexSystem() (as property)
+    * - Engine::streamingSystem() (as property)
     *
     * @return 
     */
@@ -95,6 +115,15 @@ public:
     ComponentFactory&
     componentFactory();
 
+    /**
+    * @brief The contact event system
+    *
+    * Reports which rigid bodies started or stopped touching in the last
+    * physics step
+    */
+    ContactEventSystem&
+    contactEventSystem() const;
+
     /**
     * @brief The engine's entity manager
     *
@@ -135,6 +164,14 @@ public:
         std::string filename
     );
 
+    /**
+    * @brief The load system
+    *
+    * Reports the progress of loads started with load()
+    */
+    LoadSystem&
+    loadSystem() const;
+
     /**
     * @brief The script engine's Lua state
     */
@@ -147,12 +184,57 @@ public:
     MouseSystem&
     mouseSystem() const;
 
+    /**
+    * @brief Rigid bodies whose transform changed in the current frame
+    *
+    * RigidBodyInputSystem clears the list and adds the bodies moved by
+    * scripts, Bullet adds the bodies it moved during the step through
+    * their motion states. RigidBodyOutputSystem and BulletToOgreSystem
+    * only visit these bodies, so sleeping and static bodies cost nothing.
+    * An entity can appear more than once.
+    */
+    std::vector<EntityId>&
+    movedRigidBodies() const;
+
     /**
     * @brief The Ogre root object
     */
     Ogre::Root*
     ogreRoot() const;
 
+    /**
+    * @brief The physics level-of-detail system
+    *
+    * Simplifies the physics of bodies far from a focus entity
+    */
+    PhysicsLodSystem&
+    physicsLodSystem() const;
+
+    /**
+    * @brief Whether the physics world is confined to the xy-plane
+    *
+    * @see setPhysicsPlanar()
+    */
+    bool
+    physicsPlanar() const;
+
+    /**
+    * @brief Batched ray casts, sphere casts and box overlaps
+    *
+    * Only valid after init()
+    */
+    PhysicsQuery&
+    physicsQuery() const;
+
+    /**
+    * @brief The number of threads stepping the physics world
+    *
+    * After init(), this is the number actually used. It is 1 if the
+    * linked Bullet can't run on several threads.
+    */
+    unsigned int
+    physicsThreadCount() const;
+
     /**
     * @brief The physics world
     */
@@ -170,12 +252,44 @@ public:
         std::string filename
     );
 
+    /**
+    * @brief The save system
+    *
+    * Reports the progress of saves started with save()
+    */
+    SaveSystem&
+    saveSystem() const;
+
     /**
     * @brief The Ogre scene manager
     */
     Ogre::SceneManager*
     sceneManager() const;
 
+    /**
+    * @brief The snapshot system
+    *
+    * Takes and restores in-memory snapshots of the world
+    */
+    SnapshotSystem&
+    snapshotSystem() const;
+
+    /**
+    * @brief The spatial index system
+    *
+    * Finds entities near a point or within a region
+    */
+    SpatialIndexSystem&
+    spatialIndexSystem() const;
+
+    /**
+    * @brief The streaming system
+    *
+    * Loads and unloads regions of the world around a focus entity
+    */
+    StreamingSystem&
+    streamingSystem() const;
+
     /**
     * @brief Enables or disables physics debug drawing
     *
@@ -186,6 +300,49 @@ public:
         bool enabled
     );
 
+    /**
+    * @brief Confines the physics world to the xy-plane
+    *
+    * In a planar world, RigidBodyInputSystem keeps all rigid bodies at
+    * z = 0 and only lets them move along x and y and rotate around z,
+    * whatever their linear and angular factors say. Use Box2dShape and
+    * CircleShape for such worlds. Pairs of these shapes are handled by
+    * Bullet's 2D collision algorithms, which are cheaper than the
+    * general convex ones.
+    *
+    * Can be changed at any time, bodies are adjusted in the next frame.
+    *
+    * @param planar
+    *   Defaults to \c false
+    */
+    void
+    setPhysicsPlanar(
+        bool planar
+    );
+
+    /**
+    * @brief Sets the number of threads stepping the physics world
+    *
+    * With more than one thread, the physics world uses Bullet's task
+    * scheduler, parallel dispatcher and solver pool. This needs Bullet
+    * 2.88 or later, built with BT_THREADSAFE. Otherwise, the engine
+    * falls back to the single-threaded world, with a warning only if a
+    * count other than 0 was set.
+    *
+    * Multithreaded stepping is not deterministic. Set 1 where that
+    * matters.
+    *
+    * @param threadCount
+    *   0 for one thread per core, limited by the task scheduler.
+    *   Defaults to 0.
+    *
+    * @throws std::runtime_error if the engine is already initialized
+    */
+    void
+    setPhysicsThreadCount(
+        unsigned int threadCount
+    );
+
     /**
     * @brief Shuts the engine down
     *
@@ -2,10 +2,17 @@
 
 #include "engine/component_collection.h"
 #include "engine/component_factory.h"
+#include "engine/savegame_file.h"
 #include "engine/serialization.h"
+#include "engine/shared_storage.h"
+#include "engine/storage_arena.h"
+#include "util/parallel_for.h"
 
+#include <algorithm>
 #include <atomic>
 #include <boost/thread.hpp>
+#include <ostream>
+#include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -14,6 +21,16 @@
 
 using namespace thrive;
 
+namespace {
+
+/**
+* @brief Number of components serialized as one job, if not specified
+*/
+const size_t SERIALIZATION_CHUNK_SIZE = 1024;
+
+} // namespace
+
+
 struct EntityManager::Implementation {
 
     ComponentCollection&
@@ -27,6 +44,255 @@ struct EntityManager::Implementation {
         return *collection;
     }
 
+    /**
+    * @brief Stores everything but the component collections
+    */
+    StorageContainer
+    bookkeepingStorage(
+        const ComponentFactory& factory
+    ) const {
+        StorageContainer storage;
+        // Current Id
+        storage.set("currentId", m_currentId);
+        // Components to remove
+        StorageList componentsToRemove;
+        componentsToRemove.reserve(m_componentsToRemove.size());
+        for (const auto& pair : m_componentsToRemove) {
+            StorageContainer pairStorage;
+            pairStorage.set("entityId", pair.first);
+            std::string typeName = factory.getTypeName(pair.second);
+            pairStorage.set("componentTypeName", typeName);
+            componentsToRemove.append(std::move(pairStorage));
+        }
+        storage.set("componentsToRemove", std::move(componentsToRemove));
+        // Entities to remove
+        StorageList entitiesToRemove;
+        entitiesToRemove.reserve(m_entitiesToRemove.size());
+        for (EntityId entityId : m_entitiesToRemove) {
+            StorageContainer idStorage;
+            idStorage.set("id", entityId);
+            entitiesToRemove.append(std::move(idStorage));
+        }
+        storage.set("entitiesToRemove", std::move(entitiesToRemove));
+        // Named entities
+        StorageList namedIds;
+        namedIds.reserve(m_namedIds.size());
+        for (const auto& item : m_namedIds) {
+            StorageContainer itemStorage;
+            itemStorage.set("name", item.first);
+            itemStorage.set("entityId", item.second);
+            namedIds.append(std::move(itemStorage));
+        }
+        storage.set("namedIds", std::move(namedIds));
+        return storage;
+    }
+
+    bool
+    isPersistent(
+        EntityId entityId,
+        const Component& component
+    ) const {
+        return not (
+            component.isVolatile() or
+            m_volatileEntities.count(entityId) > 0
+        );
+    }
+
+    using ComponentList = std::vector<std::pair<EntityId, const Component*>>;
+
+    /**
+    * @brief A range of components of one type to serialize
+    */
+    struct SerializationJob {
+
+        ComponentTypeId typeId;
+
+        const std::pair<EntityId, const Component*>* begin;
+
+        const std::pair<EntityId, const Component*>* end;
+
+        StorageList storages;
+
+        std::vector<uint64_t> fingerprints;
+
+    };
+
+    /**
+    * @brief Splits the persistent components into serialization jobs
+    *
+    * @param[out] collections
+    *   Receives the persistent components of each collection, sorted by
+    *   entity id. The jobs point into these lists.
+    * @param chunkSize
+    *   Maximum number of components per job
+    * @param entityIds
+    *   If not \c nullptr, only components of these entities are included
+    */
+    std::vector<SerializationJob>
+    makeJobs(
+        std::vector<std::pair<ComponentTypeId, ComponentList>>& collections,
+        size_t chunkSize,
+        const std::unordered_set<EntityId>* entityIds = nullptr
+    ) const {
+        for (const auto& item : m_collections) {
+            ComponentList components;
+            for (const auto& pair : item.second->components()) {
+                if (entityIds and entityIds->count(pair.first) == 0) {
+                    continue;
+                }
+                if (this->isPersistent(pair.first, *pair.second)) {
+                    components.emplace_back(pair.first, pair.second.get());
+                }
+            }
+            if (components.empty()) {
+                continue;
+            }
+            // Sorted, so that each chunk covers a narrow range of entities
+            std::sort(
+                components.begin(),
+                components.end(),
+                [] (const std::pair<EntityId, const Component*>& lhs, const std::pair<EntityId, const Component*>& rhs) {
+                    return lhs.first < rhs.first;
+                }
+            );
+            collections.emplace_back(item.first, std::move(components));
+        }
+        std::vector<SerializationJob> jobs;
+        for (const auto& item : collections) {
+            const ComponentList& components = item.second;
+            for (size_t begin = 0; begin < components.size(); begin += chunkSize) {
+                size_t end = std::min(begin + chunkSize, components.size());
+                SerializationJob job;
+                job.typeId = item.first;
+                job.begin = components.data() + begin;
+                job.end = components.data() + end;
+                jobs.push_back(std::move(job));
+            }
+        }
+        return jobs;
+    }
+
+    /**
+    * @brief Serializes the components of each job
+    *
+    * Jobs of native component types run on worker threads, while the
+    * calling thread takes care of the scripted ones. Only a few jobs per
+    * thread are in flight at any time, so memory stays bounded. \a sink
+    * receives the jobs in their original order, on the calling thread,
+    * so the result doesn't depend on the number of threads.
+    *
+    * @param jobs
+    *   The jobs, as returned by makeJobs()
+    * @param factory
+    *   The component factory to tell native types from scripted ones
+    * @param withFingerprints
+    *   Whether to fill in SerializationJob::fingerprints
+    * @param sink
+    *   Receives each finished job
+    */
+    void
+    serialize(
+        std::vector<SerializationJob>& jobs,
+        const ComponentFactory& factory,
+        bool withFingerprints,
+        const std::function<void(SerializationJob&)>& sink
+    ) const {
+        auto run = [withFingerprints] (SerializationJob& job) {
+            // Constructed here to allocate from this thread's arena
+            StorageList storages;
+            storages.reserve(job.end - job.begin);
+            for (auto iter = job.begin; iter != job.end; ++iter) {
+                StorageContainer storage = iter->second->storage();
+                if (withFingerprints) {
+                    job.fingerprints.push_back(storage.fingerprint());
+                }
+                storages.append(std::move(storage));
+            }
+            job.storages = std::move(storages);
+        };
+        bool useArenas = StorageArena::current() != nullptr;
+        SharedStorageTable* sharedTable = SharedStorageTable::current();
+        size_t window = 4 * std::max(boost::thread::hardware_concurrency(), 1u);
+        std::vector<SerializationJob*> nativeJobs;
+        std::vector<SerializationJob*> scriptedJobs;
+        for (size_t windowBegin = 0; windowBegin < jobs.size(); windowBegin += window) {
+            size_t windowEnd = std::min(windowBegin + window, jobs.size());
+            nativeJobs.clear();
+            scriptedJobs.clear();
+            for (size_t i = windowBegin; i < windowEnd; ++i) {
+                if (factory.isNative(jobs[i].typeId)) {
+                    nativeJobs.push_back(&jobs[i]);
+                }
+                else {
+                    scriptedJobs.push_back(&jobs[i]);
+                }
+            }
+            parallelFor(
+                nativeJobs.size(),
+                [&] (size_t i) {
+                    // One arena per job, a shared one would serialize
+                    // all allocations
+                    StorageArena::Scope arenaScope(
+                        useArenas ? StorageArena::create() : nullptr
+                    );
+                    SharedStorageTable::Scope sharedScope(sharedTable);
+                    run(*nativeJobs[i]);
+                },
+                [&] () {
+                    // Scripted components can only be stored on the
+                    // thread that owns the Lua state
+                    for (SerializationJob* job : scriptedJobs) {
+                        run(*job);
+                    }
+                }
+            );
+            for (size_t i = windowBegin; i < windowEnd; ++i) {
+                sink(jobs[i]);
+                // Release the storages early
+                jobs[i].storages = StorageList();
+            }
+        }
+    }
+
+    /**
+    * @brief Stores the persistent components, by type name
+    *
+    * Trees are shared through the current SharedStorageTable.
+    *
+    * @param factory
+    *   The component factory to use for type name lookup
+    * @param entityIds
+    *   If not \c nullptr, only components of these entities are stored
+    */
+    StorageContainer
+    collectionsStorage(
+        const ComponentFactory& factory,
+        const std::unordered_set<EntityId>* entityIds = nullptr
+    ) const {
+        StorageContainer collections;
+        StorageList componentList;
+        ComponentTypeId listType = NULL_COMPONENT_TYPE;
+        auto flushList = [&] () {
+            if (not componentList.empty()) {
+                collections.set(factory.getTypeName(listType), std::move(componentList));
+                componentList = StorageList();
+            }
+        };
+        std::vector<std::pair<ComponentTypeId, ComponentList>> components;
+        auto jobs = this->makeJobs(components, SERIALIZATION_CHUNK_SIZE, entityIds);
+        this->serialize(jobs, factory, false, [&] (SerializationJob& job) {
+            if (job.typeId != listType) {
+                flushList();
+                listType = job.typeId;
+            }
+            for (StorageContainer& componentStorage : job.storages) {
+                componentList.append(std::move(componentStorage));
+            }
+        });
+        flushList();
+        return collections;
+    }
+
     std::unordered_map<
         ComponentTypeId, 
         std::unique_ptr<ComponentCollection>
@@ -34,6 +300,14 @@ struct EntityManager::Implementation {
 
     std::list<std::pair<EntityId, ComponentTypeId>> m_componentsToRemove;
 
+    // Fingerprints of all persistent components at the last checkpoint
+    std::unordered_map<
+        ComponentTypeId,
+        std::unordered_map<EntityId, uint64_t>
+    > m_fingerprints;
+
+    bool m_hasCheckpoint = false;
+
     EntityId m_currentId = NULL_ENTITY + 1;
 
     std::unordered_map<EntityId, uint16_t> m_entities;
@@ -75,6 +349,105 @@ EntityManager::addComponent(
 }
 
 
+std::vector<EntityId>
+EntityManager::addEntities(
+    const StorageContainer& storage,
+    const ComponentFactory& factory
+) {
+    SharedStorageTable shared(storage.get<StorageList>("shared"));
+    SharedStorageTable::Scope sharedScope(&shared);
+    StorageContainer collections = storage.get<StorageContainer>("collections");
+    std::unordered_set<EntityId> added;
+    std::unordered_set<EntityId> skipped;
+    for (const std::string& typeName : collections.keys()) {
+        for (const StorageContainer& componentStorage : collections.get<StorageList>(typeName)) {
+            EntityId owner = componentStorage.get<EntityId>("owner");
+            if (skipped.count(owner)) {
+                continue;
+            }
+            if (not added.count(owner)) {
+                if (this->exists(owner)) {
+                    skipped.insert(owner);
+                    continue;
+                }
+                added.insert(owner);
+            }
+            auto component = factory.load(typeName, componentStorage);
+            if (not component) {
+                std::cerr << "Unknown component type: " << typeName << std::endl;
+                break;
+            }
+            this->addComponent(owner, std::move(component));
+        }
+    }
+    return std::vector<EntityId>(skipped.begin(), skipped.end());
+}
+
+
+StorageContainer
+EntityManager::changes(
+    const ComponentFactory& factory
+) {
+    if (not m_impl->m_hasCheckpoint) {
+        throw std::logic_error("No checkpoint to compare with");
+    }
+    StorageContainer storage = m_impl->bookkeepingStorage(factory);
+    SharedStorageTable shared;
+    SharedStorageTable::Scope sharedScope(&shared);
+    StorageContainer collections;
+    StorageList changed;
+    ComponentTypeId changedType = NULL_COMPONENT_TYPE;
+    auto flushChanged = [&] () {
+        if (not changed.empty()) {
+            collections.set(factory.getTypeName(changedType), std::move(changed));
+            changed = StorageList();
+        }
+    };
+    std::unordered_map<
+        ComponentTypeId,
+        std::unordered_map<EntityId, uint64_t>
+    > fingerprints;
+    std::vector<std::pair<ComponentTypeId, Implementation::ComponentList>> components;
+    auto jobs = m_impl->makeJobs(components, SERIALIZATION_CHUNK_SIZE);
+    m_impl->serialize(jobs, factory, true, [&] (Implementation::SerializationJob& job) {
+        if (job.typeId != changedType) {
+            flushChanged();
+            changedType = job.typeId;
+        }
+        const std::unordered_map<EntityId, uint64_t>& previous = m_impl->m_fingerprints[job.typeId];
+        std::unordered_map<EntityId, uint64_t>& current = fingerprints[job.typeId];
+        for (size_t i = 0; i < job.storages.size(); ++i) {
+            EntityId entityId = job.begin[i].first;
+            uint64_t componentFingerprint = job.fingerprints[i];
+            current.emplace(entityId, componentFingerprint);
+            auto iter = previous.find(entityId);
+            if (iter == previous.end() or iter->second != componentFingerprint) {
+                changed.append(std::move(job.storages[i]));
+            }
+        }
+    });
+    flushChanged();
+    StorageList removedComponents;
+    for (const auto& item : m_impl->m_fingerprints) {
+        const std::unordered_map<EntityId, uint64_t>& current = fingerprints[item.first];
+        for (const auto& pair : item.second) {
+            if (current.count(pair.first) == 0) {
+                StorageContainer removal;
+                removal.set("entityId", pair.first);
+                removal.set("componentTypeName", factory.getTypeName(item.first));
+                removedComponents.append(std::move(removal));
+            }
+        }
+    }
+    m_impl->m_fingerprints = std::move(fingerprints);
+    // Only what the changed components refer to
+    storage.set("shared", shared.storage(collections));
+    storage.set("collections", std::move(collections));
+    storage.set("removedComponents", std::move(removedComponents));
+    return storage;
+}
+
+
 void
 EntityManager::clear() {
     for (auto& pair : m_impl->m_collections) {
@@ -83,6 +456,8 @@ EntityManager::clear() {
     m_impl->m_componentsToRemove.clear();
     m_impl->m_entities.clear();
     m_impl->m_entitiesToRemove.clear();
+    m_impl->m_fingerprints.clear();
+    m_impl->m_hasCheckpoint = false;
     m_impl->m_namedIds.clear();
     m_impl->m_volatileEntities.clear();
 }
@@ -98,6 +473,20 @@ EntityManager::entities() {
 }
 
 
+StorageContainer
+EntityManager::entityStorage(
+    const std::unordered_set<EntityId>& entityIds,
+    const ComponentFactory& factory
+) const {
+    StorageContainer storage;
+    SharedStorageTable shared;
+    SharedStorageTable::Scope sharedScope(&shared);
+    storage.set("collections", m_impl->collectionsStorage(factory, &entityIds));
+    storage.set("shared", shared.storage());
+    return storage;
+}
+
+
 bool
 EntityManager::exists(
     EntityId entityId
@@ -146,6 +535,12 @@ EntityManager::getNamedId(
 }
 
 
+bool
+EntityManager::hasCheckpoint() const {
+    return m_impl->m_hasCheckpoint;
+}
+
+
 bool
 EntityManager::isVolatile(
     EntityId id
@@ -154,6 +549,16 @@ EntityManager::isVolatile(
 }
 
 
+std::unordered_set<EntityId>
+EntityManager::namedEntities() const {
+    std::unordered_set<EntityId> entities;
+    for (const auto& item : m_impl->m_namedIds) {
+        entities.insert(item.second);
+    }
+    return entities;
+}
+
+
 std::unordered_set<ComponentTypeId>
 EntityManager::nonEmptyCollections() const {
     std::unordered_set<ComponentTypeId> collections;
@@ -166,6 +571,82 @@ EntityManager::nonEmptyCollections() const {
 }
 
 
+void
+EntityManager::patch(
+    const StorageContainer& storage,
+    const ComponentFactory& factory
+) {
+    // Id state. Volatile entities created since the storage was made keep
+    // their ids, so the counter must not go back.
+    m_impl->m_currentId = std::max(
+        m_impl->m_currentId,
+        storage.get<EntityId>("currentId")
+    );
+    m_impl->m_namedIds.clear();
+    for (const auto& entry : storage.get<StorageList>("namedIds")) {
+        std::string name = entry.get<std::string>("name");
+        EntityId id = entry.get<EntityId>("entityId");
+        m_impl->m_namedIds[name] = id;
+    }
+    m_impl->m_componentsToRemove.clear();
+    m_impl->m_entitiesToRemove.clear();
+    // Components
+    SharedStorageTable shared(storage.get<StorageList>("shared"));
+    SharedStorageTable::Scope sharedScope(&shared);
+    std::unordered_map<ComponentTypeId, std::unordered_set<EntityId>> restored;
+    StorageContainer collections = storage.get<StorageContainer>("collections");
+    for (const std::string& typeName : collections.keys()) {
+        ComponentTypeId typeId = factory.getTypeId(typeName);
+        if (typeId == NULL_COMPONENT_TYPE) {
+            std::cerr << "Unknown component type: " << typeName << std::endl;
+            continue;
+        }
+        ComponentCollection& collection = m_impl->getComponentCollection(typeId);
+        std::unordered_set<EntityId>& restoredEntities = restored[typeId];
+        for (const StorageContainer& componentStorage : collections.get<StorageList>(typeName)) {
+            EntityId owner = componentStorage.get<EntityId>("owner");
+            restoredEntities.insert(owner);
+            // Replacing a component may be expensive for the systems that
+            // pick up the change, so unchanged components are skipped
+            Component* existing = collection[owner];
+            if (
+                existing and
+                existing->storage().fingerprint() == componentStorage.fingerprint()
+            ) {
+                continue;
+            }
+            // Changed components are replaced, not reloaded. Component::load()
+            // expects a freshly constructed component.
+            auto component = factory.load(typeName, componentStorage);
+            if (component) {
+                this->addComponent(owner, std::move(component));
+            }
+        }
+    }
+    for (const auto& item : m_impl->m_collections) {
+        const std::unordered_set<EntityId>& restoredEntities = restored[item.first];
+        for (const auto& pair : item.second->components()) {
+            if (
+                m_impl->isPersistent(pair.first, *pair.second) and
+                restoredEntities.count(pair.first) == 0
+            ) {
+                this->removeComponent(pair.first, item.first);
+            }
+        }
+    }
+    // Removals that were pending when the storage was made
+    for (const StorageContainer& entry : storage.get<StorageList>("componentsToRemove")) {
+        ComponentTypeId typeId = factory.getTypeId(
+            entry.get<std::string>("componentTypeName")
+        );
+        this->removeComponent(entry.get<EntityId>("entityId"), typeId);
+    }
+    for (const StorageContainer& entry : storage.get<StorageList>("entitiesToRemove")) {
+        this->removeEntity(entry.get<EntityId>("id"));
+    }
+}
+
+
 void
 EntityManager::processRemovals() {
     for (const auto& pair : m_impl->m_componentsToRemove) {
@@ -189,6 +670,7 @@ EntityManager::processRemovals() {
         for (const auto& pair : m_impl->m_collections) {
             pair.second->removeComponent(entityId);
         }
+        m_impl->m_entities.erase(entityId);
     }
     m_impl->m_entitiesToRemove.clear();
 }
@@ -215,44 +697,8 @@ EntityManager::restore(
     const StorageContainer& storage,
     const ComponentFactory& factory
 ) {
-    this->clear();
-    // Current Id
-    m_impl->m_currentId = storage.get<EntityId>("currentId");
-    // Named entities
-    StorageList namedIds = storage.get<StorageList>("namedIds");
-    for (const auto& entry : namedIds) {
-        std::string name = entry.get<std::string>("name");
-        EntityId id = entry.get<EntityId>("entityId");
-        m_impl->m_namedIds[name] = id;
-    }
-    // Collections
-    StorageContainer collections = storage.get<StorageContainer>("collections");
-    auto typeNames = collections.keys();
-    for (const std::string& typeName : typeNames) {
-        StorageList componentList = collections.get<StorageList>(typeName);
-        for (const StorageContainer& componentStorage : componentList) {
-            auto component = factory.load(typeName, componentStorage);
-            EntityId owner = component->owner();
-            if (owner == NULL_ENTITY) {
-                std::cerr << "Component with no entity: " << typeName << std::endl;
-            }
-            this->addComponent(owner, std::move(component));
-        }
-    }
-    // Components to remove
-    StorageList componentsToRemove = storage.get<StorageList>("componentsToRemove");
-    for (const StorageContainer& entry : componentsToRemove) {
-        EntityId entityId = entry.get<EntityId>("entityId");
-        std::string typeName = entry.get<std::string>("componentTypeName");
-        ComponentTypeId typeId = factory.getTypeId(typeName);
-        this->removeComponent(entityId, typeId);
-    }
-    // Entities to remove
-    StorageList entitiesToRemove = storage.get<StorageList>("entitiesToRemove");
-    for (const auto& entry : entitiesToRemove) {
-        EntityId entityId = entry.get<EntityId>("id");
-        this->removeEntity(entityId);
-    }
+    Restorer restorer(*this, storage, factory);
+    restorer.finish();
 }
 
 
@@ -274,62 +720,264 @@ StorageContainer
 EntityManager::storage(
     const ComponentFactory& factory
 ) const {
-    StorageContainer storage;
-    // Current Id
-    storage.set("currentId", m_impl->m_currentId);
-    // Collections
-    StorageContainer collections;
-    for (const auto& item : m_impl->m_collections) {
-        const auto& components = item.second->components();
-        StorageList componentList;
-        componentList.reserve(components.size());
-        for (const auto& pair : components) {
-            EntityId entityId = pair.first;
-            const std::unique_ptr<Component>& component = pair.second;
-            if (component->isVolatile() or 
-                m_impl->m_volatileEntities.count(entityId) > 0
-            ) {
+    StorageContainer storage = m_impl->bookkeepingStorage(factory);
+    SharedStorageTable shared;
+    SharedStorageTable::Scope sharedScope(&shared);
+    storage.set("collections", m_impl->collectionsStorage(factory));
+    storage.set("shared", shared.storage());
+    return storage;
+}
+
+
+void
+EntityManager::sections(
+    const ComponentFactory& factory,
+    const std::function<void(SavegameSection&&)>& sink,
+    size_t chunkSize,
+    bool checkpoint
+) {
+    assert(chunkSize > 0);
+    // Bookkeeping, everything but the collections
+    SavegameSection entities;
+    entities.name = SavegameSection::ENTITIES;
+    entities.content = m_impl->bookkeepingStorage(factory);
+    sink(std::move(entities));
+    // Collections, one section per job
+    if (checkpoint) {
+        m_impl->m_fingerprints.clear();
+    }
+    SharedStorageTable shared;
+    SharedStorageTable::Scope sharedScope(&shared);
+    std::vector<std::pair<ComponentTypeId, Implementation::ComponentList>> components;
+    auto jobs = m_impl->makeJobs(components, chunkSize);
+    m_impl->serialize(jobs, factory, checkpoint, [&] (Implementation::SerializationJob& job) {
+        SavegameSection chunk;
+        chunk.name = SavegameSection::collectionName(
+            factory.getTypeName(job.typeId)
+        );
+        chunk.firstEntity = job.begin->first;
+        chunk.lastEntity = (job.end - 1)->first;
+        if (checkpoint) {
+            std::unordered_map<EntityId, uint64_t>& fingerprints = m_impl->m_fingerprints[job.typeId];
+            for (size_t i = 0; i < job.fingerprints.size(); ++i) {
+                fingerprints[job.begin[i].first] = job.fingerprints[i];
+            }
+        }
+        chunk.content.set("components", std::move(job.storages));
+        sink(std::move(chunk));
+    });
+    // Complete only once all components are stored
+    if (not shared.empty()) {
+        SavegameSection sharedSection;
+        sharedSection.name = SavegameSection::SHARED;
+        sharedSection.content.set("entries", shared.storage());
+        sink(std::move(sharedSection));
+    }
+    if (checkpoint) {
+        m_impl->m_hasCheckpoint = true;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// EntityManager::Restorer
+////////////////////////////////////////////////////////////////////////////////
+
+struct EntityManager::Restorer::Implementation {
+
+    struct PendingComponent {
+
+        EntityId owner;
+
+        const std::string* typeName;
+
+        StorageContainer storage;
+
+    };
+
+    Implementation(
+        EntityManager& entityManager,
+        const ComponentFactory& factory
+    ) : m_entityManager(entityManager),
+        m_factory(factory)
+    {
+    }
+
+    /**
+    * @brief Adds all components of the next entity
+    */
+    void
+    restoreNextEntity() {
+        SharedStorageTable::Scope sharedScope(m_shared.get());
+        EntityId owner = m_components[m_next].owner;
+        while (m_next < m_components.size() and m_components[m_next].owner == owner) {
+            PendingComponent& pending = m_components[m_next];
+            auto component = m_factory.load(*pending.typeName, pending.storage);
+            // Release the storage early, restoring may take many frames
+            pending.storage = StorageContainer();
+            ++m_next;
+            if (not component) {
+                std::cerr << "Unknown component type: " << *pending.typeName << std::endl;
                 continue;
             }
-            componentList.append(component->storage());
+            if (owner == NULL_ENTITY) {
+                std::cerr << "Component with no entity: " << *pending.typeName << std::endl;
+            }
+            m_entityManager.addComponent(owner, std::move(component));
+        }
+    }
+
+    /**
+    * @brief Replaces the entity manager's content with the id state
+    */
+    void
+    start() {
+        m_entityManager.clear();
+        m_entityManager.m_impl->m_currentId = m_currentId;
+        for (const auto& entry : m_namedIds) {
+            std::string name = entry.get<std::string>("name");
+            EntityId id = entry.get<EntityId>("entityId");
+            m_entityManager.m_impl->m_namedIds[name] = id;
+        }
+        m_namedIds.clear();
+        m_isStarted = true;
+    }
+
+    void
+    applyRemovals() {
+        for (const StorageContainer& entry : m_componentsToRemove) {
+            EntityId entityId = entry.get<EntityId>("entityId");
+            std::string typeName = entry.get<std::string>("componentTypeName");
+            ComponentTypeId typeId = m_factory.getTypeId(typeName);
+            m_entityManager.removeComponent(entityId, typeId);
         }
-        if (not componentList.empty()) {
-            std::string typeName = factory.getTypeName(item.first);
-            collections.set(typeName, std::move(componentList));
+        for (const auto& entry : m_entitiesToRemove) {
+            EntityId entityId = entry.get<EntityId>("id");
+            m_entityManager.removeEntity(entityId);
         }
+        m_componentsToRemove.clear();
+        m_entitiesToRemove.clear();
+        m_isFinished = true;
     }
-    storage.set("collections", std::move(collections));
-    // Components to remove
-    StorageList componentsToRemove;
-    componentsToRemove.reserve(m_impl->m_componentsToRemove.size());
-    for (const auto& pair : m_impl->m_componentsToRemove) {
-        StorageContainer pairStorage;
-        pairStorage.set("entityId", pair.first);
-        std::string typeName = factory.getTypeName(pair.second);
-        pairStorage.set("componentTypeName", typeName);
-        componentsToRemove.append(std::move(pairStorage));
-    }
-    storage.set("componentsToRemove", std::move(componentsToRemove));
-    // Entities to remove
-    StorageList entitiesToRemove;
-    entitiesToRemove.reserve(m_impl->m_entitiesToRemove.size());
-    for (EntityId entityId : m_impl->m_entitiesToRemove) {
-        StorageContainer idStorage;
-        idStorage.set("id", entityId);
-        entitiesToRemove.append(std::move(idStorage));
-    }
-    storage.set("entitiesToRemove", std::move(entitiesToRemove));
-    // Named entities
-    StorageList namedIds;
-    namedIds.reserve(m_impl->m_namedIds.size());
-    for (const auto& item : m_impl->m_namedIds) {
-        StorageContainer itemStorage;
-        itemStorage.set("name", item.first);
-        itemStorage.set("entityId", item.second);
-        namedIds.append(std::move(itemStorage));
+
+    std::vector<PendingComponent> m_components;
+
+    StorageList m_componentsToRemove;
+
+    EntityId m_currentId = NULL_ENTITY;
+
+    EntityManager& m_entityManager;
+
+    StorageList m_entitiesToRemove;
+
+    const ComponentFactory& m_factory;
+
+    bool m_isFinished = false;
+
+    bool m_isStarted = false;
+
+    StorageList m_namedIds;
+
+    size_t m_next = 0;
+
+    // Kept until the restorer is done, so components loaded in different
+    // steps still share objects
+    std::unique_ptr<SharedStorageTable> m_shared;
+
+    std::list<std::string> m_typeNames;
+
+};
+
+
+EntityManager::Restorer::Restorer(
+    EntityManager& entityManager,
+    StorageContainer storage,
+    const ComponentFactory& factory
+) : m_impl(new Implementation(entityManager, factory))
+{
+    // Only read the storage here, the entity manager and factory may be
+    // in use on another thread until the first step
+    m_impl->m_currentId = storage.get<EntityId>("currentId");
+    m_impl->m_namedIds = storage.take<StorageList>("namedIds");
+    // Trees shared between components
+    m_impl->m_shared.reset(
+        new SharedStorageTable(storage.take<StorageList>("shared"))
+    );
+    // Collections, grouped by entity
+    StorageContainer collections = storage.take<StorageContainer>("collections");
+    m_impl->m_typeNames = collections.keys();
+    for (const std::string& typeName : m_impl->m_typeNames) {
+        StorageList componentList = collections.take<StorageList>(typeName);
+        for (StorageContainer& componentStorage : componentList) {
+            EntityId owner = componentStorage.get<EntityId>("owner");
+            m_impl->m_components.push_back(Implementation::PendingComponent{
+                owner,
+                &typeName,
+                std::move(componentStorage)
+            });
+        }
+    }
+    std::stable_sort(
+        m_impl->m_components.begin(),
+        m_impl->m_components.end(),
+        [] (const Implementation::PendingComponent& lhs, const Implementation::PendingComponent& rhs) {
+            return lhs.owner < rhs.owner;
+        }
+    );
+    // Removals
+    m_impl->m_componentsToRemove = storage.take<StorageList>("componentsToRemove");
+    m_impl->m_entitiesToRemove = storage.take<StorageList>("entitiesToRemove");
+}
+
+
+EntityManager::Restorer::~Restorer() {}
+
+
+void
+EntityManager::Restorer::finish() {
+    if (not m_impl->m_isStarted) {
+        m_impl->start();
+    }
+    while (m_impl->m_next < m_impl->m_components.size()) {
+        m_impl->restoreNextEntity();
+    }
+    if (not m_impl->m_isFinished) {
+        m_impl->applyRemovals();
     }
-    storage.set("namedIds", std::move(namedIds));
-    return storage;
 }
 
 
+bool
+EntityManager::Restorer::isFinished() const {
+    return m_impl->m_isFinished;
+}
+
+
+float
+EntityManager::Restorer::progress() const {
+    if (m_impl->m_isFinished) {
+        return 1.0f;
+    }
+    return float(m_impl->m_next) / float(m_impl->m_components.size() + 1);
+}
+
+
+void
+EntityManager::Restorer::step(
+    boost::chrono::microseconds budget
+) {
+    using Clock = boost::chrono::steady_clock;
+    Clock::time_point deadline = Clock::now() + budget;
+    if (not m_impl->m_isStarted) {
+        m_impl->start();
+    }
+    do {
+        if (m_impl->m_next == m_impl->m_components.size()) {
+            if (not m_impl->m_isFinished) {
+                m_impl->applyRemovals();
+            }
+            return;
+        }
+        m_impl->restoreNextEntity();
+    } while (Clock::now() < deadline);
+}
@@ -3,8 +3,11 @@
 #include "engine/typedefs.h"
 #include "util/make_unique.h"
 
+#include <boost/chrono.hpp>
+#include <functional>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
 namespace thrive {
 
@@ -12,6 +15,7 @@ class Component;
 class ComponentCollection;
 class ComponentFactory;
 class StorageContainer;
+struct SavegameSection;
 
 /**
 * @brief Manages entities and their components
@@ -82,10 +86,64 @@ public:
         );
     }
 
+    /**
+    * @brief Adds the components of some entities
+    *
+    * Unlike restore() and patch(), this leaves all other components and
+    * the id bookkeeping alone. Entities keep the ids they were stored
+    * with, so \a storage should come from this entity manager.
+    *
+    * Stored entities whose id is already in use are skipped as a whole,
+    * so their components are never mixed into another entity. This
+    * happens when the id was handed out again, for example after loading
+    * an older savegame.
+    *
+    * @param storage
+    *   The components to add, as returned by entityStorage()
+    * @param factory
+    *   The component factory to use
+    *
+    * @return
+    *   The skipped entities
+    */
+    std::vector<EntityId>
+    addEntities(
+        const StorageContainer& storage,
+        const ComponentFactory& factory
+    );
+
+    /**
+    * @brief Serializes what changed since the last checkpoint
+    *
+    * Changes are detected per component by comparing a fingerprint of its
+    * serialized form with the one taken at the checkpoint. This way,
+    * components need no change tracking of their own, and only changed
+    * components end up in the result.
+    *
+    * The result holds the same bookkeeping as storage(), plus:
+    * - \c collections: New or changed components, by type name
+    * - \c removedComponents: Entity id and type name of each component
+    *   that was removed
+    * - \c shared: The shared trees the changed components refer to
+    *
+    * The current state becomes the new checkpoint.
+    *
+    * @param factory
+    *   The component factory to use for type name lookup
+    *
+    * @throws std::logic_error if there is no checkpoint
+    *
+    * @see SavegameJournal::apply()
+    */
+    StorageContainer
+    changes(
+        const ComponentFactory& factory
+    );
+
     /**
     * @brief Removes all components
     *
-    * Usually only used in testing.
+    * Usually only used in testing. Also discards the checkpoint.
     */
     void
     clear();
@@ -96,6 +154,24 @@ public:
     std::unordered_set<EntityId>
     entities();
 
+    /**
+    * @brief Serializes the non-volatile components of some entities
+    *
+    * The result holds:
+    * - \c collections: The components, by type name
+    * - \c shared: The shared trees the components refer to
+    *
+    * @param entityIds
+    *   The entities to store
+    * @param factory
+    *   The component factory to use for type name lookup
+    */
+    StorageContainer
+    entityStorage(
+        const std::unordered_set<EntityId>& entityIds,
+        const ComponentFactory& factory
+    ) const;
+
     /**
     * @brief Generates a new, unique entity id
     *
@@ -231,6 +307,22 @@ public:
         EntityId entityId
     ) const;
 
+    /**
+    * @brief Whether changes() can be called
+    *
+    * A checkpoint is taken by sections() and changes().
+    */
+    bool
+    hasCheckpoint() const;
+
+    /**
+    * @brief Returns the ids of all named entities
+    *
+    * @see getNamedId()
+    */
+    std::unordered_set<EntityId>
+    namedEntities() const;
+
     /**
     * @brief Returns the set of non-empty collection ids
     *
@@ -253,6 +345,28 @@ public:
         EntityId id
     ) const;
 
+    /**
+    * @brief Restores a storage container without rebuilding everything
+    *
+    * Unlike restore(), this keeps components that exist both now and in
+    * \a storage if their serialized form is unchanged. Components that
+    * differ are replaced by freshly loaded ones, like missing components
+    * are created. Persistent components that are not in \a storage are
+    * removed with the next call to processRemovals(). Volatile entities and
+    * components are not touched. Entity ids are not handed out again, not
+    * even those of entities removed by the patch.
+    *
+    * @param storage
+    *   The storage to restore from, as returned by EntityManager::storage()
+    * @param factory
+    *   The component factory to use
+    */
+    void
+    patch(
+        const StorageContainer& storage,
+        const ComponentFactory& factory
+    );
+
     /**
     * @brief Removes all components queued for removal
     */
@@ -294,6 +408,87 @@ public:
         EntityId entityId
     );
 
+    /**
+    * @brief Restores an entity manager over several steps
+    *
+    * Spreads the cost of creating components (and of the systems that
+    * initialize them afterwards) over several frames.
+    *
+    * Creating the restorer only prepares the storage, so it can be done
+    * on a loader thread. The first step clears the entity manager. Each
+    * step then adds the components of whole entities, so an entity is
+    * either complete or absent. Pending removals are applied in the last
+    * step. The world is consistent again once isFinished() returns
+    * \c true.
+    */
+    class Restorer {
+
+    public:
+
+        /**
+        * @brief Constructor
+        *
+        * Neither touches \a entityManager nor \a factory, which may be
+        * in use on another thread.
+        *
+        * @param entityManager
+        *   The entity manager to restore. Must outlive the restorer.
+        * @param storage
+        *   The storage to restore from, as returned by EntityManager::storage().
+        *   Move it in to avoid copying it.
+        * @param factory
+        *   The component factory to use. Must outlive the restorer.
+        */
+        Restorer(
+            EntityManager& entityManager,
+            StorageContainer storage,
+            const ComponentFactory& factory
+        );
+
+        /**
+        * @brief Destructor
+        */
+        ~Restorer();
+
+        /**
+        * @brief Restores everything that is left
+        */
+        void
+        finish();
+
+        /**
+        * @brief Whether the entity manager has been restored completely
+        */
+        bool
+        isFinished() const;
+
+        /**
+        * @brief Fraction of components restored so far, between 0 and 1
+        */
+        float
+        progress() const;
+
+        /**
+        * @brief Restores entities until the time budget is used up
+        *
+        * Restores at least one entity per call, so progress is guaranteed
+        * even with a tiny budget.
+        *
+        * @param budget
+        *   Time to spend in this step
+        */
+        void
+        step(
+            boost::chrono::microseconds budget
+        );
+
+    private:
+
+        struct Implementation;
+        std::unique_ptr<Implementation> m_impl;
+
+    };
+
     /**
     * @brief Restores the entity manager from a storage container
     *
@@ -323,6 +518,9 @@ public:
     /**
     * @brief Serializes the current non-volatile components into a storage container
     *
+    * Storage trees that components share (see SharedStorageTable) are
+    * stored once, under \c shared.
+    *
     * @param factory
     *   The component factory to use for type name lookup
     *
@@ -333,6 +531,34 @@ public:
         const ComponentFactory& factory
     ) const;
 
+    /**
+    * @brief Serializes the current non-volatile components section by section
+    *
+    * Produces one section for the entity manager's bookkeeping and one
+    * or more for each component collection. Collections are sorted by 
+    * entity id and split into chunks of at most \a chunkSize components. 
+    * Each section is built and handed to \a sink before the next one is 
+    * started. Storage trees that components share are stored once, in a
+    * final SavegameSection::SHARED section.
+    *
+    * @param factory
+    *   The component factory to use for type name lookup
+    * @param sink
+    *   Receives the sections
+    * @param chunkSize
+    *   Maximum number of components per section
+    * @param checkpoint
+    *   If \c true, the serialized state becomes the checkpoint for
+    *   changes()
+    */
+    void
+    sections(
+        const ComponentFactory& factory,
+        const std::function<void(SavegameSection&&)>& sink,
+        size_t chunkSize = 1024,
+        bool checkpoint = false
+    );
+
 private:
 
     struct Implementation;
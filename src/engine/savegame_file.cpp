@@ -0,0 +1,800 @@
+#include "engine/savegame_file.h"
+
+#include "engine/shared_storage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <unordered_map>
+#include <zlib.h>
+
+using namespace thrive;
+
+namespace {
+
+const char SAVEGAME_MAGIC[8] = {'T', 'H', 'R', 'I', 'V', 'E', 'S', 'G'};
+
+const uint32_t SAVEGAME_VERSION = 1;
+
+/**
+* @brief Magic, version, reserved, index offset, index length
+*/
+const size_t HEADER_SIZE = 8 + 4 + 4 + 8 + 8;
+
+const size_t INDEX_POSITION_OFFSET = 16;
+
+const std::string COLLECTION_PREFIX = "collection/";
+
+const char JOURNAL_MAGIC[7] = {'T', 'H', 'R', 'I', 'V', 'E', 'J'};
+
+const uint8_t JOURNAL_VERSION = 1;
+
+/**
+* @brief Magic, version, base id
+*/
+const size_t JOURNAL_HEADER_SIZE = 7 + 1 + 8;
+
+/**
+* @brief Length, CRC-32
+*/
+const size_t RECORD_HEADER_SIZE = 4 + 4;
+
+/**
+* @brief Read-only stream buffer over a block of memory
+*
+* Lets operator>>(std::istream&, StorageContainer&) decode straight from
+* a mapped file.
+*/
+class MemoryBuffer : public std::streambuf {
+
+public:
+
+    MemoryBuffer(
+        const char* data,
+        size_t size
+    ) {
+        // std::streambuf wants non-const pointers, but never writes
+        // through the get area
+        char* begin = const_cast<char*>(data);
+        this->setg(begin, begin, begin + size);
+    }
+
+protected:
+
+    // Lets readers find out how much data is left
+
+    pos_type
+    seekoff(
+        off_type offset,
+        std::ios_base::seekdir direction,
+        std::ios_base::openmode which
+    ) override {
+        if (not (which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        char* base = this->eback();
+        if (direction == std::ios_base::cur) {
+            base = this->gptr();
+        }
+        else if (direction == std::ios_base::end) {
+            base = this->egptr();
+        }
+        if (
+            offset < this->eback() - base or
+            offset > this->egptr() - base
+        ) {
+            return pos_type(off_type(-1));
+        }
+        this->setg(this->eback(), base + offset, this->egptr());
+        return pos_type(this->gptr() - this->eback());
+    }
+
+    pos_type
+    seekpos(
+        pos_type position,
+        std::ios_base::openmode which
+    ) override {
+        return this->seekoff(off_type(position), std::ios_base::beg, which);
+    }
+
+};
+
+
+template<typename T>
+void
+writeRaw(
+    std::ostream& stream,
+    T value
+) {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+T
+readRaw(
+    const char* data
+) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+
+/**
+* @brief Serializes a document, compressed unless \a codec is None
+*/
+std::string
+encode(
+    const StorageContainer& content,
+    BlockCompression::Codec codec
+) {
+    std::ostringstream buffer(std::ios_base::out | std::ios_base::binary);
+    buffer << content;
+    std::string uncompressed = buffer.str();
+    if (codec == BlockCompression::None) {
+        return uncompressed;
+    }
+    return BlockCompression::compress(
+        uncompressed.data(),
+        uncompressed.size(),
+        codec
+    );
+}
+
+
+/**
+* @brief Deserializes a document written by encode()
+*/
+StorageContainer
+decode(
+    const char* data,
+    size_t length
+) {
+    std::string uncompressed;
+    if (BlockCompression::isCompressed(data, length)) {
+        uncompressed = BlockCompression::decompress(data, length);
+        data = uncompressed.data();
+        length = uncompressed.size();
+    }
+    MemoryBuffer buffer(data, length);
+    std::istream stream(&buffer);
+    stream.exceptions(std::istream::failbit | std::istream::badbit);
+    StorageContainer content;
+    stream >> content;
+    return content;
+}
+
+
+/**
+* @brief Copies everything but the collections of an entity manager storage
+*/
+void
+copyBookkeeping(
+    const StorageContainer& source,
+    StorageContainer& target
+) {
+    target.set("currentId", source.get<EntityId>("currentId"));
+    target.set("componentsToRemove", source.get<StorageList>("componentsToRemove"));
+    target.set("entitiesToRemove", source.get<StorageList>("entitiesToRemove"));
+    target.set("namedIds", source.get<StorageList>("namedIds"));
+}
+
+
+/**
+* @brief Reads a journal header
+*
+* @return 
+*   \c true if the journal belongs to the savegame with \a baseId
+*/
+bool
+readJournalHeader(
+    std::istream& stream,
+    uint64_t baseId
+) {
+    char header[JOURNAL_HEADER_SIZE];
+    if (not stream.read(header, sizeof(header))) {
+        return false;
+    }
+    return (
+        std::memcmp(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 and
+        static_cast<uint8_t>(header[sizeof(JOURNAL_MAGIC)]) == JOURNAL_VERSION and
+        readRaw<uint64_t>(header + sizeof(JOURNAL_MAGIC) + 1) == baseId
+    );
+}
+
+
+/**
+* @brief Reads the next journal record and verifies it
+*
+* @param remaining
+*   The bytes left in the journal, reduced by the record's size
+* @param record
+*   Receives the record's payload
+*
+* @return
+*   \c false if the journal ends here, because the record is cut short,
+*   or its checksum doesn't match. Nothing after it can be trusted.
+*/
+bool
+readJournalRecord(
+    std::istream& stream,
+    uint64_t& remaining,
+    std::string& record
+) {
+    char recordHeader[RECORD_HEADER_SIZE];
+    if (not stream.read(recordHeader, sizeof(recordHeader))) {
+        return false;
+    }
+    uint32_t length = readRaw<uint32_t>(recordHeader);
+    uint32_t checksum = readRaw<uint32_t>(recordHeader + sizeof(uint32_t));
+    if (RECORD_HEADER_SIZE + length > remaining) {
+        return false;
+    }
+    record.resize(length);
+    if (not stream.read(&record[0], length)) {
+        return false;
+    }
+    uLong actualChecksum = crc32(
+        0,
+        reinterpret_cast<const Bytef*>(record.data()),
+        static_cast<uInt>(record.size())
+    );
+    if (static_cast<uint32_t>(actualChecksum) != checksum) {
+        return false;
+    }
+    remaining -= RECORD_HEADER_SIZE + length;
+    return true;
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SavegameSection
+////////////////////////////////////////////////////////////////////////////////
+
+const std::string SavegameSection::ENTITIES = "entities";
+
+const std::string SavegameSection::JOURNAL = "journal";
+
+const std::string SavegameSection::SHARED = "shared";
+
+
+std::string
+SavegameSection::collectionName(
+    const std::string& typeName
+) {
+    return COLLECTION_PREFIX + typeName;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SavegameWriter
+////////////////////////////////////////////////////////////////////////////////
+
+struct SavegameWriter::Implementation {
+
+    Implementation(
+        std::ostream& stream,
+        BlockCompression::Codec codec
+    ) : m_codec(codec),
+        m_start(stream.tellp()),
+        m_stream(stream)
+    {
+    }
+
+    uint64_t
+    position() {
+        return static_cast<uint64_t>(m_stream.tellp() - m_start);
+    }
+
+    BlockCompression::Codec m_codec;
+
+    StorageList m_index;
+
+    std::streampos m_start;
+
+    std::ostream& m_stream;
+
+};
+
+
+SavegameWriter::SavegameWriter(
+    std::ostream& stream,
+    BlockCompression::Codec codec
+) : m_impl(new Implementation(stream, codec))
+{
+    stream.write(SAVEGAME_MAGIC, sizeof(SAVEGAME_MAGIC));
+    writeRaw<uint32_t>(stream, SAVEGAME_VERSION);
+    writeRaw<uint32_t>(stream, 0);
+    // Index position, patched by finish()
+    writeRaw<uint64_t>(stream, 0);
+    writeRaw<uint64_t>(stream, 0);
+}
+
+
+SavegameWriter::~SavegameWriter() {}
+
+
+void
+SavegameWriter::finish() {
+    std::ostream& stream = m_impl->m_stream;
+    uint64_t indexOffset = m_impl->position();
+    StorageContainer index;
+    index.set("sections", std::move(m_impl->m_index));
+    stream << index;
+    uint64_t end = m_impl->position();
+    stream.seekp(m_impl->m_start + std::streamoff(INDEX_POSITION_OFFSET));
+    writeRaw<uint64_t>(stream, indexOffset);
+    writeRaw<uint64_t>(stream, end - indexOffset);
+    stream.seekp(m_impl->m_start + std::streamoff(end));
+}
+
+
+void
+SavegameWriter::write(
+    const SavegameSection& section
+) {
+    uint64_t offset = m_impl->position();
+    if (m_impl->m_codec == BlockCompression::None) {
+        m_impl->m_stream << section.content;
+    }
+    else {
+        std::string compressed = encode(section.content, m_impl->m_codec);
+        m_impl->m_stream.write(compressed.data(), compressed.size());
+    }
+    StorageContainer entry;
+    entry.set("name", section.name);
+    entry.set("firstEntity", section.firstEntity);
+    entry.set("lastEntity", section.lastEntity);
+    entry.set("offset", offset);
+    entry.set("length", m_impl->position() - offset);
+    m_impl->m_index.append(std::move(entry));
+}
+
+
+void
+SavegameWriter::writeEntities(
+    const StorageContainer& entities,
+    size_t chunkSize
+) {
+    assert(chunkSize > 0);
+    SavegameSection bookkeeping;
+    bookkeeping.name = SavegameSection::ENTITIES;
+    copyBookkeeping(entities, bookkeeping.content);
+    this->write(bookkeeping);
+    StorageContainer collections = entities.get<StorageContainer>("collections");
+    std::vector<std::pair<EntityId, const StorageContainer*>> components;
+    for (const std::string& typeName : collections.keys()) {
+        StorageList componentList = collections.get<StorageList>(typeName);
+        components.clear();
+        components.reserve(componentList.size());
+        for (const StorageContainer& component : componentList) {
+            components.emplace_back(component.get<EntityId>("owner"), &component);
+        }
+        std::stable_sort(
+            components.begin(),
+            components.end(),
+            [] (const std::pair<EntityId, const StorageContainer*>& lhs, const std::pair<EntityId, const StorageContainer*>& rhs) {
+                return lhs.first < rhs.first;
+            }
+        );
+        for (size_t begin = 0; begin < components.size(); begin += chunkSize) {
+            size_t end = std::min(begin + chunkSize, components.size());
+            SavegameSection chunk;
+            chunk.name = SavegameSection::collectionName(typeName);
+            chunk.firstEntity = components[begin].first;
+            chunk.lastEntity = components[end - 1].first;
+            StorageList chunkList;
+            chunkList.reserve(end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                chunkList.append(*components[i].second);
+            }
+            chunk.content.set("components", std::move(chunkList));
+            this->write(chunk);
+        }
+    }
+    // Trees no component refers to anymore are dropped
+    SharedStorageTable shared(entities.get<StorageList>("shared"));
+    StorageList sharedEntries = shared.storage(collections);
+    if (not sharedEntries.empty()) {
+        SavegameSection sharedSection;
+        sharedSection.name = SavegameSection::SHARED;
+        sharedSection.content.set("entries", std::move(sharedEntries));
+        this->write(sharedSection);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SavegameReader
+////////////////////////////////////////////////////////////////////////////////
+
+struct SavegameReader::Implementation {
+
+    StorageContainer
+    decode(
+        uint64_t offset,
+        uint64_t length
+    ) const {
+        if (offset > m_size or length > m_size - offset) {
+            throw std::runtime_error("Corrupt savegame: section out of bounds");
+        }
+        return ::decode(m_data + offset, length);
+    }
+
+    const char* m_data = nullptr;
+
+    std::string m_filename;
+
+    boost::interprocess::file_mapping m_mapping;
+
+    boost::interprocess::mapped_region m_region;
+
+    std::vector<SectionInfo> m_sections;
+
+    size_t m_size = 0;
+
+};
+
+
+bool
+SavegameReader::isSavegameFile(
+    const std::string& filename
+) {
+    std::ifstream stream(filename, std::ifstream::binary);
+    char magic[sizeof(SAVEGAME_MAGIC)];
+    stream.read(magic, sizeof(magic));
+    return (
+        stream and 
+        std::memcmp(magic, SAVEGAME_MAGIC, sizeof(SAVEGAME_MAGIC)) == 0
+    );
+}
+
+
+SavegameReader::SavegameReader(
+    const std::string& filename
+) : m_impl(new Implementation())
+{
+    using namespace boost::interprocess;
+    try {
+        m_impl->m_mapping = file_mapping(filename.c_str(), read_only);
+        m_impl->m_region = mapped_region(m_impl->m_mapping, read_only);
+    }
+    catch (const interprocess_exception& e) {
+        throw std::runtime_error("Could not map savegame " + filename + ": " + e.what());
+    }
+    m_impl->m_filename = filename;
+    m_impl->m_data = static_cast<const char*>(m_impl->m_region.get_address());
+    m_impl->m_size = m_impl->m_region.get_size();
+    const char* data = m_impl->m_data;
+    if (
+        m_impl->m_size < HEADER_SIZE or 
+        std::memcmp(data, SAVEGAME_MAGIC, sizeof(SAVEGAME_MAGIC)) != 0
+    ) {
+        throw std::runtime_error("Not a savegame file: " + filename);
+    }
+    if (readRaw<uint32_t>(data + sizeof(SAVEGAME_MAGIC)) > SAVEGAME_VERSION) {
+        throw std::runtime_error("Savegame was written by a newer version of Thrive");
+    }
+    StorageContainer index = m_impl->decode(
+        readRaw<uint64_t>(data + INDEX_POSITION_OFFSET),
+        readRaw<uint64_t>(data + INDEX_POSITION_OFFSET + sizeof(uint64_t))
+    );
+    StorageList sections = index.get<StorageList>("sections");
+    m_impl->m_sections.reserve(sections.size());
+    for (const StorageContainer& entry : sections) {
+        SectionInfo section {
+            entry.get<std::string>("name"),
+            entry.get<EntityId>("firstEntity"),
+            entry.get<EntityId>("lastEntity"),
+            entry.get<uint64_t>("offset"),
+            entry.get<uint64_t>("length")
+        };
+        m_impl->m_sections.push_back(std::move(section));
+    }
+}
+
+
+SavegameReader::~SavegameReader() {}
+
+
+StorageList
+SavegameReader::collection(
+    const std::string& typeName
+) const {
+    std::string name = SavegameSection::collectionName(typeName);
+    StorageList components;
+    for (const SectionInfo& section : m_impl->m_sections) {
+        if (section.name != name) {
+            continue;
+        }
+        StorageList chunk = this->decode(section).get<StorageList>("components");
+        components.reserve(components.size() + chunk.size());
+        for (StorageContainer& component : chunk) {
+            components.push_back(std::move(component));
+        }
+    }
+    return components;
+}
+
+
+StorageContainer
+SavegameReader::decode(
+    const SectionInfo& section
+) const {
+    return m_impl->decode(section.offset, section.length);
+}
+
+
+StorageContainer
+SavegameReader::entities(
+    const std::function<bool(const std::string&)>& filter
+) const {
+    StorageContainer entities;
+    std::vector<std::string> typeNames;
+    const SectionInfo* journal = nullptr;
+    const SectionInfo* shared = nullptr;
+    for (const SectionInfo& section : m_impl->m_sections) {
+        if (section.name == SavegameSection::ENTITIES) {
+            entities = this->decode(section);
+        }
+        else if (section.name == SavegameSection::JOURNAL) {
+            journal = &section;
+        }
+        else if (section.name == SavegameSection::SHARED) {
+            shared = &section;
+        }
+        else if (section.name.compare(0, COLLECTION_PREFIX.size(), COLLECTION_PREFIX) == 0) {
+            std::string typeName = section.name.substr(COLLECTION_PREFIX.size());
+            if (std::find(typeNames.begin(), typeNames.end(), typeName) == typeNames.end()) {
+                typeNames.push_back(typeName);
+            }
+        }
+    }
+    StorageContainer collections;
+    for (const std::string& typeName : typeNames) {
+        // Skipped collections are never decoded
+        if (filter and not filter(typeName)) {
+            continue;
+        }
+        collections.set(typeName, this->collection(typeName));
+    }
+    entities.set("collections", std::move(collections));
+    entities.set(
+        "shared",
+        shared ? this->decode(*shared).get<StorageList>("entries") : StorageList()
+    );
+    if (journal) {
+        uint64_t baseId = this->decode(*journal).get<uint64_t>("baseId");
+        SavegameJournal::apply(
+            entities, 
+            SavegameJournal::read(m_impl->m_filename, baseId),
+            filter
+        );
+    }
+    return entities;
+}
+
+
+const std::vector<SavegameReader::SectionInfo>&
+SavegameReader::sections() const {
+    return m_impl->m_sections;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SavegameJournal
+////////////////////////////////////////////////////////////////////////////////
+
+void
+SavegameJournal::append(
+    const std::string& savegame,
+    uint64_t baseId,
+    const StorageContainer& changes,
+    BlockCompression::Codec codec
+) {
+    std::string journalFilename = SavegameJournal::filename(savegame);
+    // Find the end of the last intact record, the same way read() does
+    uint64_t end = 0;
+    {
+        std::ifstream stream(journalFilename, std::ifstream::binary);
+        if (readJournalHeader(stream, baseId)) {
+            uint64_t size = boost::filesystem::file_size(journalFilename);
+            uint64_t remaining = size - JOURNAL_HEADER_SIZE;
+            std::string record;
+            while (readJournalRecord(stream, remaining, record)) {
+            }
+            end = size - remaining;
+        }
+    }
+    std::ofstream stream;
+    if (end == 0) {
+        // No journal for this savegame yet, or a stale one
+        stream.open(journalFilename, std::ofstream::trunc | std::ofstream::binary);
+        if (not stream) {
+            throw std::runtime_error("Could not open journal: " + journalFilename);
+        }
+        stream.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        writeRaw<uint8_t>(stream, JOURNAL_VERSION);
+        writeRaw<uint64_t>(stream, baseId);
+    }
+    else {
+        // Drop a record that was cut short or corrupted, and all after it
+        boost::filesystem::resize_file(journalFilename, end);
+        stream.open(journalFilename, std::ofstream::app | std::ofstream::binary);
+        if (not stream) {
+            throw std::runtime_error("Could not open journal: " + journalFilename);
+        }
+    }
+    stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    std::string record = encode(changes, codec);
+    writeRaw<uint32_t>(stream, static_cast<uint32_t>(record.size()));
+    writeRaw<uint32_t>(stream, static_cast<uint32_t>(crc32(
+        0,
+        reinterpret_cast<const Bytef*>(record.data()),
+        static_cast<uInt>(record.size())
+    )));
+    stream.write(record.data(), record.size());
+    stream.close();
+}
+
+
+void
+SavegameJournal::apply(
+    StorageContainer& entities,
+    const std::vector<StorageContainer>& records,
+    const std::function<bool(const std::string&)>& filter
+) {
+    if (records.empty()) {
+        return;
+    }
+    copyBookkeeping(records.back(), entities);
+    // Collect the type names touched by any record
+    std::vector<std::string> typeNames;
+    auto addTypeName = [&] (const std::string& typeName) {
+        if (std::find(typeNames.begin(), typeNames.end(), typeName) == typeNames.end()) {
+            typeNames.push_back(typeName);
+        }
+    };
+    for (const StorageContainer& record : records) {
+        for (const std::string& typeName : record.get<StorageContainer>("collections").keys()) {
+            addTypeName(typeName);
+        }
+        for (const StorageContainer& removal : record.get<StorageList>("removedComponents")) {
+            addTypeName(removal.get<std::string>("componentTypeName"));
+        }
+    }
+    StorageContainer collections = entities.get<StorageContainer>("collections");
+    for (const std::string& typeName : typeNames) {
+        if (filter and not filter(typeName)) {
+            continue;
+        }
+        std::map<EntityId, StorageContainer> components;
+        for (StorageContainer& component : collections.get<StorageList>(typeName)) {
+            EntityId owner = component.get<EntityId>("owner");
+            components[owner] = std::move(component);
+        }
+        for (const StorageContainer& record : records) {
+            for (const StorageContainer& removal : record.get<StorageList>("removedComponents")) {
+                if (removal.get<std::string>("componentTypeName") == typeName) {
+                    components.erase(removal.get<EntityId>("entityId"));
+                }
+            }
+            StorageList changed = record.get<StorageContainer>("collections").get<StorageList>(typeName);
+            for (StorageContainer& component : changed) {
+                EntityId owner = component.get<EntityId>("owner");
+                components[owner] = std::move(component);
+            }
+        }
+        StorageList componentList;
+        componentList.reserve(components.size());
+        for (auto& pair : components) {
+            componentList.append(std::move(pair.second));
+        }
+        collections.set(typeName, std::move(componentList));
+    }
+    entities.set("collections", std::move(collections));
+    // Shared trees are immutable, so any copy of an id will do
+    std::map<uint64_t, StorageContainer> sharedEntries;
+    for (StorageContainer& entry : entities.get<StorageList>("shared")) {
+        uint64_t id = entry.get<uint64_t>("id");
+        sharedEntries[id] = std::move(entry);
+    }
+    for (const StorageContainer& record : records) {
+        for (StorageContainer& entry : record.get<StorageList>("shared")) {
+            uint64_t id = entry.get<uint64_t>("id");
+            sharedEntries[id] = std::move(entry);
+        }
+    }
+    StorageList shared;
+    shared.reserve(sharedEntries.size());
+    for (auto& pair : sharedEntries) {
+        shared.append(std::move(pair.second));
+    }
+    entities.set("shared", std::move(shared));
+}
+
+
+void
+SavegameJournal::compact(
+    const std::string& savegame,
+    uint64_t newBaseId,
+    BlockCompression::Codec codec
+) {
+    StorageContainer entities;
+    {
+        // The mapping must be closed before the file can be replaced
+        SavegameReader reader(savegame);
+        entities = reader.entities();
+    }
+    std::string temporaryFilename = savegame + ".tmp";
+    {
+        std::ofstream stream(temporaryFilename, std::ofstream::trunc | std::ofstream::binary);
+        if (not stream) {
+            throw std::runtime_error("Could not open file for saving: " + temporaryFilename);
+        }
+        stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        SavegameWriter writer(stream, codec);
+        writer.writeEntities(entities);
+        SavegameSection journal;
+        journal.name = SavegameSection::JOURNAL;
+        journal.content.set("baseId", newBaseId);
+        writer.write(journal);
+        writer.finish();
+    }
+    boost::filesystem::rename(temporaryFilename, savegame);
+    // The old journal doesn't match the new id anymore, but is dead weight
+    boost::filesystem::remove(SavegameJournal::filename(savegame));
+}
+
+
+std::string
+SavegameJournal::filename(
+    const std::string& savegame
+) {
+    return savegame + ".journal";
+}
+
+
+uint64_t
+SavegameJournal::newBaseId() {
+    static std::atomic<uint64_t> counter(0);
+    auto now = boost::chrono::system_clock::now().time_since_epoch();
+    uint64_t nanoseconds = boost::chrono::duration_cast<boost::chrono::nanoseconds>(now).count();
+    // The counter keeps ids unique even if the clock is coarse
+    return nanoseconds + counter++;
+}
+
+
+std::vector<StorageContainer>
+SavegameJournal::read(
+    const std::string& savegame,
+    uint64_t baseId
+) {
+    std::vector<StorageContainer> records;
+    std::ifstream stream(SavegameJournal::filename(savegame), std::ifstream::binary);
+    if (not readJournalHeader(stream, baseId)) {
+        return records;
+    }
+    uint64_t remaining = boost::filesystem::file_size(
+        SavegameJournal::filename(savegame)
+    ) - JOURNAL_HEADER_SIZE;
+    std::string record;
+    while (readJournalRecord(stream, remaining, record)) {
+        records.push_back(decode(record.data(), record.size()));
+    }
+    return records;
+}
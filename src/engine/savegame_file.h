@@ -0,0 +1,409 @@
+#pragma once
+
+#include "engine/block_compression.h"
+#include "engine/serialization.h"
+#include "engine/typedefs.h"
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief An independently decodable part of a savegame
+*
+* The entity manager state is split into one section for its own
+* bookkeeping and one or more sections per component collection. Large
+* collections are split into chunks of consecutive entities.
+*/
+struct SavegameSection {
+
+    /**
+    * @brief Name of the section holding the entity manager's bookkeeping
+    */
+    static const std::string ENTITIES;
+
+    /**
+    * @brief Name of the section linking a savegame to its journal
+    *
+    * Only present in savegames written in journaled mode.
+    *
+    * @see SavegameJournal
+    */
+    static const std::string JOURNAL;
+
+    /**
+    * @brief Name of the section holding the storage trees that components
+    * share
+    *
+    * Only present if any component shared a tree.
+    *
+    * @see SharedStorageTable
+    */
+    static const std::string SHARED;
+
+    /**
+    * @brief Returns the name of the sections holding a component collection
+    *
+    * @param typeName
+    *   The component type's name
+    */
+    static std::string
+    collectionName(
+        const std::string& typeName
+    );
+
+    /**
+    * @brief The section's name
+    *
+    * Chunks of the same collection share a name.
+    */
+    std::string name;
+
+    /**
+    * @brief The lowest entity id in this section, if any
+    */
+    EntityId firstEntity = NULL_ENTITY;
+
+    /**
+    * @brief The highest entity id in this section, if any
+    */
+    EntityId lastEntity = NULL_ENTITY;
+
+    /**
+    * @brief The section's content
+    */
+    StorageContainer content;
+
+};
+
+
+/**
+* @brief Writes a savegame file section by section
+*
+* File layout:
+* - Header: magic, version, offset and length of the index
+* - Sections: each a standalone StorageContainer document, optionally
+*   wrapped in a BlockCompression frame
+* - Index: a StorageContainer document listing name, entity range, offset
+*   and length of each section
+*
+* The index is written last, so sections can be written as they are
+* produced. The header is patched when finish() is called, which requires
+* a seekable stream.
+*/
+class SavegameWriter {
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * Writes a preliminary header.
+    *
+    * @param stream
+    *   The stream to write to. Must be seekable.
+    * @param codec
+    *   The codec to compress sections with
+    */
+    SavegameWriter(
+        std::ostream& stream,
+        BlockCompression::Codec codec = BlockCompression::Fast
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~SavegameWriter();
+
+    /**
+    * @brief Writes the index and completes the header
+    */
+    void
+    finish();
+
+    /**
+    * @brief Appends a section
+    *
+    * @param section
+    *   The section to write
+    */
+    void
+    write(
+        const SavegameSection& section
+    );
+
+    /**
+    * @brief Appends the sections for an entity manager storage
+    *
+    * The counterpart of SavegameReader::entities(). Collections are 
+    * split into chunks like in EntityManager::sections(). Shared trees
+    * that no component refers to anymore are left out.
+    *
+    * @param entities
+    *   Storage as returned by EntityManager::storage()
+    * @param chunkSize
+    *   Maximum number of components per section
+    */
+    void
+    writeEntities(
+        const StorageContainer& entities,
+        size_t chunkSize = 1024
+    );
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+
+/**
+* @brief Random access to a savegame file
+*
+* Maps the file into memory and decodes only the sections that are asked
+* for. Uncompressed sections are decoded straight from the mapped memory,
+* compressed ones are detected and decompressed first.
+*/
+class SavegameReader {
+
+public:
+
+    /**
+    * @brief Index entry of a section
+    */
+    struct SectionInfo {
+
+        std::string name;
+
+        EntityId firstEntity;
+
+        EntityId lastEntity;
+
+        uint64_t offset;
+
+        uint64_t length;
+
+    };
+
+    /**
+    * @brief Checks whether a file is a savegame file with an index
+    *
+    * Savegames from before the index was introduced are a single
+    * StorageContainer document.
+    *
+    * @param filename
+    *   The file to check
+    */
+    static bool
+    isSavegameFile(
+        const std::string& filename
+    );
+
+    /**
+    * @brief Constructor
+    *
+    * Maps the file and reads the index.
+    *
+    * @param filename
+    *   The file to open
+    *
+    * @throws std::runtime_error if the file cannot be opened or is not a
+    * valid savegame file
+    */
+    SavegameReader(
+        const std::string& filename
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~SavegameReader();
+
+    /**
+    * @brief Decodes all chunks of a component collection
+    *
+    * @param typeName
+    *   The component type's name
+    *
+    * @return 
+    *   The storages of all components of that type, empty if there are none
+    */
+    StorageList
+    collection(
+        const std::string& typeName
+    ) const;
+
+    /**
+    * @brief Decodes a single section
+    *
+    * @param section
+    *   The section to decode, as returned by sections()
+    */
+    StorageContainer
+    decode(
+        const SectionInfo& section
+    ) const;
+
+    /**
+    * @brief Assembles the entity manager storage
+    *
+    * Produces the same structure as EntityManager::storage(). If the
+    * savegame has a journal, its records are replayed on top.
+    *
+    * @param filter
+    *   Decides which component collections to decode by type name. 
+    *   Collections that are filtered out are never touched. If empty, all
+    *   collections are decoded.
+    */
+    StorageContainer
+    entities(
+        const std::function<bool(const std::string&)>& filter = nullptr
+    ) const;
+
+    /**
+    * @brief The index of all sections, in file order
+    */
+    const std::vector<SectionInfo>&
+    sections() const;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+
+/**
+* @brief Append-only log of changes on top of a savegame
+*
+* In journaled mode, a full savegame is only written now and then. In
+* between, each save appends the output of EntityManager::changes() as a
+* record to a journal file next to the savegame, so that its cost depends
+* on how much has changed, not on the size of the world.
+*
+* File layout:
+* - Header: magic, version and the id of the savegame the journal belongs
+*   to, as stored in its SavegameSection::JOURNAL section
+* - Records: length, CRC-32 and the record, a StorageContainer document
+*   optionally wrapped in a BlockCompression frame
+*
+* A journal whose id doesn't match the savegame is stale and ignored. A
+* record that was cut short or fails its checksum, e.g. after a crash
+* while appending, ends the journal. The next append() overwrites it.
+*/
+class SavegameJournal {
+
+public:
+
+    /**
+    * @brief Appends a record
+    *
+    * Starts a new journal if there is none for \a baseId yet.
+    *
+    * @param savegame
+    *   The savegame file the journal belongs to
+    * @param baseId
+    *   The id of the savegame
+    * @param changes
+    *   The record, as returned by EntityManager::changes()
+    * @param codec
+    *   The codec to compress the record with
+    *
+    * @throws std::runtime_error if the journal cannot be written
+    */
+    static void
+    append(
+        const std::string& savegame,
+        uint64_t baseId,
+        const StorageContainer& changes,
+        BlockCompression::Codec codec
+    );
+
+    /**
+    * @brief Applies records to an entity manager storage
+    *
+    * Each component collection touched by the records is rebuilt once,
+    * sorted by entity id.
+    *
+    * @param entities
+    *   Storage as returned by EntityManager::storage()
+    * @param records
+    *   The records in the order they were appended
+    * @param filter
+    *   Decides which component collections to update by type name. If 
+    *   empty, all collections are updated.
+    */
+    static void
+    apply(
+        StorageContainer& entities,
+        const std::vector<StorageContainer>& records,
+        const std::function<bool(const std::string&)>& filter = nullptr
+    );
+
+    /**
+    * @brief Folds the journal into a new savegame
+    *
+    * Writes a savegame with all records applied and \a newBaseId as its 
+    * id, then deletes the journal. The old savegame stays in place until
+    * the new one is complete.
+    *
+    * @param savegame
+    *   The savegame file
+    * @param newBaseId
+    *   The id of the new savegame
+    * @param codec
+    *   The codec to compress the new savegame with
+    *
+    * @throws std::runtime_error if the savegame cannot be read or written
+    */
+    static void
+    compact(
+        const std::string& savegame,
+        uint64_t newBaseId,
+        BlockCompression::Codec codec
+    );
+
+    /**
+    * @brief The journal file of a savegame
+    *
+    * @param savegame
+    *   The savegame file
+    */
+    static std::string
+    filename(
+        const std::string& savegame
+    );
+
+    /**
+    * @brief Creates an id for a new savegame
+    */
+    static uint64_t
+    newBaseId();
+
+    /**
+    * @brief Reads all intact records of a journal
+    *
+    * @param savegame
+    *   The savegame file the journal belongs to
+    * @param baseId
+    *   The id of the savegame
+    *
+    * @return 
+    *   The records in the order they were appended. Empty if there is no
+    *   journal or it belongs to a different savegame.
+    */
+    static std::vector<StorageContainer>
+    read(
+        const std::string& savegame,
+        uint64_t baseId
+    );
+
+};
+
+}
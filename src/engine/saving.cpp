@@ -4,19 +4,201 @@
 #include "engine/component_factory.h"
 #include "engine/engine.h"
 #include "engine/entity_manager.h"
+#include "engine/savegame_file.h"
 #include "engine/serialization.h"
+#include "engine/storage_arena.h"
+#include "scripting/luabind.h"
 
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <functional>
+#include <stdexcept>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 using namespace thrive;
 
+static const size_t SECTION_CHUNK_SIZE = 1024;
+
+static const size_t STREAM_BUFFER_SIZE = 1024 * 1024;
+
+
+/**
+* @brief Writes a savegame through a temporary file
+*
+* The target file is only replaced once the savegame has been written
+* completely, so a failed save does not destroy the previous one.
+*
+* @param filename
+*   The file to save to
+* @param write
+*   Writes the savegame into the stream it is passed
+*
+* @throws std::exception if the file could not be written
+*/
+static void
+writeSavegame(
+    const std::string& filename,
+    const std::function<void(std::ostream&)>& write
+) {
+    std::string temporaryFilename = filename + ".tmp";
+    std::vector<char> buffer(STREAM_BUFFER_SIZE);
+    std::ofstream stream;
+    // Must be set before opening the file to take effect
+    stream.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    stream.open(temporaryFilename, std::ofstream::trunc | std::ofstream::binary);
+    if (not stream) {
+        throw std::runtime_error("Could not open file for saving: " + temporaryFilename);
+    }
+    stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    write(stream);
+    stream.close();
+    boost::filesystem::rename(temporaryFilename, filename);
+    // A journal of the previous savegame no longer applies
+    boost::filesystem::remove(SavegameJournal::filename(filename));
+}
+
+
+static void
+printLuaError(
+    const luabind::error& e
+) {
+    luabind::object error_msg(luabind::from_stack(
+        e.state(),
+        -1
+    ));
+    // TODO: Log error
+    std::cerr << error_msg << std::endl;
+}
+
+
 struct SaveSystem::Implementation {
 
-    std::string m_filename;
+    ~Implementation() {
+        this->join();
+    }
+
+    void
+    finish(
+        const std::string& errorMessage
+    ) {
+        if (errorMessage.empty()) {
+            m_status = SaveSystem::Succeeded;
+        }
+        else {
+            std::cerr << "Error saving file: " << errorMessage << std::endl;
+            m_status = SaveSystem::Failed;
+            // The checkpoint no longer matches what is on disk
+            m_journalFilename.clear();
+        }
+        m_errorMessage = errorMessage;
+    }
+
+    void
+    join() {
+        if (m_worker.joinable()) {
+            m_worker.join();
+            this->finish(m_workerError);
+        }
+    }
+
+    /**
+    * @brief Runs a save, on the worker thread if asynchronous
+    *
+    * @param save
+    *   Writes the savegame or journal record, may throw
+    */
+    void
+    run(
+        std::function<void()> save
+    ) {
+        if (not m_asynchronous) {
+            std::string errorMessage;
+            try {
+                save();
+            }
+            catch (const luabind::error& e) {
+                printLuaError(e);
+                throw;
+            }
+            catch (const std::exception& e) {
+                errorMessage = e.what();
+            }
+            this->finish(errorMessage);
+            return;
+        }
+        m_workerDone = false;
+        m_workerError.clear();
+        m_worker = boost::thread([this, save] () mutable {
+            try {
+                save();
+            }
+            catch (const std::exception& e) {
+                m_workerError = e.what();
+            }
+            // Release anything the save holds on this thread
+            save = nullptr;
+            m_workerDone = true;
+        });
+    }
+
+    bool m_asynchronous = true;
+
+    uint64_t m_baseId = 0;
+
+    BlockCompression::Codec m_codec = BlockCompression::Fast;
+
+    std::string m_errorMessage;
+
+    std::deque<std::string> m_pendingFilenames;
+
+    unsigned int m_journalEntries = 0;
+
+    // The savegame the next journal record is appended to, if any
+    std::string m_journalFilename;
+
+    unsigned int m_journalLength = 0;
+
+    SaveSystem::Status m_status = SaveSystem::Idle;
+
+    boost::thread m_worker;
+
+    // Set by the worker thread just before it exits
+    std::atomic<bool> m_workerDone {false};
+
+    // Only accessed by the worker until m_workerDone is set
+    std::string m_workerError;
 
 };
 
 
+luabind::scope
+SaveSystem::luaBindings() {
+    using namespace luabind;
+    return class_<SaveSystem, System>("SaveSystem")
+        .enum_("Status") [
+            value("Idle", SaveSystem::Idle),
+            value("Saving", SaveSystem::Saving),
+            value("Succeeded", SaveSystem::Succeeded),
+            value("Failed", SaveSystem::Failed)
+        ]
+        .enum_("Codec") [
+            value("CompressionNone", BlockCompression::None),
+            value("CompressionFast", BlockCompression::Fast),
+            value("CompressionDense", BlockCompression::Dense)
+        ]
+        .def("setAsynchronous", &SaveSystem::setAsynchronous)
+        .def("setCompression", &SaveSystem::setCompression)
+        .def("setJournalLength", &SaveSystem::setJournalLength)
+        .property("errorMessage", &SaveSystem::errorMessage)
+        .property("status", &SaveSystem::status)
+    ;
+}
+
+
 SaveSystem::SaveSystem()
   : m_impl(new Implementation())
 {
@@ -26,51 +208,177 @@ SaveSystem::SaveSystem()
 SaveSystem::~SaveSystem() {}
 
 
+const std::string&
+SaveSystem::errorMessage() const {
+    return m_impl->m_errorMessage;
+}
+
+
 void
 SaveSystem::save(
     std::string filename
 ) {
-    m_impl->m_filename = filename;
+    m_impl->m_pendingFilenames.push_back(filename);
+    m_impl->m_status = SaveSystem::Saving;
     this->setActive(true);
 }
 
 
+void
+SaveSystem::setAsynchronous(
+    bool asynchronous
+) {
+    m_impl->m_asynchronous = asynchronous;
+}
+
+
+void
+SaveSystem::setCompression(
+    BlockCompression::Codec codec
+) {
+    m_impl->m_codec = codec;
+}
+
+
+void
+SaveSystem::setJournalLength(
+    unsigned int length
+) {
+    m_impl->m_journalLength = length;
+}
+
+
+void
+SaveSystem::shutdown() {
+    m_impl->join();
+    System::shutdown();
+}
+
+
+SaveSystem::Status
+SaveSystem::status() const {
+    return m_impl->m_status;
+}
+
+
 void
 SaveSystem::update(int) {
-    StorageContainer entities;
-    try {
-        entities = this->engine()->entityManager().storage(
-            this->engine()->componentFactory()
-        );
+    if (m_impl->m_worker.joinable()) {
+        if (not m_impl->m_workerDone) {
+            return;
+        }
+        m_impl->join();
+        if (not m_impl->m_pendingFilenames.empty()) {
+            m_impl->m_status = SaveSystem::Saving;
+        }
     }
-    catch (const luabind::error& e) {
-        luabind::object error_msg(luabind::from_stack(
-            e.state(),
-            -1
-        ));
-        // TODO: Log error
-        std::cerr << error_msg << std::endl;
-        throw;
+    if (m_impl->m_pendingFilenames.empty()) {
+        this->setActive(false);
+        return;
     }
-    StorageContainer savegame;
-    savegame.set("entities", std::move(entities));
-    std::ofstream stream(m_impl->m_filename, std::ofstream::trunc | std::ofstream::binary);
-    stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-    if (stream) {
+    std::string filename = m_impl->m_pendingFilenames.front();
+    m_impl->m_pendingFilenames.pop_front();
+    EntityManager& entityManager = this->engine()->entityManager();
+    const ComponentFactory& factory = this->engine()->componentFactory();
+    BlockCompression::Codec codec = m_impl->m_codec;
+    bool journaled = m_impl->m_journalLength > 0;
+    if (
+        journaled and 
+        filename == m_impl->m_journalFilename and 
+        entityManager.hasCheckpoint()
+    ) {
+        // Only what changed since the last save
+        auto changes = std::make_shared<StorageContainer>();
         try {
-            stream << savegame;
-            stream.flush();
-            stream.close();
+            *changes = entityManager.changes(factory);
         }
-        catch (const std::ofstream::failure& e) {
-            std::cerr << "Error saving file: " << e.what() << std::endl;
+        catch (const luabind::error& e) {
+            printLuaError(e);
             throw;
         }
+        uint64_t baseId = m_impl->m_baseId;
+        bool compact = ++m_impl->m_journalEntries >= m_impl->m_journalLength;
+        if (compact) {
+            m_impl->m_baseId = SavegameJournal::newBaseId();
+            m_impl->m_journalEntries = 0;
+        }
+        uint64_t newBaseId = m_impl->m_baseId;
+        m_impl->run([filename, baseId, changes, compact, newBaseId, codec] () {
+            SavegameJournal::append(filename, baseId, *changes, codec);
+            if (compact) {
+                SavegameJournal::compact(filename, newBaseId, codec);
+            }
+        });
+        return;
+    }
+    // Full savegame
+    SavegameSection journal;
+    journal.name = SavegameSection::JOURNAL;
+    if (journaled) {
+        m_impl->m_baseId = SavegameJournal::newBaseId();
+        m_impl->m_journalEntries = 0;
+        m_impl->m_journalFilename = filename;
+        journal.content.set("baseId", m_impl->m_baseId);
     }
     else {
-        std::perror("Could not open file for saving");
+        m_impl->m_journalFilename.clear();
     }
-    this->setActive(false);
+    if (not m_impl->m_asynchronous) {
+        // Write each section as soon as it is built
+        m_impl->run([&] () {
+            writeSavegame(filename, [&] (std::ostream& stream) {
+                SavegameWriter writer(stream, codec);
+                entityManager.sections(
+                    factory, 
+                    [&writer] (SavegameSection&& section) {
+                        writer.write(section);
+                    },
+                    SECTION_CHUNK_SIZE,
+                    journaled
+                );
+                if (journaled) {
+                    writer.write(journal);
+                }
+                writer.finish();
+            });
+        });
+        return;
+    }
+    // Snapshot on the main thread, scripted components can only be 
+    // stored here
+    auto snapshot = std::make_shared<std::vector<SavegameSection>>();
+    {
+        StorageArena::Scope arenaScope(StorageArena::create());
+        try {
+            entityManager.sections(
+                factory, 
+                [&snapshot] (SavegameSection&& section) {
+                    snapshot->push_back(std::move(section));
+                },
+                SECTION_CHUNK_SIZE,
+                journaled
+            );
+        }
+        catch (const luabind::error& e) {
+            printLuaError(e);
+            throw;
+        }
+        if (journaled) {
+            snapshot->push_back(std::move(journal));
+        }
+    }
+    // Serialize and write on a worker thread
+    m_impl->run([filename, codec, snapshot] () mutable {
+        writeSavegame(filename, [&snapshot, codec] (std::ostream& stream) {
+            SavegameWriter writer(stream, codec);
+            for (const SavegameSection& section : *snapshot) {
+                writer.write(section);
+            }
+            writer.finish();
+        });
+        // Release the snapshot on this thread, not the main thread
+        snapshot.reset();
+    });
 }
 
 
@@ -80,11 +388,128 @@ SaveSystem::update(int) {
 
 struct LoadSystem::Implementation {
 
-    std::string m_filename;
+    ~Implementation() {
+        this->join();
+    }
+
+    void
+    join() {
+        if (m_worker.joinable()) {
+            m_worker.join();
+        }
+    }
+
+    /**
+    * @brief Starts reading a file on the worker thread
+    *
+    * The worker also prepares the restorer, so the main thread doesn't
+    * have to copy or sort the parsed tree.
+    *
+    * @param filename
+    *   The file to read
+    * @param engine
+    *   The engine to restore into
+    */
+    void
+    startReading(
+        const std::string& filename,
+        Engine* engine
+    ) {
+        m_errorMessage.clear();
+        m_restorer.reset();
+        m_pendingRestorer.reset();
+        m_status = LoadSystem::Reading;
+        m_workerDone = false;
+        m_workerError.clear();
+        EntityManager& entityManager = engine->entityManager();
+        const ComponentFactory& factory = engine->componentFactory();
+        std::vector<std::string> typeNames = factory.typeNames();
+        std::unordered_set<std::string> knownTypeNames(
+            typeNames.begin(),
+            typeNames.end()
+        );
+        m_worker = boost::thread([this, filename, knownTypeNames, &entityManager, &factory] () {
+            try {
+                StorageArena::Scope arenaScope(StorageArena::create());
+                StorageContainer entities;
+                if (SavegameReader::isSavegameFile(filename)) {
+                    SavegameReader reader(filename);
+                    // Collections of unknown types are never decoded
+                    entities = reader.entities(
+                        [&knownTypeNames] (const std::string& typeName) {
+                            return knownTypeNames.count(typeName) > 0;
+                        }
+                    );
+                }
+                else {
+                    // Savegames from before the section index
+                    std::ifstream stream(filename, std::ifstream::binary);
+                    if (not stream) {
+                        throw std::runtime_error("Could not open file for loading: " + filename);
+                    }
+                    stream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+                    StorageContainer savegame;
+                    stream >> savegame;
+                    entities = savegame.take<StorageContainer>("entities");
+                }
+                m_pendingRestorer.reset(new EntityManager::Restorer(
+                    entityManager,
+                    std::move(entities),
+                    factory
+                ));
+            }
+            catch (const std::exception& e) {
+                m_workerError = e.what();
+            }
+            m_workerDone = true;
+        });
+    }
+
+    std::string m_errorMessage;
+
+    unsigned int m_frameBudget = 8;
+
+    bool m_hasPendingFilename = false;
+
+    std::string m_pendingFilename;
+
+    // Written by the worker until m_workerDone is set
+    std::unique_ptr<EntityManager::Restorer> m_pendingRestorer;
+
+    std::unique_ptr<EntityManager::Restorer> m_restorer;
+
+    LoadSystem::Status m_status = LoadSystem::Idle;
+
+    boost::thread m_worker;
+
+    // Set by the worker thread just before it exits
+    std::atomic<bool> m_workerDone {false};
+
+    // Only accessed by the worker until m_workerDone is set
+    std::string m_workerError;
 
 };
 
 
+luabind::scope
+LoadSystem::luaBindings() {
+    using namespace luabind;
+    return class_<LoadSystem, System>("LoadSystem")
+        .enum_("Status") [
+            value("Idle", LoadSystem::Idle),
+            value("Reading", LoadSystem::Reading),
+            value("Restoring", LoadSystem::Restoring),
+            value("Succeeded", LoadSystem::Succeeded),
+            value("Failed", LoadSystem::Failed)
+        ]
+        .def("setFrameBudget", &LoadSystem::setFrameBudget)
+        .property("errorMessage", &LoadSystem::errorMessage)
+        .property("progress", &LoadSystem::progress)
+        .property("status", &LoadSystem::status)
+    ;
+}
+
+
 LoadSystem::LoadSystem()
   : m_impl(new Implementation())
 {
@@ -94,45 +519,107 @@ LoadSystem::LoadSystem()
 LoadSystem::~LoadSystem() {}
 
 
+const std::string&
+LoadSystem::errorMessage() const {
+    return m_impl->m_errorMessage;
+}
+
+
 void
 LoadSystem::load(
     std::string filename
 ) {
-    m_impl->m_filename = filename;
+    if (m_impl->m_worker.joinable()) {
+        // The worker cannot be interrupted, start once it is done
+        m_impl->m_hasPendingFilename = true;
+        m_impl->m_pendingFilename = filename;
+    }
+    else {
+        m_impl->startReading(filename, this->engine());
+    }
     this->setActive(true);
 }
 
 
+float
+LoadSystem::progress() const {
+    switch (m_impl->m_status) {
+        case LoadSystem::Restoring:
+            return m_impl->m_restorer ? m_impl->m_restorer->progress() : 0.0f;
+        case LoadSystem::Succeeded:
+            return 1.0f;
+        default:
+            return 0.0f;
+    }
+}
+
+
+void
+LoadSystem::setFrameBudget(
+    unsigned int milliseconds
+) {
+    m_impl->m_frameBudget = milliseconds;
+}
+
+
+void
+LoadSystem::shutdown() {
+    m_impl->join();
+    m_impl->m_pendingRestorer.reset();
+    m_impl->m_restorer.reset();
+    System::shutdown();
+}
+
+
+LoadSystem::Status
+LoadSystem::status() const {
+    return m_impl->m_status;
+}
+
+
 void
 LoadSystem::update(int) {
-    EntityManager& entityManager = this->engine()->entityManager();
-    std::ifstream stream(m_impl->m_filename, std::ifstream::binary);
-    stream.clear();
-    stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-    StorageContainer savegame;
-    try {
-        stream >> savegame;
+    if (m_impl->m_worker.joinable()) {
+        if (not m_impl->m_workerDone) {
+            return;
+        }
+        m_impl->join();
+        if (m_impl->m_hasPendingFilename) {
+            m_impl->m_hasPendingFilename = false;
+            m_impl->startReading(m_impl->m_pendingFilename, this->engine());
+            return;
+        }
+        if (not m_impl->m_workerError.empty()) {
+            std::cerr << "Error loading file: " << m_impl->m_workerError << std::endl;
+            m_impl->m_errorMessage = m_impl->m_workerError;
+            m_impl->m_status = LoadSystem::Failed;
+            this->setActive(false);
+            return;
+        }
+        m_impl->m_status = LoadSystem::Restoring;
+        m_impl->m_restorer = std::move(m_impl->m_pendingRestorer);
     }
-    catch(const std::ofstream::failure& e) {
-        std::cerr << "Error loading file: " << e.what() << std::endl;
-        throw;
+    if (not m_impl->m_restorer) {
+        this->setActive(false);
+        return;
     }
-    StorageContainer entities = savegame.get<StorageContainer>("entities");
-    entityManager.clear();
     try {
-        this->engine()->entityManager().restore(
-            entities,
-            this->engine()->componentFactory()
-        );
+        if (m_impl->m_frameBudget == 0) {
+            m_impl->m_restorer->finish();
+        }
+        else {
+            m_impl->m_restorer->step(
+                boost::chrono::milliseconds(m_impl->m_frameBudget)
+            );
+        }
     }
     catch (const luabind::error& e) {
-        luabind::object error_msg(luabind::from_stack(
-            e.state(),
-            -1
-        ));
-        // TODO: Log error
-        std::cerr << error_msg << std::endl;
+        printLuaError(e);
         throw;
     }
-    this->setActive(false);
+    if (m_impl->m_restorer->isFinished()) {
+        m_impl->m_restorer.reset();
+        m_impl->m_status = LoadSystem::Succeeded;
+        this->setActive(false);
+    }
 }
@@ -1,16 +1,55 @@
 #pragma once
 
+#include "engine/block_compression.h"
 #include "engine/system.h"
 
+#include <string>
+
 namespace thrive {
 
 /**
 * @brief System for saving the game
+*
+* By default, saves run in the background. At the end of the frame in
+* which a save was requested, the system takes a snapshot of all
+* persistent components. Serialization and file I/O happen on a worker
+* thread while the game keeps running. The savegame is written to a
+* temporary file that replaces the target file only once it is complete.
+*
+* Synchronous saves stream components straight to disk and never hold
+* the whole world in memory, but block the game until they are done.
 */
 class SaveSystem : public System {
     
 public:
 
+    /**
+    * @brief Progress of the most recent save
+    */
+    enum Status {
+        Idle,
+        Saving,
+        Succeeded,
+        Failed
+    };
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - SaveSystem::setAsynchronous()
+    * - SaveSystem::setCompression()
+    * - SaveSystem::setJournalLength()
+    * - SaveSystem::errorMessage() (as property)
+    * - SaveSystem::status() (as property)
+    * - SaveSystem::Status (as enum)
+    * - BlockCompression::Codec (as enum, prefixed with "Compression")
+    *
+    * @return 
+    */
+    static luabind::scope
+    luaBindings();
+
     /**
     * @brief Constructor
     */
@@ -18,12 +57,23 @@ public:
 
     /**
     * @brief Destructor
+    *
+    * Waits for a running save to finish
     */
     ~SaveSystem();
 
+    /**
+    * @brief The error of the most recent save if it failed
+    */
+    const std::string&
+    errorMessage() const;
+
     /**
     * @brief Saves the game at the end of this frame
     *
+    * If another save is still running, this one starts after it has
+    * finished.
+    *
     * @param filename
     *   The filename to save to
     */
@@ -32,6 +82,65 @@ public:
         std::string filename
     );
 
+    /**
+    * @brief Whether saves run on a worker thread
+    *
+    * @param asynchronous
+    *   If \c false, saves block the frame they happen in, but use far
+    *   less memory. Defaults to \c true.
+    */
+    void
+    setAsynchronous(
+        bool asynchronous
+    );
+
+    /**
+    * @brief Sets the codec used for subsequent saves
+    *
+    * Loading detects the codec automatically.
+    *
+    * @param codec
+    *   Defaults to BlockCompression::Fast
+    */
+    void
+    setCompression(
+        BlockCompression::Codec codec
+    );
+
+    /**
+    * @brief Enables journaled saves
+    *
+    * In journaled mode, repeated saves to the same file only append what
+    * changed since the previous save to a journal next to the savegame.
+    * After \a length records, the journal is folded into a new savegame
+    * on the worker thread. Saving to a different file, or after loading,
+    * writes a full savegame.
+    *
+    * @param length
+    *   Number of journal records before compaction. Zero disables
+    *   journaling, which is the default.
+    *
+    * @see SavegameJournal
+    */
+    void
+    setJournalLength(
+        unsigned int length
+    );
+
+    /**
+    * @brief Waits for a running save to finish
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief The status of the most recent save
+    *
+    * Updated once per frame
+    */
+    Status
+    status() const;
+
     /**
     * @brief Updates the system
     */
@@ -43,13 +152,46 @@ private:
     std::unique_ptr<Implementation> m_impl;
 };
 
+
 /**
 * @brief System for loading a game
+*
+* Loading happens in stages. A worker thread reads and parses the file
+* while the game keeps running. Then the entity manager is cleared and
+* refilled entity by entity over several frames, each within a time
+* budget. Scripts can watch status() and progress() to show a loading
+* screen.
 */
 class LoadSystem : public System {
     
 public:
 
+    /**
+    * @brief Progress of the most recent load
+    */
+    enum Status {
+        Idle,
+        Reading,
+        Restoring,
+        Succeeded,
+        Failed
+    };
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - LoadSystem::setFrameBudget()
+    * - LoadSystem::errorMessage() (as property)
+    * - LoadSystem::progress() (as property)
+    * - LoadSystem::status() (as property)
+    * - LoadSystem::Status (as enum)
+    *
+    * @return 
+    */
+    static luabind::scope
+    luaBindings();
+
     /**
     * @brief Constructor
     */
@@ -57,12 +199,22 @@ public:
 
     /**
     * @brief Destructor
+    *
+    * Waits for the file to be read
     */
     ~LoadSystem();
 
+    /**
+    * @brief The error of the most recent load if it failed
+    */
+    const std::string&
+    errorMessage() const;
+
     /**
     * @brief Loads a savegame at the beginning of next frame
     *
+    * Cancels a load that is still in progress.
+    *
     * @param filename
     *   The file to load from
     */
@@ -71,6 +223,36 @@ public:
         std::string filename
     );
 
+    /**
+    * @brief Fraction of the savegame restored so far, between 0 and 1
+    */
+    float
+    progress() const;
+
+    /**
+    * @brief Sets the time spent on restoring per frame
+    *
+    * @param milliseconds
+    *   The time budget. Zero restores everything in one frame. Defaults
+    *   to 8 milliseconds.
+    */
+    void
+    setFrameBudget(
+        unsigned int milliseconds
+    );
+
+    /**
+    * @brief Waits for the file to be read
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief The status of the most recent load
+    */
+    Status
+    status() const;
+
     /**
     * @brief Updates the system
     */
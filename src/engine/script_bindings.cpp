@@ -4,7 +4,11 @@
 #include "engine/component_factory.h"
 #include "engine/engine.h"
 #include "engine/entity.h"
+#include "engine/saving.h"
 #include "engine/serialization.h"
+#include "engine/snapshot_system.h"
+#include "engine/spatial_index_system.h"
+#include "engine/streaming_system.h"
 #include "engine/system.h"
 #include "engine/touchable.h"
 #include "scripting/luabind.h"
@@ -15,6 +19,11 @@ thrive::EngineBindings::luaBindings() {
         StorageContainer::luaBindings(),
         StorageList::luaBindings(),
         System::luaBindings(),
+        LoadSystem::luaBindings(),
+        SaveSystem::luaBindings(),
+        SnapshotSystem::luaBindings(),
+        SpatialIndexSystem::luaBindings(),
+        StreamingSystem::luaBindings(),
         Component::luaBindings(),
         ComponentFactory::luaBindings(),
         Entity::luaBindings(),
@@ -2,12 +2,26 @@
 
 #include "scripting/luabind.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/variant.hpp>
 #include <cfloat>
+#include <cstring>
+#include <deque>
+#include <lauxlib.h>
+#include <limits>
 #include <luabind/iterator_policy.hpp>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
 #include <stdexcept>
+#include <streambuf>
 #include <unordered_map>
+#include <vector>
 
 using namespace thrive;
 
@@ -16,6 +30,164 @@ namespace {
 
 using TypeId = uint16_t;
 
+/**
+* @brief Process-wide id of an interned key
+*/
+using KeyId = uint32_t;
+
+/**
+* @brief Interns the keys of all storage containers
+*
+* Every distinct key string is stored exactly once. Containers refer to
+* their keys by KeyId, so building thousands of component storages with
+* the same handful of keys does not allocate a string per entry.
+*
+* Ids are never released. The set of keys is small and bounded by the
+* code (and scripts) that write them.
+*/
+class KeyRegistry {
+
+public:
+
+    /**
+    * @brief Looks up a key without interning it
+    *
+    * @param key
+    *   The key to look up
+    * @param[out] id
+    *   The key's id, if found
+    *
+    * @return
+    *   \c true if the key has been interned before, \c false otherwise
+    */
+    static bool
+    find(
+        const std::string& key,
+        KeyId& id
+    ) {
+        LocalCache& cache = localCache();
+        auto cached = cache.ids.find(key);
+        if (cached != cache.ids.end()) {
+            id = cached->second;
+            return true;
+        }
+        KeyRegistry& registry = instance();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        auto iter = registry.m_ids.find(key);
+        if (iter == registry.m_ids.end()) {
+            return false;
+        }
+        id = iter->second;
+        cache.ids.emplace(key, id);
+        return true;
+    }
+
+    /**
+    * @brief Returns the id of a key, interning it if necessary
+    *
+    * @param key
+    *   The key to intern
+    *
+    * @return
+    *   The key's id
+    */
+    static KeyId
+    intern(
+        const std::string& key
+    ) {
+        LocalCache& cache = localCache();
+        auto cached = cache.ids.find(key);
+        if (cached != cache.ids.end()) {
+            return cached->second;
+        }
+        KeyRegistry& registry = instance();
+        KeyId id;
+        {
+            std::lock_guard<std::mutex> lock(registry.m_mutex);
+            auto iter = registry.m_ids.find(key);
+            if (iter != registry.m_ids.end()) {
+                id = iter->second;
+            }
+            else {
+                id = registry.m_names.size();
+                registry.m_names.push_back(key);
+                registry.m_ids.insert(iter, std::make_pair(key, id));
+            }
+        }
+        cache.ids.emplace(key, id);
+        return id;
+    }
+
+    /**
+    * @brief Returns the string of an interned key
+    *
+    * @param id
+    *   The key's id, as returned by intern()
+    *
+    * @return
+    *   A reference that stays valid for the lifetime of the process
+    */
+    static const std::string&
+    name(
+        KeyId id
+    ) {
+        LocalCache& cache = localCache();
+        if (id < cache.names.size() and cache.names[id]) {
+            return *cache.names[id];
+        }
+        KeyRegistry& registry = instance();
+        const std::string* name = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(registry.m_mutex);
+            name = &registry.m_names.at(id);
+        }
+        if (cache.names.size() <= id) {
+            cache.names.resize(id + 1, nullptr);
+        }
+        cache.names[id] = name;
+        return *name;
+    }
+
+private:
+
+    /**
+    * @brief Per-thread copy of the lookups done so far
+    *
+    * Ids never change once assigned, so threads serializing in parallel
+    * only need the lock for keys they haven't seen yet.
+    */
+    struct LocalCache {
+
+        std::unordered_map<std::string, KeyId> ids;
+
+        std::vector<const std::string*> names;
+
+    };
+
+    static KeyRegistry&
+    instance() {
+        static KeyRegistry registry;
+        return registry;
+    }
+
+    static LocalCache&
+    localCache() {
+        static boost::thread_specific_ptr<LocalCache> cache;
+        if (not cache.get()) {
+            cache.reset(new LocalCache());
+        }
+        return *cache;
+    }
+
+    std::unordered_map<std::string, KeyId> m_ids;
+
+    std::mutex m_mutex;
+
+    // std::deque never moves its elements on push_back
+    std::deque<std::string> m_names;
+
+};
+
 using Variant = boost::variant<
     bool,
     char,
@@ -31,7 +203,10 @@ using Variant = boost::variant<
     double,
     std::string,
     StorageContainer,
-    StorageList
+    StorageList,
+    Ogre::Plane,
+    Ogre::Quaternion,
+    Ogre::Vector3
 >;
 
 struct StoredValue {
@@ -139,10 +314,72 @@ TYPE_INFO(StorageList, StorageList, 240)
 
 // Compound types
 TYPE_INFO(Ogre::Degree, float, 272)
-TYPE_INFO(Ogre::Plane, StorageContainer, 288)
-TYPE_INFO(Ogre::Vector3, StorageContainer, 304)
-TYPE_INFO(Ogre::Quaternion, StorageContainer, 320)
 TYPE_INFO(Ogre::ColourValue, uint32_t, 336)
+// Packed compound types
+TYPE_INFO(Ogre::Plane, Ogre::Plane, 352)
+TYPE_INFO(Ogre::Vector3, Ogre::Vector3, 368)
+TYPE_INFO(Ogre::Quaternion, Ogre::Quaternion, 384)
+
+/**
+* @brief Type ids of compound types that used to be stored as nested
+* StorageContainer
+*
+* Values with these ids are converted to their packed representation when
+* they are read.
+*/
+const TypeId LEGACY_PLANE_ID = 288;
+const TypeId LEGACY_VECTOR3_ID = 304;
+const TypeId LEGACY_QUATERNION_ID = 320;
+
+/**
+* @brief Stream buffer that hashes everything written to it (FNV-1a)
+*/
+class FingerprintBuffer : public std::streambuf {
+
+public:
+
+    uint64_t
+    fingerprint() const {
+        return m_hash;
+    }
+
+protected:
+
+    int_type
+    overflow(
+        int_type character
+    ) override {
+        if (not traits_type::eq_int_type(character, traits_type::eof())) {
+            this->mix(traits_type::to_char_type(character));
+        }
+        return traits_type::not_eof(character);
+    }
+
+    std::streamsize
+    xsputn(
+        const char* data,
+        std::streamsize size
+    ) override {
+        for (std::streamsize i = 0; i < size; ++i) {
+            this->mix(data[i]);
+        }
+        return size;
+    }
+
+private:
+
+    void
+    mix(
+        char byte
+    ) {
+        m_hash ^= static_cast<unsigned char>(byte);
+        m_hash *= 1099511628211ULL;
+    }
+
+    uint64_t m_hash = 14695981039346656037ULL;
+
+};
+
 } // namespace
 
 #define TO_LUA_CASE(typeName) \
@@ -186,17 +423,327 @@ toLua(
     }
 }
 
+
+#define PUSH_NUMBER_CASE(typeName) \
+    case TypeInfo<typeName>::Id: \
+        lua_pushnumber( \
+            L, \
+            static_cast<lua_Number>(TypeInfo<typeName>::convertFromStoredType( \
+                boost::get<TypeInfo<typeName>::StoredType>(value.value) \
+            )) \
+        ); \
+        return true;
+
+/**
+* @brief Pushes a stored value that isn't a container or list
+*
+* @return
+*   \c false if the value is a StorageContainer or StorageList, nothing
+*   is pushed then
+*/
+static bool
+pushPlainValue(
+    lua_State* L,
+    const StoredValue& value
+) {
+    switch (value.typeId) {
+        case TypeInfo<bool>::Id:
+            lua_pushboolean(L, boost::get<bool>(value.value));
+            return true;
+        PUSH_NUMBER_CASE(char)
+        PUSH_NUMBER_CASE(int8_t)
+        PUSH_NUMBER_CASE(int16_t)
+        PUSH_NUMBER_CASE(int32_t)
+        PUSH_NUMBER_CASE(int64_t)
+        PUSH_NUMBER_CASE(uint8_t)
+        PUSH_NUMBER_CASE(uint16_t)
+        PUSH_NUMBER_CASE(uint32_t)
+        PUSH_NUMBER_CASE(uint64_t)
+        PUSH_NUMBER_CASE(float)
+        PUSH_NUMBER_CASE(double)
+        case TypeInfo<std::string>::Id:
+        {
+            const std::string& string = boost::get<std::string>(value.value);
+            lua_pushlstring(L, string.data(), string.size());
+            return true;
+        }
+        case TypeInfo<StorageContainer>::Id:
+        case TypeInfo<StorageList>::Id:
+            return false;
+        default:
+            // Compound types are pushed as userdata
+            toLua(L, value).push(L);
+            return true;
+    }
+}
+
+#undef PUSH_NUMBER_CASE
+
+
+static StorageList
+listFromTable(
+    lua_State* L,
+    int index
+);
+
+
+static void
+setFromLua(
+    StorageContainer& storage,
+    const std::string& key,
+    lua_State* L,
+    int index
+);
+
+
+/**
+* @brief Whether the value at \a index can be an element of a StorageList
+*/
+static bool
+isListElement(
+    lua_State* L,
+    int index
+) {
+    switch (lua_type(L, index)) {
+        case LUA_TTABLE:
+            return true;
+        case LUA_TUSERDATA:
+        {
+            luabind::object object(luabind::from_stack(L, index));
+            return bool(luabind::object_cast_nothrow<StorageContainer>(object));
+        }
+        default:
+            return false;
+    }
+}
+
+
+/**
+* @brief Whether a table converts to a StorageList
+*
+* True for non-empty sequences of tables and StorageContainers. Other
+* sequences, like those of Vector3, and empty tables become containers
+* keyed by their indices.
+*/
+static bool
+isListTable(
+    lua_State* L,
+    int index
+) {
+    size_t length = lua_rawlen(L, index);
+    if (length == 0) {
+        return false;
+    }
+    size_t count = 0;
+    lua_pushnil(L);
+    while (lua_next(L, index)) {
+        ++count;
+        bool isElement = isListElement(L, lua_gettop(L));
+        lua_pop(L, 1);
+        if (not isElement) {
+            lua_pop(L, 1);
+            return false;
+        }
+    }
+    return count == length;
+}
+
+
+/**
+* @brief Sets each field of the table at \a index in \a storage
+*/
+static void
+fillFromTable(
+    StorageContainer& storage,
+    lua_State* L,
+    int index
+) {
+    luaL_checkstack(L, 3, "Table too deeply nested");
+    lua_pushnil(L);
+    while (lua_next(L, index)) {
+        std::string key;
+        if (lua_type(L, -2) == LUA_TSTRING) {
+            size_t length = 0;
+            const char* data = lua_tolstring(L, -2, &length);
+            key.assign(data, length);
+        }
+        else {
+            // lua_tolstring on the key itself would confuse lua_next
+            lua_pushvalue(L, -2);
+            size_t length = 0;
+            const char* data = lua_tolstring(L, -1, &length);
+            if (not data) {
+                throw std::invalid_argument("Table key can't be converted to a string");
+            }
+            key.assign(data, length);
+            lua_pop(L, 1);
+        }
+        setFromLua(storage, key, L, lua_gettop(L));
+        lua_pop(L, 1);
+    }
+}
+
+
+static StorageList
+listFromTable(
+    lua_State* L,
+    int index
+) {
+    StorageList list;
+    size_t length = lua_rawlen(L, index);
+    list.reserve(length);
+    for (size_t i = 1; i <= length; ++i) {
+        lua_rawgeti(L, index, i);
+        int element = lua_gettop(L);
+        if (lua_type(L, element) == LUA_TTABLE) {
+            StorageContainer container;
+            fillFromTable(container, L, element);
+            list.append(std::move(container));
+        }
+        else {
+            luabind::object object(luabind::from_stack(L, element));
+            auto container = luabind::object_cast_nothrow<StorageContainer>(object);
+            if (not container) {
+                throw std::invalid_argument(
+                    "Lists can only hold tables and StorageContainers"
+                );
+            }
+            list.append(std::move(*container));
+        }
+        lua_pop(L, 1);
+    }
+    return list;
+}
+
+
+#define SET_FROM_USERDATA(typeName) \
+    { \
+        auto value = luabind::object_cast_nothrow<typeName>(object); \
+        if (value) { \
+            storage.set<typeName>(key, std::move(*value)); \
+            return; \
+        } \
+    }
+
+/**
+* @brief Sets the value at \a index as \a key in \a storage
+*/
+static void
+setFromLua(
+    StorageContainer& storage,
+    const std::string& key,
+    lua_State* L,
+    int index
+) {
+    switch (lua_type(L, index)) {
+        case LUA_TBOOLEAN:
+            storage.set<bool>(key, lua_toboolean(L, index));
+            return;
+        case LUA_TNUMBER:
+            storage.set<double>(key, lua_tonumber(L, index));
+            return;
+        case LUA_TSTRING:
+        {
+            size_t length = 0;
+            const char* data = lua_tolstring(L, index, &length);
+            storage.set<std::string>(key, std::string(data, length));
+            return;
+        }
+        case LUA_TTABLE:
+            if (isListTable(L, index)) {
+                storage.set<StorageList>(key, listFromTable(L, index));
+            }
+            else {
+                StorageContainer container;
+                fillFromTable(container, L, index);
+                storage.set<StorageContainer>(key, std::move(container));
+            }
+            return;
+        case LUA_TUSERDATA:
+        {
+            luabind::object object(luabind::from_stack(L, index));
+            SET_FROM_USERDATA(Ogre::Vector3)
+            SET_FROM_USERDATA(Ogre::Quaternion)
+            SET_FROM_USERDATA(Ogre::ColourValue)
+            SET_FROM_USERDATA(Ogre::Degree)
+            SET_FROM_USERDATA(Ogre::Plane)
+            SET_FROM_USERDATA(StorageContainer)
+            SET_FROM_USERDATA(StorageList)
+            break;
+        }
+        default:
+            break;
+    }
+    throw std::invalid_argument(
+        std::string("Can't store ") + luaL_typename(L, index) + " as " + key
+    );
+}
+
+#undef SET_FROM_USERDATA
+
+
+
+
 struct StorageContainer::Implementation {
 
+    struct Entry {
+        KeyId key;
+        StoredValue value;
+    };
+
+    using Content = std::vector<Entry, StorageAllocator<Entry>>;
+
+    /**
+    * @brief Creates an implementation in the current arena, if any
+    */
+    static Implementation*
+    create() {
+        StorageArena* arena = StorageArena::current();
+        if (not arena) {
+            return new Implementation();
+        }
+        void* memory = arena->allocate(
+            sizeof(Implementation),
+            alignof(Implementation)
+        );
+        Implementation* impl = new (memory) Implementation();
+        impl->m_arena = arena;
+        return impl;
+    }
+
+    Content::const_iterator
+    find(
+        const std::string& key
+    ) const {
+        KeyId id = 0;
+        if (not KeyRegistry::find(key, id)) {
+            return m_content.cend();
+        }
+        return this->find(id);
+    }
+
+    Content::const_iterator
+    find(
+        KeyId key
+    ) const {
+        return std::find_if(
+            m_content.cbegin(),
+            m_content.cend(),
+            [key] (const Entry& entry) {
+                return entry.key == key;
+            }
+        );
+    }
+
     template<typename T>
     bool
     rawContains(
         const std::string& key
     ) const {
-        auto iter = m_content.find(key);
+        auto iter = this->find(key);
         return (
             iter != m_content.end() and
-            iter->second.typeId == TypeInfo<T>::Id
+            iter->value.typeId == TypeInfo<T>::Id
         );
     }
 
@@ -206,15 +753,15 @@ struct StorageContainer::Implementation {
         const std::string& key,
         const typename TypeInfo<T>::StoredType& defaultValue = typename TypeInfo<T>::StoredType()
     ) const {
-        auto iter = m_content.find(key);
+        auto iter = this->find(key);
         if (iter == m_content.end()) {
             return defaultValue;
         }
-        else if (iter->second.typeId != TypeInfo<T>::Id){
+        else if (iter->value.typeId != TypeInfo<T>::Id){
             return defaultValue;
         }
         else {
-            return boost::get<typename TypeInfo<T>::StoredType>(iter->second.value);
+            return boost::get<typename TypeInfo<T>::StoredType>(iter->value.value);
         }
     }
 
@@ -224,78 +771,365 @@ struct StorageContainer::Implementation {
         const std::string& key,
         typename TypeInfo<T>::StoredType value
     ) {
-        m_content[key] = StoredValue{
+        KeyId id = KeyRegistry::intern(key);
+        StoredValue storedValue {
             TypeInfo<T>::Id, 
             std::move(value)
         };
+        for (Entry& entry : m_content) {
+            if (entry.key == id) {
+                entry.value = std::move(storedValue);
+                return;
+            }
+        }
+        m_content.push_back(Entry{id, std::move(storedValue)});
+    }
+
+    template<typename T>
+    const typename TypeInfo<T>::StoredType*
+    rawFind(
+        const std::string& key
+    ) const {
+        auto iter = this->find(key);
+        if (iter == m_content.cend() or iter->value.typeId != TypeInfo<T>::Id) {
+            return nullptr;
+        }
+        return &boost::get<typename TypeInfo<T>::StoredType>(iter->value.value);
+    }
+
+    template<typename T>
+    typename TypeInfo<T>::StoredType
+    rawTake(
+        const std::string& key
+    ) {
+        using StoredType = typename TypeInfo<T>::StoredType;
+        auto found = this->find(key);
+        if (found == m_content.cend() or found->value.typeId != TypeInfo<T>::Id) {
+            return StoredType();
+        }
+        auto iter = m_content.begin() + (found - m_content.cbegin());
+        StoredType value = std::move(boost::get<StoredType>(iter->value.value));
+        m_content.erase(iter);
+        return value;
     }
 
-    std::unordered_map<std::string, StoredValue> m_content;
+    Content m_content;
+
+    // Owners of this implementation: the container and any Lua views of
+    // it. Containers copy the content before changing shared content.
+    std::atomic<unsigned int> m_references {1};
+
+    // The arena this implementation was allocated from, if any
+    StorageArena::Ptr m_arena;
 
 };
 
-#define GET_SET_CONTAINS(type) \
-    \
-    template<> \
-    bool \
-    StorageContainer::contains<type>( \
-        const std::string& key \
-    ) const { \
-        return m_impl->rawContains<type>(key); \
-    } \
-    \
-    template<> \
-    type \
-    StorageContainer::get<type>( \
-        const std::string& key, \
-        const type& defaultValue \
-    ) const { \
-        if (not this->contains<type>(key)) { \
-            return defaultValue; \
-        } \
-        auto storedValue = m_impl->rawGet<type>(key); \
-        return TypeInfo<type>::convertFromStoredType(storedValue); \
-    } \
-    \
-    template <> \
-    void \
-    StorageContainer::set<type>( \
-        const std::string& key, \
-        type value \
-    ) { \
-        auto storedValue = TypeInfo<type>::convertToStoredType(value); \
-        m_impl->rawSet<type>(key, std::move(storedValue)); \
-    }
 
-GET_SET_CONTAINS(bool)
-GET_SET_CONTAINS(char)
-GET_SET_CONTAINS(int8_t)
-GET_SET_CONTAINS(int16_t)
-GET_SET_CONTAINS(int32_t)
-GET_SET_CONTAINS(int64_t)
-GET_SET_CONTAINS(uint8_t)
-GET_SET_CONTAINS(uint16_t)
-GET_SET_CONTAINS(uint32_t)
-GET_SET_CONTAINS(uint64_t)
-GET_SET_CONTAINS(float)
-GET_SET_CONTAINS(double)
-GET_SET_CONTAINS(std::string)
-GET_SET_CONTAINS(StorageContainer)
-GET_SET_CONTAINS(StorageList)
-// Compound types
-GET_SET_CONTAINS(Ogre::Degree)
-GET_SET_CONTAINS(Ogre::Plane)
-GET_SET_CONTAINS(Ogre::Vector3)
-GET_SET_CONTAINS(Ogre::Quaternion)
-GET_SET_CONTAINS(Ogre::ColourValue)
+namespace thrive {
 
-luabind::scope
-StorageContainer::luaBindings() {
+/**
+* @brief Read-only Lua tables that convert their content on first access
+*
+* A view is an empty table whose metatable looks fields up in the
+* underlying container or list. Every field that was read is cached in
+* the table, so each value is converted at most once. Nested containers
+* and lists become views themselves, so parts that are never read are
+* never converted.
+*
+* Views share the content of the container they were made from. Once
+* the container changes, it gets its own copy of the content, so a view
+* keeps showing what the container held when the view was made.
+*/
+class LuaStorageView {
+
+public:
+
+    /**
+    * @brief Pushes a view onto the stack
+    *
+    * @param L
+    *   The Lua state
+    * @param owner
+    *   Keeps the tree that \a container or \a list belong to alive
+    * @param container
+    *   The container to view, or \c nullptr if \a list is set
+    * @param list
+    *   The list to view, or \c nullptr if \a container is set
+    */
+    static void
+    push(
+        lua_State* L,
+        std::shared_ptr<const void> owner,
+        const StorageContainer* container,
+        const StorageList* list
+    ) {
+        luaL_checkstack(L, 4, "Storage too deeply nested");
+        lua_createtable(L, 0, 0);
+        lua_createtable(L, 0, 2);
+        void* memory = lua_newuserdata(L, sizeof(Source));
+        new (memory) Source{std::move(owner), container, list};
+        if (luaL_newmetatable(L, SOURCE_METATABLE)) {
+            lua_pushcfunction(L, &LuaStorageView::collect);
+            lua_setfield(L, -2, "__gc");
+        }
+        lua_setmetatable(L, -2);
+        // Stack: view, metatable, source
+        lua_pushvalue(L, -1);
+        lua_pushcclosure(L, &LuaStorageView::index, 1);
+        lua_setfield(L, -3, "__index");
+        if (list) {
+            lua_pushcclosure(L, &LuaStorageView::length, 1);
+            lua_setfield(L, -2, "__len");
+        }
+        else {
+            lua_pop(L, 1);
+        }
+        lua_pushcfunction(L, &LuaStorageView::newIndex);
+        lua_setfield(L, -2, "__newindex");
+        lua_setmetatable(L, -2);
+    }
+
+private:
+
+    struct Source {
+
+        std::shared_ptr<const void> owner;
+
+        const StorageContainer* container;
+
+        const StorageList* list;
+
+    };
+
+    static const char* SOURCE_METATABLE;
+
+    static int
+    collect(
+        lua_State* L
+    ) {
+        static_cast<Source*>(lua_touserdata(L, 1))->~Source();
+        return 0;
+    }
+
+    /**
+    * @brief __index metamethod, converts and caches one field
+    */
+    static int
+    index(
+        lua_State* L
+    ) {
+        const Source& source = *static_cast<Source*>(
+            lua_touserdata(L, lua_upvalueindex(1))
+        );
+        if (source.list) {
+            if (lua_type(L, 2) != LUA_TNUMBER) {
+                return 0;
+            }
+            lua_Integer i = lua_tointeger(L, 2);
+            if (i < 1 or static_cast<size_t>(i) > source.list->size()) {
+                return 0;
+            }
+            push(L, source.owner, &(*source.list)[i - 1], nullptr);
+        }
+        else {
+            const StorageContainer& container = *source.container;
+            if (lua_type(L, 2) != LUA_TSTRING or not container.m_impl) {
+                return 0;
+            }
+            size_t length = 0;
+            const char* key = lua_tolstring(L, 2, &length);
+            auto iter = container.m_impl->find(std::string(key, length));
+            if (iter == container.m_impl->m_content.end()) {
+                return 0;
+            }
+            const StoredValue& value = iter->value;
+            if (pushPlainValue(L, value)) {
+                // Done
+            }
+            else if (value.typeId == TypeInfo<StorageContainer>::Id) {
+                push(L, source.owner, &boost::get<StorageContainer>(value.value), nullptr);
+            }
+            else {
+                push(L, source.owner, nullptr, &boost::get<StorageList>(value.value));
+            }
+        }
+        // Cache in the view, later reads don't reach this function
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, 1);
+        return 1;
+    }
+
+    /**
+    * @brief __len metamethod of list views
+    */
+    static int
+    length(
+        lua_State* L
+    ) {
+        const Source& source = *static_cast<Source*>(
+            lua_touserdata(L, lua_upvalueindex(1))
+        );
+        lua_pushinteger(L, source.list->size());
+        return 1;
+    }
+
+    /**
+    * @brief __newindex metamethod, views are read-only
+    */
+    static int
+    newIndex(
+        lua_State* L
+    ) {
+        return luaL_error(L, "Storage views are read-only");
+    }
+
+};
+
+const char* LuaStorageView::SOURCE_METATABLE = "thrive.LuaStorageView";
+
+}
+
+
+void
+StorageContainer::ImplementationDeleter::operator() (
+    Implementation* impl
+) const {
+    if (impl->m_references.fetch_sub(1) != 1) {
+        // Still shared
+        return;
+    }
+    if (impl->m_arena) {
+        // Keep the arena alive until the destructor has run
+        StorageArena::Ptr arena = std::move(impl->m_arena);
+        impl->~Implementation();
+    }
+    else {
+        delete impl;
+    }
+}
+
+
+StorageContainer::Implementation&
+StorageContainer::impl() {
+    if (not m_impl) {
+        m_impl.reset(Implementation::create());
+    }
+    else if (m_impl->m_references > 1) {
+        // Shared with a view, which has to keep seeing the old content
+        std::unique_ptr<Implementation, ImplementationDeleter> copy(
+            Implementation::create()
+        );
+        copy->m_content = m_impl->m_content;
+        m_impl = std::move(copy);
+    }
+    return *m_impl;
+}
+
+
+StorageContainer
+StorageContainer::shareContent() const {
+    StorageContainer container;
+    if (m_impl) {
+        m_impl->m_references += 1;
+        container.m_impl.reset(m_impl.get());
+    }
+    return container;
+}
+
+
+#define GET_SET_CONTAINS(type) \
+    \
+    template<> \
+    bool \
+    StorageContainer::contains<type>( \
+        const std::string& key \
+    ) const { \
+        return m_impl and m_impl->rawContains<type>(key); \
+    } \
+    \
+    template<> \
+    type \
+    StorageContainer::get<type>( \
+        const std::string& key, \
+        const type& defaultValue \
+    ) const { \
+        if (not this->contains<type>(key)) { \
+            return defaultValue; \
+        } \
+        auto storedValue = m_impl->rawGet<type>(key); \
+        return TypeInfo<type>::convertFromStoredType(storedValue); \
+    } \
+    \
+    template <> \
+    void \
+    StorageContainer::set<type>( \
+        const std::string& key, \
+        type value \
+    ) { \
+        auto storedValue = TypeInfo<type>::convertToStoredType(value); \
+        this->impl().rawSet<type>(key, std::move(storedValue)); \
+    }
+
+GET_SET_CONTAINS(bool)
+GET_SET_CONTAINS(char)
+GET_SET_CONTAINS(int8_t)
+GET_SET_CONTAINS(int16_t)
+GET_SET_CONTAINS(int32_t)
+GET_SET_CONTAINS(int64_t)
+GET_SET_CONTAINS(uint8_t)
+GET_SET_CONTAINS(uint16_t)
+GET_SET_CONTAINS(uint32_t)
+GET_SET_CONTAINS(uint64_t)
+GET_SET_CONTAINS(float)
+GET_SET_CONTAINS(double)
+GET_SET_CONTAINS(std::string)
+GET_SET_CONTAINS(StorageContainer)
+GET_SET_CONTAINS(StorageList)
+// Compound types
+GET_SET_CONTAINS(Ogre::Degree)
+GET_SET_CONTAINS(Ogre::Plane)
+GET_SET_CONTAINS(Ogre::Vector3)
+GET_SET_CONTAINS(Ogre::Quaternion)
+GET_SET_CONTAINS(Ogre::ColourValue)
+
+// Only types stored as themselves can be referenced or moved out
+#define FIND_TAKE(type) \
+    template <> \
+    const type* \
+    StorageContainer::find<type>( \
+        const std::string& key \
+    ) const { \
+        if (not m_impl) { \
+            return nullptr; \
+        } \
+        return m_impl->rawFind<type>(key); \
+    } \
+    \
+    template <> \
+    type \
+    StorageContainer::take<type>( \
+        const std::string& key \
+    ) { \
+        if (not m_impl) { \
+            return type(); \
+        } \
+        return this->impl().rawTake<type>(key); \
+    }
+
+FIND_TAKE(StorageContainer)
+FIND_TAKE(StorageList)
+
+#undef FIND_TAKE
+
+luabind::scope
+StorageContainer::luaBindings() {
     using namespace luabind;
     return 
         class_<StorageContainer>("StorageContainer")
             .def(constructor<>())
             .def("contains", static_cast<bool(StorageContainer::*)(const std::string&) const>(&StorageContainer::contains))
+            .def("fromTable", &StorageContainer::luaFromTable)
             .def("get", &StorageContainer::luaGet)
             .def("set", &StorageContainer::set<bool>)
             .def("set", &StorageContainer::set<double>)
@@ -308,27 +1142,26 @@ StorageContainer::luaBindings() {
             .def("set", &StorageContainer::set<Ogre::Vector3>)
             .def("set", &StorageContainer::set<Ogre::Quaternion>)
             .def("set", &StorageContainer::set<Ogre::ColourValue>)
+            .def("toTable", &StorageContainer::luaToTable)
+            .def("view", &StorageContainer::luaView)
     ;
 }
 
 
-StorageContainer::StorageContainer()
-  : m_impl(new Implementation())
-{
-}
+StorageContainer::StorageContainer() {}
 
 
 StorageContainer::StorageContainer(
     const StorageContainer& other
-) : m_impl(new Implementation())
-{
+) {
     *this = other;
 }
 
 
 StorageContainer::StorageContainer(
     StorageContainer&& other
-) : m_impl(std::move(other.m_impl))
+) noexcept
+  : m_impl(std::move(other.m_impl))
 {
 }
 
@@ -340,8 +1173,14 @@ StorageContainer&
 StorageContainer::operator = (
     const StorageContainer& other
 ) {
-    if (this != &other) {
-        m_impl->m_content = other.m_impl->m_content;
+    if (this == &other) {
+        return *this;
+    }
+    if (other.m_impl and not other.m_impl->m_content.empty()) {
+        this->impl().m_content = other.m_impl->m_content;
+    }
+    else if (m_impl) {
+        this->impl().m_content.clear();
     }
     return *this;
 }
@@ -350,18 +1189,73 @@ StorageContainer::operator = (
 StorageContainer&
 StorageContainer::operator = (
     StorageContainer&& other
-) {
+) noexcept {
     assert(this != &other);
     m_impl = std::move(other.m_impl);
     return *this;
 }
 
 
+bool
+StorageContainer::operator == (
+    const StorageContainer& other
+) const {
+    size_t size = m_impl ? m_impl->m_content.size() : 0;
+    size_t otherSize = other.m_impl ? other.m_impl->m_content.size() : 0;
+    if (size != otherSize) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        const auto& entry = m_impl->m_content[i];
+        const auto& otherEntry = other.m_impl->m_content[i];
+        if (
+            entry.key != otherEntry.key or
+            entry.value.typeId != otherEntry.value.typeId or
+            not (entry.value.value == otherEntry.value.value)
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool
+StorageContainer::operator != (
+    const StorageContainer& other
+) const {
+    return not (*this == other);
+}
+
+
 bool
 StorageContainer::contains(
     const std::string& key
 ) const {
-    return m_impl->m_content.find(key) != m_impl->m_content.cend();
+    return m_impl and m_impl->find(key) != m_impl->m_content.cend();
+}
+
+
+void
+StorageContainer::luaFromTable(
+    const luabind::object& table
+) {
+    lua_State* L = table.interpreter();
+    table.push(L);
+    int index = lua_gettop(L);
+    if (lua_type(L, index) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        throw std::invalid_argument("Expected a table");
+    }
+    try {
+        fillFromTable(*this, L, index);
+    }
+    catch (...) {
+        // Whatever the conversion left on the stack
+        lua_settop(L, index - 1);
+        throw;
+    }
+    lua_pop(L, 1);
 }
 
 
@@ -370,12 +1264,15 @@ StorageContainer::luaGet(
     const std::string& key,
     luabind::object defaultValue
 ) const {
-    auto iter = m_impl->m_content.find(key);
+    if (not m_impl) {
+        return defaultValue;
+    }
+    auto iter = m_impl->find(key);
     if (iter == m_impl->m_content.end()) {
         return defaultValue;
     }
     else {
-        luabind::object obj = toLua(defaultValue.interpreter(), iter->second);
+        luabind::object obj = toLua(defaultValue.interpreter(), iter->value);
         if (obj) {
             return obj;
         }
@@ -386,16 +1283,79 @@ StorageContainer::luaGet(
 }
 
 
+uint64_t
+StorageContainer::fingerprint() const {
+    FingerprintBuffer buffer;
+    std::ostream stream(&buffer);
+    stream << *this;
+    return buffer.fingerprint();
+}
+
+
 std::list<std::string>
 StorageContainer::keys() const {
     std::list<std::string> keys;
-    for (const auto& pair : m_impl->m_content) {
-        keys.push_back(pair.first);
+    if (not m_impl) {
+        return keys;
+    }
+    for (const auto& entry : m_impl->m_content) {
+        keys.push_back(KeyRegistry::name(entry.key));
     }
     return keys;
 }
 
 
+luabind::object
+StorageContainer::luaToTable(
+    lua_State* L
+) const {
+    this->pushTable(L);
+    luabind::object table(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return table;
+}
+
+
+luabind::object
+StorageContainer::luaView(
+    lua_State* L
+) const {
+    auto owner = std::make_shared<StorageContainer>(this->shareContent());
+    LuaStorageView::push(L, owner, owner.get(), nullptr);
+    luabind::object view(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return view;
+}
+
+
+void
+StorageContainer::pushTable(
+    lua_State* L
+) const {
+    luaL_checkstack(L, 3, "Storage too deeply nested");
+    lua_createtable(L, 0, m_impl ? m_impl->m_content.size() : 0);
+    if (not m_impl) {
+        return;
+    }
+    for (const auto& entry : m_impl->m_content) {
+        const std::string& key = KeyRegistry::name(entry.key);
+        lua_pushlstring(L, key.data(), key.size());
+        const StoredValue& value = entry.value;
+        if (pushPlainValue(L, value)) {
+            // Done
+        }
+        else if (value.typeId == TypeInfo<StorageContainer>::Id) {
+            boost::get<StorageContainer>(value.value).pushTable(L);
+        }
+        else {
+            boost::get<StorageList>(value.value).pushTable(L);
+        }
+        lua_rawset(L, -3);
+    }
+}
+
+
+
 #define NATIVE_TYPE(typeName) \
     typeName \
     TypeInfo<typeName>::convertFromStoredType( \
@@ -426,6 +1386,9 @@ NATIVE_TYPE(double)
 NATIVE_TYPE(std::string)
 NATIVE_TYPE(StorageContainer)
 NATIVE_TYPE(StorageList)
+NATIVE_TYPE(Ogre::Plane)
+NATIVE_TYPE(Ogre::Quaternion)
+NATIVE_TYPE(Ogre::Vector3)
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -448,95 +1411,6 @@ TypeInfo<Ogre::Degree>::convertToStoredType(
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-// Ogre::Plane
-////////////////////////////////////////////////////////////////////////////////
-
-Ogre::Plane
-TypeInfo<Ogre::Plane>::convertFromStoredType(
-    const StorageContainer& storage
-) {
-    Ogre::Vector3 normal = storage.get<Ogre::Vector3>("normal");
-    Ogre::Real d = storage.get<Ogre::Real>("d");
-    Ogre::Plane plane(normal, -d); // See the constructor definition in OgrePlane.cpp for the minus sign
-    return plane;
-}
-
-
-StorageContainer
-TypeInfo<Ogre::Plane>::convertToStoredType(
-    const Ogre::Plane& value
-) {
-    StorageContainer storage;
-    storage.set<Ogre::Vector3>("normal", value.normal);
-    storage.set<Ogre::Real>("d", value.d);
-    return storage;
-}
-
-
-
-////////////////////////////////////////////////////////////////////////////////
-// Ogre::Vector3
-////////////////////////////////////////////////////////////////////////////////
-
-Ogre::Vector3
-TypeInfo<Ogre::Vector3>::convertFromStoredType(
-    const StorageContainer& storage
-) {
-    std::array<Ogre::Real, 3> elements {{
-        storage.get<Ogre::Real>("x"),
-        storage.get<Ogre::Real>("y"),
-        storage.get<Ogre::Real>("z")
-    }};
-    return Ogre::Vector3(elements.data());
-}
-
-
-StorageContainer
-TypeInfo<Ogre::Vector3>::convertToStoredType(
-    const Ogre::Vector3& value
-) {
-    StorageContainer storage;
-    storage.set<Ogre::Real>("x", value.x);
-    storage.set<Ogre::Real>("y", value.y);
-    storage.set<Ogre::Real>("z", value.z);
-    return storage;
-}
-
-
-
-////////////////////////////////////////////////////////////////////////////////
-// Ogre::Quaternion
-////////////////////////////////////////////////////////////////////////////////
-
-Ogre::Quaternion
-TypeInfo<Ogre::Quaternion>::convertFromStoredType(
-    const StorageContainer& storage
-) {
-    std::array<Ogre::Real, 4> elements {{
-        storage.get<Ogre::Real>("w"),
-        storage.get<Ogre::Real>("x"),
-        storage.get<Ogre::Real>("y"),
-        storage.get<Ogre::Real>("z")
-    }};
-    return Ogre::Quaternion(elements.data());
-}
-
-
-StorageContainer
-TypeInfo<Ogre::Quaternion>::convertToStoredType(
-    const Ogre::Quaternion& value
-) {
-    StorageContainer storage;
-    storage.set<Ogre::Real>("w", value.w);
-    storage.set<Ogre::Real>("x", value.x);
-    storage.set<Ogre::Real>("y", value.y);
-    storage.set<Ogre::Real>("z", value.z);
-    return storage;
-}
-
-
-
 ////////////////////////////////////////////////////////////////////////////////
 // Ogre::ColourValue
 ////////////////////////////////////////////////////////////////////////////////
@@ -571,6 +1445,8 @@ StorageList::luaBindings() {
         .def("append", &StorageList::append)
         .def("get", &StorageList::get)
         .def("size", &StorageList::size)
+        .def("toTable", &StorageList::luaToTable)
+        .def("view", &StorageList::luaView)
     ;
 }
 
@@ -579,56 +1455,356 @@ StorageList::StorageList() {}
 
 StorageList::StorageList(
     const StorageList& other
-) : std::vector<StorageContainer>(other)
+) : std::vector<StorageContainer, StorageAllocator<StorageContainer>>(other)
 {
 }
 
 
 StorageList::StorageList(
     StorageList&& other
-) : std::vector<StorageContainer>(other)
+) noexcept
+  : std::vector<StorageContainer, StorageAllocator<StorageContainer>>(std::move(other))
 {
 }
 
 
-StorageList&
-StorageList::operator = (
-    const StorageList& other
-) {
-    std::vector<StorageContainer>::operator=(other);
-    return *this;
-}
+StorageList&
+StorageList::operator = (
+    const StorageList& other
+) {
+    std::vector<StorageContainer, StorageAllocator<StorageContainer>>::operator=(other);
+    return *this;
+}
+
+
+StorageList&
+StorageList::operator = (
+    StorageList&& other
+) noexcept {
+    std::vector<StorageContainer, StorageAllocator<StorageContainer>>::operator=(std::move(other));
+    return *this;
+}
+
+
+void
+StorageList::append(
+    StorageContainer element
+) {
+    this->emplace_back(std::move(element));
+}
+
+
+StorageContainer&
+StorageList::get(
+    size_t index
+) {
+    assert(index > 0);
+    return this->at(index - 1);
+}
+
+
+luabind::object
+StorageList::luaToTable(
+    lua_State* L
+) const {
+    this->pushTable(L);
+    luabind::object table(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return table;
+}
+
+
+luabind::object
+StorageList::luaView(
+    lua_State* L
+) const {
+    // A list of handles to the elements' content, nothing is copied
+    auto owner = std::make_shared<StorageList>();
+    owner->reserve(this->size());
+    for (const StorageContainer& element : *this) {
+        owner->push_back(element.shareContent());
+    }
+    LuaStorageView::push(L, owner, nullptr, owner.get());
+    luabind::object view(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return view;
+}
+
+
+void
+StorageList::pushTable(
+    lua_State* L
+) const {
+    luaL_checkstack(L, 2, "Storage too deeply nested");
+    lua_createtable(L, this->size(), 0);
+    for (size_t i = 0; i < this->size(); ++i) {
+        (*this)[i].pushTable(L);
+        lua_rawseti(L, -2, i + 1);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Serialization
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/**
+* @brief Marks the start of a savegame in format version 2 or later
+*
+* Format version 1 had no header and started right away with the entry
+* count of the outermost container. No sane entry count looks like this
+* magic, so both formats can be told apart by their first eight bytes.
+*/
+const char FORMAT_MAGIC[7] = {'T', 'H', 'R', 'I', 'V', 'E', 'S'};
+
+/**
+* @brief Version 1: string keys per entry, fixed width sizes
+*/
+const uint8_t LEGACY_FORMAT_VERSION = 1;
+
+/**
+* @brief Version 2: interned keys, variable length sizes
+*
+* Version 3: Ogre::Plane, Ogre::Quaternion and Ogre::Vector3 are packed
+* floats instead of nested containers
+*/
+const uint8_t FORMAT_VERSION = 3;
+
+/**
+* @brief Marks a key that has not been written by a StorageWriter yet
+*/
+const uint32_t NO_LOCAL_ID = UINT32_MAX;
+
+/**
+* @brief Most elements reserved at once when the end of input is unknown
+*/
+const uint64_t UNBOUNDED_RESERVE = 64 * 1024;
+
+
+void
+writeHeader(
+    std::ostream& stream
+) {
+    stream.write(FORMAT_MAGIC, sizeof(FORMAT_MAGIC));
+    stream.put(FORMAT_VERSION);
+}
+
+} // namespace
+
+namespace thrive {
+
+/**
+* @brief Serializes storage containers into a stream
+*
+* Each key is written as a string only once per writer. The first
+* occurrence of a key assigns it the next free local id, and the string
+* follows that id. Later occurrences are just the id. This builds the 
+* key dictionary on the fly, so the writer never needs to see the whole 
+* tree in advance.
+*/
+class StorageWriter {
+
+public:
+
+    StorageWriter(
+        std::ostream& stream
+    ) : m_stream(stream)
+    {
+    }
+
+    void
+    writeBytes(
+        const char* data,
+        size_t size
+    ) {
+        m_stream.write(data, size);
+    }
+
+    void
+    writeContainer(
+        const StorageContainer& storage
+    );
+
+    void
+    writeKey(
+        KeyId key
+    ) {
+        if (key >= m_localIds.size()) {
+            m_localIds.resize(key + 1, NO_LOCAL_ID);
+        }
+        uint32_t& localId = m_localIds[key];
+        if (localId == NO_LOCAL_ID) {
+            localId = m_nextLocalId++;
+            this->writeVarint(localId);
+            this->writeString(KeyRegistry::name(key));
+        }
+        else {
+            this->writeVarint(localId);
+        }
+    }
+
+    void
+    writeString(
+        const std::string& string
+    ) {
+        this->writeVarint(string.size());
+        this->writeBytes(string.data(), string.size());
+    }
+
+    void
+    writeVarint(
+        uint64_t value
+    ) {
+        char buffer[10];
+        size_t size = 0;
+        while (value >= 0x80) {
+            buffer[size++] = static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        buffer[size++] = static_cast<char>(value);
+        this->writeBytes(buffer, size);
+    }
+
+private:
+
+    std::vector<uint32_t> m_localIds;
+
+    uint32_t m_nextLocalId = 0;
+
+    std::ostream& m_stream;
+
+};
+
+
+/**
+* @brief Deserializes storage containers from a stream
+*
+* Understands the current format as well as the legacy format version 1.
+*/
+class StorageReader {
+
+public:
+
+    StorageReader(
+        std::istream& stream,
+        uint8_t version
+    ) : m_stream(stream),
+        m_version(version)
+    {
+        // Sizes read from the stream can't be trusted. Knowing how much
+        // input is left, they can be checked before anything is allocated.
+        std::streampos position = stream.tellg();
+        if (position != std::streampos(-1)) {
+            stream.seekg(0, std::ios_base::end);
+            m_remaining = static_cast<uint64_t>(stream.tellg() - position);
+            m_isBounded = true;
+            stream.seekg(position);
+        }
+    }
+
+    /**
+    * @brief Throws unless \a count elements can still follow
+    *
+    * Every element takes at least one byte.
+    *
+    * @return
+    *   How many elements to reserve room for
+    */
+    size_t
+    checkSize(
+        uint64_t count
+    ) const {
+        if (count > m_remaining) {
+            throw std::runtime_error("Corrupt savegame: size exceeds the remaining data");
+        }
+        // Unseekable streams only reveal their end when it's reached
+        return m_isBounded ? count : std::min<uint64_t>(count, UNBOUNDED_RESERVE);
+    }
+
+    void
+    readBytes(
+        char* data,
+        size_t size
+    ) {
+        if (size > m_remaining or not m_stream.read(data, size)) {
+            throw std::runtime_error("Corrupt savegame: unexpected end of data");
+        }
+        m_remaining -= size;
+    }
+
+    void
+    readContainer(
+        StorageContainer& storage,
+        uint64_t size
+    );
+
+    KeyId
+    readKey() {
+        if (m_version == LEGACY_FORMAT_VERSION) {
+            return KeyRegistry::intern(this->readString());
+        }
+        uint64_t localId = this->readVarint();
+        if (localId == m_keys.size()) {
+            m_keys.push_back(KeyRegistry::intern(this->readString()));
+        }
+        else if (localId > m_keys.size()) {
+            throw std::runtime_error("Corrupt savegame: undefined key reference");
+        }
+        return m_keys[localId];
+    }
+
+    uint64_t
+    readSize();
+
+    std::string
+    readString() {
+        uint64_t size = this->readSize();
+        std::string string;
+        string.reserve(this->checkSize(size));
+        // In steps, so that an unbounded stream runs out before a bogus
+        // size is allocated
+        while (string.size() < size) {
+            size_t offset = string.size();
+            string.resize(offset + std::min<uint64_t>(size - offset, UNBOUNDED_RESERVE));
+            this->readBytes(&string[offset], string.size() - offset);
+        }
+        return string;
+    }
+
+    TypeId
+    readTypeId();
+
+    uint64_t
+    readVarint() {
+        uint64_t value = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            char byte = 0;
+            this->readBytes(&byte, 1);
+            value |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Corrupt savegame: varint too long");
+    }
 
+private:
 
-StorageList&
-StorageList::operator = (
-    StorageList&& other
-) {
-    std::vector<StorageContainer>::operator=(other);
-    return *this;
-}
+    bool m_isBounded = false;
 
+    std::vector<KeyId> m_keys;
 
-void
-StorageList::append(
-    StorageContainer element
-) {
-    this->emplace_back(std::move(element));
-}
+    uint64_t m_remaining = std::numeric_limits<uint64_t>::max();
 
+    std::istream& m_stream;
 
-StorageContainer&
-StorageList::get(
-    size_t index
-) {
-    assert(index > 0);
-    return this->at(index - 1);
-}
+    uint8_t m_version;
 
+};
 
-////////////////////////////////////////////////////////////////////////////////
-// Serialization
-////////////////////////////////////////////////////////////////////////////////
+} // namespace thrive
 
 namespace {
 
@@ -637,12 +1813,12 @@ struct TypeHandler {
 
     static T
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     );
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const T& value
     );
 
@@ -658,23 +1834,22 @@ struct IntegralTypeHandler {
 
     static T
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
         T value = 0;
-        stream.read(
+        reader.readBytes(
             reinterpret_cast<char*>(&value),
             sizeof(T)
         );
-        assert(not stream.fail());
         return value;
     }
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         T value
     ) {
-        stream.write(
+        writer.writeBytes(
             reinterpret_cast<char*>(&value), 
             sizeof(T)
         );
@@ -703,19 +1878,19 @@ struct TypeHandler<bool> {
 
     static bool
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
-        auto value = TypeHandler<uint8_t>::deserialize(stream);
+        auto value = TypeHandler<uint8_t>::deserialize(reader);
         return value > 0;
     }
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const bool& value
     ) {
         uint8_t encoded = value ? 1 : 0;
-        TypeHandler<uint8_t>::serialize(stream, encoded);
+        TypeHandler<uint8_t>::serialize(writer, encoded);
     }
 
 };
@@ -730,20 +1905,19 @@ struct TypeHandler<char> {
 
     static char
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
         char value = 0;
-        stream.read(&value, 1);
-        assert(not stream.fail());
+        reader.readBytes(&value, 1);
         return value;
     }
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const char& value
     ) {
-        stream.write(&value, 1);
+        writer.writeBytes(&value, 1);
     }
 };
 
@@ -757,23 +1931,17 @@ struct TypeHandler<std::string> {
 
     static std::string
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
-        uint64_t size = TypeHandler<uint64_t>::deserialize(stream);
-        std::vector<char> buffer(size, '\0');
-        stream.read(&buffer[0], size);
-        assert(not stream.fail());
-        return std::string(buffer.begin(), buffer.end());
+        return reader.readString();
     }
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const std::string& string
     ) {
-        uint64_t size = string.size();
-        TypeHandler<uint64_t>::serialize(stream, size);
-        stream.write(string.data(), size);
+        writer.writeString(string);
     }
 
 };
@@ -788,19 +1956,19 @@ struct TypeHandler<float> {
 
     static float
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
-        std::string asString = TypeHandler<std::string>::deserialize(stream);
+        std::string asString = TypeHandler<std::string>::deserialize(reader);
         return boost::lexical_cast<float>(asString);
     }
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const float& value
     ) {
         std::string asString = boost::lexical_cast<std::string>(value);
-        TypeHandler<std::string>::serialize(stream, asString);
+        TypeHandler<std::string>::serialize(writer, asString);
     }
 
 };
@@ -815,19 +1983,19 @@ struct TypeHandler<double> {
 
     static double
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
-        std::string asString = TypeHandler<std::string>::deserialize(stream);
+        std::string asString = TypeHandler<std::string>::deserialize(reader);
         return boost::lexical_cast<double>(asString);
     }
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const double& value
     ) {
         std::string asString = boost::lexical_cast<std::string>(value);
-        TypeHandler<std::string>::serialize(stream, asString);
+        TypeHandler<std::string>::serialize(writer, asString);
     }
 
 };
@@ -842,20 +2010,20 @@ struct TypeHandler<StorageContainer> {
 
     static StorageContainer
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
         StorageContainer value;
-        stream >> value;
+        reader.readContainer(value, reader.readSize());
         return value;
     }
 
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const StorageContainer& value
     ) {
-        stream << value;
+        writer.writeContainer(value);
     }
 
 };
@@ -870,13 +2038,13 @@ struct TypeHandler<StorageList> {
 
     static StorageList
     deserialize(
-        std::istream& stream
+        StorageReader& reader
     ) {
         StorageList list;
-        uint64_t size = TypeHandler<uint64_t>::deserialize(stream);
-        list.reserve(size);
+        uint64_t size = reader.readSize();
+        list.reserve(reader.checkSize(size));
         for (size_t i=0; i < size; ++i) {
-            list.append(TypeHandler<StorageContainer>::deserialize(stream));
+            list.append(TypeHandler<StorageContainer>::deserialize(reader));
         }
         return list;
     }
@@ -884,24 +2052,198 @@ struct TypeHandler<StorageList> {
 
     static void
     serialize(
-        std::ostream& stream,
+        StorageWriter& writer,
         const StorageList& list
     ) {
-        uint64_t size = list.size();
-        TypeHandler<uint64_t>::serialize(stream, size);
+        writer.writeVarint(list.size());
         for (const auto& storageContainer : list) {
-            TypeHandler<StorageContainer>::serialize(stream, storageContainer);
+            TypeHandler<StorageContainer>::serialize(writer, storageContainer);
         }
     }
 
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Packed compound types
+////////////////////////////////////////////////////////////////////////////////
+
+static_assert(
+    std::numeric_limits<float>::is_iec559 and sizeof(float) == 4,
+    "Packed compound types are stored as IEEE 754 single precision floats"
+);
+
+/**
+* @brief Handles compound types that are serialized as N contiguous floats
+*
+* @tparam T
+*   The compound type. Must specialize toFloats() and fromFloats().
+* @tparam N
+*   The number of floats
+*/
+template<typename T, size_t N>
+struct PackedTypeHandler {
+
+    using Floats = std::array<float, N>;
+
+    static T
+    deserialize(
+        StorageReader& reader
+    ) {
+        Floats floats;
+        reader.readBytes(
+            reinterpret_cast<char*>(floats.data()),
+            sizeof(Floats)
+        );
+        return fromFloats(floats);
+    }
+
+    static void
+    serialize(
+        StorageWriter& writer,
+        const T& value
+    ) {
+        Floats floats = toFloats(value);
+        writer.writeBytes(
+            reinterpret_cast<const char*>(floats.data()),
+            sizeof(Floats)
+        );
+    }
+
+    static T
+    fromFloats(
+        const Floats& floats
+    );
+
+    static Floats
+    toFloats(
+        const T& value
+    );
+
+};
+
+
+template<>
+Ogre::Plane
+PackedTypeHandler<Ogre::Plane, 4>::fromFloats(
+    const Floats& floats
+) {
+    Ogre::Plane plane;
+    plane.normal = Ogre::Vector3(floats[0], floats[1], floats[2]);
+    plane.d = floats[3];
+    return plane;
+}
+
+
+template<>
+PackedTypeHandler<Ogre::Plane, 4>::Floats
+PackedTypeHandler<Ogre::Plane, 4>::toFloats(
+    const Ogre::Plane& plane
+) {
+    return Floats {{
+        plane.normal.x,
+        plane.normal.y,
+        plane.normal.z,
+        plane.d
+    }};
+}
+
+
+template<>
+Ogre::Quaternion
+PackedTypeHandler<Ogre::Quaternion, 4>::fromFloats(
+    const Floats& floats
+) {
+    return Ogre::Quaternion(floats[0], floats[1], floats[2], floats[3]);
+}
+
+
+template<>
+PackedTypeHandler<Ogre::Quaternion, 4>::Floats
+PackedTypeHandler<Ogre::Quaternion, 4>::toFloats(
+    const Ogre::Quaternion& quaternion
+) {
+    return Floats {{
+        quaternion.w,
+        quaternion.x,
+        quaternion.y,
+        quaternion.z
+    }};
+}
+
+
+template<>
+Ogre::Vector3
+PackedTypeHandler<Ogre::Vector3, 3>::fromFloats(
+    const Floats& floats
+) {
+    return Ogre::Vector3(floats[0], floats[1], floats[2]);
+}
+
+
+template<>
+PackedTypeHandler<Ogre::Vector3, 3>::Floats
+PackedTypeHandler<Ogre::Vector3, 3>::toFloats(
+    const Ogre::Vector3& vector
+) {
+    return Floats {{
+        vector.x,
+        vector.y,
+        vector.z
+    }};
+}
+
+template<> struct TypeHandler<Ogre::Plane> : public PackedTypeHandler<Ogre::Plane, 4> {};
+template<> struct TypeHandler<Ogre::Quaternion> : public PackedTypeHandler<Ogre::Quaternion, 4> {};
+template<> struct TypeHandler<Ogre::Vector3> : public PackedTypeHandler<Ogre::Vector3, 3> {};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Legacy compound types
+////////////////////////////////////////////////////////////////////////////////
+
+static Ogre::Vector3
+legacyVector3(
+    const StorageContainer& storage
+) {
+    return Ogre::Vector3(
+        storage.get<Ogre::Real>("x"),
+        storage.get<Ogre::Real>("y"),
+        storage.get<Ogre::Real>("z")
+    );
+}
+
+
+static Ogre::Plane
+legacyPlane(
+    const StorageContainer& storage
+) {
+    // Nested vectors have already been upgraded while reading "storage"
+    Ogre::Vector3 normal = storage.get<Ogre::Vector3>("normal");
+    Ogre::Real d = storage.get<Ogre::Real>("d");
+    Ogre::Plane plane(normal, -d); // See the constructor definition in OgrePlane.cpp for the minus sign
+    return plane;
+}
+
+
+static Ogre::Quaternion
+legacyQuaternion(
+    const StorageContainer& storage
+) {
+    return Ogre::Quaternion(
+        storage.get<Ogre::Real>("w"),
+        storage.get<Ogre::Real>("x"),
+        storage.get<Ogre::Real>("y"),
+        storage.get<Ogre::Real>("z")
+    );
+}
+
+
 struct SerializationVisitor : public boost::static_visitor<> {
 
     SerializationVisitor(
-        std::ostream& stream
-    ) : m_stream(stream)
+        StorageWriter& writer
+    ) : m_writer(writer)
     {
     }
 
@@ -910,20 +2252,37 @@ struct SerializationVisitor : public boost::static_visitor<> {
     operator () (
         const T& value
     ) const {
-        TypeHandler<T>::serialize(m_stream, value);
+        TypeHandler<T>::serialize(m_writer, value);
     }
 
-    std::ostream& m_stream;
+    StorageWriter& m_writer;
 };
 
 #define DESERIALIZE_CASE(typeName) \
     case TypeInfo<typeName>::Id: \
-        return TypeHandler<TypeInfo<typeName>::StoredType>::deserialize(stream)
+        return TypeHandler<TypeInfo<typeName>::StoredType>::deserialize(reader)
 
+#define DESERIALIZE_LEGACY_CASE(typeName, legacyId, conversion) \
+    case legacyId: \
+        typeId = TypeInfo<typeName>::Id; \
+        return conversion(TypeHandler<StorageContainer>::deserialize(reader))
+
+/**
+* @brief Deserializes a single value
+*
+* @param[in,out] typeId
+*   The value's type id as read from the stream. Legacy ids are replaced
+*   with the id of the value's current representation.
+* @param reader
+*   The reader to read from
+*
+* @return 
+*   The value
+*/
 static Variant
 deserialize(
-    TypeId typeId,
-    std::istream& stream
+    TypeId& typeId,
+    StorageReader& reader
 ) {
     switch (typeId) {
         DESERIALIZE_CASE(bool);
@@ -947,8 +2306,13 @@ deserialize(
         DESERIALIZE_CASE(Ogre::Vector3);
         DESERIALIZE_CASE(Ogre::Quaternion);
         DESERIALIZE_CASE(Ogre::ColourValue);
+        // Legacy compound types
+        DESERIALIZE_LEGACY_CASE(Ogre::Plane, LEGACY_PLANE_ID, legacyPlane);
+        DESERIALIZE_LEGACY_CASE(Ogre::Vector3, LEGACY_VECTOR3_ID, legacyVector3);
+        DESERIALIZE_LEGACY_CASE(Ogre::Quaternion, LEGACY_QUATERNION_ID, legacyQuaternion);
         default:
-            assert(false && "Unknown type id. Did you add a new STORABLE_TYPE, but forgot the DESERIALIZE_CASE?");
+            // Also a missing DESERIALIZE_CASE for a new STORABLE_TYPE
+            throw std::runtime_error("Corrupt savegame: unknown type id");
     }
     return Variant(); // Should never be reached, but mingw complains without it
 }
@@ -956,19 +2320,78 @@ deserialize(
 
 } // namespace
 
+
+void
+StorageWriter::writeContainer(
+    const StorageContainer& storage
+) {
+    if (not storage.m_impl) {
+        this->writeVarint(0);
+        return;
+    }
+    SerializationVisitor visitor(*this);
+    const auto& content = storage.m_impl->m_content;
+    this->writeVarint(content.size());
+    for (const auto& entry : content) {
+        this->writeKey(entry.key);
+        this->writeVarint(entry.value.typeId);
+        boost::apply_visitor(visitor, entry.value.value);
+    }
+}
+
+
+void
+StorageReader::readContainer(
+    StorageContainer& storage,
+    uint64_t size
+) {
+    if (size == 0) {
+        storage = StorageContainer();
+        return;
+    }
+    auto& content = storage.impl().m_content;
+    content.clear();
+    content.reserve(this->checkSize(size));
+    for (size_t i = 0; i < size; ++i) {
+        KeyId key = this->readKey();
+        TypeId typeId = this->readTypeId();
+        Variant value = ::deserialize(typeId, *this);
+        // Keys are unique within a well-formed container, so there is no
+        // need to search for an existing entry
+        content.push_back(StorageContainer::Implementation::Entry{
+            key,
+            StoredValue{typeId, std::move(value)}
+        });
+    }
+}
+
+
+uint64_t
+StorageReader::readSize() {
+    if (m_version == LEGACY_FORMAT_VERSION) {
+        return TypeHandler<uint64_t>::deserialize(*this);
+    }
+    return this->readVarint();
+}
+
+
+TypeId
+StorageReader::readTypeId() {
+    if (m_version == LEGACY_FORMAT_VERSION) {
+        return TypeHandler<TypeId>::deserialize(*this);
+    }
+    return this->readVarint();
+}
+
+
 std::ostream&
 thrive::operator << (
     std::ostream& stream,
     const StorageContainer& storage
 ) {
-    SerializationVisitor visitor(stream);
-    const auto& content = storage.m_impl->m_content;
-    TypeHandler<uint64_t>::serialize(stream, content.size());
-    for (const auto& pair : content) {
-        TypeHandler<std::string>::serialize(stream, pair.first);    
-        TypeHandler<TypeId>::serialize(stream, pair.second.typeId);    
-        boost::apply_visitor(visitor, pair.second.value);
-    }
+    writeHeader(stream);
+    StorageWriter writer(stream);
+    writer.writeContainer(storage);
     return stream;
 }
 
@@ -978,20 +2401,201 @@ thrive::operator >> (
     std::istream& stream,
     StorageContainer& storage
 ) {
-    uint64_t size = TypeHandler<uint64_t>::deserialize(stream);
-    storage.m_impl->m_content.clear();
-    for (size_t i = 0; i < size; ++i) {
-        std::string key = TypeHandler<std::string>::deserialize(stream);
-        TypeId typeId = TypeHandler<TypeId>::deserialize(stream);
-        storage.m_impl->m_content[key] = StoredValue {
-            typeId,
-            deserialize(typeId, stream)
-        };
+    char header[sizeof(FORMAT_MAGIC) + 1];
+    if (not stream.read(header, sizeof(header))) {
+        throw std::runtime_error("Corrupt savegame: header missing");
+    }
+    if (std::memcmp(header, FORMAT_MAGIC, sizeof(FORMAT_MAGIC)) == 0) {
+        uint8_t version = header[sizeof(FORMAT_MAGIC)];
+        if (version > FORMAT_VERSION) {
+            throw std::runtime_error("Savegame was written by a newer version of Thrive");
+        }
+        StorageReader reader(stream, version);
+        reader.readContainer(storage, reader.readSize());
+    }
+    else {
+        // Legacy format, the header is the outer container's entry count
+        static_assert(sizeof(header) == sizeof(uint64_t), "Header must overlay legacy size");
+        uint64_t size = 0;
+        std::memcpy(&size, header, sizeof(size));
+        StorageReader reader(stream, LEGACY_FORMAT_VERSION);
+        reader.readContainer(storage, size);
     }
     return stream;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// StorageStreamWriter
+////////////////////////////////////////////////////////////////////////////////
+
+struct StorageStreamWriter::Implementation {
+
+    struct Scope {
+        bool isList;
+        uint64_t remaining;
+    };
+
+    Implementation(
+        std::ostream& stream
+    ) : m_writer(stream)
+    {
+    }
+
+    /**
+    * @brief Accounts for an entry and writes its key and type
+    */
+    void
+    beginEntry(
+        const std::string& key,
+        TypeId typeId
+    ) {
+        this->consume(false);
+        m_writer.writeKey(KeyRegistry::intern(key));
+        m_writer.writeVarint(typeId);
+    }
+
+    void
+    consume(
+        bool isList
+    ) {
+        if (m_scopes.empty() or m_scopes.back().isList != isList) {
+            throw std::logic_error(
+                isList ? "Not inside a storage list" : "Not inside a storage container"
+            );
+        }
+        if (m_scopes.back().remaining == 0) {
+            throw std::logic_error("More entries written than announced");
+        }
+        m_scopes.back().remaining -= 1;
+    }
+
+    void
+    open(
+        bool isList,
+        uint64_t size
+    ) {
+        m_writer.writeVarint(size);
+        m_scopes.push_back(Scope{isList, size});
+    }
+
+    bool m_hasRoot = false;
+
+    std::vector<Scope> m_scopes;
+
+    StorageWriter m_writer;
+
+};
+
+
+StorageStreamWriter::StorageStreamWriter(
+    std::ostream& stream
+) : m_impl(new Implementation(stream))
+{
+    writeHeader(stream);
+}
+
+
+StorageStreamWriter::~StorageStreamWriter() {}
+
+
+void
+StorageStreamWriter::beginContainer(
+    size_t size
+) {
+    if (not m_impl->m_hasRoot) {
+        m_impl->m_hasRoot = true;
+    }
+    else {
+        m_impl->consume(true);
+    }
+    m_impl->open(false, size);
+}
+
+
+void
+StorageStreamWriter::beginContainer(
+    const std::string& key,
+    size_t size
+) {
+    m_impl->beginEntry(key, TypeInfo<StorageContainer>::Id);
+    m_impl->open(false, size);
+}
+
+
+void
+StorageStreamWriter::beginList(
+    const std::string& key,
+    size_t size
+) {
+    m_impl->beginEntry(key, TypeInfo<StorageList>::Id);
+    m_impl->open(true, size);
+}
+
+
+void
+StorageStreamWriter::end() {
+    if (m_impl->m_scopes.empty()) {
+        throw std::logic_error("No open container or list");
+    }
+    if (m_impl->m_scopes.back().remaining > 0) {
+        throw std::logic_error("Fewer entries written than announced");
+    }
+    m_impl->m_scopes.pop_back();
+}
+
+
+bool
+StorageStreamWriter::isComplete() const {
+    return m_impl->m_hasRoot and m_impl->m_scopes.empty();
+}
+
+
+void
+StorageStreamWriter::writeElement(
+    const StorageContainer& element
+) {
+    if (not m_impl->m_hasRoot) {
+        throw std::logic_error("Not inside a storage list");
+    }
+    m_impl->consume(true);
+    m_impl->m_writer.writeContainer(element);
+}
 
 
+#define STREAM_WRITE(typeName) \
+    template<> \
+    void \
+    StorageStreamWriter::write<typeName>( \
+        const std::string& key, \
+        const typeName& value \
+    ) { \
+        using Info = TypeInfo<typeName>; \
+        m_impl->beginEntry(key, Info::Id); \
+        TypeHandler<Info::StoredType>::serialize( \
+            m_impl->m_writer, \
+            Info::convertToStoredType(value) \
+        ); \
+    }
 
+STREAM_WRITE(bool)
+STREAM_WRITE(char)
+STREAM_WRITE(int8_t)
+STREAM_WRITE(int16_t)
+STREAM_WRITE(int32_t)
+STREAM_WRITE(int64_t)
+STREAM_WRITE(uint8_t)
+STREAM_WRITE(uint16_t)
+STREAM_WRITE(uint32_t)
+STREAM_WRITE(uint64_t)
+STREAM_WRITE(float)
+STREAM_WRITE(double)
+STREAM_WRITE(std::string)
+STREAM_WRITE(StorageContainer)
+STREAM_WRITE(StorageList)
+// Compound types
+STREAM_WRITE(Ogre::Degree)
+STREAM_WRITE(Ogre::Plane)
+STREAM_WRITE(Ogre::Vector3)
+STREAM_WRITE(Ogre::Quaternion)
+STREAM_WRITE(Ogre::ColourValue)
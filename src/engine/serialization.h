@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine/storage_arena.h"
 #include "scripting/luabind.h"
 
 #include <cstdint>
@@ -32,6 +33,13 @@ namespace thrive {
 
 /**
 * @brief A key-value storage for serialization
+*
+* Entries are kept in a flat array in insertion order. Containers are
+* small, so a linear search over interned keys beats hashing.
+*
+* The entries are allocated from the current StorageArena (if any), see
+* StorageArena::Scope. A default-constructed container allocates nothing
+* until the first value is set.
 */
 class StorageContainer {
 
@@ -43,6 +51,9 @@ public:
     * - StorageContainer::contains
     * - StorageContainer::get
     * - StorageContainer::set
+    * - StorageContainer::luaFromTable (as fromTable)
+    * - StorageContainer::luaToTable (as toTable)
+    * - StorageContainer::luaView (as view)
     *
     */
     static luabind::scope
@@ -66,10 +77,11 @@ public:
     * @brief Move-constructor
     *
     * @param other
+    *   Left empty
     */
     StorageContainer(
         StorageContainer&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Destructor
@@ -91,12 +103,36 @@ public:
     * @brief Move assignment
     *
     * @param other
+    *   Left empty
     *
     */
     StorageContainer&
     operator = (
         StorageContainer&& other
-    );
+    ) noexcept;
+
+    /**
+    * @brief Compares keys, their order and values
+    *
+    * Unlike comparing fingerprints, this never mistakes different content
+    * for equal.
+    *
+    * @param other
+    */
+    bool
+    operator == (
+        const StorageContainer& other
+    ) const;
+
+    /**
+    * @brief Negation of operator ==
+    *
+    * @param other
+    */
+    bool
+    operator != (
+        const StorageContainer& other
+    ) const;
 
     /**
     * @brief Checks for a key
@@ -129,6 +165,25 @@ public:
         const std::string& key
     ) const;
 
+    /**
+    * @brief Retrieves a value from the container without copying it
+    *
+    * @tparam T
+    *   The value's type, StorageContainer or StorageList
+    * @param key
+    *   The key to retrieve
+    *
+    * @return 
+    *   The value associated with \a key, or \c nullptr if the key could
+    *   not be found or has a value that is not \a T. Valid until the
+    *   container is modified.
+    */
+    template<typename T>
+    const T*
+    find(
+        const std::string& key
+    ) const;
+
     /**
     * @brief Retrieves a value from the container
     *
@@ -151,6 +206,14 @@ public:
         const T& defaultValue = T()
     ) const;
 
+    /**
+    * @brief Hashes the serialized form of this container (FNV-1a)
+    *
+    * Containers with equal content have equal fingerprints.
+    */
+    uint64_t
+    fingerprint() const;
+
     /**
     * @brief Returns a list of all keys in this container
     *
@@ -172,6 +235,67 @@ public:
         luabind::object defaultValue
     ) const;
 
+    /**
+    * @brief Sets all fields of a Lua table in one call
+    *
+    * The table is converted natively, without a call through the bindings
+    * per field. Supported values are:
+    * - booleans, numbers (stored as \c double) and strings
+    * - userdata of the types that set() accepts from Lua
+    * - tables: a sequence of tables or an empty table becomes a
+    *   StorageList, any other table a StorageContainer. Sequences may also
+    *   hold StorageContainer userdata.
+    *
+    * Keys that aren't strings are converted to strings.
+    *
+    * @param table
+    *   The table to convert
+    *
+    * @throws std::invalid_argument if a value can't be stored
+    */
+    void
+    luaFromTable(
+        const luabind::object& table
+    );
+
+    /**
+    * @brief Converts this container into a Lua table in one call
+    *
+    * The counterpart of luaFromTable(). Numbers of any type become Lua
+    * numbers, lists become sequences of tables.
+    *
+    * @param L
+    *   The Lua state to create the table in
+    *
+    * @return 
+    */
+    luabind::object
+    luaToTable(
+        lua_State* L
+    ) const;
+
+    /**
+    * @brief Wraps this container in a Lua table that converts lazily
+    *
+    * Reading a field of the view converts just that field and caches it.
+    * Nested containers and lists are views as well. Prefer this over
+    * luaToTable() when only part of the content is read.
+    *
+    * The view shares this container's content instead of copying it.
+    * Changing the container afterwards gives the container its own copy,
+    * so later changes don't show in the view. Views are read-only,
+    * assigning to a field raises an error.
+    *
+    * @param L
+    *   The Lua state to create the view in
+    *
+    * @return 
+    */
+    luabind::object
+    luaView(
+        lua_State* L
+    ) const;
+
     /**
     * @brief Sets a value in this container
     *
@@ -191,6 +315,27 @@ public:
         T value
     );
 
+    /**
+    * @brief Moves a value out of the container
+    *
+    * Unlike get(), this doesn't copy the value, which makes it the cheaper
+    * way to read big subtrees only needed once. The key is removed.
+    *
+    * @tparam T
+    *   The value's type, StorageContainer or StorageList
+    * @param key
+    *   The key to take
+    *
+    * @return 
+    *   The value associated with \a key, or an empty \a T if the key
+    *   could not be found or has a value that is not \a T
+    */
+    template<typename T>
+    T
+    take(
+        const std::string& key
+    );
+
     friend std::ostream& 
     operator << (
         std::ostream& stream,
@@ -205,13 +350,54 @@ public:
 
 private:
 
+    friend class LuaStorageView;
+
+    friend class StorageList;
+
+    friend class StorageReader;
+
+    friend class StorageWriter;
+
     struct Implementation;
-    std::unique_ptr<Implementation> m_impl;
+
+    struct ImplementationDeleter {
+
+        void
+        operator() (
+            Implementation* impl
+        ) const;
+
+    };
+
+    /**
+    * @brief The content, for changing it
+    *
+    * Copies the content first if a Lua view shares it.
+    */
+    Implementation&
+    impl();
+
+    void
+    pushTable(
+        lua_State* L
+    ) const;
+
+    /**
+    * @brief A container that shares this one's content, see luaView()
+    */
+    StorageContainer
+    shareContent() const;
+
+    std::unique_ptr<Implementation, ImplementationDeleter> m_impl;
 };
 
 /**
 * @brief Output stream operator for StorageContainer
 *
+* Writes a self-contained document: a format header followed by the
+* container. Each key string is written only once per document, later
+* occurrences refer to it by a small id.
+*
 * @param stream
 * @param storage
 *
@@ -226,6 +412,9 @@ operator << (
 /**
 * @brief Input stream operator for StorageContainer
 *
+* Reads documents written by operator<<(std::ostream&, const StorageContainer&)
+* as well as savegames from before the format header was introduced.
+*
 * @param stream
 * @param storage
 *
@@ -240,8 +429,10 @@ operator >> (
 
 /**
 * @brief A list of StorageContainers
+*
+* Allocates from the current StorageArena, if any.
 */
-class StorageList : public std::vector<StorageContainer> {
+class StorageList : public std::vector<StorageContainer, StorageAllocator<StorageContainer>> {
 
 public:
 
@@ -251,6 +442,8 @@ public:
     * - StorageList::append
     * - StorageList::get
     * - StorageList::size
+    * - StorageList::luaToTable (as toTable)
+    * - StorageList::luaView (as view)
     *
     * @return 
     */
@@ -278,7 +471,7 @@ public:
     */
     StorageList(
         StorageList&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Copy assignment
@@ -300,7 +493,7 @@ public:
     StorageList&
     operator = (
         StorageList&& other
-    );
+    ) noexcept;
 
     /**
     * @brief Appends a StorageContainer to this list
@@ -328,6 +521,188 @@ public:
         size_t index
     );
 
+    /**
+    * @brief Converts this list into a sequence of Lua tables in one call
+    *
+    * @param L
+    *   The Lua state to create the table in
+    *
+    * @return 
+    *
+    * @see StorageContainer::luaToTable()
+    */
+    luabind::object
+    luaToTable(
+        lua_State* L
+    ) const;
+
+    /**
+    * @brief Wraps this list in a Lua table that converts lazily
+    *
+    * Supports indexing from 1 and the length operator.
+    *
+    * @param L
+    *   The Lua state to create the view in
+    *
+    * @return 
+    *
+    * @see StorageContainer::luaView()
+    */
+    luabind::object
+    luaView(
+        lua_State* L
+    ) const;
+
+private:
+
+    friend class StorageContainer;
+
+    void
+    pushTable(
+        lua_State* L
+    ) const;
+
+};
+
+/**
+* @brief Writes a document piece by piece
+*
+* Produces the same format as operator<<(std::ostream&, const StorageContainer&),
+* but never holds more than one entry in memory. Every container and list
+* is opened with its number of entries, which must be known up front, and
+* closed with end() once all entries have been written.
+*
+* Usage:
+* \code
+* StorageStreamWriter writer(stream);
+* writer.beginContainer(2);
+* writer.write<int32_t>("answer", 42);
+* writer.beginList("items", items.size());
+* for (const auto& item : items) {
+*     writer.writeElement(item.storage());
+* }
+* writer.end(); // items
+* writer.end(); // root
+* \endcode
+*/
+class StorageStreamWriter {
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * Writes the format header.
+    *
+    * @param stream
+    *   The stream to write to. Should be buffered.
+    */
+    StorageStreamWriter(
+        std::ostream& stream
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~StorageStreamWriter();
+
+    /**
+    * @brief Opens the root container or a container element of a list
+    *
+    * @param size
+    *   The number of entries the container will have
+    *
+    * @throws std::logic_error if no list element or root is expected
+    */
+    void
+    beginContainer(
+        size_t size
+    );
+
+    /**
+    * @brief Opens a container entry in the current container
+    *
+    * @param key
+    *   The entry's key
+    * @param size
+    *   The number of entries the nested container will have
+    *
+    * @throws std::logic_error if the current scope is not a container
+    */
+    void
+    beginContainer(
+        const std::string& key,
+        size_t size
+    );
+
+    /**
+    * @brief Opens a list entry in the current container
+    *
+    * @param key
+    *   The entry's key
+    * @param size
+    *   The number of elements the list will have
+    *
+    * @throws std::logic_error if the current scope is not a container
+    */
+    void
+    beginList(
+        const std::string& key,
+        size_t size
+    );
+
+    /**
+    * @brief Closes the innermost open container or list
+    *
+    * @throws std::logic_error if fewer entries have been written than
+    * announced
+    */
+    void
+    end();
+
+    /**
+    * @brief Whether the root container has been closed
+    */
+    bool
+    isComplete() const;
+
+    /**
+    * @brief Writes an entry into the current container
+    *
+    * @tparam T
+    *   A storable type
+    * @param key
+    *   The entry's key
+    * @param value
+    *   The entry's value
+    *
+    * @throws std::logic_error if the current scope is not a container
+    */
+    template<typename T>
+    void
+    write(
+        const std::string& key,
+        const T& value
+    );
+
+    /**
+    * @brief Writes a complete element into the current list
+    *
+    * @param element
+    *   The element
+    *
+    * @throws std::logic_error if the current scope is not a list
+    */
+    void
+    writeElement(
+        const StorageContainer& element
+    );
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
 };
 
 /**
@@ -356,6 +731,13 @@ public:
     StorageContainer::set<typeName>( \
         const std::string& key, \
         typeName value \
+    ); \
+    \
+    template<> \
+    void \
+    StorageStreamWriter::write<typeName>( \
+        const std::string& key, \
+        const typeName& value \
     );
 
 // Native types
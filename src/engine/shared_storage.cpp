@@ -0,0 +1,226 @@
+#include "engine/shared_storage.h"
+
+#include "engine/storage_arena.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace thrive;
+
+static thread_local SharedStorageTable* CurrentTable = nullptr;
+
+const std::string SharedStorageTable::REFERENCE_KEY = "sharedStorage";
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SharedStorageTable::Scope
+////////////////////////////////////////////////////////////////////////////////
+
+SharedStorageTable::Scope::Scope(
+    SharedStorageTable* table
+) : m_previous(CurrentTable),
+    m_table(table)
+{
+    CurrentTable = m_table;
+}
+
+
+SharedStorageTable::Scope::~Scope() {
+    assert(CurrentTable == m_table && "Shared storage scopes must be nested");
+    CurrentTable = m_previous;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SharedStorageTable
+////////////////////////////////////////////////////////////////////////////////
+
+struct SharedStorageTable::Implementation {
+
+    std::map<uint64_t, StorageContainer> m_entries;
+
+    std::mutex m_mutex;
+
+    std::unordered_map<uint64_t, std::shared_ptr<void>> m_objects;
+
+};
+
+
+void
+SharedStorageTable::collectReferences(
+    const StorageContainer& storage,
+    std::vector<uint64_t>& ids
+) {
+    // Subtrees are visited in place, copying them would cost depth times
+    // their size
+    for (const std::string& key : storage.keys()) {
+        if (key == REFERENCE_KEY and storage.contains<uint64_t>(key)) {
+            ids.push_back(storage.get<uint64_t>(key));
+        }
+        else if (const StorageContainer* child = storage.find<StorageContainer>(key)) {
+            collectReferences(*child, ids);
+        }
+        else if (const StorageList* list = storage.find<StorageList>(key)) {
+            for (const StorageContainer& element : *list) {
+                collectReferences(element, ids);
+            }
+        }
+    }
+}
+
+
+SharedStorageTable*
+SharedStorageTable::current() {
+    return CurrentTable;
+}
+
+
+StorageContainer
+SharedStorageTable::resolve(
+    const StorageContainer& storage
+) {
+    if (not storage.contains<uint64_t>(REFERENCE_KEY)) {
+        return storage;
+    }
+    if (not CurrentTable) {
+        throw std::out_of_range("No shared storage table to resolve reference");
+    }
+    return CurrentTable->get(storage.get<uint64_t>(REFERENCE_KEY));
+}
+
+
+StorageContainer
+SharedStorageTable::share(
+    const StorageContainer& storage
+) {
+    if (not CurrentTable) {
+        return storage;
+    }
+    StorageContainer reference;
+    reference.set<uint64_t>(REFERENCE_KEY, CurrentTable->add(storage));
+    return reference;
+}
+
+
+SharedStorageTable::SharedStorageTable()
+  : m_impl(new Implementation())
+{
+}
+
+
+SharedStorageTable::SharedStorageTable(
+    const StorageList& entries
+) : SharedStorageTable()
+{
+    // Entries outlive the arena they were loaded into
+    StorageArena::Scope arenaScope(nullptr);
+    for (const StorageContainer& entry : entries) {
+        m_impl->m_entries.emplace(
+            entry.get<uint64_t>("id"),
+            entry.get<StorageContainer>("storage")
+        );
+    }
+}
+
+
+SharedStorageTable::~SharedStorageTable() {}
+
+
+uint64_t
+SharedStorageTable::add(
+    const StorageContainer& storage
+) {
+    // Ids start at the content hash. A different tree with the same hash
+    // moves on to the next free id, so trees never share an id by mistake.
+    uint64_t id = storage.fingerprint();
+    std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+    while (true) {
+        auto iter = m_impl->m_entries.find(id);
+        if (iter == m_impl->m_entries.end()) {
+            // The caller's arena may be released before the table
+            StorageArena::Scope arenaScope(nullptr);
+            m_impl->m_entries.emplace(id, StorageContainer(storage));
+            return id;
+        }
+        if (iter->second == storage) {
+            return id;
+        }
+        ++id;
+    }
+}
+
+
+std::shared_ptr<void>&
+SharedStorageTable::cachedObject(
+    uint64_t id
+) {
+    return m_impl->m_objects[id];
+}
+
+
+bool
+SharedStorageTable::empty() const {
+    return m_impl->m_entries.empty();
+}
+
+
+StorageContainer
+SharedStorageTable::get(
+    uint64_t id
+) const {
+    auto iter = m_impl->m_entries.find(id);
+    if (iter == m_impl->m_entries.end()) {
+        throw std::out_of_range("Unknown shared storage: " + boost::lexical_cast<std::string>(id));
+    }
+    return iter->second;
+}
+
+
+StorageList
+SharedStorageTable::storage() const {
+    StorageList entries;
+    entries.reserve(m_impl->m_entries.size());
+    for (const auto& item : m_impl->m_entries) {
+        StorageContainer entry;
+        entry.set<uint64_t>("id", item.first);
+        entry.set("storage", item.second);
+        entries.append(std::move(entry));
+    }
+    return entries;
+}
+
+
+StorageList
+SharedStorageTable::storage(
+    const StorageContainer& root
+) const {
+    std::vector<uint64_t> pending;
+    collectReferences(root, pending);
+    std::map<uint64_t, const StorageContainer*> referenced;
+    while (not pending.empty()) {
+        uint64_t id = pending.back();
+        pending.pop_back();
+        if (referenced.count(id)) {
+            continue;
+        }
+        auto iter = m_impl->m_entries.find(id);
+        if (iter == m_impl->m_entries.end()) {
+            continue;
+        }
+        referenced.emplace(id, &iter->second);
+        collectReferences(iter->second, pending);
+    }
+    StorageList entries;
+    entries.reserve(referenced.size());
+    for (const auto& item : referenced) {
+        StorageContainer entry;
+        entry.set<uint64_t>("id", item.first);
+        entry.set("storage", *item.second);
+        entries.append(std::move(entry));
+    }
+    return entries;
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "engine/serialization.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief Deduplicates storage trees that many components have in common
+*
+* While a table is current, components can share() parts of their storage,
+* for example collision shapes. Each distinct tree is stored once in the
+* table and replaced by a small reference. Identical trees get the same
+* reference. Ids are derived from the content (see
+* StorageContainer::fingerprint()), so they don't depend on the order in
+* which components are serialized. Trees are compared in full before an
+* id is reused. In the unlikely case that two different trees have the
+* same fingerprint, the later one gets the next free id.
+*
+* When loading, the table built from the savegame is made current again,
+* so components can resolve() their references and share the objects
+* built from them (see object()).
+*
+* Usage:
+* \code
+* SharedStorageTable table;
+* SharedStorageTable::Scope scope(&table);
+* // Components stored on this thread until the scope is left share
+* // their trees through the table
+* \endcode
+*/
+class SharedStorageTable {
+
+public:
+
+    /**
+    * @brief The key under which references store the id
+    */
+    static const std::string REFERENCE_KEY;
+
+    /**
+    * @brief Makes a table the current one of this thread while in scope
+    *
+    * Scopes can be nested. Leaving a scope restores the previous table.
+    */
+    class Scope {
+
+    public:
+
+        /**
+        * @brief Constructor
+        *
+        * @param table
+        *   The table to make current. May be \c nullptr to store trees
+        *   inline while in this scope. Must outlive the scope.
+        */
+        Scope(
+            SharedStorageTable* table
+        );
+
+        /**
+        * @brief Non-copyable
+        */
+        Scope(const Scope& other) = delete;
+
+        /**
+        * @brief Destructor
+        */
+        ~Scope();
+
+    private:
+
+        SharedStorageTable* m_previous = nullptr;
+
+        SharedStorageTable* m_table = nullptr;
+
+    };
+
+    /**
+    * @brief Collects the ids referenced anywhere in a storage tree
+    *
+    * @param storage
+    *   The tree to search
+    * @param[out] ids
+    *   Receives the ids
+    */
+    static void
+    collectReferences(
+        const StorageContainer& storage,
+        std::vector<uint64_t>& ids
+    );
+
+    /**
+    * @brief The table of the innermost active Scope on this thread
+    *
+    * @return
+    *   The current table or \c nullptr
+    */
+    static SharedStorageTable*
+    current();
+
+    /**
+    * @brief Returns the tree a reference refers to
+    *
+    * @param storage
+    *   A reference, as returned by share(), or a tree stored inline
+    *
+    * @return
+    *   The referenced tree from the current table, or \a storage itself if
+    *   it isn't a reference
+    *
+    * @throws std::out_of_range if the reference can't be resolved
+    */
+    static StorageContainer
+    resolve(
+        const StorageContainer& storage
+    );
+
+    /**
+    * @brief Adds a tree to the current table
+    *
+    * @param storage
+    *   The tree to share
+    *
+    * @return
+    *   A reference to the tree, or \a storage itself if there is no
+    *   current table
+    */
+    static StorageContainer
+    share(
+        const StorageContainer& storage
+    );
+
+    /**
+    * @brief Constructor
+    */
+    SharedStorageTable();
+
+    /**
+    * @brief Constructs a table from its storage
+    *
+    * @param entries
+    *   As returned by storage()
+    */
+    SharedStorageTable(
+        const StorageList& entries
+    );
+
+    /**
+    * @brief Non-copyable
+    */
+    SharedStorageTable(const SharedStorageTable& other) = delete;
+
+    /**
+    * @brief Destructor
+    */
+    ~SharedStorageTable();
+
+    /**
+    * @brief Adds a tree
+    *
+    * Thread safe.
+    *
+    * @param storage
+    *   The tree to add
+    *
+    * @return
+    *   The tree's id
+    */
+    uint64_t
+    add(
+        const StorageContainer& storage
+    );
+
+    /**
+    * @brief Whether the table is empty
+    */
+    bool
+    empty() const;
+
+    /**
+    * @brief Returns a tree
+    *
+    * @param id
+    *   The tree's id
+    *
+    * @throws std::out_of_range if there is no such tree
+    */
+    StorageContainer
+    get(
+        uint64_t id
+    ) const;
+
+    /**
+    * @brief Returns the object built from a tree, building it if necessary
+    *
+    * Lets everything that refers to the same tree share one object. Only
+    * use this for objects that are never modified.
+    *
+    * @tparam T
+    *   The object's class
+    * @param id
+    *   The tree's id
+    * @param load
+    *   Builds the object from the tree, called at most once per id
+    */
+    template<typename T>
+    std::shared_ptr<T>
+    object(
+        uint64_t id,
+        const std::function<std::shared_ptr<T>(const StorageContainer&)>& load
+    ) {
+        std::shared_ptr<void>& object = this->cachedObject(id);
+        if (not object) {
+            object = load(this->get(id));
+        }
+        return std::static_pointer_cast<T>(object);
+    }
+
+    /**
+    * @brief Serializes the table
+    *
+    * @return
+    *   A list of id / tree pairs, sorted by id
+    */
+    StorageList
+    storage() const;
+
+    /**
+    * @brief Serializes the part of the table a tree refers to
+    *
+    * Includes trees that are only referenced by other shared trees.
+    *
+    * @param root
+    *   The tree whose references to follow
+    *
+    * @return
+    *   Same as storage(), but restricted to the referenced trees
+    */
+    StorageList
+    storage(
+        const StorageContainer& root
+    ) const;
+
+private:
+
+    std::shared_ptr<void>&
+    cachedObject(
+        uint64_t id
+    );
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+
+};
+
+}
@@ -0,0 +1,173 @@
+#include "engine/snapshot_system.h"
+
+#include "engine/engine.h"
+#include "engine/entity_manager.h"
+#include "engine/serialization.h"
+#include "engine/storage_arena.h"
+#include "scripting/luabind.h"
+
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace thrive;
+
+struct SnapshotSystem::Implementation {
+
+    void
+    dropExcess() {
+        while (m_snapshots.size() > m_capacity) {
+            m_snapshots.pop_front();
+        }
+    }
+
+    size_t m_capacity = 8;
+
+    bool m_captureRequested = false;
+
+    BlockCompression::Codec m_codec = BlockCompression::None;
+
+    bool m_restoreRequested = false;
+
+    unsigned int m_restoreAge = 0;
+
+    // Oldest first
+    std::deque<std::string> m_snapshots;
+
+};
+
+
+luabind::scope
+SnapshotSystem::luaBindings() {
+    using namespace luabind;
+    return class_<SnapshotSystem, System>("SnapshotSystem")
+        .def("capture", &SnapshotSystem::capture)
+        .def("clear", &SnapshotSystem::clear)
+        .def("restore", &SnapshotSystem::restore)
+        .def("setCapacity", &SnapshotSystem::setCapacity)
+        .def("setCompression", &SnapshotSystem::setCompression)
+        .property("count", &SnapshotSystem::count)
+        .property("memoryUsage", &SnapshotSystem::memoryUsage)
+    ;
+}
+
+
+SnapshotSystem::SnapshotSystem()
+  : m_impl(new Implementation())
+{
+}
+
+
+SnapshotSystem::~SnapshotSystem() {}
+
+
+void
+SnapshotSystem::capture() {
+    m_impl->m_captureRequested = true;
+    this->setActive(true);
+}
+
+
+void
+SnapshotSystem::clear() {
+    m_impl->m_snapshots.clear();
+}
+
+
+size_t
+SnapshotSystem::count() const {
+    return m_impl->m_snapshots.size();
+}
+
+
+size_t
+SnapshotSystem::memoryUsage() const {
+    size_t total = 0;
+    for (const std::string& snapshot : m_impl->m_snapshots) {
+        total += snapshot.size();
+    }
+    return total;
+}
+
+
+void
+SnapshotSystem::restore(
+    unsigned int age
+) {
+    m_impl->m_restoreRequested = true;
+    m_impl->m_restoreAge = age;
+    this->setActive(true);
+}
+
+
+void
+SnapshotSystem::setCapacity(
+    size_t capacity
+) {
+    m_impl->m_capacity = capacity;
+    m_impl->dropExcess();
+}
+
+
+void
+SnapshotSystem::setCompression(
+    BlockCompression::Codec codec
+) {
+    m_impl->m_codec = codec;
+}
+
+
+void
+SnapshotSystem::shutdown() {
+    m_impl->m_snapshots.clear();
+    System::shutdown();
+}
+
+
+void
+SnapshotSystem::update(int) {
+    EntityManager& entityManager = this->engine()->entityManager();
+    const ComponentFactory& factory = this->engine()->componentFactory();
+    if (m_impl->m_captureRequested and m_impl->m_capacity > 0) {
+        // The storage tree only lives until it is serialized
+        StorageArena::Scope arenaScope(StorageArena::create());
+        std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+        stream << entityManager.storage(factory);
+        std::string snapshot = stream.str();
+        if (m_impl->m_codec != BlockCompression::None) {
+            snapshot = BlockCompression::compress(
+                snapshot.data(),
+                snapshot.size(),
+                m_impl->m_codec
+            );
+        }
+        m_impl->m_snapshots.push_back(std::move(snapshot));
+        m_impl->dropExcess();
+    }
+    m_impl->m_captureRequested = false;
+    if (m_impl->m_restoreRequested) {
+        m_impl->m_restoreRequested = false;
+        if (m_impl->m_restoreAge < m_impl->m_snapshots.size()) {
+            const std::string& snapshot = m_impl->m_snapshots[
+                m_impl->m_snapshots.size() - 1 - m_impl->m_restoreAge
+            ];
+            StorageContainer storage;
+            {
+                StorageArena::Scope arenaScope(StorageArena::create());
+                std::istringstream stream(
+                    BlockCompression::isCompressed(snapshot.data(), snapshot.size()) ?
+                        BlockCompression::decompress(snapshot.data(), snapshot.size()) :
+                        snapshot,
+                    std::ios_base::in | std::ios_base::binary
+                );
+                stream >> storage;
+            }
+            entityManager.patch(storage, factory);
+        }
+        else {
+            std::cerr << "No snapshot to restore: " << m_impl->m_restoreAge << std::endl;
+        }
+    }
+    this->setActive(false);
+}
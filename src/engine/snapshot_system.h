@@ -0,0 +1,137 @@
+#pragma once
+
+#include "engine/block_compression.h"
+#include "engine/system.h"
+
+#include <memory>
+
+namespace thrive {
+
+/**
+* @brief Keeps recent snapshots of the world in memory
+*
+* A snapshot holds everything a savegame would, serialized into a single
+* buffer. Snapshots are kept in a ring, the oldest one is dropped when a
+* new one doesn't fit anymore.
+*
+* Restoring a snapshot patches the entity manager instead of rebuilding
+* it (see EntityManager::patch()). Components that haven't changed since
+* the snapshot are left alone, so their scene nodes and rigid bodies
+* survive. This makes quickloading, rewinding while debugging and
+* rolling back the simulation in tests nearly instant.
+*
+* Snapshots are taken and restored at the end of the frame they were
+* requested in.
+*/
+class SnapshotSystem : public System {
+
+public:
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - SnapshotSystem::capture()
+    * - SnapshotSystem::clear()
+    * - SnapshotSystem::restore()
+    * - SnapshotSystem::setCapacity()
+    * - SnapshotSystem::setCompression()
+    * - SnapshotSystem::count() (as property)
+    * - SnapshotSystem::memoryUsage() (as property)
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    */
+    SnapshotSystem();
+
+    /**
+    * @brief Destructor
+    */
+    ~SnapshotSystem();
+
+    /**
+    * @brief Takes a snapshot at the end of this frame
+    */
+    void
+    capture();
+
+    /**
+    * @brief Removes all snapshots
+    */
+    void
+    clear();
+
+    /**
+    * @brief The number of snapshots held
+    */
+    size_t
+    count() const;
+
+    /**
+    * @brief The total size of all snapshots in bytes
+    */
+    size_t
+    memoryUsage() const;
+
+    /**
+    * @brief Restores a snapshot at the end of this frame
+    *
+    * Snapshots taken earlier in the same frame are taken first. The
+    * snapshot stays in the ring.
+    *
+    * @param age
+    *   Which snapshot to restore, 0 is the most recent one
+    */
+    void
+    restore(
+        unsigned int age = 0
+    );
+
+    /**
+    * @brief Sets how many snapshots are kept
+    *
+    * Drops the oldest snapshots if there are too many.
+    *
+    * @param capacity
+    *   The maximum number of snapshots. Defaults to 8.
+    */
+    void
+    setCapacity(
+        size_t capacity
+    );
+
+    /**
+    * @brief Sets the codec used for subsequent snapshots
+    *
+    * @param codec
+    *   Defaults to BlockCompression::None, which is fastest
+    */
+    void
+    setCompression(
+        BlockCompression::Codec codec
+    );
+
+    /**
+    * @brief Drops all snapshots
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief Updates the system
+    */
+    void
+    update(int) override;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+};
+
+}
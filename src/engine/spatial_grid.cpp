@@ -0,0 +1,480 @@
+#include "engine/spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace thrive;
+
+namespace {
+
+using CellKey = uint64_t;
+
+CellKey
+cellKey(
+    int32_t x,
+    int32_t y
+) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+
+int32_t
+cellX(
+    CellKey key
+) {
+    return static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+}
+
+
+int32_t
+cellY(
+    CellKey key
+) {
+    return static_cast<int32_t>(static_cast<uint32_t>(key));
+}
+
+
+struct Point {
+
+    CellKey cell;
+
+    EntityId entityId;
+
+    // Index into the cell's list
+    uint32_t slot;
+
+    float x;
+
+    float y;
+
+};
+
+} // namespace
+
+
+struct SpatialGrid::Implementation {
+
+    Implementation(
+        float cellSize
+    ) {
+        this->setCellSize(cellSize);
+    }
+
+    void
+    addToCell(
+        uint32_t index
+    ) {
+        Point& point = m_points[index];
+        int32_t x = this->cellCoordinate(point.x);
+        int32_t y = this->cellCoordinate(point.y);
+        point.cell = cellKey(x, y);
+        std::vector<uint32_t>& cell = m_cells[point.cell];
+        point.slot = cell.size();
+        cell.push_back(index);
+        if (not m_hasBounds) {
+            m_minX = m_maxX = x;
+            m_minY = m_maxY = y;
+            m_hasBounds = true;
+        }
+        else {
+            m_minX = std::min(m_minX, x);
+            m_maxX = std::max(m_maxX, x);
+            m_minY = std::min(m_minY, y);
+            m_maxY = std::max(m_maxY, y);
+        }
+    }
+
+    int32_t
+    cellCoordinate(
+        float value
+    ) const {
+        // Clamped, so that infinite query ranges don't overflow
+        const float limit = 1e9f;
+        float cell = std::floor(value * m_inverseCellSize);
+        return static_cast<int32_t>(std::max(-limit, std::min(limit, cell)));
+    }
+
+    /**
+    * @brief Calls \a visitor with the index of each point in a block of cells
+    *
+    * Walks the occupied cells instead if the block has more cells than
+    * there are occupied ones.
+    */
+    template<typename Visitor>
+    void
+    forEachInCells(
+        int32_t minX,
+        int32_t maxX,
+        int32_t minY,
+        int32_t maxY,
+        Visitor visitor
+    ) const {
+        minX = std::max(minX, m_minX);
+        maxX = std::min(maxX, m_maxX);
+        minY = std::max(minY, m_minY);
+        maxY = std::min(maxY, m_maxY);
+        if (m_points.empty() or minX > maxX or minY > maxY) {
+            return;
+        }
+        uint64_t cellCount =
+            static_cast<uint64_t>(int64_t(maxX) - minX + 1) *
+            static_cast<uint64_t>(int64_t(maxY) - minY + 1);
+        if (cellCount > m_cells.size()) {
+            for (const auto& pair : m_cells) {
+                int32_t x = cellX(pair.first);
+                int32_t y = cellY(pair.first);
+                if (x < minX or x > maxX or y < minY or y > maxY) {
+                    continue;
+                }
+                for (uint32_t index : pair.second) {
+                    visitor(index);
+                }
+            }
+            return;
+        }
+        for (int32_t x = minX; x <= maxX; ++x) {
+            for (int32_t y = minY; y <= maxY; ++y) {
+                this->forEachInCell(x, y, visitor);
+            }
+        }
+    }
+
+    template<typename Visitor>
+    void
+    forEachInCell(
+        int32_t x,
+        int32_t y,
+        Visitor& visitor
+    ) const {
+        auto iter = m_cells.find(cellKey(x, y));
+        if (iter == m_cells.end()) {
+            return;
+        }
+        for (uint32_t index : iter->second) {
+            visitor(index);
+        }
+    }
+
+    void
+    rebuild() {
+        m_cells.clear();
+        m_hasBounds = false;
+        for (uint32_t index = 0; index < m_points.size(); ++index) {
+            this->addToCell(index);
+        }
+    }
+
+    void
+    removeFromCell(
+        uint32_t index
+    ) {
+        const Point& point = m_points[index];
+        auto iter = m_cells.find(point.cell);
+        std::vector<uint32_t>& cell = iter->second;
+        uint32_t last = cell.back();
+        cell[point.slot] = last;
+        m_points[last].slot = point.slot;
+        cell.pop_back();
+        if (cell.empty()) {
+            m_cells.erase(iter);
+        }
+    }
+
+    void
+    setCellSize(
+        float cellSize
+    ) {
+        if (not (cellSize > 0.0f)) {
+            throw std::invalid_argument("Cell size must be positive");
+        }
+        m_cellSize = cellSize;
+        m_inverseCellSize = 1.0f / cellSize;
+    }
+
+    float m_cellSize = 0.0f;
+
+    // Occupied cells only
+    std::unordered_map<CellKey, std::vector<uint32_t>> m_cells;
+
+    bool m_hasBounds = false;
+
+    std::unordered_map<EntityId, uint32_t> m_indices;
+
+    float m_inverseCellSize = 0.0f;
+
+    // Bounds of the cells occupied since the last rebuild, may be too large
+    int32_t m_maxX = 0;
+
+    int32_t m_maxY = 0;
+
+    int32_t m_minX = 0;
+
+    int32_t m_minY = 0;
+
+    std::vector<Point> m_points;
+
+};
+
+
+SpatialGrid::SpatialGrid(
+    float cellSize
+) : m_impl(new Implementation(cellSize))
+{
+}
+
+
+SpatialGrid::~SpatialGrid() {}
+
+
+float
+SpatialGrid::cellSize() const {
+    return m_impl->m_cellSize;
+}
+
+
+void
+SpatialGrid::clear() {
+    m_impl->m_cells.clear();
+    m_impl->m_hasBounds = false;
+    m_impl->m_indices.clear();
+    m_impl->m_points.clear();
+}
+
+
+bool
+SpatialGrid::contains(
+    EntityId entityId
+) const {
+    return m_impl->m_indices.count(entityId) > 0;
+}
+
+
+void
+SpatialGrid::queryBox(
+    const Ogre::Vector3& min,
+    const Ogre::Vector3& max,
+    std::vector<EntityId>& result
+) const {
+    const std::vector<Point>& points = m_impl->m_points;
+    m_impl->forEachInCells(
+        m_impl->cellCoordinate(min.x),
+        m_impl->cellCoordinate(max.x),
+        m_impl->cellCoordinate(min.y),
+        m_impl->cellCoordinate(max.y),
+        [&] (uint32_t index) {
+            const Point& point = points[index];
+            if (
+                point.x >= min.x and point.x <= max.x and
+                point.y >= min.y and point.y <= max.y
+            ) {
+                result.push_back(point.entityId);
+            }
+        }
+    );
+}
+
+
+void
+SpatialGrid::queryNearest(
+    const Ogre::Vector3& center,
+    size_t count,
+    std::vector<EntityId>& result,
+    float maxDistance
+) const {
+    const Implementation& impl = *m_impl;
+    if (count == 0 or impl.m_points.empty() or maxDistance < 0.0f) {
+        return;
+    }
+    using Candidate = std::pair<float, EntityId>;
+    // Largest squared distance on top
+    std::priority_queue<Candidate> candidates;
+    const float maxDistanceSquared = maxDistance * maxDistance;
+    auto visitor = [&] (uint32_t index) {
+        const Point& point = impl.m_points[index];
+        float dx = point.x - center.x;
+        float dy = point.y - center.y;
+        float distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared > maxDistanceSquared) {
+            return;
+        }
+        if (candidates.size() < count) {
+            candidates.emplace(distanceSquared, point.entityId);
+        }
+        else if (distanceSquared < candidates.top().first) {
+            candidates.pop();
+            candidates.emplace(distanceSquared, point.entityId);
+        }
+    };
+    const int32_t centerX = impl.cellCoordinate(center.x);
+    const int32_t centerY = impl.cellCoordinate(center.y);
+    // Distance from the center to the nearest edge of its cell
+    const float localX = center.x - centerX * impl.m_cellSize;
+    const float localY = center.y - centerY * impl.m_cellSize;
+    const float edgeDistance = std::max(0.0f, std::min(
+        std::min(localX, impl.m_cellSize - localX),
+        std::min(localY, impl.m_cellSize - localY)
+    ));
+    // Rings of cells around the center cell, starting at the first one
+    // that touches an occupied cell
+    int64_t ring = std::max<int64_t>({
+        0,
+        int64_t(impl.m_minX) - centerX,
+        int64_t(centerX) - impl.m_maxX,
+        int64_t(impl.m_minY) - centerY,
+        int64_t(centerY) - impl.m_maxY
+    });
+    for (;; ++ring) {
+        if (ring > 0) {
+            // No point in this ring can be closer than this
+            float bound = (ring - 1) * impl.m_cellSize + edgeDistance;
+            if (bound > maxDistance) {
+                break;
+            }
+            if (candidates.size() == count and bound * bound > candidates.top().first) {
+                break;
+            }
+        }
+        const int64_t minX = int64_t(centerX) - ring;
+        const int64_t maxX = int64_t(centerX) + ring;
+        const int64_t minY = int64_t(centerY) - ring;
+        const int64_t maxY = int64_t(centerY) + ring;
+        // Top and bottom rows, clamped to the occupied bounds
+        const int64_t firstX = std::max<int64_t>(minX, impl.m_minX);
+        const int64_t lastX = std::min<int64_t>(maxX, impl.m_maxX);
+        for (int64_t y : {minY, maxY}) {
+            if (y >= impl.m_minY and y <= impl.m_maxY) {
+                for (int64_t x = firstX; x <= lastX; ++x) {
+                    impl.forEachInCell(int32_t(x), int32_t(y), visitor);
+                }
+            }
+            if (ring == 0) {
+                break;
+            }
+        }
+        // Left and right columns without the corners
+        const int64_t firstY = std::max<int64_t>(minY + 1, impl.m_minY);
+        const int64_t lastY = std::min<int64_t>(maxY - 1, impl.m_maxY);
+        for (int64_t x : {minX, maxX}) {
+            if (ring == 0 or x < impl.m_minX or x > impl.m_maxX) {
+                continue;
+            }
+            for (int64_t y = firstY; y <= lastY; ++y) {
+                impl.forEachInCell(int32_t(x), int32_t(y), visitor);
+            }
+        }
+        // Stop once the ring encloses all occupied cells
+        if (
+            minX <= impl.m_minX and maxX >= impl.m_maxX and
+            minY <= impl.m_minY and maxY >= impl.m_maxY
+        ) {
+            break;
+        }
+    }
+    size_t first = result.size();
+    result.resize(first + candidates.size());
+    for (size_t i = result.size(); i > first; --i) {
+        result[i - 1] = candidates.top().second;
+        candidates.pop();
+    }
+}
+
+
+void
+SpatialGrid::queryRadius(
+    const Ogre::Vector3& center,
+    float radius,
+    std::vector<EntityId>& result
+) const {
+    if (radius < 0.0f) {
+        return;
+    }
+    const std::vector<Point>& points = m_impl->m_points;
+    const float radiusSquared = radius * radius;
+    m_impl->forEachInCells(
+        m_impl->cellCoordinate(center.x - radius),
+        m_impl->cellCoordinate(center.x + radius),
+        m_impl->cellCoordinate(center.y - radius),
+        m_impl->cellCoordinate(center.y + radius),
+        [&] (uint32_t index) {
+            const Point& point = points[index];
+            float dx = point.x - center.x;
+            float dy = point.y - center.y;
+            if (dx * dx + dy * dy <= radiusSquared) {
+                result.push_back(point.entityId);
+            }
+        }
+    );
+}
+
+
+void
+SpatialGrid::remove(
+    EntityId entityId
+) {
+    auto iter = m_impl->m_indices.find(entityId);
+    if (iter == m_impl->m_indices.end()) {
+        return;
+    }
+    uint32_t index = iter->second;
+    m_impl->m_indices.erase(iter);
+    m_impl->removeFromCell(index);
+    std::vector<Point>& points = m_impl->m_points;
+    uint32_t last = points.size() - 1;
+    if (index != last) {
+        // Move the last point into the gap
+        points[index] = points[last];
+        const Point& moved = points[index];
+        m_impl->m_cells[moved.cell][moved.slot] = index;
+        m_impl->m_indices[moved.entityId] = index;
+    }
+    points.pop_back();
+}
+
+
+void
+SpatialGrid::setCellSize(
+    float cellSize
+) {
+    m_impl->setCellSize(cellSize);
+    m_impl->rebuild();
+}
+
+
+void
+SpatialGrid::setPosition(
+    EntityId entityId,
+    const Ogre::Vector3& position
+) {
+    auto inserted = m_impl->m_indices.emplace(entityId, m_impl->m_points.size());
+    if (inserted.second) {
+        Point point;
+        point.entityId = entityId;
+        point.x = position.x;
+        point.y = position.y;
+        m_impl->m_points.push_back(point);
+        m_impl->addToCell(inserted.first->second);
+        return;
+    }
+    uint32_t index = inserted.first->second;
+    Point& point = m_impl->m_points[index];
+    point.x = position.x;
+    point.y = position.y;
+    CellKey cell = cellKey(
+        m_impl->cellCoordinate(position.x),
+        m_impl->cellCoordinate(position.y)
+    );
+    if (cell != point.cell) {
+        m_impl->removeFromCell(index);
+        m_impl->addToCell(index);
+    }
+}
+
+
+size_t
+SpatialGrid::size() const {
+    return m_impl->m_points.size();
+}
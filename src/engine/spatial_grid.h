@@ -0,0 +1,167 @@
+#pragma once
+
+#include "engine/typedefs.h"
+
+#include <limits>
+#include <memory>
+#include <OgreVector3.h>
+#include <vector>
+
+namespace thrive {
+
+/**
+* @brief Uniform grid of points in the xy-plane
+*
+* Each entity is a point, the z coordinate is ignored. The plane is
+* divided into square cells, only cells holding points take up memory.
+* Moving a point within its cell is a plain assignment, moving it to
+* another cell is constant time, too.
+*
+* The cell size should be on the order of the typical query radius. Much
+* smaller cells make queries visit many empty cells, much larger ones
+* make them test many points that are too far away.
+*/
+class SpatialGrid {
+
+public:
+
+    /**
+    * @brief Constructor
+    *
+    * @param cellSize
+    *   The edge length of a cell
+    */
+    explicit SpatialGrid(
+        float cellSize = 10.0f
+    );
+
+    /**
+    * @brief Destructor
+    */
+    ~SpatialGrid();
+
+    /**
+    * @brief The edge length of a cell
+    */
+    float
+    cellSize() const;
+
+    /**
+    * @brief Removes all points
+    */
+    void
+    clear();
+
+    /**
+    * @brief Whether an entity is in the grid
+    *
+    * @param entityId
+    */
+    bool
+    contains(
+        EntityId entityId
+    ) const;
+
+    /**
+    * @brief Removes an entity
+    *
+    * Does nothing if the entity is not in the grid.
+    *
+    * @param entityId
+    */
+    void
+    remove(
+        EntityId entityId
+    );
+
+    /**
+    * @brief Finds all entities within an axis aligned box
+    *
+    * @param min
+    *   The lower corner
+    * @param max
+    *   The upper corner
+    * @param result
+    *   The entities found are appended to this, in no particular order
+    */
+    void
+    queryBox(
+        const Ogre::Vector3& min,
+        const Ogre::Vector3& max,
+        std::vector<EntityId>& result
+    ) const;
+
+    /**
+    * @brief Finds the entities nearest to a point
+    *
+    * @param center
+    *   The point to search around
+    * @param count
+    *   The maximum number of entities to find
+    * @param result
+    *   The entities found are appended to this, nearest first
+    * @param maxDistance
+    *   Entities further away than this are ignored
+    */
+    void
+    queryNearest(
+        const Ogre::Vector3& center,
+        size_t count,
+        std::vector<EntityId>& result,
+        float maxDistance = std::numeric_limits<float>::infinity()
+    ) const;
+
+    /**
+    * @brief Finds all entities within a circle
+    *
+    * @param center
+    *   The center of the circle
+    * @param radius
+    *   The radius of the circle
+    * @param result
+    *   The entities found are appended to this, in no particular order
+    */
+    void
+    queryRadius(
+        const Ogre::Vector3& center,
+        float radius,
+        std::vector<EntityId>& result
+    ) const;
+
+    /**
+    * @brief Changes the cell size
+    *
+    * Rebuilds the grid.
+    *
+    * @param cellSize
+    */
+    void
+    setCellSize(
+        float cellSize
+    );
+
+    /**
+    * @brief Adds an entity or moves it if it is in the grid already
+    *
+    * @param entityId
+    * @param position
+    */
+    void
+    setPosition(
+        EntityId entityId,
+        const Ogre::Vector3& position
+    );
+
+    /**
+    * @brief The number of entities in the grid
+    */
+    size_t
+    size() const;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+};
+
+}
@@ -0,0 +1,248 @@
+#include "engine/spatial_index_system.h"
+
+#include "engine/engine.h"
+#include "engine/entity_filter.h"
+#include "engine/spatial_grid.h"
+#include "ogre/scene_node_system.h"
+#include "scripting/luabind.h"
+
+#include <OgreVector3.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+/**
+* @brief Pushes a sequence of entity ids
+*/
+void
+pushEntities(
+    lua_State* L,
+    const std::vector<EntityId>& entities
+) {
+    lua_createtable(L, entities.size(), 0);
+    for (size_t i = 0; i < entities.size(); ++i) {
+        lua_pushnumber(L, static_cast<lua_Number>(entities[i]));
+        lua_rawseti(L, -2, i + 1);
+    }
+}
+
+
+luabind::object
+popObject(
+    lua_State* L
+) {
+    luabind::object object(luabind::from_stack(L, -1));
+    lua_pop(L, 1);
+    return object;
+}
+
+
+/**
+* @brief Runs \a query for each Vector3 in \a centers
+*
+* Pushes a sequence with one result sequence per center.
+*/
+template<typename Query>
+void
+pushBatch(
+    lua_State* L,
+    const luabind::object& centers,
+    Query query
+) {
+    if (luabind::type(centers) != LUA_TTABLE) {
+        throw std::invalid_argument("Expected a sequence of Vector3");
+    }
+    centers.push(L);
+    size_t count = lua_rawlen(L, -1);
+    lua_pop(L, 1);
+    lua_createtable(L, count, 0);
+    std::vector<EntityId> result;
+    for (size_t i = 1; i <= count; ++i) {
+        Ogre::Vector3 center = luabind::object_cast<Ogre::Vector3>(centers[i]);
+        result.clear();
+        query(center, result);
+        pushEntities(L, result);
+        lua_rawseti(L, -2, i);
+    }
+}
+
+} // namespace
+
+
+struct SpatialIndexSystem::Implementation {
+
+    EntityFilter<
+        OgreSceneNodeComponent
+    > m_entities = {true};
+
+    SpatialGrid m_grid;
+
+};
+
+
+luabind::scope
+SpatialIndexSystem::luaBindings() {
+    using namespace luabind;
+    return class_<SpatialIndexSystem, System>("SpatialIndexSystem")
+        .def("queryBox", &SpatialIndexSystem::luaQueryBox)
+        .def("queryNearest", &SpatialIndexSystem::luaQueryNearest)
+        .def("queryNearestBatch", &SpatialIndexSystem::luaQueryNearestBatch)
+        .def("queryRadius", &SpatialIndexSystem::luaQueryRadius)
+        .def("queryRadiusBatch", &SpatialIndexSystem::luaQueryRadiusBatch)
+        .def("setCellSize", &SpatialIndexSystem::setCellSize)
+        .property("size", &SpatialIndexSystem::size)
+    ;
+}
+
+
+SpatialIndexSystem::SpatialIndexSystem()
+  : m_impl(new Implementation())
+{
+}
+
+
+SpatialIndexSystem::~SpatialIndexSystem() {}
+
+
+const SpatialGrid&
+SpatialIndexSystem::grid() const {
+    return m_impl->m_grid;
+}
+
+
+void
+SpatialIndexSystem::init(
+    Engine* engine
+) {
+    System::init(engine);
+    m_impl->m_entities.setEntityManager(&engine->entityManager());
+}
+
+
+luabind::object
+SpatialIndexSystem::luaQueryBox(
+    lua_State* L,
+    const Ogre::Vector3& min,
+    const Ogre::Vector3& max
+) const {
+    std::vector<EntityId> result;
+    m_impl->m_grid.queryBox(min, max, result);
+    pushEntities(L, result);
+    return popObject(L);
+}
+
+
+luabind::object
+SpatialIndexSystem::luaQueryNearest(
+    lua_State* L,
+    const Ogre::Vector3& center,
+    unsigned int count
+) const {
+    std::vector<EntityId> result;
+    m_impl->m_grid.queryNearest(center, count, result);
+    pushEntities(L, result);
+    return popObject(L);
+}
+
+
+luabind::object
+SpatialIndexSystem::luaQueryNearestBatch(
+    lua_State* L,
+    const luabind::object& centers,
+    unsigned int count
+) const {
+    const SpatialGrid& grid = m_impl->m_grid;
+    pushBatch(L, centers,
+        [&grid, count] (const Ogre::Vector3& center, std::vector<EntityId>& result) {
+            grid.queryNearest(center, count, result);
+        }
+    );
+    return popObject(L);
+}
+
+
+luabind::object
+SpatialIndexSystem::luaQueryRadius(
+    lua_State* L,
+    const Ogre::Vector3& center,
+    float radius
+) const {
+    std::vector<EntityId> result;
+    m_impl->m_grid.queryRadius(center, radius, result);
+    pushEntities(L, result);
+    return popObject(L);
+}
+
+
+luabind::object
+SpatialIndexSystem::luaQueryRadiusBatch(
+    lua_State* L,
+    const luabind::object& centers,
+    float radius
+) const {
+    const SpatialGrid& grid = m_impl->m_grid;
+    pushBatch(L, centers,
+        [&grid, radius] (const Ogre::Vector3& center, std::vector<EntityId>& result) {
+            grid.queryRadius(center, radius, result);
+        }
+    );
+    return popObject(L);
+}
+
+
+void
+SpatialIndexSystem::setCellSize(
+    float cellSize
+) {
+    m_impl->m_grid.setCellSize(cellSize);
+}
+
+
+void
+SpatialIndexSystem::shutdown() {
+    m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_grid.clear();
+    System::shutdown();
+}
+
+
+size_t
+SpatialIndexSystem::size() const {
+    return m_impl->m_grid.size();
+}
+
+
+void
+SpatialIndexSystem::update(int) {
+    SpatialGrid& grid = m_impl->m_grid;
+    for (EntityId entityId : m_impl->m_entities.removedEntities()) {
+        grid.remove(entityId);
+    }
+    // New components may have been untouched already, read them anyway
+    for (const auto& added : m_impl->m_entities.addedEntities()) {
+        OgreSceneNodeComponent* sceneNodeComponent = std::get<0>(added.second);
+        if (sceneNodeComponent->m_parentId == NULL_ENTITY) {
+            grid.setPosition(added.first, sceneNodeComponent->m_transform.position);
+        }
+    }
+    m_impl->m_entities.clearChanges();
+    for (const auto& value : m_impl->m_entities) {
+        OgreSceneNodeComponent* sceneNodeComponent = std::get<0>(value.second);
+        // Child positions are relative to their parent
+        bool isChild = sceneNodeComponent->m_parentId != NULL_ENTITY;
+        if (sceneNodeComponent->m_parentId.hasChanges() and isChild) {
+            grid.remove(value.first);
+        }
+        else if (
+            not isChild and (
+                sceneNodeComponent->m_transform.hasChanges() or
+                sceneNodeComponent->m_parentId.hasChanges()
+            )
+        ) {
+            grid.setPosition(value.first, sceneNodeComponent->m_transform.position);
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "engine/system.h"
+#include "engine/typedefs.h"
+#include "scripting/luabind.h"
+
+#include <memory>
+
+namespace Ogre {
+    class Vector3;
+}
+
+namespace thrive {
+
+class SpatialGrid;
+
+/**
+* @brief Keeps a SpatialGrid of all entity positions up to date
+*
+* Answers "what is near here" without scanning all entities or relying
+* on physics contacts.
+*
+* Every entity with an OgreSceneNodeComponent and no parent scene node is
+* a point in the grid. Rigid bodies are covered through their scene node.
+* Only transforms touched since the last frame are read, so the system
+* must run after everything that moves scene nodes and before the
+* graphics systems, which untouch them.
+*
+* Results reflect the positions at the time of the last update.
+*/
+class SpatialIndexSystem : public System {
+
+public:
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - SpatialIndexSystem::luaQueryBox() (as queryBox)
+    * - SpatialIndexSystem::luaQueryNearest() (as queryNearest)
+    * - SpatialIndexSystem::luaQueryNearestBatch() (as queryNearestBatch)
+    * - SpatialIndexSystem::luaQueryRadius() (as queryRadius)
+    * - SpatialIndexSystem::luaQueryRadiusBatch() (as queryRadiusBatch)
+    * - SpatialIndexSystem::setCellSize()
+    * - SpatialIndexSystem::size() (as property)
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    */
+    SpatialIndexSystem();
+
+    /**
+    * @brief Destructor
+    */
+    ~SpatialIndexSystem();
+
+    /**
+    * @brief The grid, for queries from C++
+    */
+    const SpatialGrid&
+    grid() const;
+
+    /**
+    * @brief Initializes the system
+    *
+    * @param engine
+    */
+    void
+    init(
+        Engine* engine
+    ) override;
+
+    /**
+    * @brief Finds all entities within an axis aligned box
+    *
+    * @param L
+    * @param min
+    * @param max
+    *
+    * @return
+    *   A sequence of entity ids
+    */
+    luabind::object
+    luaQueryBox(
+        lua_State* L,
+        const Ogre::Vector3& min,
+        const Ogre::Vector3& max
+    ) const;
+
+    /**
+    * @brief Finds the entities nearest to a point
+    *
+    * @param L
+    * @param center
+    * @param count
+    *
+    * @return
+    *   A sequence of at most \a count entity ids, nearest first
+    */
+    luabind::object
+    luaQueryNearest(
+        lua_State* L,
+        const Ogre::Vector3& center,
+        unsigned int count
+    ) const;
+
+    /**
+    * @brief Runs luaQueryNearest() for many points in one call
+    *
+    * @param L
+    * @param centers
+    *   A sequence of Vector3
+    * @param count
+    *
+    * @return
+    *   A sequence with one result sequence per center
+    */
+    luabind::object
+    luaQueryNearestBatch(
+        lua_State* L,
+        const luabind::object& centers,
+        unsigned int count
+    ) const;
+
+    /**
+    * @brief Finds all entities within a circle
+    *
+    * @param L
+    * @param center
+    * @param radius
+    *
+    * @return
+    *   A sequence of entity ids
+    */
+    luabind::object
+    luaQueryRadius(
+        lua_State* L,
+        const Ogre::Vector3& center,
+        float radius
+    ) const;
+
+    /**
+    * @brief Runs luaQueryRadius() for many points in one call
+    *
+    * @param L
+    * @param centers
+    *   A sequence of Vector3
+    * @param radius
+    *
+    * @return
+    *   A sequence with one result sequence per center
+    */
+    luabind::object
+    luaQueryRadiusBatch(
+        lua_State* L,
+        const luabind::object& centers,
+        float radius
+    ) const;
+
+    /**
+    * @brief Sets the edge length of the grid cells
+    *
+    * Best set to about the typical query radius.
+    *
+    * @param cellSize
+    *   Defaults to 10
+    */
+    void
+    setCellSize(
+        float cellSize
+    );
+
+    /**
+    * @brief Shuts the system down
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief The number of entities in the grid
+    */
+    size_t
+    size() const;
+
+    /**
+    * @brief Updates the system
+    */
+    void
+    update(int) override;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+};
+
+}
@@ -0,0 +1,115 @@
+#include "engine/storage_arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+using namespace thrive;
+
+static const size_t INITIAL_BLOCK_SIZE = 64 * 1024;
+
+static const size_t MAXIMUM_BLOCK_SIZE = 16 * 1024 * 1024;
+
+static thread_local StorageArena* CurrentArena = nullptr;
+
+
+void
+thrive::intrusive_ptr_add_ref(
+    StorageArena* arena
+) {
+    arena->m_referenceCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void
+thrive::intrusive_ptr_release(
+    StorageArena* arena
+) {
+    if (arena->m_referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete arena;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StorageArena::Scope
+////////////////////////////////////////////////////////////////////////////////
+
+StorageArena::Scope::Scope(
+    Ptr arena
+) : m_arena(std::move(arena)),
+    m_previous(CurrentArena)
+{
+    CurrentArena = m_arena.get();
+}
+
+
+StorageArena::Scope::~Scope() {
+    assert(CurrentArena == m_arena.get() && "Arena scopes must be nested");
+    CurrentArena = m_previous;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// StorageArena
+////////////////////////////////////////////////////////////////////////////////
+
+StorageArena::Ptr
+StorageArena::create() {
+    return Ptr(new StorageArena());
+}
+
+
+StorageArena*
+StorageArena::current() {
+    return CurrentArena;
+}
+
+
+StorageArena::StorageArena()
+  : m_nextBlockSize(INITIAL_BLOCK_SIZE),
+    m_referenceCount(0)
+{
+}
+
+
+StorageArena::~StorageArena() {}
+
+
+void
+StorageArena::addBlock(
+    size_t minimumSize
+) {
+    size_t blockSize = std::max(m_nextBlockSize, minimumSize);
+    m_blocks.emplace_back(new char[blockSize]);
+    m_cursor = m_blocks.back().get();
+    m_remaining = blockSize;
+    m_capacity += blockSize;
+    m_nextBlockSize = std::min(m_nextBlockSize * 2, MAXIMUM_BLOCK_SIZE);
+}
+
+
+void*
+StorageArena::allocate(
+    size_t size,
+    size_t alignment
+) {
+    assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(m_cursor) % alignment) % alignment;
+    if (m_cursor == nullptr or padding + size > m_remaining) {
+        this->addBlock(size + alignment);
+        padding = (alignment - reinterpret_cast<uintptr_t>(m_cursor) % alignment) % alignment;
+    }
+    char* memory = m_cursor + padding;
+    m_cursor += padding + size;
+    m_remaining -= padding + size;
+    return memory;
+}
+
+
+size_t
+StorageArena::capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <atomic>
+#include <boost/intrusive_ptr.hpp>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace thrive {
+
+class StorageArena;
+
+void
+intrusive_ptr_add_ref(
+    StorageArena* arena
+);
+
+void
+intrusive_ptr_release(
+    StorageArena* arena
+);
+
+/**
+* @brief Monotonic memory pool for storage trees
+*
+* Serializing a large world creates millions of small objects that all
+* die together once the savegame is written (or loaded). An arena hands
+* out that memory from a few large blocks and releases it in one go.
+* Individual deallocations are no-ops.
+*
+* Arenas are reference counted. Everything that holds memory from an arena
+* also holds a reference to it, so a storage container that outlives its
+* savegame (e.g. because a script still refers to it) stays valid.
+*
+* Usage:
+* \code
+* StorageArena::Scope arenaScope(StorageArena::create());
+* // All storage containers and lists created on this thread until the
+* // scope is left are allocated from the new arena
+* \endcode
+*/
+class StorageArena {
+
+public:
+
+    /**
+    * @brief Reference counted pointer to an arena
+    */
+    using Ptr = boost::intrusive_ptr<StorageArena>;
+
+    /**
+    * @brief Makes an arena the current one of this thread while in scope
+    *
+    * Scopes can be nested. Leaving a scope restores the previous arena.
+    */
+    class Scope {
+
+    public:
+
+        /**
+        * @brief Constructor
+        *
+        * @param arena
+        *   The arena to make current. May be \c nullptr to allocate from
+        *   the heap while in this scope.
+        */
+        Scope(
+            Ptr arena
+        );
+
+        /**
+        * @brief Non-copyable
+        */
+        Scope(const Scope& other) = delete;
+
+        /**
+        * @brief Destructor
+        */
+        ~Scope();
+
+    private:
+
+        Ptr m_arena;
+
+        StorageArena* m_previous = nullptr;
+
+    };
+
+    /**
+    * @brief Creates a new, empty arena
+    */
+    static Ptr
+    create();
+
+    /**
+    * @brief The arena of the innermost active Scope on this thread
+    *
+    * @return
+    *   The current arena or \c nullptr if allocations should go to the heap
+    */
+    static StorageArena*
+    current();
+
+    /**
+    * @brief Non-copyable
+    */
+    StorageArena(const StorageArena& other) = delete;
+
+    /**
+    * @brief Destructor
+    *
+    * Releases all blocks
+    */
+    ~StorageArena();
+
+    /**
+    * @brief Allocates uninitialized memory
+    *
+    * Thread safe.
+    *
+    * @param size
+    *   Number of bytes
+    * @param alignment
+    *   Required alignment, must be a power of two
+    *
+    * @return
+    *   Memory that stays valid until the arena is destroyed
+    */
+    void*
+    allocate(
+        size_t size,
+        size_t alignment
+    );
+
+    /**
+    * @brief The total size of all blocks held by this arena
+    */
+    size_t
+    capacity() const;
+
+private:
+
+    friend void intrusive_ptr_add_ref(StorageArena*);
+
+    friend void intrusive_ptr_release(StorageArena*);
+
+    StorageArena();
+
+    void
+    addBlock(
+        size_t minimumSize
+    );
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+
+    size_t m_capacity = 0;
+
+    char* m_cursor = nullptr;
+
+    mutable std::mutex m_mutex;
+
+    size_t m_nextBlockSize;
+
+    std::atomic<size_t> m_referenceCount;
+
+    size_t m_remaining = 0;
+
+};
+
+
+/**
+* @brief Standard allocator that allocates from a StorageArena
+*
+* A default constructed allocator binds to StorageArena::current(). Without
+* a current arena, it falls back to the heap.
+*
+* @tparam T
+*   The allocated type
+*/
+template<typename T>
+class StorageAllocator {
+
+public:
+
+    using value_type = T;
+
+    using propagate_on_container_move_assignment = std::true_type;
+
+    using propagate_on_container_swap = std::true_type;
+
+    template<typename U>
+    struct rebind {
+        using other = StorageAllocator<U>;
+    };
+
+    /**
+    * @brief Constructor
+    *
+    * Binds to the current arena, if any.
+    */
+    StorageAllocator()
+      : m_arena(StorageArena::current())
+    {
+    }
+
+    /**
+    * @brief Converting constructor
+    *
+    * @param other
+    *   Allocator whose arena to share
+    */
+    template<typename U>
+    StorageAllocator(
+        const StorageAllocator<U>& other
+    ) : m_arena(other.arena())
+    {
+    }
+
+    /**
+    * @brief The arena this allocator allocates from
+    *
+    * @return
+    *   The arena or \c nullptr for the heap
+    */
+    const StorageArena::Ptr&
+    arena() const {
+        return m_arena;
+    }
+
+    T*
+    allocate(
+        size_t n
+    ) {
+        if (m_arena) {
+            return static_cast<T*>(
+                m_arena->allocate(n * sizeof(T), alignof(T))
+            );
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void
+    deallocate(
+        T* pointer,
+        size_t
+    ) {
+        if (not m_arena) {
+            ::operator delete(pointer);
+        }
+    }
+
+    /**
+    * @brief Copies of a container allocate from the copying thread's arena
+    */
+    StorageAllocator
+    select_on_container_copy_construction() const {
+        return StorageAllocator();
+    }
+
+    template<typename U>
+    bool
+    operator == (
+        const StorageAllocator<U>& other
+    ) const {
+        return m_arena == other.arena();
+    }
+
+    template<typename U>
+    bool
+    operator != (
+        const StorageAllocator<U>& other
+    ) const {
+        return m_arena != other.arena();
+    }
+
+private:
+
+    StorageArena::Ptr m_arena;
+
+};
+
+}
@@ -0,0 +1,634 @@
+#include "engine/streaming_system.h"
+
+#include "engine/component_factory.h"
+#include "engine/engine.h"
+#include "engine/entity_filter.h"
+#include "engine/entity_manager.h"
+#include "engine/serialization.h"
+#include "engine/storage_arena.h"
+#include "ogre/scene_node_system.h"
+#include "scripting/luabind.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace thrive;
+
+namespace {
+
+using Cell = std::pair<int, int>;
+
+const char* const CELL_SIZE_FILENAME = "cell_size";
+
+const char* const CHUNK_EXTENSION = ".cell";
+
+/**
+* @brief Reads and decodes a chunk file
+*/
+StorageContainer
+readChunk(
+    const std::string& filename
+) {
+    std::ifstream stream(filename, std::ifstream::binary);
+    if (not stream) {
+        throw std::runtime_error("Could not open chunk: " + filename);
+    }
+    std::string data(
+        (std::istreambuf_iterator<char>(stream)),
+        std::istreambuf_iterator<char>()
+    );
+    if (BlockCompression::isCompressed(data.data(), data.size())) {
+        data = BlockCompression::decompress(data.data(), data.size());
+    }
+    std::istringstream decoded(data, std::ios_base::in | std::ios_base::binary);
+    decoded.exceptions(std::istream::failbit | std::istream::badbit);
+    StorageContainer storage;
+    decoded >> storage;
+    return storage;
+}
+
+
+/**
+* @brief Encodes and writes a chunk file through a temporary file
+*/
+void
+writeChunk(
+    const std::string& filename,
+    const StorageContainer& storage,
+    BlockCompression::Codec codec
+) {
+    std::ostringstream encoded(std::ios_base::out | std::ios_base::binary);
+    encoded << storage;
+    std::string data = encoded.str();
+    if (codec != BlockCompression::None) {
+        data = BlockCompression::compress(data.data(), data.size(), codec);
+    }
+    std::string temporaryFilename = filename + ".tmp";
+    {
+        std::ofstream stream(temporaryFilename, std::ofstream::trunc | std::ofstream::binary);
+        if (not stream) {
+            throw std::runtime_error("Could not open chunk for writing: " + temporaryFilename);
+        }
+        stream.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        stream.write(data.data(), data.size());
+    }
+    boost::filesystem::rename(temporaryFilename, filename);
+}
+
+} // namespace
+
+
+struct StreamingSystem::Implementation {
+
+    /**
+    * @brief Chunks of a cell, read by the worker
+    */
+    struct ReadCell {
+
+        Cell cell;
+
+        std::vector<std::string> filenames;
+
+        std::vector<StorageContainer> chunks;
+
+    };
+
+    ~Implementation() {
+        this->stopWorker();
+    }
+
+    std::string
+    cellSizeFilename() const {
+        return (boost::filesystem::path(m_directory) / CELL_SIZE_FILENAME).string();
+    }
+
+    Cell
+    cellAt(
+        const Ogre::Vector3& position
+    ) const {
+        return Cell(
+            int(std::floor(position.x / m_cellSize)),
+            int(std::floor(position.y / m_cellSize))
+        );
+    }
+
+    /**
+    * @brief Distance from \a position to the nearest point of \a cell
+    */
+    float
+    distance(
+        const Cell& cell,
+        const Ogre::Vector3& position
+    ) const {
+        float minX = cell.first * m_cellSize;
+        float minY = cell.second * m_cellSize;
+        float dx = std::max({minX - position.x, 0.0f, position.x - (minX + m_cellSize)});
+        float dy = std::max({minY - position.y, 0.0f, position.y - (minY + m_cellSize)});
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    std::string
+    newChunkFilename(
+        const Cell& cell
+    ) {
+        boost::filesystem::path path(m_directory);
+        path /= boost::lexical_cast<std::string>(cell.first) + "_" +
+            boost::lexical_cast<std::string>(cell.second) + "_" +
+            boost::lexical_cast<std::string>(m_nextChunkIndex++) +
+            CHUNK_EXTENSION;
+        return path.string();
+    }
+
+    /**
+    * @brief Adopts the cell size stored in the directory, if any
+    */
+    void
+    readCellSize() {
+        std::ifstream stream(this->cellSizeFilename());
+        float cellSize = 0.0f;
+        if (stream >> cellSize and cellSize > 0.0f) {
+            m_cellSize = cellSize;
+        }
+        else {
+            this->writeCellSize();
+        }
+    }
+
+    void
+    writeCellSize() const {
+        std::ofstream stream(this->cellSizeFilename(), std::ofstream::trunc);
+        stream << m_cellSize << std::endl;
+        if (not stream) {
+            throw std::runtime_error("Could not write cell size: " + this->cellSizeFilename());
+        }
+    }
+
+    /**
+    * @brief Queues a job for the worker thread
+    */
+    void
+    post(
+        std::function<void()> job
+    ) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobAvailable.notify_one();
+    }
+
+    /**
+    * @brief Indexes the chunks already stored in the directory
+    */
+    void
+    scanDirectory() {
+        m_chunks.clear();
+        m_nextChunkIndex = 0;
+        for (
+            boost::filesystem::directory_iterator iter(m_directory);
+            iter != boost::filesystem::directory_iterator();
+            ++iter
+        ) {
+            const boost::filesystem::path& path = iter->path();
+            if (path.extension() != CHUNK_EXTENSION) {
+                continue;
+            }
+            int x = 0;
+            int y = 0;
+            unsigned long index = 0;
+            if (std::sscanf(path.stem().string().c_str(), "%d_%d_%lu", &x, &y, &index) != 3) {
+                std::cerr << "Ignoring unknown chunk: " << path.string() << std::endl;
+                continue;
+            }
+            m_chunks[Cell(x, y)].push_back(path.string());
+            m_nextChunkIndex = std::max(m_nextChunkIndex, index + 1);
+        }
+    }
+
+    void
+    startWorker() {
+        m_stopping = false;
+        m_worker = boost::thread([this] () {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_jobAvailable.wait(lock, [this] () {
+                        return m_stopping or not m_jobs.empty();
+                    });
+                    if (m_jobs.empty()) {
+                        return;
+                    }
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+
+    /**
+    * @brief Stops the worker once all queued jobs are done
+    */
+    void
+    stopWorker() {
+        if (not m_worker.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobAvailable.notify_one();
+        m_worker.join();
+    }
+
+    // Chunk files of unloaded cells
+    std::map<Cell, std::vector<std::string>> m_chunks;
+
+    float m_cellSize = 200.0f;
+
+    BlockCompression::Codec m_codec = BlockCompression::Fast;
+
+    std::string m_directory;
+
+    EntityFilter<OgreSceneNodeComponent> m_entities;
+
+    EntityId m_focusEntity = NULL_ENTITY;
+
+    std::condition_variable m_jobAvailable;
+
+    std::deque<std::function<void()>> m_jobs;
+
+    unsigned int m_loadBudget = 2;
+
+    std::set<Cell> m_loadedCells;
+
+    float m_loadRadius = 400.0f;
+
+    std::mutex m_mutex;
+
+    unsigned long m_nextChunkIndex = 0;
+
+    std::set<Cell> m_pendingCells;
+
+    std::unordered_set<EntityId> m_pinned;
+
+    // Filled by the worker, guarded by m_mutex
+    std::deque<ReadCell> m_readCells;
+
+    // Guarded by m_mutex
+    bool m_stopping = false;
+
+    unsigned int m_unloadBudget = 2;
+
+    float m_unloadRadius = 600.0f;
+
+    boost::thread m_worker;
+
+};
+
+
+luabind::scope
+StreamingSystem::luaBindings() {
+    using namespace luabind;
+    return class_<StreamingSystem, System>("StreamingSystem")
+        .def("pin", &StreamingSystem::pin)
+        .def("setBudget", &StreamingSystem::setBudget)
+        .def("setCellSize", &StreamingSystem::setCellSize)
+        .def("setCompression", &StreamingSystem::setCompression)
+        .def("setDirectory", &StreamingSystem::setDirectory)
+        .def("setFocusEntity", &StreamingSystem::setFocusEntity)
+        .def("setRadii", &StreamingSystem::setRadii)
+        .def("unpin", &StreamingSystem::unpin)
+        .property("loadedCellCount", &StreamingSystem::loadedCellCount)
+        .property("pendingCellCount", &StreamingSystem::pendingCellCount)
+    ;
+}
+
+
+StreamingSystem::StreamingSystem()
+  : m_impl(new Implementation())
+{
+}
+
+
+StreamingSystem::~StreamingSystem() {}
+
+
+void
+StreamingSystem::init(
+    Engine* engine
+) {
+    System::init(engine);
+    m_impl->m_entities.setEntityManager(&engine->entityManager());
+}
+
+
+size_t
+StreamingSystem::loadedCellCount() const {
+    return m_impl->m_loadedCells.size();
+}
+
+
+size_t
+StreamingSystem::pendingCellCount() const {
+    return m_impl->m_pendingCells.size();
+}
+
+
+void
+StreamingSystem::pin(
+    EntityId entityId
+) {
+    m_impl->m_pinned.insert(entityId);
+}
+
+
+void
+StreamingSystem::setBudget(
+    unsigned int loads,
+    unsigned int unloads
+) {
+    m_impl->m_loadBudget = loads;
+    m_impl->m_unloadBudget = unloads;
+}
+
+
+void
+StreamingSystem::setCellSize(
+    float cellSize
+) {
+    // Stored chunks are indexed by the old grid
+    if (not m_impl->m_chunks.empty() or not m_impl->m_pendingCells.empty()) {
+        throw std::logic_error("Cannot change the cell size while cells are stored");
+    }
+    m_impl->m_cellSize = cellSize;
+    m_impl->m_loadedCells.clear();
+    if (not m_impl->m_directory.empty()) {
+        m_impl->writeCellSize();
+    }
+}
+
+
+void
+StreamingSystem::setCompression(
+    BlockCompression::Codec codec
+) {
+    m_impl->m_codec = codec;
+}
+
+
+void
+StreamingSystem::setDirectory(
+    const std::string& directory
+) {
+    // Pending writes belong to the previous directory. Cells that were
+    // read but not added yet are still added with the next update.
+    m_impl->stopWorker();
+    m_impl->m_chunks.clear();
+    m_impl->m_loadedCells.clear();
+    m_impl->m_directory = directory;
+    if (directory.empty()) {
+        return;
+    }
+    boost::filesystem::create_directories(directory);
+    m_impl->readCellSize();
+    m_impl->scanDirectory();
+    m_impl->startWorker();
+}
+
+
+void
+StreamingSystem::setFocusEntity(
+    EntityId entityId
+) {
+    m_impl->m_focusEntity = entityId;
+}
+
+
+void
+StreamingSystem::setRadii(
+    float loadRadius,
+    float unloadRadius
+) {
+    m_impl->m_loadRadius = loadRadius;
+    m_impl->m_unloadRadius = std::max(loadRadius, unloadRadius);
+}
+
+
+void
+StreamingSystem::shutdown() {
+    m_impl->stopWorker();
+    m_impl->m_entities.setEntityManager(nullptr);
+    System::shutdown();
+}
+
+
+void
+StreamingSystem::unpin(
+    EntityId entityId
+) {
+    m_impl->m_pinned.erase(entityId);
+}
+
+
+void
+StreamingSystem::update(int) {
+    EntityManager& entityManager = this->engine()->entityManager();
+    const ComponentFactory& factory = this->engine()->componentFactory();
+    // Add the cells the worker has read
+    for (unsigned int i = 0; i < m_impl->m_loadBudget; ++i) {
+        Implementation::ReadCell readCell;
+        {
+            std::lock_guard<std::mutex> lock(m_impl->m_mutex);
+            if (m_impl->m_readCells.empty()) {
+                break;
+            }
+            readCell = std::move(m_impl->m_readCells.front());
+            m_impl->m_readCells.pop_front();
+        }
+        for (const StorageContainer& chunk : readCell.chunks) {
+            for (EntityId entityId : entityManager.addEntities(chunk, factory)) {
+                std::cerr << "Dropping streamed entity " << entityId <<
+                    ", its id is already in use" << std::endl;
+            }
+        }
+        m_impl->m_pendingCells.erase(readCell.cell);
+        m_impl->m_loadedCells.insert(readCell.cell);
+        // Only now the entities can't get lost anymore
+        std::vector<std::string> filenames = std::move(readCell.filenames);
+        m_impl->post([filenames] () {
+            for (const std::string& filename : filenames) {
+                boost::system::error_code error;
+                boost::filesystem::remove(filename, error);
+            }
+        });
+    }
+    if (m_impl->m_directory.empty()) {
+        return;
+    }
+    auto focusNode = entityManager.getComponent<OgreSceneNodeComponent>(
+        m_impl->m_focusEntity
+    );
+    if (not focusNode) {
+        return;
+    }
+    Ogre::Vector3 focus = focusNode->m_transform.position;
+    // Find the entities of cells beyond the unload radius
+    std::unordered_set<EntityId> named = entityManager.namedEntities();
+    std::unordered_multimap<EntityId, EntityId> children;
+    std::map<Cell, std::unordered_set<EntityId>> unloads;
+    for (const auto& entry : m_impl->m_entities) {
+        EntityId entityId = entry.first;
+        const OgreSceneNodeComponent* sceneNode = std::get<0>(entry.second);
+        EntityId parentId = sceneNode->m_parentId;
+        if (parentId != NULL_ENTITY) {
+            children.emplace(parentId, entityId);
+            continue;
+        }
+        if (
+            named.count(entityId) or
+            m_impl->m_pinned.count(entityId) or
+            entityManager.isVolatile(entityId)
+        ) {
+            continue;
+        }
+        Cell cell = m_impl->cellAt(sceneNode->m_transform.position);
+        if (
+            m_impl->m_pendingCells.count(cell) == 0 and
+            m_impl->distance(cell, focus) > m_impl->m_unloadRadius
+        ) {
+            unloads[cell].insert(entityId);
+        }
+    }
+    for (auto iter = m_impl->m_loadedCells.begin(); iter != m_impl->m_loadedCells.end(); ) {
+        if (
+            unloads.count(*iter) == 0 and
+            m_impl->distance(*iter, focus) > m_impl->m_unloadRadius
+        ) {
+            iter = m_impl->m_loadedCells.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+    // Unload, furthest cells first
+    std::vector<std::pair<float, Cell>> unloadOrder;
+    for (const auto& item : unloads) {
+        unloadOrder.emplace_back(m_impl->distance(item.first, focus), item.first);
+    }
+    std::sort(unloadOrder.rbegin(), unloadOrder.rend());
+    if (unloadOrder.size() > m_impl->m_unloadBudget) {
+        unloadOrder.resize(m_impl->m_unloadBudget);
+    }
+    for (const auto& item : unloadOrder) {
+        const Cell& cell = item.second;
+        std::unordered_set<EntityId>& entityIds = unloads[cell];
+        std::vector<EntityId> pending(entityIds.begin(), entityIds.end());
+        while (not pending.empty()) {
+            EntityId parentId = pending.back();
+            pending.pop_back();
+            auto range = children.equal_range(parentId);
+            for (auto iter = range.first; iter != range.second; ++iter) {
+                if (entityIds.insert(iter->second).second) {
+                    pending.push_back(iter->second);
+                }
+            }
+        }
+        auto storage = std::make_shared<StorageContainer>();
+        {
+            // The storage tree only lives until it is written
+            StorageArena::Scope arenaScope(StorageArena::create());
+            *storage = entityManager.entityStorage(entityIds, factory);
+        }
+        std::string filename = m_impl->newChunkFilename(cell);
+        m_impl->m_chunks[cell].push_back(filename);
+        BlockCompression::Codec codec = m_impl->m_codec;
+        m_impl->post([filename, storage, codec] () mutable {
+            try {
+                writeChunk(filename, *storage, codec);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error unloading cell: " << e.what() << std::endl;
+            }
+            // Release the storage on this thread, not the main thread
+            storage.reset();
+        });
+        for (EntityId entityId : entityIds) {
+            entityManager.removeEntity(entityId);
+        }
+        m_impl->m_loadedCells.erase(cell);
+    }
+    // Load, nearest cells first
+    std::vector<std::pair<float, Cell>> loadOrder;
+    Cell minCell = m_impl->cellAt(focus - Ogre::Vector3(m_impl->m_loadRadius, m_impl->m_loadRadius, 0));
+    Cell maxCell = m_impl->cellAt(focus + Ogre::Vector3(m_impl->m_loadRadius, m_impl->m_loadRadius, 0));
+    for (int x = minCell.first; x <= maxCell.first; ++x) {
+        for (int y = minCell.second; y <= maxCell.second; ++y) {
+            Cell cell(x, y);
+            float cellDistance = m_impl->distance(cell, focus);
+            if (
+                cellDistance > m_impl->m_loadRadius or
+                m_impl->m_loadedCells.count(cell) or
+                m_impl->m_pendingCells.count(cell)
+            ) {
+                continue;
+            }
+            if (m_impl->m_chunks.count(cell) == 0) {
+                // Nothing stored, nothing to wait for
+                m_impl->m_loadedCells.insert(cell);
+                continue;
+            }
+            loadOrder.emplace_back(cellDistance, cell);
+        }
+    }
+    std::sort(loadOrder.begin(), loadOrder.end());
+    if (loadOrder.size() > m_impl->m_loadBudget) {
+        loadOrder.resize(m_impl->m_loadBudget);
+    }
+    for (const auto& item : loadOrder) {
+        const Cell& cell = item.second;
+        auto chunks = m_impl->m_chunks.find(cell);
+        std::vector<std::string> filenames = std::move(chunks->second);
+        m_impl->m_chunks.erase(chunks);
+        m_impl->m_pendingCells.insert(cell);
+        Implementation* impl = m_impl.get();
+        impl->post([impl, cell, filenames] () {
+            Implementation::ReadCell readCell;
+            readCell.cell = cell;
+            StorageArena::Scope arenaScope(StorageArena::create());
+            for (const std::string& filename : filenames) {
+                try {
+                    readCell.chunks.push_back(readChunk(filename));
+                    readCell.filenames.push_back(filename);
+                }
+                catch (const std::exception& e) {
+                    // The file is left alone and picked up again with
+                    // the next scan of the directory
+                    std::cerr << "Error loading cell: " << e.what() << std::endl;
+                }
+            }
+            std::lock_guard<std::mutex> lock(impl->m_mutex);
+            impl->m_readCells.push_back(std::move(readCell));
+        });
+    }
+}
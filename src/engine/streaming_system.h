@@ -0,0 +1,225 @@
+#pragma once
+
+#include "engine/block_compression.h"
+#include "engine/system.h"
+#include "engine/typedefs.h"
+
+#include <memory>
+#include <string>
+
+namespace thrive {
+
+/**
+* @brief Streams the world in and out by region
+*
+* The play plane (x and y) is divided into square cells. Entities in
+* cells far away from the focus entity, usually the camera, are stored
+* on disk and removed from the entity manager. When the focus comes
+* close again, they are read back.
+*
+* A cell is loaded once it is within the load radius of the focus and
+* unloaded once it is beyond the unload radius. The unload radius is
+* larger, so the band between both radii prevents cells at the edge
+* from being loaded and unloaded over and over.
+*
+* Each unload appends a chunk file to the cell, loading a cell consumes
+* all of its chunks. Files are read, decoded, compressed and written on
+* a worker thread, only the serialization and creation of components
+* happen on the main thread, because of scripted components. Budgets
+* limit how many cells are loaded and unloaded per frame.
+*
+* An entity's cell is determined by the position of its
+* OgreSceneNodeComponent. Entities without one, named entities, pinned
+* entities and volatile entities are never unloaded. Entities with a
+* parent scene node are unloaded along with their parent.
+*
+* The streaming directory holds the unloaded part of the world, savegames
+* only contain the loaded part. Keep both together. Loading an older
+* savegame does not rewind the directory. Stored entities whose id is in
+* use again when their cell is loaded are dropped and reported, see
+* EntityManager::addEntities().
+*/
+class StreamingSystem : public System {
+
+public:
+
+    /**
+    * @brief Lua bindings
+    *
+    * Exposes:
+    * - StreamingSystem::pin()
+    * - StreamingSystem::setBudget()
+    * - StreamingSystem::setCellSize()
+    * - StreamingSystem::setCompression()
+    * - StreamingSystem::setDirectory()
+    * - StreamingSystem::setFocusEntity()
+    * - StreamingSystem::setRadii()
+    * - StreamingSystem::unpin()
+    * - StreamingSystem::loadedCellCount() (as property)
+    * - StreamingSystem::pendingCellCount() (as property)
+    *
+    * @return
+    */
+    static luabind::scope
+    luaBindings();
+
+    /**
+    * @brief Constructor
+    */
+    StreamingSystem();
+
+    /**
+    * @brief Destructor
+    */
+    ~StreamingSystem();
+
+    /**
+    * @brief Initializes the system
+    *
+    * @param engine
+    */
+    void
+    init(
+        Engine* engine
+    ) override;
+
+    /**
+    * @brief The number of cells currently loaded
+    */
+    size_t
+    loadedCellCount() const;
+
+    /**
+    * @brief The number of cells being read
+    */
+    size_t
+    pendingCellCount() const;
+
+    /**
+    * @brief Keeps an entity loaded, wherever it is
+    *
+    * @param entityId
+    *   The entity to pin
+    */
+    void
+    pin(
+        EntityId entityId
+    );
+
+    /**
+    * @brief Sets how many cells may be loaded and unloaded per frame
+    *
+    * @param loads
+    *   Maximum number of cells loaded per frame. Defaults to 2.
+    * @param unloads
+    *   Maximum number of cells unloaded per frame. Defaults to 2.
+    */
+    void
+    setBudget(
+        unsigned int loads,
+        unsigned int unloads
+    );
+
+    /**
+    * @brief Sets the edge length of the cells
+    *
+    * The cell size is stored in the directory along with the chunks.
+    * setDirectory() picks it up from there.
+    *
+    * @param cellSize
+    *   Defaults to 200
+    *
+    * @throw std::logic_error
+    *   If cells are stored or being read
+    */
+    void
+    setCellSize(
+        float cellSize
+    );
+
+    /**
+    * @brief Sets the codec used for subsequent unloads
+    *
+    * @param codec
+    *   Defaults to BlockCompression::Fast
+    */
+    void
+    setCompression(
+        BlockCompression::Codec codec
+    );
+
+    /**
+    * @brief Sets the directory the cells are stored in
+    *
+    * Creates the directory if necessary and picks up the cells already
+    * stored there, along with their cell size. Streaming is disabled
+    * while no directory is set.
+    *
+    * @param directory
+    *   The directory, or an empty string to stop streaming
+    */
+    void
+    setDirectory(
+        const std::string& directory
+    );
+
+    /**
+    * @brief Sets the entity around which cells are kept loaded
+    *
+    * @param entityId
+    *   The entity to follow, usually the camera. Needs an
+    *   OgreSceneNodeComponent. Streaming pauses without one.
+    */
+    void
+    setFocusEntity(
+        EntityId entityId
+    );
+
+    /**
+    * @brief Sets the distances at which cells are loaded and unloaded
+    *
+    * Distances are measured from the focus to the nearest point of a
+    * cell.
+    *
+    * @param loadRadius
+    *   Cells closer than this are loaded. Defaults to 400.
+    * @param unloadRadius
+    *   Cells further away than this are unloaded. Raised to
+    *   \a loadRadius if smaller. Defaults to 600.
+    */
+    void
+    setRadii(
+        float loadRadius,
+        float unloadRadius
+    );
+
+    /**
+    * @brief Waits for all pending writes
+    */
+    void
+    shutdown() override;
+
+    /**
+    * @brief Releases an entity pinned with pin()
+    *
+    * @param entityId
+    *   The entity to unpin
+    */
+    void
+    unpin(
+        EntityId entityId
+    );
+
+    /**
+    * @brief Updates the system
+    */
+    void
+    update(int) override;
+
+private:
+
+    struct Implementation;
+    std::unique_ptr<Implementation> m_impl;
+};
+
+}
@@ -0,0 +1,55 @@
+#include "engine/block_compression.h"
+
+#include <boost/lexical_cast.hpp>
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+static std::string
+testData(
+    size_t size
+) {
+    std::string data;
+    data.reserve(size);
+    for (size_t i = 0; data.size() < size; ++i) {
+        data += "owner" + boost::lexical_cast<std::string>(i % 97) + ";";
+    }
+    data.resize(size);
+    return data;
+}
+
+
+TEST(BlockCompression, RoundTrip) {
+    std::string data = testData(100000);
+    for (auto codec : {BlockCompression::None, BlockCompression::Fast, BlockCompression::Dense}) {
+        std::string frame = BlockCompression::compress(data.data(), data.size(), codec, 4096);
+        EXPECT_TRUE(BlockCompression::isCompressed(frame.data(), frame.size()));
+        EXPECT_EQ(data, BlockCompression::decompress(frame.data(), frame.size()));
+        if (codec != BlockCompression::None) {
+            EXPECT_LT(frame.size(), data.size());
+        }
+    }
+}
+
+
+TEST(BlockCompression, Empty) {
+    std::string frame = BlockCompression::compress("", 0, BlockCompression::Fast);
+    EXPECT_EQ("", BlockCompression::decompress(frame.data(), frame.size()));
+}
+
+
+TEST(BlockCompression, Corrupt) {
+    std::string data = testData(10000);
+    std::string frame = BlockCompression::compress(data.data(), data.size(), BlockCompression::Fast, 4096);
+    EXPECT_FALSE(BlockCompression::isCompressed(data.data(), data.size()));
+    EXPECT_THROW(
+        BlockCompression::decompress(frame.data(), frame.size() - 1),
+        std::runtime_error
+    );
+    frame[frame.size() - 10] ^= 0x55;
+    EXPECT_THROW(
+        BlockCompression::decompress(frame.data(), frame.size()),
+        std::runtime_error
+    );
+}
@@ -0,0 +1,163 @@
+#include "engine/entity_manager.h"
+
+#include "engine/component_factory.h"
+#include "engine/serialization.h"
+#include "engine/tests/test_component.h"
+#include "util/make_unique.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+namespace {
+
+/**
+* @brief A serializable component that counts how often it was loaded
+*
+* m_marked isn't serialized, it tells apart objects with equal storage.
+*/
+class PatchTestComponent : public Component {
+    COMPONENT(PatchTest)
+
+public:
+
+    void
+    load(
+        const StorageContainer& storage
+    ) override {
+        Component::load(storage);
+        m_value = storage.get<int>("value");
+        m_loadCount += 1;
+    }
+
+    StorageContainer
+    storage() const override {
+        StorageContainer storage = Component::storage();
+        storage.set<int>("value", m_value);
+        return storage;
+    }
+
+    int m_loadCount = 0;
+
+    bool m_marked = false;
+
+    int m_value = 0;
+
+};
+
+}
+
+REGISTER_COMPONENT(PatchTestComponent)
+
+
+TEST(EntityManager, PatchReplacesChangedComponents) {
+    EntityManager entityManager;
+    ComponentFactory factory;
+    EntityId changed = entityManager.generateNewId();
+    EntityId unchanged = entityManager.generateNewId();
+    entityManager.addComponent(changed, make_unique<PatchTestComponent>())->m_value = 1;
+    entityManager.addComponent(unchanged, make_unique<PatchTestComponent>())->m_value = 2;
+    StorageContainer storage = entityManager.storage(factory);
+    // Modify after the snapshot
+    PatchTestComponent* oldComponent = entityManager.getComponent<PatchTestComponent>(changed);
+    oldComponent->m_value = 3;
+    oldComponent->m_marked = true;
+    EntityId added = entityManager.generateNewId();
+    entityManager.addComponent(added, make_unique<PatchTestComponent>());
+    entityManager.addComponent(unchanged, make_unique<TestComponent<0>>());
+    PatchTestComponent* unchangedComponent = entityManager.getComponent<PatchTestComponent>(unchanged);
+    entityManager.patch(storage, factory);
+    entityManager.processRemovals();
+    // The changed component was loaded fresh, not reloaded in place
+    PatchTestComponent* changedComponent = entityManager.getComponent<PatchTestComponent>(changed);
+    ASSERT_TRUE(changedComponent != nullptr);
+    EXPECT_EQ(1, changedComponent->m_value);
+    EXPECT_FALSE(changedComponent->m_marked);
+    EXPECT_EQ(1, changedComponent->m_loadCount);
+    EXPECT_EQ(changed, changedComponent->owner());
+    // The unchanged one is left alone
+    EXPECT_EQ(unchangedComponent, entityManager.getComponent<PatchTestComponent>(unchanged));
+    EXPECT_EQ(0, unchangedComponent->m_loadCount);
+    // Components added after the snapshot are gone
+    EXPECT_EQ(nullptr, entityManager.getComponent<PatchTestComponent>(added));
+    EXPECT_EQ(nullptr, entityManager.getComponent<TestComponent<0>>(unchanged));
+}
+
+
+TEST(EntityManager, PatchKeepsIdsOfVolatileEntities) {
+    EntityManager entityManager;
+    ComponentFactory factory;
+    EntityId persistent = entityManager.generateNewId();
+    entityManager.addComponent(persistent, make_unique<PatchTestComponent>());
+    StorageContainer storage = entityManager.storage(factory);
+    // Like an organelle, created after the snapshot
+    EntityId volatileId = entityManager.generateNewId();
+    entityManager.setVolatile(volatileId, true);
+    entityManager.addComponent(volatileId, make_unique<PatchTestComponent>());
+    entityManager.patch(storage, factory);
+    entityManager.processRemovals();
+    EXPECT_TRUE(entityManager.exists(volatileId));
+    EntityId newId = entityManager.generateNewId();
+    EXPECT_NE(volatileId, newId);
+    EXPECT_FALSE(entityManager.exists(newId));
+}
+
+
+TEST(EntityManager, RestorerStepsThroughEntities) {
+    EntityManager entityManager;
+    ComponentFactory factory;
+    EntityId first = entityManager.generateNewId();
+    EntityId second = entityManager.generateNewId();
+    entityManager.addComponent(first, make_unique<PatchTestComponent>())->m_value = 1;
+    entityManager.addComponent(second, make_unique<PatchTestComponent>())->m_value = 2;
+    entityManager.removeComponent(second, PatchTestComponent::TYPE_ID);
+    StorageContainer storage = entityManager.storage(factory);
+    entityManager.processRemovals();
+    EntityId later = entityManager.generateNewId();
+    entityManager.addComponent(later, make_unique<PatchTestComponent>());
+    EntityManager::Restorer restorer(entityManager, std::move(storage), factory);
+    // Creating the restorer leaves the entity manager alone
+    EXPECT_TRUE(entityManager.exists(later));
+    EXPECT_EQ(0.0f, restorer.progress());
+    // Each step restores at least one entity
+    restorer.step(boost::chrono::microseconds(0));
+    EXPECT_FALSE(entityManager.exists(later));
+    EXPECT_TRUE(entityManager.exists(first));
+    EXPECT_FALSE(entityManager.exists(second));
+    EXPECT_FALSE(restorer.isFinished());
+    float progress = restorer.progress();
+    EXPECT_LT(0.0f, progress);
+    EXPECT_GT(1.0f, progress);
+    restorer.finish();
+    EXPECT_TRUE(restorer.isFinished());
+    EXPECT_EQ(1.0f, restorer.progress());
+    EXPECT_EQ(1, entityManager.getComponent<PatchTestComponent>(first)->m_value);
+    EXPECT_EQ(2, entityManager.getComponent<PatchTestComponent>(second)->m_value);
+    // The removal that was pending when the storage was made is applied
+    entityManager.processRemovals();
+    EXPECT_FALSE(entityManager.exists(second));
+    // Ids continue where the storage left off
+    EXPECT_EQ(later, entityManager.generateNewId());
+}
+
+
+TEST(EntityManager, AddEntitiesSkipsIdsInUse) {
+    EntityManager entityManager;
+    ComponentFactory factory;
+    EntityId stored = entityManager.generateNewId();
+    EntityId reused = entityManager.generateNewId();
+    entityManager.addComponent(stored, make_unique<PatchTestComponent>())->m_value = 1;
+    entityManager.addComponent(reused, make_unique<PatchTestComponent>())->m_value = 2;
+    StorageContainer storage = entityManager.entityStorage({stored, reused}, factory);
+    entityManager.removeEntity(stored);
+    entityManager.removeEntity(reused);
+    entityManager.processRemovals();
+    // The id was handed out again in the meantime
+    entityManager.addComponent(reused, make_unique<TestComponent<0>>());
+    std::vector<EntityId> skipped = entityManager.addEntities(storage, factory);
+    ASSERT_EQ(1u, skipped.size());
+    EXPECT_EQ(reused, skipped.front());
+    EXPECT_EQ(1, entityManager.getComponent<PatchTestComponent>(stored)->m_value);
+    EXPECT_EQ(nullptr, entityManager.getComponent<PatchTestComponent>(reused));
+    EXPECT_NE(nullptr, entityManager.getComponent<TestComponent<0>>(reused));
+}
@@ -0,0 +1,272 @@
+#include "engine/savegame_file.h"
+
+#include "engine/shared_storage.h"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+struct SavegameFileTest : public ::testing::Test {
+
+    SavegameFileTest()
+      : filename((
+            boost::filesystem::temp_directory_path() / 
+            boost::filesystem::unique_path()
+        ).string())
+    {
+    }
+
+    ~SavegameFileTest() {
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(SavegameJournal::filename(filename));
+    }
+
+    static StorageContainer
+    changes(
+        EntityId currentId
+    ) {
+        StorageContainer record;
+        record.set<EntityId>("currentId", currentId);
+        StorageContainer changed;
+        changed.set("A", chunk("A", 3, 3).content.get<StorageList>("components"));
+        changed.set("B", chunk("B", 9, 9).content.get<StorageList>("components"));
+        record.set("collections", std::move(changed));
+        StorageContainer removal;
+        removal.set<EntityId>("entityId", 2);
+        removal.set<std::string>("componentTypeName", "A");
+        StorageList removedComponents;
+        removedComponents.append(std::move(removal));
+        record.set("removedComponents", std::move(removedComponents));
+        return record;
+    }
+
+    static SavegameSection
+    chunk(
+        const std::string& typeName,
+        EntityId firstEntity,
+        EntityId lastEntity
+    ) {
+        SavegameSection section;
+        section.name = SavegameSection::collectionName(typeName);
+        section.firstEntity = firstEntity;
+        section.lastEntity = lastEntity;
+        StorageList components;
+        for (EntityId id = firstEntity; id <= lastEntity; ++id) {
+            StorageContainer component;
+            component.set<EntityId>("owner", id);
+            components.append(std::move(component));
+        }
+        section.content.set("components", std::move(components));
+        return section;
+    }
+
+    void
+    write(
+        uint64_t baseId = 0
+    ) {
+        std::ofstream stream(filename, std::ofstream::binary);
+        SavegameWriter writer(stream);
+        SavegameSection entities;
+        entities.name = SavegameSection::ENTITIES;
+        entities.content.set<EntityId>("currentId", 42);
+        writer.write(entities);
+        writer.write(chunk("A", 1, 3));
+        writer.write(chunk("B", 2, 2));
+        writer.write(chunk("A", 4, 5));
+        if (baseId != 0) {
+            SavegameSection journal;
+            journal.name = SavegameSection::JOURNAL;
+            journal.content.set("baseId", baseId);
+            writer.write(journal);
+        }
+        writer.finish();
+    }
+
+    std::string filename;
+
+};
+
+
+TEST_F(SavegameFileTest, Index) {
+    this->write();
+    ASSERT_TRUE(SavegameReader::isSavegameFile(filename));
+    SavegameReader reader(filename);
+    const auto& sections = reader.sections();
+    ASSERT_EQ(4u, sections.size());
+    EXPECT_EQ(SavegameSection::ENTITIES, sections[0].name);
+    EXPECT_EQ(SavegameSection::collectionName("A"), sections[1].name);
+    EXPECT_EQ(1u, sections[1].firstEntity);
+    EXPECT_EQ(3u, sections[1].lastEntity);
+    StorageContainer chunk = reader.decode(sections[2]);
+    StorageList components = chunk.get<StorageList>("components");
+    ASSERT_EQ(1u, components.size());
+    EXPECT_EQ(2u, components[0].get<EntityId>("owner"));
+}
+
+
+TEST_F(SavegameFileTest, Collection) {
+    this->write();
+    SavegameReader reader(filename);
+    StorageList components = reader.collection("A");
+    ASSERT_EQ(5u, components.size());
+    EXPECT_EQ(5u, components.back().get<EntityId>("owner"));
+    EXPECT_TRUE(reader.collection("C").empty());
+}
+
+
+TEST_F(SavegameFileTest, Entities) {
+    this->write();
+    SavegameReader reader(filename);
+    StorageContainer entities = reader.entities(
+        [] (const std::string& typeName) {
+            return typeName != "B";
+        }
+    );
+    EXPECT_EQ(42u, entities.get<EntityId>("currentId"));
+    StorageContainer collections = entities.get<StorageContainer>("collections");
+    EXPECT_EQ(5u, collections.get<StorageList>("A").size());
+    EXPECT_FALSE(collections.contains("B"));
+}
+
+
+TEST_F(SavegameFileTest, LegacyFileIsNotASavegameFile) {
+    StorageContainer savegame;
+    savegame.set<int32_t>("value", 1);
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        stream << savegame;
+    }
+    EXPECT_FALSE(SavegameReader::isSavegameFile(filename));
+    EXPECT_THROW(SavegameReader reader(filename), std::runtime_error);
+}
+
+
+TEST_F(SavegameFileTest, UncompressedSections) {
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        SavegameWriter writer(stream, BlockCompression::None);
+        writer.write(chunk("A", 1, 100));
+        writer.finish();
+    }
+    SavegameReader reader(filename);
+    EXPECT_EQ(100u, reader.collection("A").size());
+}
+
+
+TEST_F(SavegameFileTest, JournalReplay) {
+    this->write(7);
+    SavegameJournal::append(filename, 7, changes(50), BlockCompression::Fast);
+    SavegameReader reader(filename);
+    StorageContainer entities = reader.entities();
+    EXPECT_EQ(50u, entities.get<EntityId>("currentId"));
+    StorageContainer collections = entities.get<StorageContainer>("collections");
+    StorageList a = collections.get<StorageList>("A");
+    ASSERT_EQ(4u, a.size());
+    EXPECT_EQ(1u, a[0].get<EntityId>("owner"));
+    EXPECT_EQ(3u, a[1].get<EntityId>("owner"));
+    StorageList b = collections.get<StorageList>("B");
+    ASSERT_EQ(2u, b.size());
+    EXPECT_EQ(9u, b[1].get<EntityId>("owner"));
+}
+
+
+TEST_F(SavegameFileTest, StaleJournalIsIgnored) {
+    this->write(7);
+    SavegameJournal::append(filename, 8, changes(50), BlockCompression::Fast);
+    SavegameReader reader(filename);
+    StorageContainer entities = reader.entities();
+    EXPECT_EQ(42u, entities.get<EntityId>("currentId"));
+    // Appending for the right savegame replaces the stale journal
+    SavegameJournal::append(filename, 7, changes(51), BlockCompression::Fast);
+    EXPECT_EQ(1u, SavegameJournal::read(filename, 7).size());
+    EXPECT_TRUE(SavegameJournal::read(filename, 8).empty());
+}
+
+
+TEST_F(SavegameFileTest, TornJournalRecord) {
+    this->write(7);
+    SavegameJournal::append(filename, 7, changes(50), BlockCompression::None);
+    SavegameJournal::append(filename, 7, changes(51), BlockCompression::None);
+    std::string journal = SavegameJournal::filename(filename);
+    boost::filesystem::resize_file(journal, boost::filesystem::file_size(journal) - 3);
+    std::vector<StorageContainer> records = SavegameJournal::read(filename, 7);
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ(50u, records[0].get<EntityId>("currentId"));
+    SavegameJournal::append(filename, 7, changes(52), BlockCompression::None);
+    records = SavegameJournal::read(filename, 7);
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(52u, records[1].get<EntityId>("currentId"));
+}
+
+
+TEST_F(SavegameFileTest, CorruptJournalRecord) {
+    this->write(7);
+    SavegameJournal::append(filename, 7, changes(50), BlockCompression::None);
+    SavegameJournal::append(filename, 7, changes(51), BlockCompression::None);
+    std::string journal = SavegameJournal::filename(filename);
+    // Full length, but zero-filled, like a tail lost in a crash
+    uint64_t size = boost::filesystem::file_size(journal);
+    boost::filesystem::resize_file(journal, size - 8);
+    boost::filesystem::resize_file(journal, size);
+    std::vector<StorageContainer> records = SavegameJournal::read(filename, 7);
+    ASSERT_EQ(1u, records.size());
+    SavegameJournal::append(filename, 7, changes(52), BlockCompression::None);
+    records = SavegameJournal::read(filename, 7);
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(50u, records[0].get<EntityId>("currentId"));
+    EXPECT_EQ(52u, records[1].get<EntityId>("currentId"));
+}
+
+
+TEST_F(SavegameFileTest, CompactJournal) {
+    this->write(7);
+    SavegameJournal::append(filename, 7, changes(50), BlockCompression::Fast);
+    SavegameJournal::compact(filename, 8, BlockCompression::Fast);
+    EXPECT_FALSE(boost::filesystem::exists(SavegameJournal::filename(filename)));
+    SavegameReader reader(filename);
+    StorageContainer entities = reader.entities();
+    EXPECT_EQ(50u, entities.get<EntityId>("currentId"));
+    StorageContainer collections = entities.get<StorageContainer>("collections");
+    EXPECT_EQ(4u, collections.get<StorageList>("A").size());
+    EXPECT_EQ(2u, collections.get<StorageList>("B").size());
+}
+
+
+TEST_F(SavegameFileTest, UnreferencedSharedEntriesAreDropped) {
+    SharedStorageTable table;
+    StorageContainer component;
+    component.set<EntityId>("owner", 1);
+    {
+        SharedStorageTable::Scope scope(&table);
+        StorageContainer used;
+        used.set<int32_t>("value", 1);
+        component.set("shared", SharedStorageTable::share(used));
+        StorageContainer unused;
+        unused.set<int32_t>("value", 2);
+        SharedStorageTable::share(unused);
+    }
+    StorageList components;
+    components.append(component);
+    StorageContainer collections;
+    collections.set("A", std::move(components));
+    StorageContainer entities;
+    entities.set<EntityId>("currentId", 42);
+    entities.set("collections", std::move(collections));
+    entities.set("shared", table.storage());
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        SavegameWriter writer(stream);
+        writer.writeEntities(entities);
+        writer.finish();
+    }
+    SavegameReader reader(filename);
+    StorageList shared = reader.entities().get<StorageList>("shared");
+    ASSERT_EQ(1u, shared.size());
+    EXPECT_EQ(
+        1,
+        shared[0].get<StorageContainer>("storage").get<int32_t>("value")
+    );
+}
@@ -1,6 +1,13 @@
 #include "engine/serialization.h"
 
+#include "engine/storage_arena.h"
+#include "scripting/lua_state.h"
+#include "scripting/script_initializer.h"
+#include "util/parallel_for.h"
+
+#include <boost/lexical_cast.hpp>
 #include <gtest/gtest.h>
+#include <luabind/luabind.hpp>
 
 using namespace thrive;
 
@@ -109,3 +116,363 @@ TEST(Serialization, Vector3) {
 
 
 
+
+
+TEST(Serialization, KeysAreWrittenOnce) {
+    StorageList list;
+    for (int i = 0; i < 100; ++i) {
+        StorageContainer element;
+        element.set<int32_t>("someLongKeyName", i);
+        list.append(std::move(element));
+    }
+    StorageContainer container;
+    container.set("list", std::move(list));
+    std::ostringstream outputStream(std::ios_base::out | std::ios_base::binary);
+    outputStream << container;
+    std::string data = outputStream.str();
+    std::string key = "someLongKeyName";
+    size_t firstPosition = data.find(key);
+    EXPECT_NE(std::string::npos, firstPosition);
+    EXPECT_EQ(std::string::npos, data.find(key, firstPosition + 1));
+    // Round trip
+    StorageContainer copy;
+    std::istringstream inputStream(data, std::ios_base::in | std::ios_base::binary);
+    inputStream >> copy;
+    StorageList listCopy = copy.get<StorageList>("list");
+    ASSERT_EQ(100u, listCopy.size());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, listCopy[i].get<int32_t>("someLongKeyName", -1));
+    }
+}
+
+
+TEST(Serialization, LegacyFormat) {
+    // A container holding a single int32_t "value" of 2001, as written by
+    // the original format without header and key dictionary
+    std::ostringstream legacy(std::ios_base::out | std::ios_base::binary);
+    uint64_t entryCount = 1;
+    std::string key = "value";
+    uint64_t keySize = key.size();
+    uint16_t typeId = 80;
+    int32_t value = 2001;
+    legacy.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+    legacy.write(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+    legacy.write(key.data(), key.size());
+    legacy.write(reinterpret_cast<const char*>(&typeId), sizeof(typeId));
+    legacy.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    StorageContainer container;
+    std::istringstream inputStream(
+        legacy.str(),
+        std::ios_base::in | std::ios_base::binary
+    );
+    inputStream >> container;
+    EXPECT_EQ(2001, container.get<int32_t>("value"));
+}
+
+
+TEST(Serialization, CorruptInputThrows) {
+    StorageContainer container;
+    container.set<std::string>("value", "thrive");
+    std::ostringstream outputStream(std::ios_base::out | std::ios_base::binary);
+    outputStream << container;
+    std::string data = outputStream.str();
+    // Truncated anywhere, including inside the header
+    for (size_t size = 0; size < data.size(); ++size) {
+        std::istringstream inputStream(
+            data.substr(0, size),
+            std::ios_base::in | std::ios_base::binary
+        );
+        StorageContainer copy;
+        EXPECT_THROW(inputStream >> copy, std::runtime_error);
+    }
+    // An entry count far beyond the input is rejected before allocating
+    std::string bogus = data.substr(0, 8) + std::string(9, '\xFF') + '\x01';
+    std::istringstream inputStream(bogus, std::ios_base::in | std::ios_base::binary);
+    StorageContainer copy;
+    EXPECT_THROW(inputStream >> copy, std::runtime_error);
+}
+
+
+TEST(Serialization, Quaternion) {
+    Ogre::Quaternion quaternion(0.5, 0.5, -0.5, 0.5);
+    testSerialization(quaternion);
+}
+
+
+TEST(Serialization, Plane) {
+    Ogre::Plane plane(Ogre::Vector3(0, 0, 1), 4.0f);
+    testSerialization(plane);
+}
+
+
+TEST(Serialization, LegacyVector3) {
+    // Format version 2 stored vectors as nested containers with type id 304
+    // and floats as text
+    std::string data("THRIVES\x02", 8);
+    data.push_back(1); // Entry count
+    data.push_back(0); // Define key 0...
+    data.push_back(6); // ...with 6 characters
+    data.append("vector");
+    data.append("\xB0\x02", 2); // Type id 304
+    data.push_back(3); // Entry count of nested container
+    const char* names[] = {"x", "y", "z"};
+    for (int i = 0; i < 3; ++i) {
+        data.push_back(char(i + 1)); // Define key i + 1...
+        data.push_back(1); // ...with 1 character
+        data.append(names[i]);
+        data.append("\xB0\x01", 2); // Type id 176 (float)
+        data.push_back(1); // Text with 1 character
+        data.push_back(char('1' + i));
+    }
+    StorageContainer copy;
+    std::istringstream inputStream(data, std::ios_base::in | std::ios_base::binary);
+    inputStream >> copy;
+    EXPECT_TRUE(copy.contains<Ogre::Vector3>("vector"));
+    EXPECT_TRUE(Ogre::Vector3(1, 2, 3) == copy.get<Ogre::Vector3>("vector"));
+}
+
+
+TEST(Serialization, MoveLeavesEmptyContainer) {
+    StorageContainer original;
+    original.set<int32_t>("value", 42);
+    StorageContainer moved(std::move(original));
+    EXPECT_EQ(42, moved.get<int32_t>("value"));
+    EXPECT_FALSE(original.contains("value"));
+    EXPECT_TRUE(original.keys().empty());
+    original.set<int32_t>("value", 7);
+    EXPECT_EQ(7, original.get<int32_t>("value"));
+}
+
+
+TEST(Serialization, TakeMovesValueOut) {
+    StorageContainer nested;
+    nested.set<int32_t>("value", 42);
+    StorageContainer container;
+    container.set("nested", nested);
+    container.set<int32_t>("other", 1);
+    StorageContainer taken = container.take<StorageContainer>("nested");
+    EXPECT_EQ(42, taken.get<int32_t>("value"));
+    EXPECT_FALSE(container.contains("nested"));
+    EXPECT_EQ(1, container.get<int32_t>("other"));
+    // Missing keys and other types give an empty value
+    EXPECT_TRUE(container.take<StorageList>("other").empty());
+    EXPECT_EQ(1, container.get<int32_t>("other"));
+}
+
+
+TEST(Serialization, Equality) {
+    StorageList list;
+    list.append(StorageContainer());
+    list[0].set<int32_t>("value", 1);
+    StorageContainer container;
+    container.set<float>("a", 1.0f);
+    container.set("list", list);
+    StorageContainer copy = container;
+    EXPECT_TRUE(container == copy);
+    list[0].set<int32_t>("value", 2);
+    copy.set("list", list);
+    EXPECT_TRUE(container != copy);
+    // Same value, different type
+    StorageContainer other;
+    other.set<double>("a", 1.0);
+    other.set("list", container.get<StorageList>("list"));
+    EXPECT_FALSE(container == other);
+    EXPECT_TRUE(StorageContainer() == StorageContainer());
+}
+
+
+TEST(Serialization, FindDoesNotCopy) {
+    StorageContainer container;
+    container.set("nested", StorageContainer());
+    const StorageContainer* nested = container.find<StorageContainer>("nested");
+    ASSERT_TRUE(nested != nullptr);
+    EXPECT_EQ(nullptr, container.find<StorageList>("nested"));
+    EXPECT_EQ(nullptr, container.find<StorageContainer>("missing"));
+    EXPECT_EQ(nested, container.find<StorageContainer>("nested"));
+}
+
+
+TEST(Serialization, KeysKeepInsertionOrder) {
+    StorageContainer container;
+    container.set<int32_t>("c", 1);
+    container.set<int32_t>("a", 2);
+    container.set<int32_t>("b", 3);
+    container.set<int32_t>("a", 4);
+    std::list<std::string> expected = {"c", "a", "b"};
+    EXPECT_EQ(expected, container.keys());
+    EXPECT_EQ(4, container.get<int32_t>("a"));
+}
+
+
+TEST(Serialization, ArenaOutlivesScope) {
+    StorageContainer outer;
+    {
+        StorageArena::Ptr arena = StorageArena::create();
+        StorageArena::Scope arenaScope(arena);
+        StorageList list;
+        for (int32_t i = 0; i < 100; ++i) {
+            StorageContainer element;
+            element.set<int32_t>("index", i);
+            element.set<std::string>("name", "element");
+            list.append(std::move(element));
+        }
+        outer.set<StorageList>("list", std::move(list));
+        EXPECT_GT(arena->capacity(), 0u);
+    }
+    // The arena is kept alive by the containers allocated from it
+    StorageList list = outer.get<StorageList>("list");
+    ASSERT_EQ(100u, list.size());
+    EXPECT_EQ(99, list.back().get<int32_t>("index"));
+    EXPECT_EQ("element", list.front().get<std::string>("name"));
+}
+
+
+TEST(Serialization, StreamWriterMatchesTree) {
+    StorageContainer tree;
+    tree.set<int32_t>("answer", 42);
+    StorageList list;
+    for (int32_t i = 0; i < 3; ++i) {
+        StorageContainer element;
+        element.set<int32_t>("index", i);
+        element.set<Ogre::Vector3>("position", Ogre::Vector3(i, 0, 0));
+        list.append(std::move(element));
+    }
+    tree.set<StorageList>("list", list);
+    StorageContainer nested;
+    nested.set<std::string>("name", "nested");
+    tree.set<StorageContainer>("nested", nested);
+    std::ostringstream treeStream(std::ios_base::out | std::ios_base::binary);
+    treeStream << tree;
+    std::ostringstream streamed(std::ios_base::out | std::ios_base::binary);
+    StorageStreamWriter writer(streamed);
+    writer.beginContainer(3);
+    writer.write<int32_t>("answer", 42);
+    writer.beginList("list", list.size());
+    for (const auto& element : list) {
+        writer.writeElement(element);
+    }
+    writer.end();
+    writer.beginContainer("nested", 1);
+    writer.write<std::string>("name", "nested");
+    writer.end();
+    writer.end();
+    EXPECT_TRUE(writer.isComplete());
+    EXPECT_EQ(treeStream.str(), streamed.str());
+}
+
+
+TEST(Serialization, StreamWriterChecksSizes) {
+    std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+    StorageStreamWriter writer(stream);
+    writer.beginContainer(1);
+    EXPECT_THROW(writer.end(), std::logic_error);
+    EXPECT_THROW(writer.writeElement(StorageContainer()), std::logic_error);
+    writer.write<bool>("flag", true);
+    EXPECT_THROW(writer.write<bool>("flag", true), std::logic_error);
+    writer.end();
+    EXPECT_TRUE(writer.isComplete());
+}
+
+
+TEST(Serialization, ParallelSerializationIsDeterministic) {
+    auto serialize = [] (size_t index) {
+        StorageContainer container;
+        container.set<int32_t>("index", 7);
+        // Keys that no thread has seen before
+        container.set<std::string>("parallelKey" + boost::lexical_cast<std::string>(index % 4), "value");
+        std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+        stream << container;
+        return stream.str();
+    };
+    std::vector<std::string> results(64);
+    parallelFor(results.size(), [&] (size_t i) {
+        StorageArena::Scope arenaScope(StorageArena::create());
+        results[i] = serialize(i);
+    });
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(serialize(i), results[i]);
+    }
+}
+
+
+TEST(Serialization, LuaTableRoundTrip) {
+    LuaState L;
+    initializeLua(L);
+    ASSERT_TRUE(L.doString(
+        "storage = StorageContainer()\n"
+        "storage:fromTable{\n"
+        "    flag = true,\n"
+        "    number = 42.5,\n"
+        "    text = 'hello',\n"
+        "    position = Vector3(1, 2, 3),\n"
+        "    nested = { value = 1 },\n"
+        "    items = { { q = 1 }, { q = 2 } },\n"
+        "    empty = {}\n"
+        "}\n"
+        "t = storage:toTable()\n"
+        "roundTrip = t.flag and t.number == 42.5 and t.text == 'hello' and\n"
+        "    t.position == Vector3(1, 2, 3) and t.nested.value == 1 and\n"
+        "    #t.items == 2 and t.items[2].q == 2 and #t.empty == 0\n"
+    ));
+    luabind::object globals = luabind::globals(L);
+    EXPECT_TRUE(luabind::object_cast<bool>(globals["roundTrip"]));
+    StorageContainer storage = luabind::object_cast<StorageContainer>(globals["storage"]);
+    EXPECT_EQ(42.5, storage.get<double>("number"));
+    EXPECT_EQ(Ogre::Vector3(1, 2, 3), storage.get<Ogre::Vector3>("position"));
+    ASSERT_EQ(2u, storage.get<StorageList>("items").size());
+    EXPECT_TRUE(storage.contains<StorageContainer>("empty"));
+    EXPECT_FALSE(L.doString("StorageContainer():fromTable{ f = print }"));
+}
+
+
+TEST(Serialization, LuaTableSequencesOfValues) {
+    LuaState L;
+    initializeLua(L);
+    ASSERT_TRUE(L.doString(
+        "storage = StorageContainer()\n"
+        "storage:fromTable{\n"
+        "    points = { Vector3(1, 2, 3), Vector3(4, 5, 6) },\n"
+        "    containers = { StorageContainer(), {} },\n"
+        "    empty = {}\n"
+        "}\n"
+        "t = storage:toTable()\n"
+        "roundTrip = t.points['2'] == Vector3(4, 5, 6) and\n"
+        "    #t.containers == 2 and next(t.empty) == nil\n"
+    ));
+    luabind::object globals = luabind::globals(L);
+    EXPECT_TRUE(luabind::object_cast<bool>(globals["roundTrip"]));
+    StorageContainer storage = luabind::object_cast<StorageContainer>(globals["storage"]);
+    StorageContainer points = storage.get<StorageContainer>("points");
+    EXPECT_EQ(Ogre::Vector3(1, 2, 3), points.get<Ogre::Vector3>("1"));
+    EXPECT_EQ(2u, storage.get<StorageList>("containers").size());
+    EXPECT_TRUE(storage.contains<StorageContainer>("empty"));
+}
+
+
+TEST(Serialization, LuaView) {
+    LuaState L;
+    initializeLua(L);
+    ASSERT_TRUE(L.doString(
+        "storage = StorageContainer()\n"
+        "storage:fromTable{\n"
+        "    number = 42.5,\n"
+        "    nested = { value = 1 },\n"
+        "    items = { { q = 1 }, { q = 2 } }\n"
+        "}\n"
+        "v = storage:view()\n"
+        "lazy = rawget(v, 'nested') == nil\n"
+        "items = storage:get('items', StorageList()):toTable()\n"
+        "view = v.number == 42.5 and v.nested.value == 1 and\n"
+        "    #v.items == 2 and v.items[2].q == 2 and v.items[3] == nil and\n"
+        "    v.missing == nil and #items == 2 and items[1].q == 1\n"
+        "readOnly = not pcall(function() v.number = 1 end)\n"
+        "w = storage:view()\n"
+        "storage:set('number', 7)\n"
+        "copyOnWrite = w.number == 42.5 and storage:get('number', 0) == 7\n"
+    ));
+    luabind::object globals = luabind::globals(L);
+    EXPECT_TRUE(luabind::object_cast<bool>(globals["lazy"]));
+    EXPECT_TRUE(luabind::object_cast<bool>(globals["view"]));
+    EXPECT_TRUE(luabind::object_cast<bool>(globals["readOnly"]));
+    EXPECT_TRUE(luabind::object_cast<bool>(globals["copyOnWrite"]));
+}
@@ -0,0 +1,109 @@
+#include "engine/shared_storage.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrive;
+
+
+static StorageContainer
+sphere(
+    float radius
+) {
+    StorageContainer storage;
+    storage.set<uint8_t>("shapeType", 6);
+    storage.set<float>("radius", radius);
+    return storage;
+}
+
+
+TEST(SharedStorageTable, IdenticalTreesAreStoredOnce) {
+    SharedStorageTable table;
+    uint64_t first = table.add(sphere(1.0f));
+    uint64_t second = table.add(sphere(1.0f));
+    uint64_t third = table.add(sphere(2.0f));
+    EXPECT_EQ(first, second);
+    EXPECT_NE(first, third);
+    EXPECT_EQ(2u, table.storage().size());
+    EXPECT_EQ(2.0f, table.get(third).get<float>("radius"));
+}
+
+
+TEST(SharedStorageTable, CollidingTreesGetDifferentIds) {
+    // An entry whose id is another tree's fingerprint, as if both trees
+    // hashed to the same value
+    StorageContainer entry;
+    entry.set<uint64_t>("id", sphere(1.0f).fingerprint());
+    entry.set("storage", sphere(2.0f));
+    StorageList entries;
+    entries.append(std::move(entry));
+    SharedStorageTable table(entries);
+    uint64_t id = table.add(sphere(1.0f));
+    EXPECT_NE(sphere(1.0f).fingerprint(), id);
+    EXPECT_EQ(1.0f, table.get(id).get<float>("radius"));
+    EXPECT_EQ(2.0f, table.get(sphere(1.0f).fingerprint()).get<float>("radius"));
+    EXPECT_EQ(id, table.add(sphere(1.0f)));
+}
+
+
+TEST(SharedStorageTable, ShareWithoutTableStoresInline) {
+    StorageContainer storage = SharedStorageTable::share(sphere(1.0f));
+    EXPECT_EQ(1.0f, storage.get<float>("radius"));
+    EXPECT_EQ(1.0f, SharedStorageTable::resolve(storage).get<float>("radius"));
+}
+
+
+TEST(SharedStorageTable, ShareAndResolve) {
+    SharedStorageTable table;
+    StorageContainer reference;
+    {
+        SharedStorageTable::Scope scope(&table);
+        reference = SharedStorageTable::share(sphere(1.0f));
+    }
+    EXPECT_FALSE(reference.contains("radius"));
+    EXPECT_THROW(SharedStorageTable::resolve(reference), std::out_of_range);
+    // Round trip through storage
+    SharedStorageTable loaded(table.storage());
+    SharedStorageTable::Scope scope(&loaded);
+    EXPECT_EQ(1.0f, SharedStorageTable::resolve(reference).get<float>("radius"));
+}
+
+
+TEST(SharedStorageTable, ObjectsAreBuiltOnce) {
+    SharedStorageTable table;
+    uint64_t id = table.add(sphere(1.0f));
+    int calls = 0;
+    auto load = [&calls] (const StorageContainer& storage) {
+        ++calls;
+        return std::make_shared<float>(storage.get<float>("radius"));
+    };
+    std::shared_ptr<float> first = table.object<float>(id, load);
+    std::shared_ptr<float> second = table.object<float>(id, load);
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1.0f, *first);
+}
+
+
+TEST(SharedStorageTable, StorageOfRootFollowsNestedReferences) {
+    SharedStorageTable table;
+    StorageContainer root;
+    {
+        SharedStorageTable::Scope scope(&table);
+        // Unreferenced
+        SharedStorageTable::share(sphere(3.0f));
+        StorageList childShapes;
+        childShapes.append(SharedStorageTable::share(sphere(1.0f)));
+        childShapes.append(SharedStorageTable::share(sphere(1.0f)));
+        StorageContainer compound;
+        compound.set<uint8_t>("shapeType", 3);
+        compound.set("childShapes", std::move(childShapes));
+        root.set("shape", SharedStorageTable::share(compound));
+    }
+    EXPECT_EQ(3u, table.storage().size());
+    StorageList referenced = table.storage(root);
+    ASSERT_EQ(2u, referenced.size());
+    EXPECT_LT(
+        referenced[0].get<uint64_t>("id"),
+        referenced[1].get<uint64_t>("id")
+    );
+}
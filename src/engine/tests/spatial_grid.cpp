@@ -0,0 +1,135 @@
+#include "engine/spatial_grid.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace thrive;
+
+
+static std::vector<EntityId>
+sorted(
+    std::vector<EntityId> entities
+) {
+    std::sort(entities.begin(), entities.end());
+    return entities;
+}
+
+
+TEST(SpatialGrid, SetPositionAndRemove) {
+    SpatialGrid grid(1.0f);
+    grid.setPosition(1, Ogre::Vector3(0.5f, 0.5f, 0.0f));
+    grid.setPosition(2, Ogre::Vector3(5.5f, 0.5f, 0.0f));
+    EXPECT_EQ(2u, grid.size());
+    EXPECT_TRUE(grid.contains(1));
+    // Moving doesn't add
+    grid.setPosition(1, Ogre::Vector3(-3.5f, 2.5f, 0.0f));
+    EXPECT_EQ(2u, grid.size());
+    grid.remove(1);
+    grid.remove(1);
+    EXPECT_EQ(1u, grid.size());
+    EXPECT_FALSE(grid.contains(1));
+    std::vector<EntityId> result;
+    grid.queryRadius(Ogre::Vector3(5.5f, 0.5f, 0.0f), 0.1f, result);
+    EXPECT_EQ(std::vector<EntityId>({2}), result);
+}
+
+
+TEST(SpatialGrid, QueryRadius) {
+    SpatialGrid grid(2.0f);
+    grid.setPosition(1, Ogre::Vector3(0.0f, 0.0f, 0.0f));
+    grid.setPosition(2, Ogre::Vector3(3.0f, 0.0f, 0.0f));
+    grid.setPosition(3, Ogre::Vector3(0.0f, -4.0f, 0.0f));
+    // z is ignored
+    grid.setPosition(4, Ogre::Vector3(2.0f, 2.0f, 100.0f));
+    std::vector<EntityId> result;
+    grid.queryRadius(Ogre::Vector3::ZERO, 3.0f, result);
+    EXPECT_EQ(std::vector<EntityId>({1, 2, 4}), sorted(result));
+    result.clear();
+    grid.queryRadius(Ogre::Vector3(0.0f, -4.0f, 0.0f), 0.5f, result);
+    EXPECT_EQ(std::vector<EntityId>({3}), result);
+}
+
+
+TEST(SpatialGrid, QueryBox) {
+    SpatialGrid grid(1.0f);
+    grid.setPosition(1, Ogre::Vector3(0.5f, 0.5f, 0.0f));
+    grid.setPosition(2, Ogre::Vector3(-1.5f, 0.5f, 0.0f));
+    grid.setPosition(3, Ogre::Vector3(2.5f, 2.5f, 0.0f));
+    std::vector<EntityId> result;
+    grid.queryBox(
+        Ogre::Vector3(-2.0f, 0.0f, 0.0f),
+        Ogre::Vector3(1.0f, 1.0f, 0.0f),
+        result
+    );
+    EXPECT_EQ(std::vector<EntityId>({1, 2}), sorted(result));
+}
+
+
+TEST(SpatialGrid, QueryNearest) {
+    SpatialGrid grid(1.0f);
+    grid.setPosition(1, Ogre::Vector3(10.0f, 0.0f, 0.0f));
+    grid.setPosition(2, Ogre::Vector3(1.0f, 0.0f, 0.0f));
+    grid.setPosition(3, Ogre::Vector3(0.0f, -3.0f, 0.0f));
+    grid.setPosition(4, Ogre::Vector3(-50.0f, 0.0f, 0.0f));
+    std::vector<EntityId> result;
+    grid.queryNearest(Ogre::Vector3::ZERO, 3, result);
+    EXPECT_EQ(std::vector<EntityId>({2, 3, 1}), result);
+    result.clear();
+    grid.queryNearest(Ogre::Vector3::ZERO, 10, result, 5.0f);
+    EXPECT_EQ(std::vector<EntityId>({2, 3}), result);
+    // Query point far outside the occupied cells
+    result.clear();
+    grid.queryNearest(Ogre::Vector3(1000.0f, 1000.0f, 0.0f), 1, result);
+    EXPECT_EQ(std::vector<EntityId>({1}), result);
+}
+
+
+TEST(SpatialGrid, MatchesBruteForce) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    SpatialGrid grid(7.0f);
+    std::vector<Ogre::Vector3> positions(500);
+    for (EntityId id = 0; id < positions.size(); ++id) {
+        positions[id] = Ogre::Vector3(coordinate(random), coordinate(random), 0.0f);
+        grid.setPosition(id, positions[id]);
+    }
+    // Move and remove some
+    for (EntityId id = 0; id < positions.size(); id += 3) {
+        positions[id] = Ogre::Vector3(coordinate(random), coordinate(random), 0.0f);
+        grid.setPosition(id, positions[id]);
+    }
+    for (EntityId id = 1; id < positions.size(); id += 7) {
+        grid.remove(id);
+    }
+    grid.setCellSize(5.0f);
+    auto isRemoved = [] (EntityId id) {
+        return id % 7 == 1;
+    };
+    for (int i = 0; i < 20; ++i) {
+        Ogre::Vector3 center(coordinate(random), coordinate(random), 0.0f);
+        float radius = 15.0f;
+        std::vector<EntityId> expected;
+        std::vector<std::pair<float, EntityId>> byDistance;
+        for (EntityId id = 0; id < positions.size(); ++id) {
+            if (isRemoved(id)) {
+                continue;
+            }
+            float distance = center.distance(positions[id]);
+            if (distance <= radius) {
+                expected.push_back(id);
+            }
+            byDistance.emplace_back(distance, id);
+        }
+        std::vector<EntityId> result;
+        grid.queryRadius(center, radius, result);
+        EXPECT_EQ(expected, sorted(result));
+        std::sort(byDistance.begin(), byDistance.end());
+        result.clear();
+        grid.queryNearest(center, 5, result);
+        ASSERT_EQ(5u, result.size());
+        for (size_t k = 0; k < result.size(); ++k) {
+            EXPECT_EQ(byDistance[k].second, result[k]);
+        }
+    }
+}
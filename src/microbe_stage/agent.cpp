@@ -1,5 +1,8 @@
 #include "microbe_stage/agent.h"
 
+#include "bullet/bullet_ogre_conversion.h"
+#include "bullet/collision_shape.h"
+#include "bullet/contact_event_system.h"
 #include "bullet/rigid_body_system.h"
 #include "engine/component_factory.h"
 #include "engine/engine.h"
@@ -9,6 +12,7 @@
 #include "scripting/luabind.h"
 #include "util/random.h"
 
+#include <btBulletDynamicsCommon.h>
 #include <OgreEntity.h>
 #include <OgreSceneManager.h>
 
@@ -267,8 +271,15 @@ struct AgentMovementSystem::Implementation {
 
     EntityFilter<
         AgentComponent,
-        RigidBodyComponent
-    > m_entities;
+        OgreSceneNodeComponent
+    > m_entities = {true};
+
+    // Shared by all sensors
+    CollisionShape::Ptr m_sensorShape;
+
+    std::unordered_map<EntityId, std::unique_ptr<btCollisionObject>> m_sensors;
+
+    btDiscreteDynamicsWorld* m_world = nullptr;
 };
 
 
@@ -287,23 +298,76 @@ AgentMovementSystem::init(
 ) {
     System::init(engine);
     m_impl->m_entities.setEntityManager(&engine->entityManager());
+    m_impl->m_sensorShape = CollisionShape::intern(
+        std::make_shared<SphereShape>(0.01)
+    );
+    m_impl->m_world = engine->physicsWorld();
+    assert(m_impl->m_world != nullptr && "World object is null. Initialize the Engine first.");
 }
 
 
 void
 AgentMovementSystem::shutdown() {
+    for (const auto& pair : m_impl->m_sensors) {
+        m_impl->m_world->removeCollisionObject(pair.second.get());
+    }
+    m_impl->m_sensors.clear();
     m_impl->m_entities.setEntityManager(nullptr);
+    m_impl->m_sensorShape.reset();
+    m_impl->m_world = nullptr;
     System::shutdown();
 }
 
 
 void
 AgentMovementSystem::update(int milliseconds) {
+    for (EntityId entityId : m_impl->m_entities.removedEntities()) {
+        auto iter = m_impl->m_sensors.find(entityId);
+        if (iter != m_impl->m_sensors.end()) {
+            m_impl->m_world->removeCollisionObject(iter->second.get());
+            m_impl->m_sensors.erase(iter);
+        }
+    }
+    EntityManager& entityManager = this->engine()->entityManager();
+    for (const auto& added : m_impl->m_entities.addedEntities()) {
+        EntityId entityId = added.first;
+        // Savegames from before sensors gave agents a rigid body, which
+        // held the authoritative position
+        auto legacyBody = entityManager.getComponent<RigidBodyComponent>(entityId);
+        if (legacyBody) {
+            OgreSceneNodeComponent* sceneNodeComponent = std::get<1>(added.second);
+            sceneNodeComponent->m_transform.position = legacyBody->m_dynamicProperties.position;
+            sceneNodeComponent->m_transform.touch();
+            entityManager.removeComponent(entityId, RigidBodyComponent::TYPE_ID);
+        }
+        // Neither a rigid body nor in the solver, only collision detection
+        std::unique_ptr<btCollisionObject> sensor(new btCollisionObject());
+        sensor->setCollisionShape(m_impl->m_sensorShape->bulletShape());
+        sensor->setCollisionFlags(
+            btCollisionObject::CF_KINEMATIC_OBJECT |
+            btCollisionObject::CF_NO_CONTACT_RESPONSE
+        );
+        sensor->setActivationState(DISABLE_DEACTIVATION);
+        sensor->setUserPointer(reinterpret_cast<void*>(entityId));
+        m_impl->m_world->addCollisionObject(
+            sensor.get(),
+            btBroadphaseProxy::SensorTrigger,
+            btBroadphaseProxy::AllFilter & (~ btBroadphaseProxy::SensorTrigger)
+        );
+        m_impl->m_sensors[entityId] = std::move(sensor);
+    }
+    m_impl->m_entities.clearChanges();
     for (auto& value : m_impl->m_entities) {
         AgentComponent* agentComponent = std::get<0>(value.second);
-        RigidBodyComponent* rigidBodyComponent = std::get<1>(value.second);
+        OgreSceneNodeComponent* sceneNodeComponent = std::get<1>(value.second);
+        auto& transform = sceneNodeComponent->m_transform;
         Ogre::Vector3 delta = agentComponent->m_velocity * float(milliseconds) / 1000.0f;
-        rigidBodyComponent->m_dynamicProperties.position += delta;
+        if (not delta.isZeroLength()) {
+            transform.position += delta;
+            transform.touch();
+        }
+        btCollisionObject* sensor = m_impl->m_sensors[value.first].get();
+        sensor->getWorldTransform().setOrigin(ogreToBullet(transform.position));
     }
 }
 
@@ -386,15 +450,7 @@ AgentEmitterSystem::update(int milliseconds) {
                 auto agentSceneNodeComponent = make_unique<OgreSceneNodeComponent>();
                 agentSceneNodeComponent->m_transform.scale = emitterComponent->m_particleScale;
                 agentSceneNodeComponent->m_meshName = emitterComponent->m_meshName;
-                // Collision Hull
-                auto agentRigidBodyComponent = make_unique<RigidBodyComponent>(
-                    btBroadphaseProxy::SensorTrigger,
-                    btBroadphaseProxy::AllFilter & (~ btBroadphaseProxy::SensorTrigger)
-                );
-                agentRigidBodyComponent->m_properties.shape = std::make_shared<SphereShape>(0.01);
-                agentRigidBodyComponent->m_properties.hasContactResponse = false;
-                agentRigidBodyComponent->m_properties.kinematic = true;
-                agentRigidBodyComponent->m_dynamicProperties.position = sceneNodeComponent->m_transform.position + emissionPosition;
+                agentSceneNodeComponent->m_transform.position = sceneNodeComponent->m_transform.position + emissionPosition;
                 // Agent Component
                 auto agentComponent = make_unique<AgentComponent>();
                 agentComponent->m_timeToLive = emitterComponent->m_particleLifetime;
@@ -405,7 +461,6 @@ AgentEmitterSystem::update(int milliseconds) {
                 std::list<std::unique_ptr<Component>> components;
                 components.emplace_back(std::move(agentSceneNodeComponent));
                 components.emplace_back(std::move(agentComponent));
-                components.emplace_back(std::move(agentRigidBodyComponent));
                 for (auto& component : components) {
                     entityManager.addComponent(
                         agentEntityId,
@@ -432,7 +487,7 @@ struct AgentAbsorberSystem::Implementation {
         AgentComponent
     > m_agents;
 
-    btDiscreteDynamicsWorld* m_world = nullptr;
+    ContactEventSystem* m_contacts = nullptr;
 
 };
 
@@ -453,7 +508,7 @@ AgentAbsorberSystem::init(
     System::init(engine);
     m_impl->m_absorbers.setEntityManager(&engine->entityManager());
     m_impl->m_agents.setEntityManager(&engine->entityManager());
-    m_impl->m_world = engine->physicsWorld();
+    m_impl->m_contacts = &engine->contactEventSystem();
 }
 
 
@@ -461,7 +516,7 @@ void
 AgentAbsorberSystem::shutdown() {
     m_impl->m_absorbers.setEntityManager(nullptr);
     m_impl->m_agents.setEntityManager(nullptr);
-    m_impl->m_world = nullptr;
+    m_impl->m_contacts = nullptr;
     System::shutdown();
 }
 
@@ -472,14 +527,10 @@ AgentAbsorberSystem::update(int) {
         AgentAbsorberComponent* absorber = std::get<0>(entry.second);
         absorber->m_absorbedAgents.clear();
     }
-    auto dispatcher = m_impl->m_world->getDispatcher();
-    int numManifolds = dispatcher->getNumManifolds();
-    for (int i = 0; i < numManifolds; i++) {
-        btPersistentManifold* contactManifold = dispatcher->getManifoldByIndexInternal(i);
-        auto objectA = static_cast<const btCollisionObject*>(contactManifold->getBody0());
-        auto objectB = static_cast<const btCollisionObject*>(contactManifold->getBody1());
-        EntityId entityA = reinterpret_cast<size_t>(objectA->getUserPointer());
-        EntityId entityB = reinterpret_cast<size_t>(objectB->getUserPointer());
+    // Only new contacts, an agent is absorbed when it first touches
+    for (const ContactEvent& contact : m_impl->m_contacts->begun()) {
+        EntityId entityA = contact.entityA;
+        EntityId entityB = contact.entityB;
         AgentAbsorberComponent* absorber = nullptr;
         AgentComponent* agent = nullptr;
         if (
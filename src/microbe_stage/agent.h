@@ -317,6 +317,16 @@ private:
 
 /**
 * @brief Moves agent particles around
+*
+* Agents only need to know when they touch an absorber. Instead of a rigid
+* body, this system gives each agent a bare collision object that takes
+* part in collision detection, but not in the solver, and moves it along
+* with the agent's OgreSceneNodeComponent. Contacts are reported through
+* the ContactEventSystem like those of rigid bodies.
+*
+* Agents from older savegames still have a RigidBodyComponent. It is
+* removed when the agent shows up, after its position has been copied
+* to the scene node.
 */
 class AgentMovementSystem : public System {
 
@@ -82,6 +82,7 @@ OgreCameraComponent::load(
     m_properties.polygonMode = static_cast<Ogre::PolygonMode>(
         storage.get<int16_t>("polygonMode", Ogre::PM_SOLID)
     );
+    m_properties.touch();
 }
 
 
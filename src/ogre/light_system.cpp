@@ -81,6 +81,7 @@ OgreLightComponent::load(
     m_properties.type = static_cast<Ogre::Light::LightTypes>(
         storage.get<int16_t>("lightType", Ogre::Light::LT_POINT)
     );
+    m_properties.touch();
 }
 
 
@@ -82,6 +82,7 @@ OgreSceneNodeComponent::load(
     m_transform.scale = storage.get<Ogre::Vector3>("scale", Ogre::Vector3(1,1,1));
     m_meshName = storage.get<Ogre::String>("meshName");
     m_parentId = storage.get<EntityId>("parentId", NULL_ENTITY);
+    m_transform.touch();
 }
 
 
@@ -58,6 +58,7 @@ SkyPlaneComponent::load(
     m_properties.xsegments = storage.get<int>("xsegments");
     m_properties.ysegments = storage.get<int>("ysegments");
     m_properties.groupName = storage.get<Ogre::String>("groupName");
+    m_properties.touch();
 }
 
 
@@ -83,6 +83,7 @@ TextOverlayComponent::load(
         storage.get<uint8_t>("verticalAlignment", Ogre::GVA_TOP)
     );
     m_properties.width = storage.get<Ogre::Real>("width", 100.0f);
+    m_properties.touch();
 }
 
 
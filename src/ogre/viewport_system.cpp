@@ -77,6 +77,7 @@ OgreViewportComponent::load(
     m_properties.top = storage.get<Ogre::Real>("top");
     m_properties.width = storage.get<Ogre::Real>("width");
     m_zOrder = storage.get<int32_t>("zOrder");
+    m_properties.touch();
 }
 
 
@@ -0,0 +1,203 @@
+#include "util/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/thread.hpp>
+#include <condition_variable>
+#include <exception>
+#include <list>
+#include <mutex>
+
+using namespace thrive;
+
+namespace {
+
+/**
+* @brief The jobs of one parallelFor() call
+*/
+struct Batch {
+
+    /**
+    * @brief Runs jobs until none are left or one failed
+    */
+    void
+    work() {
+        size_t i;
+        while (not m_failed and (i = m_next++) < m_count) {
+            try {
+                (*m_job)(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                if (not m_error) {
+                    m_error = std::current_exception();
+                }
+                m_failed = true;
+            }
+        }
+    }
+
+    bool
+    hasWork() const {
+        return not m_failed and m_next < m_count;
+    }
+
+    size_t m_count = 0;
+
+    std::exception_ptr m_error;
+
+    std::mutex m_errorMutex;
+
+    std::atomic<bool> m_failed {false};
+
+    const std::function<void(size_t)>* m_job = nullptr;
+
+    std::atomic<size_t> m_next {0};
+
+    // Workers currently in work(), guarded by the pool's mutex
+    size_t m_workers = 0;
+
+};
+
+
+/**
+* @brief Threads that help out with the batches of all parallelFor() calls
+*/
+class WorkerPool {
+
+public:
+
+    /**
+    * @brief The pool, started on first use
+    *
+    * Never destroyed. Its threads only ever wait for work, joining them
+    * during static destruction would gain nothing.
+    */
+    static WorkerPool&
+    instance() {
+        static WorkerPool* pool = new WorkerPool(
+            std::max(boost::thread::hardware_concurrency(), 1u) - 1
+        );
+        return *pool;
+    }
+
+    /**
+    * @brief Makes \a batch available to the workers
+    */
+    void
+    add(
+        Batch& batch
+    ) {
+        if (m_workerCount == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_batches.push_back(&batch);
+        }
+        m_workAvailable.notify_all();
+    }
+
+    /**
+    * @brief Withdraws \a batch and waits for the workers still on it
+    */
+    void
+    remove(
+        Batch& batch
+    ) {
+        if (m_workerCount == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_batches.remove(&batch);
+        m_workerDone.wait(lock, [&batch] () {
+            return batch.m_workers == 0;
+        });
+    }
+
+private:
+
+    explicit WorkerPool(
+        unsigned int workerCount
+    ) : m_workerCount(workerCount)
+    {
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            boost::thread([this] () { this->run(); }).detach();
+        }
+    }
+
+    /**
+    * @brief Worker loop
+    */
+    void
+    run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            Batch* batch = nullptr;
+            m_workAvailable.wait(lock, [this, &batch] () {
+                for (Batch* candidate : m_batches) {
+                    if (candidate->hasWork()) {
+                        batch = candidate;
+                        return true;
+                    }
+                }
+                return false;
+            });
+            batch->m_workers += 1;
+            lock.unlock();
+            batch->work();
+            lock.lock();
+            batch->m_workers -= 1;
+            if (batch->m_workers == 0) {
+                m_workerDone.notify_all();
+            }
+        }
+    }
+
+    // Batches that may still have jobs left, oldest first
+    std::list<Batch*> m_batches;
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_workAvailable;
+
+    const unsigned int m_workerCount;
+
+    std::condition_variable m_workerDone;
+
+};
+
+} // namespace
+
+
+void
+thrive::parallelFor(
+    size_t count,
+    const std::function<void(size_t)>& job,
+    const std::function<void()>& callerFirst
+) {
+    Batch batch;
+    batch.m_count = count;
+    batch.m_job = &job;
+    WorkerPool& pool = WorkerPool::instance();
+    if (count > 0) {
+        pool.add(batch);
+    }
+    if (callerFirst) {
+        try {
+            callerFirst();
+        }
+        catch (...) {
+            batch.m_failed = true;
+            pool.remove(batch);
+            throw;
+        }
+    }
+    if (count > 0) {
+        batch.work();
+        pool.remove(batch);
+    }
+    if (batch.m_error) {
+        std::rethrow_exception(batch.m_error);
+    }
+}
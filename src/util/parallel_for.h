@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace thrive {
+
+/**
+* @brief Runs \a job for each index in [0, count) on all cores
+*
+* Indices are handed out one at a time, so jobs of uneven size are
+* balanced across threads. The calling thread works along and the
+* function returns once all jobs are done.
+*
+* The jobs run on a pool of one thread per additional core that is
+* started with the first call and kept for the lifetime of the program,
+* so calling this often in a row is cheap. Calls from several threads,
+* and from inside a job, share the pool.
+*
+* If a job throws, the remaining jobs are skipped and the first exception
+* is rethrown on the calling thread.
+*
+* @param count
+*   Number of jobs
+* @param job
+*   Called with each index, on an unspecified thread
+* @param callerFirst
+*   If set, runs on the calling thread before it joins the workers. Use
+*   this for work that must stay on the calling thread, like calls into
+*   Lua.
+*/
+void
+parallelFor(
+    size_t count,
+    const std::function<void(size_t)>& job,
+    const std::function<void()>& callerFirst = nullptr
+);
+
+}